@@ -2,3 +2,82 @@ PROJECT_CEEDLING_ROOT = "vendor/ceedling"
 load "#{PROJECT_CEEDLING_ROOT}/lib/rakefile.rb"
 
 task :default => %w[ test:all release ]
+
+# Headless builds: the model and engine as a static library with no
+# display dependencies, and the UCI executable linked against it.
+HEADLESS_ROOT    = "build/headless"
+HEADLESS_CFLAGS  = "-O2 -Wall -Isrc/model -Isrc/engine -Isrc/utils"
+HEADLESS_SOURCES = FileList["src/model/*.c", "src/engine/*.c", "src/utils/*.c"]
+HEADLESS_OBJECTS = HEADLESS_SOURCES.pathmap("#{HEADLESS_ROOT}/obj/%n.o")
+HEADLESS_LIB     = "#{HEADLESS_ROOT}/libjegchess.a"
+HEADLESS_UCI     = "#{HEADLESS_ROOT}/jegChess-uci"
+HEADLESS_TBGEN   = "#{HEADLESS_ROOT}/jegChess-tbgen"
+HEADLESS_PGNINDEX = "#{HEADLESS_ROOT}/jegChess-pgnindex"
+HEADLESS_BOOKBUILD = "#{HEADLESS_ROOT}/jegChess-bookbuild"
+
+directory "#{HEADLESS_ROOT}/obj"
+
+HEADLESS_SOURCES.zip(HEADLESS_OBJECTS).each do |source, object|
+  file object => [source, "#{HEADLESS_ROOT}/obj"] do
+    sh "gcc #{HEADLESS_CFLAGS} -c #{source} -o #{object}"
+  end
+end
+
+file HEADLESS_LIB => HEADLESS_OBJECTS do
+  sh "ar rcs #{HEADLESS_LIB} #{HEADLESS_OBJECTS.join(' ')}"
+end
+
+file HEADLESS_UCI => [HEADLESS_LIB, "src/cli/uci.c"] do
+  sh "gcc #{HEADLESS_CFLAGS} src/cli/uci.c #{HEADLESS_LIB} -lpthread -lm -o #{HEADLESS_UCI}"
+end
+
+file HEADLESS_TBGEN => [HEADLESS_LIB, "src/cli/tbgen.c"] do
+  sh "gcc #{HEADLESS_CFLAGS} src/cli/tbgen.c #{HEADLESS_LIB} -lpthread -lm -o #{HEADLESS_TBGEN}"
+end
+
+file HEADLESS_PGNINDEX => [HEADLESS_LIB, "src/cli/pgnindex.c"] do
+  sh "gcc #{HEADLESS_CFLAGS} src/cli/pgnindex.c #{HEADLESS_LIB} -lpthread -lm -o #{HEADLESS_PGNINDEX}"
+end
+
+file HEADLESS_BOOKBUILD => [HEADLESS_LIB, "src/cli/bookbuild.c"] do
+  sh "gcc #{HEADLESS_CFLAGS} src/cli/bookbuild.c #{HEADLESS_LIB} -lpthread -lm -o #{HEADLESS_BOOKBUILD}"
+end
+
+# The piece art, packed into one texture atlas that the display compiles
+# in (see src/display/piece_atlas.h).  Point JEGCHESS_IMG_DIR at the art.
+ATLAS_IMG_DIR = ENV.fetch("JEGCHESS_IMG_DIR", "/usr/share/jegChess/img")
+ATLAS_PACKER  = "#{HEADLESS_ROOT}/jegChess-atlaspack"
+ATLAS_DATA    = "src/display/piece_atlas_data.h"
+
+file ATLAS_PACKER => ["src/cli/atlaspack.c", "src/display/piece_atlas.h", "#{HEADLESS_ROOT}/obj"] do
+  sh "gcc -O2 -Wall src/cli/atlaspack.c -o #{ATLAS_PACKER}"
+end
+
+file ATLAS_DATA => [ATLAS_PACKER] + FileList["#{ATLAS_IMG_DIR}/*.bmp"] do
+  sh "#{ATLAS_PACKER} #{ATLAS_IMG_DIR} #{ATLAS_DATA}"
+end
+
+namespace :display do
+  desc "Pack the piece art into the display's texture atlas"
+  task :atlas => ATLAS_DATA
+end
+
+# The display can't compile without the atlas
+task :release => "display:atlas"
+
+namespace :headless do
+  desc "Build the display-free model/engine library"
+  task :lib => HEADLESS_LIB
+
+  desc "Build the jegChess-uci engine executable"
+  task :uci => HEADLESS_UCI
+
+  desc "Build the jegChess-tbgen endgame tablebase generator"
+  task :tbgen => HEADLESS_TBGEN
+
+  desc "Build the jegChess-pgnindex position index tool"
+  task :pgnindex => HEADLESS_PGNINDEX
+
+  desc "Build the jegChess-bookbuild explorer and book builder"
+  task :bookbuild => HEADLESS_BOOKBUILD
+end
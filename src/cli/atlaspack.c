@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../display/piece_atlas.h"
+
+/*
+ * jegChess-atlaspack: pack the piece art into the display's texture
+ * atlas (see piece_atlas.h) at build time.
+ *
+ *   jegChess-atlaspack IMAGE_DIR OUTPUT
+ *
+ * IMAGE_DIR holds the original art: each piece drawn on a black and on a
+ * white square (e.g. white_knight_on_black.bmp), uncompressed 24 or 32
+ * bit BMPs of one size.  Comparing the two versions of a piece tells the
+ * piece from its background: a pixel that is the same on both squares is
+ * solid piece, one that differs by the full range is background.  That
+ * difference is the pixel's transparency, and the version on black is
+ * already the piece's color premultiplied by its alpha.
+ */
+
+struct bmp_image {
+  int width;
+  int height;
+  uint8_t *bgr;               /* (strong) 3 bytes a pixel, top row first */
+};
+typedef struct bmp_image bmp_image_t;
+
+static const char *type_names[PIECE_ATLAS_TYPES] = {
+  "rook", "knight", "bishop", "king", "queen", "pawn"
+};
+static const char *color_names[PIECE_ATLAS_COLORS] = { "white", "black" };
+
+static uint32_t read_le(const uint8_t *data, int bytes);
+static int atlaspack_load_bmp(const char *path, bmp_image_t *image);
+static int atlaspack_write(const char *path, const char *source,
+                           const uint8_t *pixels, int sprite, int cell);
+
+int main(int argc, char **argv)
+{
+  bmp_image_t on_black, on_white;
+  uint8_t *pixels = NULL;
+  char path[4096];
+  int sprite = 0, cell = 1, width, color, type, x, y, i;
+  int status = 1;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s IMAGE_DIR OUTPUT\n", argv[0]);
+    return 1;
+  }
+
+  for (color = 0; color < PIECE_ATLAS_COLORS; color++) {
+    for (type = 0; type < PIECE_ATLAS_TYPES; type++) {
+      snprintf(path, sizeof(path), "%s/%s_%s_on_black.bmp", argv[1],
+               color_names[color], type_names[type]);
+      if (atlaspack_load_bmp(path, &on_black)) goto done;
+      snprintf(path, sizeof(path), "%s/%s_%s_on_white.bmp", argv[1],
+               color_names[color], type_names[type]);
+      if (atlaspack_load_bmp(path, &on_white)) {
+        free(on_black.bgr);
+        goto done;
+      }
+      if (on_black.width != on_white.width ||
+          on_black.height != on_white.height ||
+          on_black.width != on_black.height ||
+          (sprite && on_black.width != sprite)) {
+        fprintf(stderr, "%s: sprites must be square and of one size\n",
+                path);
+        free(on_black.bgr);
+        free(on_white.bgr);
+        goto done;
+      }
+
+      /* The first sprite decides the layout */
+      if (!pixels) {
+        sprite = on_black.width;
+        while (cell < sprite) cell <<= 1;
+        pixels = calloc((size_t)PIECE_ATLAS_COLUMNS * PIECE_ATLAS_ROWS *
+                        cell * cell, 4);
+        if (!pixels) {
+          free(on_black.bgr);
+          free(on_white.bgr);
+          goto done;
+        }
+      }
+
+      width = PIECE_ATLAS_COLUMNS * cell;
+      for (y = 0; y < sprite; y++) {
+        for (x = 0; x < sprite; x++) {
+          const uint8_t *dark = &on_black.bgr[3 * (y * sprite + x)];
+          const uint8_t *light = &on_white.bgr[3 * (y * sprite + x)];
+          uint8_t *out = &pixels[4 * ((color * cell + y) * width +
+                                      type * cell + x)];
+          int spread = 0, alpha;
+
+          for (i = 0; i < 3; i++) spread += light[i] - dark[i];
+          alpha = 255 - spread / 3;
+          if (alpha < 0) alpha = 0;
+          if (alpha > 255) alpha = 255;
+          out[0] = dark[2] < alpha ? dark[2] : alpha;
+          out[1] = dark[1] < alpha ? dark[1] : alpha;
+          out[2] = dark[0] < alpha ? dark[0] : alpha;
+          out[3] = alpha;
+        }
+      }
+      free(on_black.bgr);
+      free(on_white.bgr);
+    }
+  }
+
+  status = atlaspack_write(argv[2], argv[1], pixels, sprite, cell);
+
+done:
+  free(pixels);
+  return status;
+}
+
+/*
+ *   read_le
+ * Read a little-endian integer of 'bytes' bytes
+ */
+static uint32_t read_le(const uint8_t *data, int bytes)
+{
+  uint32_t value = 0;
+  while (bytes--) value = value << 8 | data[bytes];
+  return value;
+}
+
+/*
+ *   atlaspack_load_bmp
+ * Read an uncompressed 24 or 32 bit BMP file
+ *   @param path the file
+ *   @param image receives the pixels, which the caller frees
+ *   @return 0 on success, 1 (after saying why) on failure
+ */
+static int atlaspack_load_bmp(const char *path, bmp_image_t *image)
+{
+  uint8_t header[54];
+  FILE *file = fopen(path, "rb");
+  long offset, stride;
+  int bpp, bottom_up, x, y;
+  uint8_t *row;
+
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+  if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+      memcmp(header, "BM", 2) != 0) {
+    fprintf(stderr, "%s: not a BMP file\n", path);
+    fclose(file);
+    return 1;
+  }
+
+  offset = read_le(header + 10, 4);
+  image->width = (int32_t)read_le(header + 18, 4);
+  image->height = (int32_t)read_le(header + 22, 4);
+  bpp = read_le(header + 28, 2);
+  bottom_up = image->height > 0;
+  if (!bottom_up) image->height = -image->height;
+  if ((bpp != 24 && bpp != 32) || read_le(header + 30, 4) != 0 ||
+      image->width <= 0 || image->width > 4096 || image->height > 4096) {
+    fprintf(stderr, "%s: only uncompressed 24/32 bit BMPs are supported\n",
+            path);
+    fclose(file);
+    return 1;
+  }
+
+  stride = ((long)image->width * bpp + 31) / 32 * 4;
+  row = malloc(stride);
+  image->bgr = malloc((size_t)image->width * image->height * 3);
+  if (!row || !image->bgr || fseek(file, offset, SEEK_SET) != 0) {
+    fprintf(stderr, "%s: could not read the pixels\n", path);
+    free(row);
+    free(image->bgr);
+    fclose(file);
+    return 1;
+  }
+
+  for (y = 0; y < image->height; y++) {
+    uint8_t *out = &image->bgr[3 * (size_t)image->width *
+                               (bottom_up ? image->height - 1 - y : y)];
+    if (fread(row, 1, stride, file) != (size_t)stride) {
+      fprintf(stderr, "%s: truncated\n", path);
+      free(row);
+      free(image->bgr);
+      fclose(file);
+      return 1;
+    }
+    for (x = 0; x < image->width; x++)
+      memcpy(&out[3 * x], &row[x * bpp / 8], 3);
+  }
+
+  free(row);
+  fclose(file);
+  return 0;
+}
+
+/*
+ *   atlaspack_write
+ * Write the atlas as a C header, under a temporary name first so a
+ * failed build never leaves half of one behind
+ *   @return 0 on success, 1 on failure
+ */
+static int atlaspack_write(const char *path, const char *source,
+                           const uint8_t *pixels, int sprite, int cell)
+{
+  size_t size = (size_t)PIECE_ATLAS_COLUMNS * PIECE_ATLAS_ROWS * cell *
+                cell * 4, i;
+  char temp[4096 + 8];
+  FILE *file;
+  int ok;
+
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+  if (!(file = fopen(temp, "w")) ) {
+    perror(temp);
+    return 1;
+  }
+
+  fprintf(file,
+          "/* Generated by jegChess-atlaspack from %s; do not edit */\n"
+          "#define PIECE_ATLAS_SPRITE %d\n"
+          "#define PIECE_ATLAS_CELL   %d\n"
+          "#define PIECE_ATLAS_WIDTH  %d\n"
+          "#define PIECE_ATLAS_HEIGHT %d\n\n"
+          "static const unsigned char piece_atlas_pixels[%zu] = {",
+          source, sprite, cell, PIECE_ATLAS_COLUMNS * cell,
+          PIECE_ATLAS_ROWS * cell, size);
+  for (i = 0; i < size; i++)
+    fprintf(file, "%s0x%02x,", i % 12 ? " " : "\n  ", pixels[i]);
+  fprintf(file, "\n};\n");
+
+  ok = !ferror(file);
+  if (fclose(file) != 0) ok = 0;
+  if (!ok || rename(temp, path) != 0) {
+    fprintf(stderr, "Could not write %s\n", path);
+    remove(temp);
+    return 1;
+  }
+  return 0;
+}
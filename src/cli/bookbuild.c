@@ -0,0 +1,68 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../engine/book.h"
+#include "../engine/explorer.h"
+
+/*
+ * jegChess-bookbuild: count the opening moves of a PGN database into an
+ * explorer table and a Polyglot book (see the BookFile UCI option).
+ *
+ *   jegChess-bookbuild [-j threads] [-m megabytes] [-t tempdir]
+ *                      [-p plies] [-g games] [-k random64.bin]
+ *                      GAMES.pgn EXPLORER [BOOK]
+ */
+
+static void bookbuild_usage(const char *program);
+
+int main(int argc, char **argv)
+{
+  const char *keys_path = NULL;
+  explorer_options_t options;
+  book_keys_t *keys;
+  int i, status;
+
+  explorer_default_options(&options);
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (i + 1 >= argc) break;
+    if (!strcmp(argv[i], "-j")) options.threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-m"))
+      options.memory = (size_t)atol(argv[++i]) << 20;
+    else if (!strcmp(argv[i], "-t")) options.temp_dir = argv[++i];
+    else if (!strcmp(argv[i], "-p")) options.max_ply = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-g")) options.book_min_games = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-k")) keys_path = argv[++i];
+    else break;
+  }
+  if (argc - i < 2 || argc - i > 3 || !options.memory) {
+    bookbuild_usage(argv[0]);
+    return 1;
+  }
+
+  if (!(keys = book_keys_load(keys_path))) {
+    fprintf(stderr, "Could not load the Random64 table %s\n",
+            keys_path ? keys_path : "(standard)");
+    return 1;
+  }
+  status = explorer_build(argv[i], argv[i + 1], argc - i == 3 ? argv[i + 2]
+                          : NULL, keys, &options, stdout);
+  book_keys_destroy(keys);
+  if (status) {
+    fprintf(stderr, "Could not build from %s\n", argv[i]);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ *   bookbuild_usage
+ * Print the command line syntax
+ */
+static void bookbuild_usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [-j threads] [-m megabytes] [-t tempdir] [-p plies]\n"
+          "          [-g games] [-k random64.bin] GAMES.pgn EXPLORER [BOOK]\n",
+          program);
+}
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../model/board.h"
+#include "../model/fen.h"
+#include "../model/pgn.h"
+#include "../model/position_index.h"
+
+/*
+ * jegChess-pgnindex: index the positions of a PGN database, and look up
+ * the games that reached a position.
+ *
+ *   jegChess-pgnindex build [-j threads] [-m megabytes] [-t tempdir]
+ *                           GAMES.pgn INDEX
+ *   jegChess-pgnindex query [-n max] INDEX GAMES.pgn FEN...
+ */
+
+#define PGNINDEX_DEFAULT_MEMORY 1024    /* Megabytes */
+#define PGNINDEX_DEFAULT_HITS   20
+
+static int pgnindex_build(int argc, char **argv);
+static int pgnindex_query(int argc, char **argv);
+static bool pgnindex_print(const pgn_game_t *game, void *user);
+static void pgnindex_usage(const char *program);
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && !strcmp(argv[1], "build"))
+    return pgnindex_build(argc, argv);
+  if (argc > 1 && !strcmp(argv[1], "query"))
+    return pgnindex_query(argc, argv);
+  pgnindex_usage(argv[0]);
+  return 1;
+}
+
+/*
+ *   pgnindex_build
+ * The build command
+ */
+static int pgnindex_build(int argc, char **argv)
+{
+  long threads = sysconf(_SC_NPROCESSORS_ONLN), megabytes;
+  const char *temp_dir = ".";
+  int i;
+
+  megabytes = PGNINDEX_DEFAULT_MEMORY;
+  if (threads < 1) threads = 1;
+  for (i = 2; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-j") && i + 1 < argc) threads = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+      megabytes = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) temp_dir = argv[++i];
+    else break;
+  }
+  if (argc - i != 2 || megabytes < 1) {
+    pgnindex_usage(argv[0]);
+    return 1;
+  }
+
+  if (position_index_build(argv[i], argv[i + 1], temp_dir, threads,
+                           (size_t)megabytes << 20, stdout)) {
+    fprintf(stderr, "Could not index %s\n", argv[i]);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ *   pgnindex_query
+ * The query command: for each FEN, the games that reached it, with
+ * their players read from the PGN file
+ */
+static int pgnindex_query(int argc, char **argv)
+{
+  position_index_t *index;
+  position_hit_t *hits;
+  struct timespec start, end;
+  pgn_file_t *file;
+  board_t *board;
+  long max = PGNINDEX_DEFAULT_HITS, found, shown, j;
+  int i = 2;
+
+  if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+    max = atol(argv[i + 1]);
+    i += 2;
+  }
+  if (argc - i < 3 || max < 1) {
+    pgnindex_usage(argv[0]);
+    return 1;
+  }
+  if (!(index = position_index_open(argv[i]))) {
+    fprintf(stderr, "Could not open index %s\n", argv[i]);
+    return 1;
+  }
+  if (!(file = pgn_open(argv[i + 1])) ||
+      !(hits = malloc(max * sizeof(position_hit_t)))) {
+    fprintf(stderr, "Could not open %s\n", argv[i + 1]);
+    pgn_close(file);
+    position_index_close(index);
+    return 1;
+  }
+
+  for (i += 2; i < argc; i++) {
+    if (!(board = fen_board(argv[i]))) {
+      fprintf(stderr, "Bad FEN: %s\n", argv[i]);
+      continue;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    found = position_index_query(index, board->hash, hits, max);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    board_destroy(board);
+
+    printf("%s\n  %ld games (%.3f ms)\n", argv[i], found,
+           (end.tv_sec - start.tv_sec) * 1e3 +
+           (end.tv_nsec - start.tv_nsec) / 1e6);
+    shown = found < max ? found : max;
+    for (j = 0; j < shown; j++) {
+      if (hits[j].game >= file->size) continue;
+      printf("  ply %-4d ", hits[j].ply);
+      pgn_read_buffer(file->data + hits[j].game, file->size - hits[j].game,
+                      false, pgnindex_print, NULL);
+    }
+  }
+  free(hits);
+  pgn_close(file);
+  position_index_close(index);
+  return 0;
+}
+
+/*
+ *   pgnindex_print
+ * Print one line about a game and stop reading
+ */
+static bool pgnindex_print(const pgn_game_t *game, void *user)
+{
+  char white[64] = "?", black[64] = "?", event[64] = "?", date[16] = "?";
+
+  (void)user;
+  pgn_tag_value(game, "White", white, sizeof(white));
+  pgn_tag_value(game, "Black", black, sizeof(black));
+  pgn_tag_value(game, "Event", event, sizeof(event));
+  pgn_tag_value(game, "Date", date, sizeof(date));
+  printf("%s - %s, %s %s\n", white, black, event, date);
+  return false;
+}
+
+/*
+ *   pgnindex_usage
+ * Print the command line syntax
+ */
+static void pgnindex_usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s build [-j threads] [-m megabytes] [-t tempdir] "
+          "GAMES.pgn INDEX\n"
+          "       %s query [-n max] INDEX GAMES.pgn FEN...\n",
+          program, program);
+}
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../engine/tablebase.h"
+#include "../engine/tablebase_gen.h"
+
+/*
+ * jegChess-tbgen: build endgame tablebase files for the engine to probe
+ * (see the TablebasePath UCI option).
+ *
+ *   jegChess-tbgen [-j threads] [-d dir] SIGNATURE...
+ *   jegChess-tbgen [-j threads] [-d dir] --all PIECES
+ *
+ * Signatures name the pieces of each side, e.g. KRvKN.  Smaller tables
+ * a signature depends on are built first if they aren't in 'dir' yet.
+ */
+
+static void tbgen_usage(const char *program);
+
+int main(int argc, char **argv)
+{
+  const char *dir = ".";
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int i, all = 0;
+
+  if (threads < 1) threads = 1;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      threads = atol(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+      dir = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--all") && i + 1 < argc) {
+      all = atoi(argv[++i]);
+    }
+    else {
+      tbgen_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (all < 3 ? i == argc : i != argc) {
+    tbgen_usage(argv[0]);
+    return 1;
+  }
+
+  if (all) {
+    if (tablebase_generate_all(all, dir, threads, stdout)) {
+      fprintf(stderr, "Could not generate all %d-piece tables\n", all);
+      return 1;
+    }
+    return 0;
+  }
+
+  for (; i < argc; i++) {
+    if (tablebase_generate(argv[i], dir, threads, stdout)) {
+      fprintf(stderr, "Could not generate %s\n", argv[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ *   tbgen_usage
+ * Print the command line syntax
+ */
+static void tbgen_usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [-j threads] [-d dir] SIGNATURE...\n"
+          "       %s [-j threads] [-d dir] --all PIECES (3..%d)\n",
+          program, program, TB_MAX_PIECES);
+}
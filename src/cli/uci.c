@@ -0,0 +1,484 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Import Objects from the Chess model and engine (no display code) */
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/timer.h"
+#include "../model/fen.h"
+#include "../engine/engine.h"
+#include "../engine/search.h"
+#include "../engine/trans_table.h"
+#include "../engine/eval.h"
+
+/*
+ * jegChess-uci: the engine speaking the Universal Chess Interface over
+ * stdin/stdout, for tournament managers and GUIs.  Commands are read one
+ * line at a time on the main thread; search output is written from the
+ * engine's search thread.
+ *
+ * Besides the standard commands, "bench" measures the search, and
+ * "profile [reset]" prints (or zeroes) the per-region cycle counters of
+ * timer.h.  With TIMER_PROFILE_ENV set they are also printed to stderr
+ * on "quit".
+ */
+
+#define UCI_LINE_MAX  8192
+#define UCI_HASH_MAX  4096
+
+/* Default "bench" settings: search depth and number of MultiPV lines */
+#define UCI_BENCH_DEPTH  8
+#define UCI_BENCH_LINES  4
+
+/* Option values that are applied per search rather than to the engine */
+struct uci_options {
+  int multipv;
+  bool own_book;
+  bool book_best_only;
+  char book_file[UCI_LINE_MAX];
+  char book_keys[UCI_LINE_MAX];
+};
+typedef struct uci_options uci_options_t;
+
+/* Bench positions, as move sequences from the starting position */
+static const char *bench_positions[] = {
+  "",
+  "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",
+  "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+  "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6",
+  "d2d4 d7d5 c2c4 c7c6 g1f3 g8f6 b1c3 d5c4 a2a4 c8f5 e2e3 e7e6 f1c4 f8b4",
+};
+#define UCI_BENCH_POSITIONS \
+  (int)(sizeof(bench_positions) / sizeof(bench_positions[0]))
+
+static void uci_position(engine_t *engine, char *args);
+static void uci_go(engine_t *engine, uci_options_t *options, char *args);
+static void uci_setoption(engine_t *engine, uci_options_t *options,
+                          char *args);
+static void uci_bench(engine_t *engine, char *args);
+static void uci_update_book(engine_t *engine, uci_options_t *options);
+static uint64_t bench_search(engine_t *engine, const char *moves, int depth,
+                             int multipv);
+static void uci_on_info(const search_info_t *info, void *user);
+static void uci_on_bestmove(uint16_t best, uint16_t ponder, void *user);
+
+int main()
+{
+  char line[UCI_LINE_MAX];
+  char *command, *args;
+  uci_options_t options = {1, false, false, "", ""};
+
+  engine_t *engine = engine_init(TRANS_TABLE_DEFAULT_MB);
+  if (!engine) {
+    printf("info string Error initializing engine\n");
+    return 1;
+  }
+  engine_set_callbacks(engine, uci_on_info, uci_on_bestmove, NULL);
+
+  while (fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    command = strtok_r(line, " \t", &args);
+    if (!command) continue;
+
+    /* Replies of more than one call lock stdout (never while waiting on
+     * the search, which needs it to report) so that no "info" line of a
+     * running search lands in the middle of them
+     */
+    if (!strcmp(command, "uci")) {
+      flockfile(stdout);
+      printf("id name jegChess\n");
+      printf("id author jeg90\n");
+      printf("option name Hash type spin default %d min 1 max %d\n",
+             TRANS_TABLE_DEFAULT_MB, UCI_HASH_MAX);
+      printf("option name Ponder type check default false\n");
+      printf("option name MultiPV type spin default 1 min 1 max %d\n",
+             SEARCH_MAX_MULTIPV);
+      printf("option name OwnBook type check default false\n");
+      printf("option name BookFile type string default <empty>\n");
+      printf("option name BookKeys type string default <empty>\n");
+      printf("option name BookBestOnly type check default false\n");
+      printf("option name TablebasePath type string default <empty>\n");
+      printf("uciok\n");
+      funlockfile(stdout);
+    }
+    else if (!strcmp(command, "isready")) {
+      printf("readyok\n");
+    }
+    else if (!strcmp(command, "ucinewgame")) {
+      engine_stop(engine);
+      engine_wait(engine);
+      engine_new_game(engine);
+    }
+    else if (!strcmp(command, "position")) {
+      uci_position(engine, args);
+    }
+    else if (!strcmp(command, "go")) {
+      uci_go(engine, &options, args);
+    }
+    else if (!strcmp(command, "ponderhit")) {
+      engine_ponderhit(engine);
+    }
+    else if (!strcmp(command, "stop")) {
+      engine_stop(engine);
+      engine_wait(engine);
+    }
+    else if (!strcmp(command, "setoption")) {
+      uci_setoption(engine, &options, args);
+    }
+    else if (!strcmp(command, "bench")) {
+      engine_stop(engine);
+      engine_wait(engine);
+      uci_bench(engine, args);
+    }
+    else if (!strcmp(command, "profile")) {
+      if (args && !strcmp(args, "reset")) timer_profile_reset();
+      else {
+        flockfile(stdout);
+        timer_profile_report(stdout);
+        funlockfile(stdout);
+      }
+    }
+    else if (!strcmp(command, "quit")) {
+      break;
+    }
+    else {
+      printf("info string Unknown command: %s\n", command);
+    }
+    fflush(stdout);
+  }
+
+  engine_destroy(engine);
+  if (getenv(TIMER_PROFILE_ENV)) timer_profile_report(stderr);
+  return 0;
+}
+
+/*
+ *   uci_position
+ * "position startpos [moves m1 m2 ...]" or
+ * "position fen <fen> [moves m1 m2 ...]"
+ *   @param engine the engine to set up
+ *   @param args the rest of the command line
+ */
+static void uci_position(engine_t *engine, char *args)
+{
+  char *save, *token, *moves = strstr(args, "moves");
+  board_t *position = NULL;
+
+  /* Split off the moves first: the FEN itself contains spaces */
+  if (moves) {
+    *moves = '\0';
+    moves += strlen("moves");
+  }
+  token = strtok_r(args, " \t", &save);
+
+  if (token && !strcmp(token, "fen")) {
+    if (!(position = fen_board(save))) {
+      printf("info string Illegal FEN: %s\n", save);
+      return;
+    }
+  }
+  else if (!token || strcmp(token, "startpos")) {
+    printf("info string Expected 'position startpos' or 'position fen'\n");
+    return;
+  }
+  if (engine_set_position(engine, position)) {
+    printf("info string Cannot set up a position while searching\n");
+    return;
+  }
+
+  if (!moves) return;
+  for (token = strtok_r(moves, " \t", &save); token;
+       token = strtok_r(NULL, " \t", &save)) {
+    if (engine_play_move(engine, token)) {
+      printf("info string Illegal move: %s\n", token);
+      return;
+    }
+  }
+}
+
+/*
+ *   uci_go
+ * Parse the search limits and start thinking.  Times are given for both
+ * sides; only the side to move's count.
+ *   @param engine the engine to start
+ *   @param options the per-search option values
+ *   @param args the rest of the command line
+ */
+static void uci_go(engine_t *engine, uci_options_t *options, char *args)
+{
+  search_limits_t limits = {0};
+  color_t us = engine->board->moves_next;
+  char *save, *token, *value;
+
+  for (token = strtok_r(args, " \t", &save); token;
+       token = strtok_r(NULL, " \t", &save)) {
+    if (!strcmp(token, "infinite")) {
+      limits.infinite = true;
+      continue;
+    }
+    if (!strcmp(token, "ponder")) {
+      limits.ponder = true;
+      continue;
+    }
+    if (!(value = strtok_r(NULL, " \t", &save))) break;
+
+    if ((!strcmp(token, "wtime") && us == WHITE) ||
+        (!strcmp(token, "btime") && us == BLACK)) {
+      limits.time.remaining_ms = atoll(value);
+      limits.use_time = true;
+    }
+    else if ((!strcmp(token, "winc") && us == WHITE) ||
+             (!strcmp(token, "binc") && us == BLACK)) {
+      limits.time.increment_ms = atoll(value);
+    }
+    else if (!strcmp(token, "movestogo")) {
+      limits.time.moves_to_go = atoi(value);
+    }
+    else if (!strcmp(token, "movetime")) {
+      limits.time.move_time_ms = atoll(value);
+      limits.use_time = true;
+    }
+    else if (!strcmp(token, "depth")) {
+      limits.depth = atoi(value);
+    }
+    else if (!strcmp(token, "nodes")) {
+      limits.nodes = strtoull(value, NULL, 10);
+    }
+  }
+
+  limits.multipv = options->multipv;
+  if (engine_go(engine, &limits))
+    printf("info string Already searching\n");
+}
+
+/*
+ *   uci_setoption
+ * "setoption name <name> value <value>" for Hash, MultiPV, the book
+ * options and TablebasePath.  Ponder is accepted but needs no setting: the GUI decides
+ * when to send "go ponder".
+ *   @param engine the engine to configure
+ *   @param options the per-search option values
+ *   @param args the rest of the command line
+ */
+static void uci_setoption(engine_t *engine, uci_options_t *options,
+                          char *args)
+{
+  char *name, *value;
+  long size;
+
+  /* Values (file names) may contain spaces: split on " value " */
+  if (!(name = strstr(args, "name ")) || !(value = strstr(name, " value ")))
+    return;
+  name += strlen("name ");
+  *value = '\0';
+  value += strlen(" value ");
+
+  if (!strcmp(name, "Hash")) {
+    size = atol(value);
+    if (size < 1 || size > UCI_HASH_MAX || engine_set_hash(engine, size))
+      printf("info string Could not set Hash to %s\n", value);
+  }
+  else if (!strcmp(name, "MultiPV")) {
+    options->multipv = atoi(value);
+    if (options->multipv < 1) options->multipv = 1;
+    if (options->multipv > SEARCH_MAX_MULTIPV)
+      options->multipv = SEARCH_MAX_MULTIPV;
+  }
+  else if (!strcmp(name, "OwnBook")) {
+    options->own_book = !strcmp(value, "true");
+    uci_update_book(engine, options);
+  }
+  else if (!strcmp(name, "BookFile")) {
+    snprintf(options->book_file, sizeof(options->book_file), "%s",
+             strcmp(value, "<empty>") ? value : "");
+    uci_update_book(engine, options);
+  }
+  else if (!strcmp(name, "BookKeys")) {
+    snprintf(options->book_keys, sizeof(options->book_keys), "%s",
+             strcmp(value, "<empty>") ? value : "");
+    uci_update_book(engine, options);
+  }
+  else if (!strcmp(name, "BookBestOnly")) {
+    options->book_best_only = !strcmp(value, "true");
+    uci_update_book(engine, options);
+  }
+  else if (!strcmp(name, "TablebasePath")) {
+    if (engine_set_tablebase(engine, strcmp(value, "<empty>") ? value : NULL))
+      printf("info string Could not open tablebase directory %s\n", value);
+    else if (engine->tablebase)
+      printf("info string Tablebase: %d tables, up to %d pieces\n",
+             engine->tablebase->num_tables, engine->tablebase->max_pieces);
+  }
+  else if (!strcmp(name, "Ponder")) {
+    return;
+  }
+  else {
+    printf("info string Unknown option: %s\n", name);
+  }
+}
+
+/*
+ *   uci_update_book
+ * (Re)open or close the book to match the book options
+ *   @param engine the engine to configure
+ *   @param options the current option values
+ */
+static void uci_update_book(engine_t *engine, uci_options_t *options)
+{
+  book_select_t select = options->book_best_only ? BOOK_SELECT_BEST
+                                                 : BOOK_SELECT_WEIGHTED;
+
+  if (!options->own_book || !options->book_file[0]) {
+    engine_set_book(engine, NULL, NULL, select);
+    return;
+  }
+  if (engine_set_book(engine, options->book_file,
+                      options->book_keys[0] ? options->book_keys : NULL,
+                      select))
+    printf("info string Could not open book %s with keys %s\n",
+           options->book_file,
+           options->book_keys[0] ? options->book_keys : "(standard)");
+}
+
+/*
+ *   uci_bench
+ * "bench [depth] [lines]": search a fixed set of positions to a fixed
+ * depth, once for a single best line and once in MultiPV mode, each from
+ * an empty transposition table, and report what the extra lines cost.
+ * Independent searches would cost 'lines' times as much.
+ *   @param engine the (idle) engine to benchmark with
+ *   @param args the rest of the command line
+ */
+static void uci_bench(engine_t *engine, char *args)
+{
+  int depth = UCI_BENCH_DEPTH, lines = UCI_BENCH_LINES, i;
+  uint64_t single = 0, multi = 0, nodes;
+  int64_t single_ms, multi_ms;
+  chess_timer_t clock;
+  char *save, *token;
+
+  if ((token = strtok_r(args, " \t", &save))) depth = atoi(token);
+  if ((token = strtok_r(NULL, " \t", &save))) lines = atoi(token);
+  if (depth < 1) depth = UCI_BENCH_DEPTH;
+  if (lines < 2 || lines > SEARCH_MAX_MULTIPV) lines = UCI_BENCH_LINES;
+
+  engine_set_callbacks(engine, NULL, NULL, NULL);
+
+  timer_reset(&clock);
+  timer_start(&clock);
+  for (i = 0; i < UCI_BENCH_POSITIONS; i++)
+    single += bench_search(engine, bench_positions[i], depth, 1);
+  timer_stop(&clock);
+  single_ms = timer_elapsed_ms(&clock);
+
+  timer_reset(&clock);
+  timer_start(&clock);
+  for (i = 0; i < UCI_BENCH_POSITIONS; i++) {
+    nodes = bench_search(engine, bench_positions[i], depth, lines);
+    multi += nodes;
+    printf("info string bench position %d: %llu nodes for %d lines\n",
+           i + 1, (unsigned long long)nodes, lines);
+  }
+  timer_stop(&clock);
+  multi_ms = timer_elapsed_ms(&clock);
+
+  engine_set_callbacks(engine, uci_on_info, uci_on_bestmove, NULL);
+  engine_new_game(engine);
+
+  printf("info string bench depth %d: 1 line %llu nodes %lld ms, "
+         "%d lines %llu nodes %lld ms\n", depth, (unsigned long long)single,
+         (long long)single_ms, lines, (unsigned long long)multi,
+         (long long)multi_ms);
+  printf("info string bench MultiPV %d costs %.2fx the nodes of one line "
+         "(independent searches: %dx)\n", lines,
+         single ? (double)multi / single : 0.0, lines);
+}
+
+/*
+ *   bench_search
+ * One bench search from a fresh game
+ *   @return the number of nodes searched
+ */
+static uint64_t bench_search(engine_t *engine, const char *moves, int depth,
+                             int multipv)
+{
+  search_limits_t limits = {0};
+  char buffer[UCI_LINE_MAX], *save, *token;
+
+  engine_new_game(engine);
+  strncpy(buffer, moves, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+  for (token = strtok_r(buffer, " ", &save); token;
+       token = strtok_r(NULL, " ", &save))
+    engine_play_move(engine, token);
+
+  limits.depth = depth;
+  limits.multipv = multipv;
+  engine_go(engine, &limits);
+  engine_wait(engine);
+  return engine->search->nodes;
+}
+
+/*
+ *   uci_on_info
+ * Search callback: print one "info" line per completed iteration.  The
+ * main thread may be answering "isready" meanwhile, so the line is
+ * formatted first and written with a single call (stdio locks the stream
+ * for each call), never interleaving with other output.
+ */
+static void uci_on_info(const search_info_t *info, void *user)
+{
+  char line[UCI_LINE_MAX], text[6];
+  size_t length;
+  int i;
+  uint64_t nps = info->time_ms > 0 ? info->nodes * 1000 / info->time_ms : 0;
+
+  length = snprintf(line, sizeof(line), "info multipv %d depth %d seldepth %d",
+                    info->multipv, info->depth, info->seldepth);
+  if (info->score >= SEARCH_MATE_BOUND)
+    length += snprintf(line + length, sizeof(line) - length, " score mate %d",
+                       (EVAL_MATE - info->score + 1) / 2);
+  else if (info->score <= -SEARCH_MATE_BOUND)
+    length += snprintf(line + length, sizeof(line) - length, " score mate %d",
+                       -(EVAL_MATE + info->score) / 2);
+  else
+    length += snprintf(line + length, sizeof(line) - length, " score cp %d",
+                       info->score);
+  length += snprintf(line + length, sizeof(line) - length,
+                     " nodes %llu nps %llu time %lld hashfull %d"
+                     " tbhits %llu pv",
+                     (unsigned long long)info->nodes, (unsigned long long)nps,
+                     (long long)info->time_ms, info->hashfull,
+                     (unsigned long long)info->tb_hits);
+  /* SEARCH_MAX_PLY moves of at most 6 chars always fit */
+  for (i = 0; i < info->pv_length; i++) {
+    move_packed_to_string(info->pv[i], text);
+    length += snprintf(line + length, sizeof(line) - length, " %s", text);
+  }
+  snprintf(line + length, sizeof(line) - length, "\n");
+
+  fputs(line, stdout);
+  fflush(stdout);
+}
+
+/*
+ *   uci_on_bestmove
+ * Search callback: print the final "bestmove" line
+ */
+static void uci_on_bestmove(uint16_t best, uint16_t ponder, void *user)
+{
+  char best_text[6], ponder_text[6];
+
+  move_packed_to_string(best, best_text);
+  if (ponder != MOVE_NONE) {
+    move_packed_to_string(ponder, ponder_text);
+    printf("bestmove %s ponder %s\n", best_text, ponder_text);
+  }
+  else {
+    printf("bestmove %s\n", best_text);
+  }
+  fflush(stdout);
+}
@@ -1,238 +1,227 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <math.h>
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES   /* glGenBuffers and friends */
+#endif
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <GL/glut.h>
-#include <SDL/SDL.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include "window-params.h"
 #include "display-data.h"
 #include "cursor.h"
 #include "key-press.h"
+#include "chess-screen.h"
+#include "piece_atlas.h"
+#include PIECE_ATLAS_DATA
 #include "../misc.h"
+#include "../model/timer.h"
+#include "../model/game_io.h"
+#include "../model/journal.h"
+#include "../model/board_snapshot.h"
+#include "../model/move_cache.h"
+#include "../engine/search.h"
 
 /* A pointer to the canonical board-data to display */
 display_data_t* disp_data;
 
-/* Static display resources */
-static GLuint piece_textures[24];
+/* Static display resources: every piece's sprite, in one texture */
+static GLuint piece_atlas_texture;
 
-/*
- *   gl_load_texture
- * This function adds an OpenGL texture to the static piece_textures
- * array.  The code was mostly copied from a tutorial found on
- * nehe.gamedev.net.  My understanding of OpenGL is pretty limited
- * so this code is provided AS-IS at the moment.
- *   @param filename the name of the bmp file to load
- *   @param index the index to load the texture into
- *   @return TRUE if the texture load was successful, FALSE otherwise
- */
-static int
-gl_load_texture(const char *filename,int index)
-{
-  int status = FALSE;
+/* One corner of a quad as the vertex buffers hold it: the board's squares
+ * use the color, the pieces the texture coordinates.
+ */
+struct screen_vertex {
+  GLfloat x, y;
+  GLfloat s, t;
+  GLubyte red, green, blue, alpha;
+};
+typedef struct screen_vertex screen_vertex_t;
+
+#define QUAD_VERTICES 4
+#define MAX_PIECES    32
+
+/* The squares never change, so they're uploaded once at startup.  The
+ * pieces are rebuilt into their own buffer each frame.
+ */
+static GLuint board_vertex_buffer;
+static GLuint piece_vertex_buffer;
 
-  SDL_Surface *texture_image[1];
+/* The computer's best line is drawn as arrows: a shaft (two triangles)
+ * and a head (one), fading out along the line
+ */
+#define ARROW_VERTICES    9
+#define ARROW_SHAFT_WIDTH 0.15f  /* In squares */
+#define ARROW_HEAD_WIDTH  0.45f
+#define ARROW_HEAD_LENGTH 0.4f
+#define ARROW_ALPHA_FIRST 200
+#define ARROW_ALPHA_STEP  40
+
+/* The selected piece's square is tinted, and each square it may move to
+ * marked with a dot TARGET_COEFF of a square across
+ */
+#define TARGET_COEFF    0.3
+#define SELECTED_RGBA   60, 140, 220, 110
+#define TARGET_RGBA     60, 140, 220, 200
 
-  if (texture_image[0] = SDL_LoadBMP(filename)) {
-    status = TRUE;
+/* The evaluation bar, in the left border: WHITE's share of it grows with
+ * WHITE's advantage, and is full EVAL_BAR_RANGE centipawns ahead
+ */
+#define EVAL_BAR_LEFT   (DEFAULT_BORDER_COEFF / 3.0)
+#define EVAL_BAR_WIDTH  (DEFAULT_BORDER_COEFF / 4.0)
+#define EVAL_BAR_RANGE  1000
 
-    glGenTextures(1, &piece_textures[index]);
+/* How often (ms) a running game clock is redrawn */
+#define CLOCK_REFRESH_MS 100
 
-    glBindTexture(GL_TEXTURE_2D, piece_textures[index]);
+/* How often (ms) new positions and finished saves and loads are
+ * picked up
+ */
+#define MODEL_POLL_MS 50
 
-    glTexImage2D(GL_TEXTURE_2D, 0, 3, texture_image[0]->w,
-                 texture_image[0]->h, 0, GL_BGR,
-                 GL_UNSIGNED_BYTE, texture_image[0]->pixels);
+/* The shortest time (ms) between two frames, capping the frame rate */
+#define FRAME_MIN_MS 16
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-  }
+/* Frame pacing: a frame is pending from the first change after a frame
+ * until the next frame is drawn, so any number of changes in between
+ * cost one redraw.
+ */
+static bool frame_pending = false;
+static int last_frame_ms = 0;
 
-  if (texture_image[0]) SDL_FreeSurface(texture_image[0]);
-  return status;
-}
+/* What each side's clock last showed, in its display's units */
+static int64_t clock_shown[2] = { -1, -1 };
+
+/* The version of the published position last drawn */
+static uint64_t board_shown = 0;
 
 /*
- *   load_all_textures
- * Loads all the textures (OpenGL primitives akin to 'pictures') into
- * an global array ('piece_textures')
+ *   load_piece_atlas
+ * Upload the piece atlas compiled into the executable (see piece_atlas.h)
+ * as one texture.  Mipmaps keep the sprites smooth in small windows.
  */
 static void
-load_all_textures()
-{
-  gl_load_texture("/usr/share/jegChess/img/black_rook_on_black.bmp",0);
-  gl_load_texture("/usr/share/jegChess/img/black_rook_on_white.bmp",1);
-  gl_load_texture("/usr/share/jegChess/img/black_knight_on_black.bmp",2);
-  gl_load_texture("/usr/share/jegChess/img/black_knight_on_white.bmp",3);
-  gl_load_texture("/usr/share/jegChess/img/black_bishop_on_black.bmp",4);
-  gl_load_texture("/usr/share/jegChess/img/black_bishop_on_white.bmp",5);
-  gl_load_texture("/usr/share/jegChess/img/black_king_on_black.bmp",6);
-  gl_load_texture("/usr/share/jegChess/img/black_king_on_white.bmp",7);
-  gl_load_texture("/usr/share/jegChess/img/black_queen_on_black.bmp",8);
-  gl_load_texture("/usr/share/jegChess/img/black_queen_on_white.bmp",9);
-  gl_load_texture("/usr/share/jegChess/img/black_pawn_on_black.bmp",10);
-  gl_load_texture("/usr/share/jegChess/img/black_pawn_on_white.bmp",11);
-
-  gl_load_texture("/usr/share/jegChess/img/white_rook_on_black.bmp",12);
-  gl_load_texture("/usr/share/jegChess/img/white_rook_on_white.bmp",13);
-  gl_load_texture("/usr/share/jegChess/img/white_knight_on_black.bmp",14);
-  gl_load_texture("/usr/share/jegChess/img/white_knight_on_white.bmp",15);
-  gl_load_texture("/usr/share/jegChess/img/white_bishop_on_black.bmp",16);
-  gl_load_texture("/usr/share/jegChess/img/white_bishop_on_white.bmp",17);
-  gl_load_texture("/usr/share/jegChess/img/white_king_on_black.bmp",18);
-  gl_load_texture("/usr/share/jegChess/img/white_king_on_white.bmp",19);
-  gl_load_texture("/usr/share/jegChess/img/white_queen_on_black.bmp",20);
-  gl_load_texture("/usr/share/jegChess/img/white_queen_on_white.bmp",21);
-  gl_load_texture("/usr/share/jegChess/img/white_pawn_on_black.bmp",22);
-  gl_load_texture("/usr/share/jegChess/img/white_pawn_on_white.bmp",23);
-}
-
-/*
- *   lookup_texture_index
- * Translates a piece_t struct into the index of the texture
- * to display the piece as on-screen
- *   @param to_draw the piece_t struct to find a texture for
- *   @return the index in the piece_textures array
- */
-static int
-lookup_texture_index(piece_t *to_draw)
+load_piece_atlas()
 {
-  if (!to_draw) return -1;
-
-  /* The texture for a piece is affected by its side (WHITE or BLACK), its
-   * type (ROOK, KNIGHT, etc), and the background square color.
-   */
-  int black_square = (to_draw->rank + to_draw->file) % 2 == 0;
-  int white_square = !black_square;
-
-  switch(to_draw->color) {
-    case BLACK:
-      switch(to_draw->type) {
-        case ROOK:
-          return black_square ? 0 : 1;
-        case KNIGHT:
-          return black_square ? 2 : 3;
-        case BISHOP:
-          return black_square ? 4 : 5;
-        case KING:
-          return black_square ? 6 : 7;
-        case QUEEN:
-          return black_square ? 8 : 9;
-        case PAWN:
-          return black_square ? 10 : 11;
-        default:
-          /* Should prob report an error */
-          return -1;
-      }
-    case WHITE:
-      switch(to_draw->type) {
-        case ROOK:
-          return black_square ? 12 : 13;
-        case KNIGHT:
-          return black_square ? 14 : 15;
-        case BISHOP:
-          return black_square ? 16 : 17;
-        case KING:
-          return black_square ? 18 : 19;
-        case QUEEN:
-          return black_square ? 20 : 21;
-        case PAWN:
-          return black_square ? 22 : 23;
-        default:
-          /* Should prob return an error */
-          return -1;
-      }
-    default:
-      /* Should prob report an error */
-      return -1;
-  }
+  glGenTextures(1, &piece_atlas_texture);
+  glBindTexture(GL_TEXTURE_2D, piece_atlas_texture);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PIECE_ATLAS_WIDTH,
+               PIECE_ATLAS_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               piece_atlas_pixels);
 }
 
 /*
- *   draw_board_square
- * Draw the square of the board located at the given rank and file
+ *   set_quad
+ * Place the four corners of one square's quad, counter-clockwise from
+ * the bottom left
+ *   @param quad the QUAD_VERTICES vertices to fill in
  *   @param rank the rank of the square
  *   @param file the file of the square
  */
 static void
-draw_board_square(int rank, int file)
+set_quad(screen_vertex_t *quad, int rank, int file)
 {
   /* Figure out square's X,Y position */
-  float base_x = DEFAULT_BORDER_COEFF;
-  float base_y = DEFAULT_BORDER_COEFF;
-  float sq_x = base_x + (float)file*SQUARE_WIDTH;
-  float sq_y = base_y + (float)rank*SQUARE_HEIGHT;
-  glPushMatrix();
-    glTranslatef(sq_x,sq_y,0.0);
+  GLfloat sq_x = DEFAULT_BORDER_COEFF + (GLfloat)file * SQUARE_WIDTH;
+  GLfloat sq_y = DEFAULT_BORDER_COEFF + (GLfloat)rank * SQUARE_HEIGHT;
 
-    /* Set the square color */
-    if ( (rank+file)%2==1) glColor3f(1.0,1.0,1.0);
-    else glColor3f(0.0,0.0,0.0);
+  quad[0].x = sq_x;                quad[0].y = sq_y;
+  quad[1].x = sq_x + SQUARE_WIDTH; quad[1].y = sq_y;
+  quad[2].x = sq_x + SQUARE_WIDTH; quad[2].y = sq_y + SQUARE_HEIGHT;
+  quad[3].x = sq_x;                quad[3].y = sq_y + SQUARE_HEIGHT;
 
-    /* Draw the actual square */
-    glBegin(GL_POLYGON);
-      glVertex3f(0.0f,0.0f,0.0f);
-      glVertex3f(SQUARE_WIDTH,0.0f,0.0f);
-      glVertex3f(SQUARE_WIDTH,SQUARE_HEIGHT,0.0f);
-      glVertex3f(0.0f,SQUARE_HEIGHT,0.0f);
-    glEnd();
-  glPopMatrix();
 }
 
 /*
- *   draw_board_squares
- * Iterate through all squares on the chess board, drawing each
+ *   set_sprite
+ * Point a quad's texture coordinates at a piece's sprite in the atlas
+ *   @param quad the QUAD_VERTICES vertices, as set up by set_quad
+ *   @param code the piece, as board_snapshot_squares codes it
  */
 static void
-draw_board_squares()
+set_sprite(screen_vertex_t *quad, uint8_t code)
 {
-  int rank=0, file=0;
-  /* Iterate over all squares */
-  for (rank = 0; rank < BOARD_SIZE; rank++) {
-    for (file = 0; file < BOARD_SIZE; file++) {
-      draw_board_square(rank,file);
-    }
-  }
+  GLfloat left = (GLfloat)((code & 7) * PIECE_ATLAS_CELL) /
+                 PIECE_ATLAS_WIDTH;
+  GLfloat top = (GLfloat)((code >> 3) * PIECE_ATLAS_CELL) /
+                PIECE_ATLAS_HEIGHT;
+  GLfloat right = left + (GLfloat)PIECE_ATLAS_SPRITE / PIECE_ATLAS_WIDTH;
+  GLfloat bottom = top + (GLfloat)PIECE_ATLAS_SPRITE / PIECE_ATLAS_HEIGHT;
+
+  /* The atlas is stored top row first */
+  quad[0].s = left;  quad[0].t = bottom;
+  quad[1].s = right; quad[1].t = bottom;
+  quad[2].s = right; quad[2].t = top;
+  quad[3].s = left;  quad[3].t = top;
 }
 
 /*
- *   draw_board_piece
- * Draws the provided piece_t piece on the chess-screen.
- *   @param to_draw the piece_t struct to be drawn on the chess window
+ *   build_board_vertices
+ * Upload the 64 squares of the board, colors included, into a vertex
+ * buffer drawn as is every frame
  */
 static void
-draw_board_piece(piece_t *to_draw)
+build_board_vertices()
 {
+  screen_vertex_t vertices[BOARD_SIZE * BOARD_SIZE * QUAD_VERTICES];
+  screen_vertex_t *quad = vertices;
+  int rank, file, i;
 
-  /* Figure out square's X,Y position */
-  float base_x = DEFAULT_BORDER_COEFF;
-  float base_y = DEFAULT_BORDER_COEFF;
-  float sq_x = base_x + (float)to_draw->file * SQUARE_WIDTH;
-  float sq_y = base_y + (float)to_draw->rank * SQUARE_HEIGHT;
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++, quad += QUAD_VERTICES) {
+      GLubyte shade = (rank + file) % 2 == 1 ? 255 : 0;
+      set_quad(quad, rank, file);
+      for (i = 0; i < QUAD_VERTICES; i++) {
+        quad[i].red = quad[i].green = quad[i].blue = shade;
+        quad[i].alpha = 255;
+      }
+    }
+  }
 
-  /* Find texture matching piece */
-  int tex_index;
-  tex_index = lookup_texture_index(to_draw);
-  if (tex_index < 0) return; /* If texture couldnt be found, give up */
+  glGenBuffers(1, &board_vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, board_vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glGenBuffers(1, &piece_vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, piece_vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER,
+               MAX_PIECES * QUAD_VERTICES * sizeof(screen_vertex_t), NULL,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-  glBindTexture( GL_TEXTURE_2D, piece_textures[tex_index] );
-  /* Do actual drawing */
-  glPushMatrix();
-    glTranslatef(sq_x,sq_y,0.0);
-    glBegin(GL_QUADS);
-      glColor3f(1.0f,1.0f,1.0f);
-      /* Botton left of texture and quad */
-      glTexCoord2f( 0.0f, 1.0f ); glVertex3f(0.0f,0.0f,0.001f);
-      /* Bottom right of texture and quad */
-      glTexCoord2f( 1.0f, 1.0f ); glVertex3f(SQUARE_WIDTH,0.0f,0.001f);
-      /* Top right of texture and quad */
-      glTexCoord2f( 1.0f, 0.0f ); glVertex3f(SQUARE_WIDTH,SQUARE_HEIGHT,0.001f);
-      /* Top Left of texture and quad */
-      glTexCoord2f( 0.0f, 0.0f ); glVertex3f(0.0f,SQUARE_HEIGHT,0.001f);
-    glEnd();
-  glPopMatrix();
+/*
+ *   draw_board_squares
+ * Draw all squares on the chess board in one call
+ */
+static void
+draw_board_squares()
+{
+  glBindBuffer(GL_ARRAY_BUFFER, board_vertex_buffer);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(screen_vertex_t),
+                  (const GLvoid *)offsetof(screen_vertex_t, x) );
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(screen_vertex_t),
+                 (const GLvoid *)offsetof(screen_vertex_t, red) );
+
+  glDrawArrays(GL_QUADS, 0, BOARD_SIZE * BOARD_SIZE * QUAD_VERTICES);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 /*
@@ -269,44 +258,495 @@ draw_cursor()
 
 /*
  *   draw_board_pieces
- * Iterates through all chess-pieces and draws them on the board
+ * Draws every piece of the latest published position.  The pieces'
+ * quads all go into one buffer and are drawn, with the atlas bound once,
+ * in a single call.  The squares are already drawn; the sprites blend
+ * over them.
  */
 static void
 draw_board_pieces()
 {
-  /* Turn on texture mapping */
-  glEnable(GL_TEXTURE_2D);
-
-  /* Iterate over all squares */
-  int rank = 0, file = 0;
-  for (rank = 0; rank < BOARD_SIZE; rank++) {
-    for (file = 0; file < BOARD_SIZE; file++) {
-      piece_t *piece_to_draw =
-          disp_data->board_on_screen->spaces[rank][file]->piece;
-      if (piece_to_draw) draw_board_piece(piece_to_draw);
-    }
+  screen_vertex_t vertices[MAX_PIECES * QUAD_VERTICES];
+  uint8_t squares[NUM_SQUARES];
+  board_packed_t position;
+  int num_pieces = 0, square;
+
+  board_shown = board_snapshot_read(disp_data->snapshot, &position);
+  board_snapshot_squares(&position, squares);
+  for (square = 0; square < NUM_SQUARES && num_pieces < MAX_PIECES;
+       square++) {
+    if (squares[square] == BOARD_SNAPSHOT_EMPTY) continue;
+    set_quad(&vertices[num_pieces * QUAD_VERTICES], SQUARE_RANK(square),
+             SQUARE_FILE(square) );
+    set_sprite(&vertices[num_pieces * QUAD_VERTICES], squares[square]);
+    num_pieces++;
   }
+  if (num_pieces == 0) return;
+
+  /* Replace the buffer's contents rather than wait on the last frame */
+  glBindBuffer(GL_ARRAY_BUFFER, piece_vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0,
+                  num_pieces * QUAD_VERTICES * sizeof(screen_vertex_t),
+                  vertices);
+
+  /* Turn on texture mapping; the atlas is premultiplied by alpha */
+  glEnable(GL_TEXTURE_2D);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  glBindTexture(GL_TEXTURE_2D, piece_atlas_texture);
+  glColor3f(1.0f, 1.0f, 1.0f);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(screen_vertex_t),
+                  (const GLvoid *)offsetof(screen_vertex_t, x) );
+  glTexCoordPointer(2, GL_FLOAT, sizeof(screen_vertex_t),
+                    (const GLvoid *)offsetof(screen_vertex_t, s) );
+
+  glDrawArrays(GL_QUADS, 0, num_pieces * QUAD_VERTICES);
+
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   /* Turn off texture-mapping..if this isn't done, attempting to draw
    * regular squares creates black dead-space
    */
+  glDisable(GL_BLEND);
   glDisable(GL_TEXTURE_2D);
 }
 
+/*
+ *   set_color
+ * Give a quad's corners one color
+ *   @param quad the QUAD_VERTICES vertices to color
+ */
+static void
+set_color(screen_vertex_t *quad, GLubyte red, GLubyte green, GLubyte blue,
+          GLubyte alpha)
+{
+  int i;
+
+  for (i = 0; i < QUAD_VERTICES; i++) {
+    quad[i].red = red; quad[i].green = green; quad[i].blue = blue;
+    quad[i].alpha = alpha;
+  }
+}
+
+/*
+ *   draw_selection
+ * Tint the selected piece's square and mark every square it may move
+ * to, from the cached legal moves, in one call.  Drawn over the pieces,
+ * so captures show too.
+ */
+static void
+draw_selection()
+{
+  screen_vertex_t vertices[(NUM_SQUARES + 1) * QUAD_VERTICES];
+  screen_vertex_t *quad = vertices;
+  square_t *selected = disp_data->selected_square;
+  uint64_t targets;
+  GLfloat inset_x = (1.0 - TARGET_COEFF) / 2.0 * SQUARE_WIDTH;
+  GLfloat inset_y = (1.0 - TARGET_COEFF) / 2.0 * SQUARE_HEIGHT;
+  int square;
+
+  if (!selected) return;
+  targets = move_cache_targets(disp_data->moves,
+                               SQUARE_INDEX(selected->rank, selected->file) );
+
+  set_quad(quad, selected->rank, selected->file);
+  set_color(quad, SELECTED_RGBA);
+  quad += QUAD_VERTICES;
+  for (square = 0; square < NUM_SQUARES; square++) {
+    if (!(targets >> square & 1) ) continue;
+    set_quad(quad, SQUARE_RANK(square), SQUARE_FILE(square) );
+    quad[0].x += inset_x; quad[0].y += inset_y;
+    quad[1].x -= inset_x; quad[1].y += inset_y;
+    quad[2].x -= inset_x; quad[2].y -= inset_y;
+    quad[3].x += inset_x; quad[3].y -= inset_y;
+    set_color(quad, TARGET_RGBA);
+    quad += QUAD_VERTICES;
+  }
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(screen_vertex_t), &vertices[0].x);
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(screen_vertex_t),
+                 &vertices[0].red);
+
+  glDrawArrays(GL_QUADS, 0, quad - vertices);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisable(GL_BLEND);
+}
+
+/*
+ *   set_arrow
+ * Build an arrow from the middle of one square to the middle of another,
+ * as ARROW_VERTICES triangle corners of one color
+ *   @param arrow the vertices to fill in
+ *   @param from the square the arrow starts on
+ *   @param to the square it points at
+ *   @param alpha how opaque to draw it
+ */
+static void
+set_arrow(screen_vertex_t *arrow, int from, int to, GLubyte alpha)
+{
+  GLfloat x0 = DEFAULT_BORDER_COEFF + (SQUARE_FILE(from) + 0.5) * SQUARE_WIDTH;
+  GLfloat y0 = DEFAULT_BORDER_COEFF + (SQUARE_RANK(from) + 0.5) * SQUARE_WIDTH;
+  GLfloat x1 = DEFAULT_BORDER_COEFF + (SQUARE_FILE(to) + 0.5) * SQUARE_WIDTH;
+  GLfloat y1 = DEFAULT_BORDER_COEFF + (SQUARE_RANK(to) + 0.5) * SQUARE_WIDTH;
+  GLfloat length = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0) );
+  /* Unit vectors along and across the arrow, scaled to a square */
+  GLfloat ax = (x1 - x0) / length * SQUARE_WIDTH;
+  GLfloat ay = (y1 - y0) / length * SQUARE_WIDTH;
+  GLfloat sx = -ay * ARROW_SHAFT_WIDTH / 2, sy = ax * ARROW_SHAFT_WIDTH / 2;
+  GLfloat hx = -ay * ARROW_HEAD_WIDTH / 2, hy = ax * ARROW_HEAD_WIDTH / 2;
+  GLfloat bx = x1 - ax * ARROW_HEAD_LENGTH, by = y1 - ay * ARROW_HEAD_LENGTH;
+  GLfloat corners[ARROW_VERTICES][2] = {
+    { x0 + sx, y0 + sy }, { x0 - sx, y0 - sy }, { bx - sx, by - sy },
+    { x0 + sx, y0 + sy }, { bx - sx, by - sy }, { bx + sx, by + sy },
+    { bx + hx, by + hy }, { bx - hx, by - hy }, { x1, y1 }
+  };
+  int i;
+
+  for (i = 0; i < ARROW_VERTICES; i++) {
+    arrow[i].x = corners[i][0];
+    arrow[i].y = corners[i][1];
+    arrow[i].red = 40; arrow[i].green = 160; arrow[i].blue = 60;
+    arrow[i].alpha = alpha;
+  }
+}
+
+/*
+ *   draw_pv_arrows
+ * Draw the computer's current best line over the board, one arrow per
+ * move, all in a single call
+ *   @param analysis the latest report of the search
+ */
+static void
+draw_pv_arrows(const cpu_analysis_t *analysis)
+{
+  screen_vertex_t vertices[CPU_PLAYER_PV_SHOWN * ARROW_VERTICES];
+  int num_arrows = 0, i, from, to, alpha;
+
+  for (i = 0; i < analysis->pv_length; i++) {
+    from = analysis->pv[i] & 0x3F;
+    to = analysis->pv[i] >> 6 & 0x3F;
+    alpha = ARROW_ALPHA_FIRST - i * ARROW_ALPHA_STEP;
+    if (from == to || alpha <= 0) break;
+    set_arrow(&vertices[num_arrows++ * ARROW_VERTICES], from, to, alpha);
+  }
+  if (num_arrows == 0) return;
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(screen_vertex_t), &vertices[0].x);
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(screen_vertex_t),
+                 &vertices[0].red);
+
+  glDrawArrays(GL_TRIANGLES, 0, num_arrows * ARROW_VERTICES);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisable(GL_BLEND);
+}
+
+/*
+ *   draw_eval_bar
+ * Draw the evaluation bar beside the board: WHITE's part from the
+ * bottom, BLACK's above it
+ *   @param score the evaluation, in centipawns from WHITE's view
+ */
+static void
+draw_eval_bar(int score)
+{
+  float bottom = DEFAULT_BORDER_COEFF;
+  float top = 1.0f - DEFAULT_BORDER_COEFF;
+  float split;
+
+  if (score > EVAL_BAR_RANGE) score = EVAL_BAR_RANGE;
+  if (score < -EVAL_BAR_RANGE) score = -EVAL_BAR_RANGE;
+  split = bottom + (top - bottom) *
+          (0.5f + 0.5f * (float)score / EVAL_BAR_RANGE);
+
+  glBegin(GL_QUADS);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glVertex2f(EVAL_BAR_LEFT, bottom);
+    glVertex2f(EVAL_BAR_LEFT + EVAL_BAR_WIDTH, bottom);
+    glVertex2f(EVAL_BAR_LEFT + EVAL_BAR_WIDTH, split);
+    glVertex2f(EVAL_BAR_LEFT, split);
+    glColor3f(0.0f, 0.0f, 0.0f);
+    glVertex2f(EVAL_BAR_LEFT, split);
+    glVertex2f(EVAL_BAR_LEFT + EVAL_BAR_WIDTH, split);
+    glVertex2f(EVAL_BAR_LEFT + EVAL_BAR_WIDTH, top);
+    glVertex2f(EVAL_BAR_LEFT, top);
+  glEnd();
+}
+
+/*
+ *   draw_search_readout
+ * Print the search's depth, speed and score (as "#n" once it sees a
+ * mate) in the border below the board, right of WHITE's clock
+ *   @param analysis the latest report of the search
+ */
+static void
+draw_search_readout(const cpu_analysis_t *analysis)
+{
+  char text[64], score[16];
+  int64_t knps = analysis->time_ms > 0 ?
+                 (int64_t)analysis->nodes / analysis->time_ms : 0;
+  const char *c;
+
+  if (analysis->score >= SEARCH_MATE_BOUND)
+    snprintf(score, sizeof(score), "#%d",
+             (EVAL_MATE - analysis->score + 1) / 2);
+  else if (analysis->score <= -SEARCH_MATE_BOUND)
+    snprintf(score, sizeof(score), "#-%d",
+             (EVAL_MATE + analysis->score + 1) / 2);
+  else
+    snprintf(score, sizeof(score), "%+.2f", analysis->score / 100.0);
+  snprintf(text, sizeof(text), "depth %d  %lld knps  %s", analysis->depth,
+           (long long)knps, score);
+
+  glColor3f(0.0f, 0.0f, 0.0f);
+  glRasterPos2f(0.5f, DEFAULT_BORDER_COEFF / 2.0f);
+  for (c = text; *c; c++)
+    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
+}
+
+/*
+ *   draw_analysis
+ * Show what the computer is thinking, while it thinks
+ */
+static void
+draw_analysis()
+{
+  const cpu_analysis_t *analysis;
+
+  if (!disp_data->cpu || !disp_data->cpu->has_analysis) return;
+  analysis = &disp_data->cpu->analysis;
+  draw_pv_arrows(analysis);
+  draw_eval_bar(analysis->score);
+  draw_search_readout(analysis);
+}
+
+/*
+ *   clock_shown_value
+ * What a side's clock shows, as a number that changes exactly when the
+ * text does: tenths of a second in the last ten seconds, else seconds
+ *   @param side the player whose clock is read
+ *   @return the value, negated once the side has flagged
+ */
+static int64_t
+clock_shown_value(color_t side)
+{
+  int64_t remaining = game_clock_remaining_ms(disp_data->clock, side);
+  int64_t value;
+
+  if (remaining < 0) remaining = 0;
+  value = remaining < 10000 ? remaining / 100 : 100 + remaining / 1000;
+  return game_clock_flagged(disp_data->clock, side) ? -1 - value : value;
+}
+
+/*
+ *   draw_clock
+ * Print one side's remaining time as M:SS (or S.t in the last ten
+ * seconds) at the given position in the window border.
+ *   @param side the player whose clock is drawn
+ *   @param x the x position of the text
+ *   @param y the y position of the text
+ */
+static void
+draw_clock(color_t side, float x, float y)
+{
+  char text[16];
+  int64_t remaining = game_clock_remaining_ms(disp_data->clock, side);
+  if (remaining < 0) remaining = 0;
+  clock_shown[side] = clock_shown_value(side);
+
+  if (remaining < 10000)
+    snprintf(text, sizeof(text), "%d.%d", (int)(remaining / 1000),
+             (int)(remaining % 1000) / 100);
+  else
+    snprintf(text, sizeof(text), "%d:%02d", (int)(remaining / 60000),
+             (int)(remaining / 1000) % 60);
+
+  /* A flagged side's clock turns red */
+  if (game_clock_flagged(disp_data->clock, side)) glColor3f(0.8f, 0.0f, 0.0f);
+  else glColor3f(0.0f, 0.0f, 0.0f);
+
+  glRasterPos2f(x, y);
+  const char *c;
+  for (c = text; *c; c++)
+    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+}
+
+/*
+ *   draw_clocks
+ * Draw WHITE's clock below the board and BLACK's clock above it
+ */
+static void
+draw_clocks()
+{
+  if (!disp_data->clock || disp_data->clock->mode == GAME_CLOCK_UNTIMED) return;
+
+  draw_clock(WHITE, DEFAULT_BORDER_COEFF, DEFAULT_BORDER_COEFF / 2.0f);
+  draw_clock(BLACK, DEFAULT_BORDER_COEFF, 1.0f - DEFAULT_BORDER_COEFF / 2.0f);
+}
+
+/*
+ *   clock_tick
+ * GLUT timer callback keeping the on-screen clock current.  Redraws are
+ * only requested while a clock is running, and only when its text would
+ * change.
+ *   @param value unused
+ */
+static void
+clock_tick(int value)
+{
+  if (disp_data->clock && disp_data->clock->turn.running &&
+      disp_data->clock->mode != GAME_CLOCK_UNTIMED &&
+      (clock_shown_value(WHITE) != clock_shown[WHITE] ||
+       clock_shown_value(BLACK) != clock_shown[BLACK]) )
+    chess_screen_invalidate(DISPLAY_DIRTY_CLOCK);
+  glutTimerFunc(CLOCK_REFRESH_MS, clock_tick, 0);
+}
+
+/*
+ *   model_poll
+ * GLUT timer callback picking up what other threads did to the model: a
+ * newly published position gets drawn, the computer's latest analysis
+ * is taken off its queue (only the newest report is kept, so a fast
+ * search costs one redraw per poll), its move is played once its
+ * search is done, and saves and loads the game_io worker has
+ * finished are collected.  A loaded game replaces the one on
+ * the board here, on the display thread, which owns the board; the
+ * journal then restarts from it.  The journal's own disk work is posted
+ * to the worker too.  Polling never blocks, so neither a slow disk nor
+ * a busy board owner can stall a frame.
+ *   @param value unused
+ */
+static void
+model_poll(int value)
+{
+  game_io_request_t *request;
+
+  if (board_snapshot_version(disp_data->snapshot) != board_shown)
+    chess_screen_invalidate(DISPLAY_DIRTY_BOARD);
+  if (disp_data->cpu && cpu_player_drain_analysis(disp_data->cpu) )
+    chess_screen_invalidate(DISPLAY_DIRTY_OVERLAY);
+  key_press_poll_cpu();
+
+  while (disp_data->io && (request = game_io_poll(disp_data->io)) ) {
+    if (request->type == GAME_IO_JOURNAL_SYNC ||
+        request->type == GAME_IO_JOURNAL_COMPACT) {
+      if (disp_data->journal &&
+          game_io_journal_done(disp_data->io, request,
+                               disp_data->journal) != 0 &&
+          request->status != 0)
+        fprintf(stderr, "jegChess: could not write the journal\n");
+      game_io_release(request);
+      continue;
+    }
+    if (request->status != 0)
+      fprintf(stderr, "jegChess: could not %s %s\n",
+              request->type == GAME_IO_SAVE ? "save" : "load", request->path);
+    if (request->type == GAME_IO_LOAD && request->status == 0) {
+      /* No search may be running on the game being replaced */
+      key_press_reset();
+      if (game_io_apply(request, disp_data->board_on_screen,
+                        disp_data->history) != 0)
+        fprintf(stderr, "jegChess: %s does not play\n", request->path);
+      if (disp_data->clock)
+        game_clock_reset(disp_data->clock, DEFAULT_CLOCK_BASE_MS);
+      if (disp_data->journal) journal_invalidate(disp_data->journal);
+      chess_screen_board_changed();
+    }
+    game_io_release(request);
+  }
+
+  /* Batched fsyncs and compactions of the journal run on the worker */
+  if (disp_data->io && disp_data->journal)
+    game_io_journal(disp_data->io, disp_data->journal);
+  glutTimerFunc(MODEL_POLL_MS, model_poll, 0);
+}
+
+/*
+ *   frame_due
+ * GLUT timer callback asking for the frame held back by the frame cap
+ *   @param value unused
+ */
+static void
+frame_due(int value)
+{
+  glutPostRedisplay();
+}
+
+/*
+ *   chess_screen_invalidate
+ * Note that something on screen changed and make sure a frame follows.
+ * A frame already pending covers the change; otherwise one is asked for
+ * right away, or once FRAME_MIN_MS have passed since the last.
+ *   @param what the DISPLAY_DIRTY_* bits that changed
+ */
+void
+chess_screen_invalidate(unsigned int what)
+{
+  int wait;
+
+  if (!what) return;
+  disp_data->dirty |= what;
+  if (frame_pending) return;
+
+  frame_pending = true;
+  wait = last_frame_ms + FRAME_MIN_MS - glutGet(GLUT_ELAPSED_TIME);
+  if (wait <= 0) glutPostRedisplay();
+  else glutTimerFunc(wait, frame_due, 0);
+}
+
+/*
+ *   chess_screen_board_changed
+ * Publish board_on_screen after changing it on the display thread, and
+ * draw it in the next frame.  Its cached legal moves are now stale.
+ */
+void
+chess_screen_board_changed(void)
+{
+  move_cache_invalidate(disp_data->moves);
+  board_snapshot_publish(disp_data->snapshot, disp_data->board_on_screen);
+  chess_screen_invalidate(DISPLAY_DIRTY_BOARD);
+}
+
 /*
  *   display
  * The entry point for all actual OpenGL code.  Passed as a function
- * pointer to the OpenGL callback loop.
+ * pointer to the OpenGL callback loop.  GLUT also calls it when the
+ * window is exposed, so it always draws the whole scene into the back
+ * buffer, then swaps.
  */
 static void
 display(void)
 {
+  TIMER_PROFILE_SCOPE(PROFILE_RENDER);
+  frame_pending = false;
+  last_frame_ms = glutGet(GLUT_ELAPSED_TIME);
+
   glClear(GL_COLOR_BUFFER_BIT);
   draw_board_squares();
   draw_board_pieces();
+  draw_selection();
   draw_cursor();
+  draw_analysis();
+  draw_clocks();
 
-  glFlush();
+  disp_data->dirty = 0;
+  glutSwapBuffers();
 }
 
 /*
@@ -325,7 +765,7 @@ glut_init_window(window_params_t* disp)
 
   /* Run glut calls */
   glutInit(&argc, argv);
-  glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
+  glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
   glutInitWindowSize(disp->win_height, disp->win_width);
   glutInitWindowPosition(200,200);
   glutCreateWindow("jegChess");
@@ -347,7 +787,8 @@ gl_init_state(window_params_t *disp)
   glMatrixMode(GL_PROJECTION);
   glLoadIdentity();
   glOrtho(0.0, 1.0, 0.0, 1.0, -1.0, 1.0);
-  load_all_textures();
+  load_piece_atlas();
+  build_board_vertices();
 }
 
 /*
@@ -365,6 +806,12 @@ gl_enter_main_loop()
   glutKeyboardUpFunc(key_press_normal_released);
   glutSpecialUpFunc(key_press_special_released);
 
+  /* Keep the game clock ticking on screen */
+  glutTimerFunc(CLOCK_REFRESH_MS, clock_tick, 0);
+
+  /* Pick up new positions and finished saves and loads */
+  glutTimerFunc(MODEL_POLL_MS, model_poll, 0);
+
   glutMainLoop();
 }
 
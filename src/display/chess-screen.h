@@ -9,6 +9,19 @@
  */
 extern display_data_t* disp_data;
 
+/* Note that the DISPLAY_DIRTY_* parts of the screen changed.  Changes
+ * are drawn together in the next frame, at most one every FRAME_MIN_MS.
+ * Must be called on the display thread.
+ */
+void chess_screen_invalidate(unsigned int what);
+
+/* Publish the board after the display thread changed it (a move, undo
+ * or load), invalidate its cached legal moves, and redraw it.  Other
+ * threads changing the board publish to disp_data->snapshot themselves;
+ * the display picks that up on its own.
+ */
+void chess_screen_board_changed(void);
+
 /*
  *   chess_screen_main
  *  Thread main for the display window.  This code is the ultimate
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/move_gen.h"
+#include "../model/history_stack.h"
+#include "../model/timer.h"
+#include "../engine/engine.h"
+#include "../engine/search.h"
+#include "../utils/queue.h"
+#include "cpu-player.h"
+
+/* Results in flight: the latest search's, and any cancelled ones' */
+#define CPU_PLAYER_QUEUE_SIZE 8
+
+static void set_limits(game_clock_t *clock, color_t side,
+                       search_limits_t *limits);
+static void deliver(uint16_t best, uint16_t ponder, void *player_as_void);
+static void report(const search_info_t *info, void *player_as_void);
+
+/*
+ *   cpu_player_init
+ * Create a player reporting through the engine's bestmove callback
+ *   @param engine the engine to search with
+ *   @return a * to the new cpu_player_t, or NULL on failure
+ */
+cpu_player_t* cpu_player_init(engine_t *engine)
+{
+  cpu_player_t *player = malloc(sizeof(cpu_player_t) );
+  int i;
+
+  if (!player) return NULL;
+  player->results = queue_init(CPU_PLAYER_QUEUE_SIZE);
+  player->free_slots = queue_init(CPU_PLAYER_INFO_SLOTS);
+  player->infos = queue_init(CPU_PLAYER_INFO_SLOTS);
+  if (!player->results || !player->free_slots || !player->infos) {
+    queue_destroy(player->results);
+    queue_destroy(player->free_slots);
+    queue_destroy(player->infos);
+    free(player);
+    return NULL;
+  }
+  for (i = 0; i < CPU_PLAYER_INFO_SLOTS; i++)
+    queue_push(player->free_slots, &player->slots[i]);
+
+  player->engine = engine;
+  atomic_init(&player->generation, 0);
+  player->thinking = false;
+  player->side = WHITE;
+  player->pondering = false;
+  player->ponder_hash = 0;
+  player->has_analysis = false;
+  engine_set_callbacks(engine, report, deliver, player);
+  return player;
+}
+
+/*
+ *   cpu_player_destroy
+ * Cancel any search and cleanup a player
+ *   @param player the cpu_player_t to destroy
+ */
+void cpu_player_destroy(cpu_player_t *player)
+{
+  cpu_result_t *result;
+
+  if (!player) return;
+  cpu_player_cancel(player);
+  engine_set_callbacks(player->engine, NULL, NULL, NULL);
+  while ((result = queue_pop(player->results)) ) free(result);
+  queue_destroy(player->results);
+  queue_destroy(player->free_slots);
+  queue_destroy(player->infos);
+  free(player);
+}
+
+/*
+ *   cpu_player_go
+ * Start the engine on the side to move, or let the ponder search go on
+ * if the opponent played the reply it expected
+ *   @param player the player to move for
+ *   @param history the moves played on the engine's board
+ *   @param clock the game clock, or NULL
+ *   @return 0 on success, -1 on failure
+ */
+int cpu_player_go(cpu_player_t *player, history_stack_t *history,
+                  game_clock_t *clock)
+{
+  engine_t *engine = player->engine;
+  color_t side = engine->board->moves_next;
+  search_limits_t limits = { 0 };
+
+  /* A ponder hit: that search is now the one whose move is wanted */
+  if (player->pondering && player->ponder_hash == engine->board->hash &&
+      engine_ponderhit(engine) == 0) {
+    player->pondering = false;
+    player->thinking = true;
+    return 0;
+  }
+
+  cpu_player_cancel(player);
+  if (engine_set_game_history(engine, history->hashes, history->count))
+    return -1;
+  set_limits(clock, side, &limits);
+
+  /* The new generation is current before the search can report */
+  atomic_fetch_add(&player->generation, 1);
+  player->side = side;
+  player->has_analysis = false;
+  if (engine_go(engine, &limits) != 0) return -1;
+  player->thinking = true;
+  return 0;
+}
+
+/*
+ *   cpu_player_ponder
+ * Search the position after the opponent's expected reply while they
+ * think.  The search copies the board when it starts, so the reply is
+ * played on the game board only for that moment.  Its move isn't wanted
+ * (player->thinking stays false) until cpu_player_go finds the reply
+ * was played.
+ *   @param player the player that just moved
+ *   @param history the moves played on the engine's board
+ *   @param clock the game clock, or NULL
+ *   @param reply the expected reply, packed
+ *   @return 0 if pondering, -1 if not
+ */
+int cpu_player_ponder(cpu_player_t *player, history_stack_t *history,
+                      game_clock_t *clock, uint16_t reply)
+{
+  engine_t *engine = player->engine;
+  board_t *board = engine->board;
+  search_limits_t limits = { 0 };
+  board_undo_t undo;
+  uint64_t *hashes;
+  move_t move;
+  int status;
+
+  cpu_player_cancel(player);
+  if (reply == MOVE_NONE || !move_gen_find_packed(board, reply, &move) ||
+      !(hashes = malloc((history->count + 1) * sizeof(uint64_t) )))
+    return -1;
+  memcpy(hashes, history->hashes, history->count * sizeof(uint64_t) );
+  hashes[history->count] = board->hash;
+  status = engine_set_game_history(engine, hashes, history->count + 1);
+  free(hashes);
+  if (status) return -1;
+
+  board_make_move(board, &move, &undo);
+  set_limits(clock, board->moves_next, &limits);
+  limits.ponder = true;
+  atomic_fetch_add(&player->generation, 1);
+  player->side = board->moves_next;
+  player->ponder_hash = board->hash;
+  status = engine_go(engine, &limits);
+  board_unmake_move(board, &move, &undo);
+  if (status) return -1;
+  player->pondering = true;
+  return 0;
+}
+
+/*
+ *   cpu_player_cancel
+ * Stop the search and make whatever it reports stale
+ *   @param player the player to stop
+ */
+void cpu_player_cancel(cpu_player_t *player)
+{
+  atomic_fetch_add(&player->generation, 1);
+  player->thinking = false;
+  player->pondering = false;
+  player->has_analysis = false;
+  engine_stop(player->engine);
+  engine_wait(player->engine);
+}
+
+/*
+ *   cpu_player_poll
+ * Look for the search's move, dropping stale ones
+ *   @param player the player to poll
+ *   @param best receives the move (MOVE_NONE if there was none)
+ *   @param ponder receives the reply expected (or MOVE_NONE)
+ *   @return true once the wanted search has reported
+ */
+bool cpu_player_poll(cpu_player_t *player, uint16_t *best, uint16_t *ponder)
+{
+  unsigned int current = atomic_load(&player->generation);
+  cpu_result_t *result;
+  bool found = false;
+
+  while (!found && (result = queue_pop(player->results)) ) {
+    if (player->thinking && result->generation == current) {
+      *best = result->best;
+      *ponder = result->ponder;
+      found = true;
+    }
+    free(result);
+  }
+  if (found) {
+    player->thinking = false;
+    player->has_analysis = false;   /* Its line starts from the old board */
+    engine_wait(player->engine);  /* The thread has reported; just join */
+  }
+  return found;
+}
+
+/*
+ *   cpu_player_drain_analysis
+ * Take every posted report, hand its slot back, and keep the newest one
+ * of the search still thinking
+ *   @param player the player to drain
+ *   @return true if player->analysis changed
+ */
+bool cpu_player_drain_analysis(cpu_player_t *player)
+{
+  unsigned int current = atomic_load(&player->generation);
+  cpu_analysis_t *slot;
+  bool changed = false;
+
+  while ((slot = queue_pop(player->infos)) ) {
+    if (player->thinking && slot->generation == current) {
+      player->analysis = *slot;
+      player->has_analysis = changed = true;
+    }
+    queue_push(player->free_slots, slot);
+  }
+  return changed;
+}
+
+/*
+ *   set_limits
+ * Time the search by the clock if it is running, else give it
+ * CPU_PLAYER_MOVETIME_MS
+ *   @param clock the game clock, or NULL
+ *   @param side the side searched for
+ *   @param limits receives the time limits
+ */
+static void set_limits(game_clock_t *clock, color_t side,
+                       search_limits_t *limits)
+{
+  limits->use_time = true;
+  if (clock && clock->mode != GAME_CLOCK_UNTIMED && clock->turn.running) {
+    limits->time.remaining_ms = game_clock_remaining_ms(clock, side);
+    if (clock->mode == GAME_CLOCK_FISCHER)
+      limits->time.increment_ms = clock->bonus_ms;
+  }
+  else {
+    limits->time.move_time_ms = CPU_PLAYER_MOVETIME_MS;
+  }
+}
+
+/*
+ *   report
+ * Info callback, on the search thread: post the iteration in a free
+ * slot, or skip it if none is free
+ */
+static void report(const search_info_t *info, void *player_as_void)
+{
+  cpu_player_t *player = player_as_void;
+  cpu_analysis_t *slot;
+  int i;
+
+  /* Only the main line of a multi-PV search is shown */
+  if (info->multipv > 1 || !(slot = queue_pop(player->free_slots)) )
+    return;
+
+  slot->generation = atomic_load(&player->generation);
+  slot->depth = info->depth;
+  slot->score = player->side == WHITE ? info->score : -info->score;
+  slot->nodes = info->nodes;
+  slot->time_ms = info->time_ms;
+  slot->pv_length = info->pv_length < CPU_PLAYER_PV_SHOWN ?
+                    info->pv_length : CPU_PLAYER_PV_SHOWN;
+  for (i = 0; i < slot->pv_length; i++) slot->pv[i] = info->pv[i];
+  queue_push(player->infos, slot);
+}
+
+/*
+ *   deliver
+ * Bestmove callback, on the search thread: post the move to the display
+ */
+static void deliver(uint16_t best, uint16_t ponder, void *player_as_void)
+{
+  cpu_player_t *player = player_as_void;
+  cpu_result_t *result = malloc(sizeof(cpu_result_t) );
+
+  if (!result) return;
+  result->generation = atomic_load(&player->generation);
+  result->best = best;
+  result->ponder = ponder;
+  if (!queue_push(player->results, result)) free(result);
+}
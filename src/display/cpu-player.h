@@ -0,0 +1,126 @@
+#ifndef _CPU_PLAYER_H
+#define _CPU_PLAYER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "../model/board.h"
+#include "../model/history_stack.h"
+#include "../model/timer.h"
+#include "../engine/engine.h"
+#include "../utils/queue.h"
+
+/*
+ * The cpu_player_t struct lets the display play against the engine
+ * without ever waiting for it.  A search runs on the engine's own thread
+ * (on a copy of the board); its best move comes back as a message on a
+ * lock-free queue, which the display loop drains when convenient.
+ *
+ * While it searches, the engine reports each finished iteration (best
+ * line, score, depth, speed) for the display to show.  Those reports
+ * travel through a second lock-free queue, in a fixed pool of slots: the
+ * search thread takes a free slot, fills it and posts it, or skips the
+ * report if the display hasn't handed any slots back yet.  Reporting
+ * never allocates or waits, so it can't slow the search.
+ *
+ * Once the computer has moved it ponders: it searches the position after
+ * the reply its search expects, on the opponent's time.  If the
+ * opponent plays that reply, the next cpu_player_go turns the ponder
+ * search into the computer's search (engine_ponderhit), keeping what it
+ * found so far; if not, the ponder search is stopped and discarded.
+ *
+ * Undoing, loading or quitting cancels the search: the engine's stop
+ * flag is raised, which the search polls at every node, and the search
+ * is given a new generation number so that the move it still reports is
+ * recognised as stale and dropped.
+ */
+
+/* Time per move when the game isn't timed */
+#define CPU_PLAYER_MOVETIME_MS 2000
+
+/* Iteration reports in flight at once; more are skipped */
+#define CPU_PLAYER_INFO_SLOTS 8
+
+/* Moves of the best line kept for display */
+#define CPU_PLAYER_PV_SHOWN 8
+
+/* An iteration report, as the display shows it */
+struct cpu_analysis {
+  unsigned int generation;    /* Of the search that made it */
+  int depth;
+  int score;                  /* Centipawns, from WHITE's view */
+  uint64_t nodes;
+  int64_t time_ms;
+  int pv_length;
+  uint16_t pv[CPU_PLAYER_PV_SHOWN]; /* Packed, from the searched position */
+};
+typedef struct cpu_analysis cpu_analysis_t;
+
+/* A best move, as reported from the search thread */
+struct cpu_result {
+  unsigned int generation;    /* Of the search that found it */
+  uint16_t best;              /* Packed, or MOVE_NONE */
+  uint16_t ponder;            /* The reply expected, or MOVE_NONE */
+};
+typedef struct cpu_result cpu_result_t;
+
+struct cpu_player {
+  engine_t *engine;           /* (weak) Plays on the display's board */
+  queue_t *results;           /* (strong) cpu_result_t* from the search */
+  atomic_uint generation;     /* Of the latest search started */
+  bool thinking;              /* A search whose move is still wanted */
+  color_t side;               /* The side searched for */
+  bool pondering;             /* Searching on the opponent's time */
+  uint64_t ponder_hash;       /* The position pondered on */
+
+  cpu_analysis_t slots[CPU_PLAYER_INFO_SLOTS];
+  queue_t *free_slots;        /* (strong) Slots the search may fill */
+  queue_t *infos;             /* (strong) Filled slots, oldest first */
+  cpu_analysis_t analysis;    /* The latest report taken by the display */
+  bool has_analysis;          /* Whether 'analysis' is of a running search */
+};
+typedef struct cpu_player cpu_player_t;
+
+/* Create a player for an engine, taking over its bestmove callback.
+ * Returns NULL on failure.
+ */
+cpu_player_t* cpu_player_init(engine_t *engine);
+
+/* Cancel any search and cleanup */
+void cpu_player_destroy(cpu_player_t *player);
+
+/* Start searching for a move for the side to move on engine->board,
+ * which 'history' was played on.  Uses the clock if it is running,
+ * else CPU_PLAYER_MOVETIME_MS.  If the board is the position pondered
+ * on, the ponder search carries on instead.  Returns 0 on success, -1
+ * on failure.
+ */
+int cpu_player_go(cpu_player_t *player, history_stack_t *history,
+                  game_clock_t *clock);
+
+/* Ponder: search the position after 'reply' (packed), the opponent's
+ * expected move on engine->board, for the side that moves after it,
+ * until the next cpu_player_go or cancel.  Returns 0 if pondering, -1
+ * if not (e.g. 'reply' isn't legal).
+ */
+int cpu_player_ponder(cpu_player_t *player, history_stack_t *history,
+                      game_clock_t *clock, uint16_t reply);
+
+/* Stop the search, if any, and drop its move.  Returns once the search
+ * thread has finished, which the stop flag makes quick.
+ */
+void cpu_player_cancel(cpu_player_t *player);
+
+/* Take the move of the search, once it has one, and the reply it
+ * expects.  Never blocks.  Returns true (with 'best' MOVE_NONE if there
+ * was no legal move) when the search has finished.
+ */
+bool cpu_player_poll(cpu_player_t *player, uint16_t *best, uint16_t *ponder);
+
+/* Take the iteration reports posted since the last call, keeping the
+ * newest in player->analysis.  Never blocks.  Returns true if that
+ * changed.
+ */
+bool cpu_player_drain_analysis(cpu_player_t *player);
+
+#endif
@@ -2,8 +2,15 @@
 #include <stdio.h>
 
 #include "../model/board.h"
+#include "../model/timer.h"
+#include "../model/history_stack.h"
+#include "../model/journal.h"
+#include "../model/game_io.h"
+#include "../model/move_cache.h"
+#include "../model/board_snapshot.h"
 #include "window-params.h"
 #include "cursor.h"
+#include "cpu-player.h"
 #include "display-data.h"
 
 /*
@@ -20,9 +27,20 @@ display_data_init(board_t *board, window_params_t *prefs)
   if (! new_display_data) return NULL;
 
   new_display_data->board_on_screen = board;
+  new_display_data->snapshot = board_snapshot_init(board);
   new_display_data->display_prefs = prefs;
   new_display_data->cursor = cursor_init();
   new_display_data->selected_square = NULL;
+  new_display_data->moves = move_cache_init();
+  new_display_data->clock = game_clock_init(GAME_CLOCK_FISCHER,
+                              DEFAULT_CLOCK_BASE_MS, DEFAULT_CLOCK_BONUS_MS);
+  new_display_data->history =
+    history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+  new_display_data->journal = NULL;
+  new_display_data->io = game_io_init();
+  new_display_data->cpu = NULL;
+  new_display_data->cpu_side = -1;
+  new_display_data->dirty = DISPLAY_DIRTY_ALL;
   return new_display_data;
 }
 
@@ -40,9 +58,20 @@ display_data_init_default_window_params(board_t *board)
 
   /* Init struct members */
   new_display_data->board_on_screen = board;
+  new_display_data->snapshot = board_snapshot_init(board);
   new_display_data->display_prefs = window_params_init_defaults();
   new_display_data->cursor = cursor_init();
   new_display_data->selected_square = NULL;
+  new_display_data->moves = move_cache_init();
+  new_display_data->clock = game_clock_init(GAME_CLOCK_FISCHER,
+                              DEFAULT_CLOCK_BASE_MS, DEFAULT_CLOCK_BONUS_MS);
+  new_display_data->history =
+    history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+  new_display_data->journal = NULL;
+  new_display_data->io = game_io_init();
+  new_display_data->cpu = NULL;
+  new_display_data->cpu_side = -1;
+  new_display_data->dirty = DISPLAY_DIRTY_ALL;
 
   return new_display_data;
 }
@@ -54,9 +83,16 @@ display_data_init_default_window_params(board_t *board)
  */
 void display_data_destroy(display_data_t *data)
 {
-  /* Destroy strongly-owned member variables */
+  /* Destroy strongly-owned member variables, the search first */
+  cpu_player_destroy(data->cpu);
   window_params_destroy(data->display_prefs);
   cursor_destroy(data->cursor);
+  game_clock_destroy(data->clock);
+  game_io_destroy(data->io);
+  journal_close(data->journal);
+  history_stack_destroy(data->history);
+  board_snapshot_destroy(data->snapshot);
+  move_cache_destroy(data->moves);
 
   free(data);
 }
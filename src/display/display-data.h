@@ -3,7 +3,26 @@
 
 #include "../model/board.h"
 #include "../model/chess.h"
+#include "../model/timer.h"
+#include "../model/history_stack.h"
+#include "../model/journal.h"
+#include "../model/game_io.h"
+#include "../model/board_snapshot.h"
+#include "../model/move_cache.h"
 #include "cursor.h"
+#include "cpu-player.h"
+
+/* Default time control for the on-screen clock: 5 minutes + 3 seconds */
+#define DEFAULT_CLOCK_BASE_MS   (5 * 60 * 1000)
+#define DEFAULT_CLOCK_BONUS_MS  3000
+
+/* What has changed on screen since the last frame (display_data.dirty) */
+#define DISPLAY_DIRTY_BOARD     0x01  /* Pieces moved, game loaded */
+#define DISPLAY_DIRTY_CURSOR    0x02
+#define DISPLAY_DIRTY_SELECTION 0x04
+#define DISPLAY_DIRTY_CLOCK     0x08  /* The clocks' text changed */
+#define DISPLAY_DIRTY_OVERLAY   0x10  /* The computer's analysis changed */
+#define DISPLAY_DIRTY_ALL       0x1f
 
 /**
  * The display_data_t struct encapsulates all information
@@ -15,14 +34,33 @@
  * via the board_t struct which holds the canonical board that the players
  * see and the computer bases computations on.
  *
+ * Moves made on the board go through the history stack, so they can be
+ * undone and redone, and through the journal (when one is open) so the
+ * game survives a crash.  Saving and loading whole games happens on the
+ * game_io worker, so the display never waits on the disk.
+ *
+ * The renderer never reads the board itself, which its owner may be
+ * changing: it draws the latest position published to 'snapshot'.
+ * Whoever changes the board publishes the new position, and invalidates
+ * 'moves', which caches its legal moves for selecting and moving pieces.
+ *
  * The second is a handle on the display/window preferences such as the
  * size of the window and the color scheme used.
  */
 struct display_data {
   board_t *board_on_screen;       /* (weak) */
+  board_snapshot_t *snapshot;     /* (strong) Published board_on_screen */
   window_params_t *display_prefs; /* (strong) */
   cursor_t *cursor;               /* (strong) */
-  square_t *selected_square;      /* (weak) */
+  square_t *selected_square;      /* (weak) Piece to move, or NULL */
+  move_cache_t *moves;            /* (strong) Legal moves on the board */
+  game_clock_t *clock;            /* (strong) */
+  history_stack_t *history;       /* (strong) Moves played on the board */
+  journal_t *journal;             /* (strong) Autosave, or NULL */
+  game_io_t *io;                  /* (strong) Save/load worker */
+  cpu_player_t *cpu;              /* (strong) Computer opponent, or NULL */
+  int cpu_side;                   /* color_t the computer plays, or -1 */
+  unsigned int dirty;             /* DISPLAY_DIRTY_* bits not yet drawn */
 };
 typedef struct display_data display_data_t;
 
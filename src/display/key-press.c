@@ -6,12 +6,16 @@
 #include "cursor.h"
 #include "chess-screen.h"
 #include "display-data.h"
+#include "cpu-player.h"
+#include "../model/move_gen.h"
+#include "../model/move_cache.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 
 /* State information about how to handle key presses */
 enum display_mode {
-  /* Computer's turn, accept no keypresses */
+  /* Computer's turn: arrows, undo, load and quit (which cancel it) */
   CPU_TURN,
   /* Player turn: arrows, undo, redo, select */
   PC_NO_PIECE_SELECTED,
@@ -28,7 +32,25 @@ do_handle_normal_released_nps(unsigned char key, int x, int y);
 static void
 do_handle_normal_released_ps(unsigned char key, int x, int y);
 static void
+do_handle_normal_released_cpu(unsigned char key, int x, int y);
+static void
 do_handle_arrow_key(int key, int x, int y);
+static void
+select_at_cursor(void);
+static void
+deselect(void);
+static void
+move_to_cursor(void);
+static bool
+play_move(move_t *move);
+static void
+start_clock(void);
+static void
+pause_clock(void);
+static void
+start_cpu(void);
+static void
+quit(void);
 /* End forward declarations */
 
 /*
@@ -46,8 +68,11 @@ do_handle_arrow_key(int key, int x, int y);
 void
 key_press_normal_released(unsigned char key, int x, int y)
 {
+  /* Quitting works in every mode */
+  if (key == 'q' || key == 'Q' || key == 27) quit();
+
   /* Key handling depends on the current control mode
-   * (i.e. no key presses accepted during Computer's turn)
+   * (i.e. few key presses accepted during Computer's turn)
    */
   switch(key_press_mode)
   {
@@ -58,7 +83,7 @@ key_press_normal_released(unsigned char key, int x, int y)
       do_handle_normal_released_ps(key, x, y);
       break;
     case CPU_TURN:
-      /* No-op */
+      do_handle_normal_released_cpu(key, x, y);
       break;
     default:
       break;
@@ -75,6 +100,7 @@ key_press_normal_released(unsigned char key, int x, int y)
  *    'p': Pause the current game
  *    's': Save the current game
  *    'l': Load a new game
+ *    'g': Let the computer play the side to move, from now on
  *    'ENTER': select the piece on the given square
  *   @param key the character code for the pressed key
  *   @param x the x value of the mouse when the key was pressed
@@ -87,11 +113,22 @@ do_handle_normal_released_nps(unsigned char key, int x, int y)
   {
     case 'u':
     case 'U':
-      /* Unimplemented */
+      /* Any pondering was on the line being taken back */
+      if (disp_data->cpu) cpu_player_cancel(disp_data->cpu);
+      if (disp_data->journal ? journal_undo(disp_data->journal) :
+          history_stack_undo(disp_data->history, disp_data->board_on_screen)) {
+        pause_clock();
+        chess_screen_board_changed();
+      }
       break;
     case 'r':
     case 'R':
-      /* Unimplemented */
+      if (disp_data->cpu) cpu_player_cancel(disp_data->cpu);
+      if (disp_data->journal ? journal_redo(disp_data->journal) :
+          history_stack_redo(disp_data->history, disp_data->board_on_screen)) {
+        pause_clock();
+        chess_screen_board_changed();
+      }
       break;
     case 'p':
     case 'P':
@@ -99,17 +136,244 @@ do_handle_normal_released_nps(unsigned char key, int x, int y)
       break;
     case 's':
     case 'S':
-      /* Unimplemented */
+      /* Only the snapshot is taken here; the worker writes the file */
+      game_io_save(disp_data->io, GAME_IO_DEFAULT_PATH,
+                   disp_data->board_on_screen, disp_data->history);
       break;
     case 'l':
     case 'L':
-      /* Unimplemented */
+      /* Applied by the display's poll timer once read */
+      game_io_load(disp_data->io, GAME_IO_DEFAULT_PATH);
+      break;
+    case 'g':
+    case 'G':
+      if (!disp_data->cpu) break;
+      disp_data->cpu_side = disp_data->board_on_screen->moves_next;
+      start_cpu();
+      break;
+    case '\r':
+    case '\n':
+      select_at_cursor();
       break;
     default:
       break;
   }
+}
+
+/*
+ *   do_handle_normal_released_cpu
+ * Handles ASCII keys pressed by the user in CPU_TURN mode.  The search
+ * runs on its own thread meanwhile; these keys cancel it and hand both
+ * sides back to the player ('g' sets the computer playing again):
+ *    'u': Undo the previous move, back to the player's turn
+ *    'l': Load a new game, to be played by hand
+ *   @param key the character code for the pressed key
+ *   @param x the x value of the mouse when the key was pressed
+ *   @param y the y value of the mouse when the key was pressed
+ */
+static void
+do_handle_normal_released_cpu(unsigned char key, int x, int y)
+{
+  switch(key)
+  {
+    case 'u':
+    case 'U':
+      cpu_player_cancel(disp_data->cpu);
+      disp_data->cpu_side = -1;
+      key_press_mode = PC_NO_PIECE_SELECTED;
+      do_handle_normal_released_nps(key, x, y);
+      break;
+    case 'l':
+    case 'L':
+      cpu_player_cancel(disp_data->cpu);
+      disp_data->cpu_side = -1;
+      key_press_mode = PC_NO_PIECE_SELECTED;
+      do_handle_normal_released_nps(key, x, y);
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ *   key_press_poll_cpu
+ * Play the computer's move once its search has one, then let it ponder
+ * on the reply it expects.  Called from the display loop; never blocks.
+ */
+void
+key_press_poll_cpu(void)
+{
+  uint16_t best, ponder;
+  move_t move;
+
+  if (key_press_mode != CPU_TURN || !disp_data->cpu ||
+      !cpu_player_poll(disp_data->cpu, &best, &ponder) )
+    return;
+
+  key_press_mode = PC_NO_PIECE_SELECTED;
+  if (best == MOVE_NONE ||
+      !move_gen_find_packed(disp_data->board_on_screen, best, &move) )
+    return;
+  if (play_move(&move) )
+    cpu_player_ponder(disp_data->cpu, disp_data->history, disp_data->clock,
+                      ponder);
+}
+
+/*
+ *   key_press_reset
+ * Cancel the computer's turn and drop the selection.  The display calls
+ * this before applying a loaded game, which may finish after the
+ * computer was set thinking about the game it replaces.
+ */
+void
+key_press_reset(void)
+{
+  if (disp_data->cpu) cpu_player_cancel(disp_data->cpu);
+  disp_data->cpu_side = -1;
+  disp_data->selected_square = NULL;
+  key_press_mode = PC_NO_PIECE_SELECTED;
+  chess_screen_invalidate(DISPLAY_DIRTY_SELECTION | DISPLAY_DIRTY_OVERLAY);
+}
+
+/*
+ *   select_at_cursor
+ * Select the piece under the cursor, if it has somewhere to go.  Its
+ * targets come from the board's cached legal moves, generated here only
+ * if the board changed since they were last needed.
+ */
+static void
+select_at_cursor(void)
+{
+  cursor_t *cursor = disp_data->cursor;
+
+  if (move_cache_update(disp_data->moves, disp_data->board_on_screen) != 0 ||
+      !move_cache_targets(disp_data->moves,
+                          SQUARE_INDEX(cursor->rank, cursor->file) ) )
+    return;
+  disp_data->selected_square =
+    disp_data->board_on_screen->spaces[cursor->rank][cursor->file];
+  key_press_mode = PC_PIECE_SELECTED;
+  chess_screen_invalidate(DISPLAY_DIRTY_SELECTION);
+}
+
+/*
+ *   deselect
+ * Drop the selected piece, back to NO_PIECE_SELECTED mode
+ */
+static void
+deselect(void)
+{
+  disp_data->selected_square = NULL;
+  key_press_mode = PC_NO_PIECE_SELECTED;
+  chess_screen_invalidate(DISPLAY_DIRTY_SELECTION);
+}
+
+/*
+ *   move_to_cursor
+ * Move the selected piece to the cursor's square if the cached legal
+ * moves allow it (promoting to a queen).  Otherwise, the cursor on the
+ * selected piece drops it, and on another piece that can move selects
+ * that one instead.
+ */
+static void
+move_to_cursor(void)
+{
+  square_t *selected = disp_data->selected_square;
+  cursor_t *cursor = disp_data->cursor;
+  move_t *found, move;
+
+  found = move_cache_find(disp_data->moves,
+                          SQUARE_INDEX(selected->rank, selected->file),
+                          SQUARE_INDEX(cursor->rank, cursor->file) );
+  if (!found) {
+    deselect();
+    if (cursor->rank != selected->rank || cursor->file != selected->file)
+      select_at_cursor();
+    return;
+  }
+
+  move = *found;
+  deselect();
+  if (play_move(&move) && disp_data->cpu &&
+      disp_data->cpu_side == disp_data->board_on_screen->moves_next)
+    start_cpu();
+}
 
-  glutPostRedisplay();
+/*
+ *   play_move
+ * Play a legal move on the board, through the journal if one is open,
+ * and press the clock.  The first move (and the first after an undo)
+ * starts the mover's clock.  Nothing else changes if the move can't be
+ * played (the history is full).
+ *   @param move the move to play
+ *   @return true if the move was played
+ */
+static bool
+play_move(move_t *move)
+{
+  color_t mover = disp_data->board_on_screen->moves_next;
+
+  if ((disp_data->journal ? journal_push(disp_data->journal, move) :
+       history_stack_push(disp_data->history, disp_data->board_on_screen,
+                          move) ) != 0)
+    return false;
+  if (disp_data->clock) {
+    if (!disp_data->clock->turn.running)
+      game_clock_start(disp_data->clock, mover);
+    game_clock_press(disp_data->clock);
+  }
+  chess_screen_board_changed();
+  return true;
+}
+
+/*
+ *   start_clock
+ * Run the clock of the side to move, if it isn't running already
+ */
+static void
+start_clock(void)
+{
+  if (disp_data->clock && !disp_data->clock->turn.running)
+    game_clock_start(disp_data->clock,
+                     disp_data->board_on_screen->moves_next);
+}
+
+/*
+ *   pause_clock
+ * Stop the clock while moves are taken back or replayed; the next move
+ * played restarts it
+ */
+static void
+pause_clock(void)
+{
+  if (disp_data->clock) game_clock_pause(disp_data->clock);
+  chess_screen_invalidate(DISPLAY_DIRTY_CLOCK);
+}
+
+/*
+ *   start_cpu
+ * Set the computer thinking about the position on the board, on the
+ * engine's thread and against its running clock, and wait for its move
+ * in CPU_TURN mode
+ */
+static void
+start_cpu(void)
+{
+  start_clock();
+  if (cpu_player_go(disp_data->cpu, disp_data->history,
+                    disp_data->clock) == 0)
+    key_press_mode = CPU_TURN;
+}
+
+/*
+ *   quit
+ * Cancel any search, save what is open and leave
+ */
+static void
+quit(void)
+{
+  display_data_destroy(disp_data);
+  exit(0);
 }
 
 /*
@@ -129,16 +393,15 @@ do_handle_normal_released_ps(unsigned char key, int x, int y)
   {
     case 'c':
     case 'C':
-      /* Unimplemented */
+      deselect();
       break;
+    case '\r':
     case '\n':
-      /* Unimplemented */
+      move_to_cursor();
       break;
     default:
       break;
   }
-
-  glutPostRedisplay();
 }
 
 /*
@@ -171,8 +434,6 @@ key_press_special_released(int key, int x, int y)
     default:
       break;
   }
-
-  glutPostRedisplay();
 }
 
 /*
@@ -186,23 +447,26 @@ key_press_special_released(int key, int x, int y)
 static void
 do_handle_arrow_key(int key, int x, int y)
 {
+  bool moved = false;
+
   switch(key)
   {
     case GLUT_KEY_LEFT:
-      cursor_move(disp_data->cursor, LEFT);
+      moved = cursor_move(disp_data->cursor, LEFT) == 0;
       break;
     case GLUT_KEY_RIGHT:
-      cursor_move(disp_data->cursor, RIGHT);
+      moved = cursor_move(disp_data->cursor, RIGHT) == 0;
       break;
     case GLUT_KEY_UP:
-      cursor_move(disp_data->cursor, UP);
+      moved = cursor_move(disp_data->cursor, UP) == 0;
       break;
     case GLUT_KEY_DOWN:
-      cursor_move(disp_data->cursor, DOWN);
+      moved = cursor_move(disp_data->cursor, DOWN) == 0;
       break;
     default:
       break;
   }
 
-  glutPostRedisplay();
+  /* Bumping into the edge of the board changes nothing on screen */
+  if (moved) chess_screen_invalidate(DISPLAY_DIRTY_CURSOR);
 }
@@ -19,4 +19,17 @@ key_press_normal_released(unsigned char key, int x, int y);
 void
 key_press_special_released(int key, int x, int y);
 
+/* Play the computer's move if its search has finished.  Called
+ * regularly from the display loop.
+ */
+void
+key_press_poll_cpu(void);
+
+/* Back to the player's turn with nothing selected, before the game on
+ * the board is replaced (a load): a running search is cancelled and the
+ * computer stops playing either side.
+ */
+void
+key_press_reset(void);
+
 #endif
@@ -0,0 +1,29 @@
+#ifndef _PIECE_ATLAS_H
+#define _PIECE_ATLAS_H
+
+/*
+ * The piece art is packed at build time (rake display:atlas, which runs
+ * jegChess-atlaspack) into a single RGBA texture, generated as
+ * PIECE_ATLAS_DATA and compiled into the executable.  The generated
+ * header defines:
+ *
+ *   PIECE_ATLAS_SPRITE   width and height of each sprite, in pixels
+ *   PIECE_ATLAS_CELL     the grid's cell size, a power of two
+ *   PIECE_ATLAS_WIDTH    PIECE_ATLAS_COLUMNS * PIECE_ATLAS_CELL
+ *   PIECE_ATLAS_HEIGHT   PIECE_ATLAS_ROWS * PIECE_ATLAS_CELL
+ *   piece_atlas_pixels   the texture, top row first
+ *
+ * Sprites sit in the top left corner of their cells, one column per
+ * piece type (in piece_type_t order) and one row per color (in color_t
+ * order).  Pixels are premultiplied by alpha and the art's background is
+ * transparent, so the square's own color shows through and 12 sprites
+ * serve both square colors.
+ */
+
+#define PIECE_ATLAS_DATA    "piece_atlas_data.h"
+#define PIECE_ATLAS_TYPES   6   /* ROOK .. PAWN */
+#define PIECE_ATLAS_COLORS  2   /* WHITE, BLACK */
+#define PIECE_ATLAS_COLUMNS 8   /* Rounded up so the atlas is a power of 2 */
+#define PIECE_ATLAS_ROWS    PIECE_ATLAS_COLORS
+
+#endif
@@ -0,0 +1,352 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "book.h"
+#include "book_random64.h"
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/move_gen.h"
+#include "../model/piece.h"
+
+static uint64_t read_be(const unsigned char *bytes, int count);
+static size_t lower_bound(book_t *book, uint64_t key);
+static uint16_t from_polyglot_move(board_t *board, uint16_t raw);
+static int piece_kind(piece_t *piece);
+static uint64_t next_random(book_t *book);
+
+/*
+ *   book_keys_load
+ * Get the Random64 table Polyglot keys are built from: the standard
+ * one, or one read from a file
+ *   @param path the table file, or NULL for the standard table
+ *   @return a * to the table, or NULL on failure
+ */
+book_keys_t* book_keys_load(const char *path)
+{
+  unsigned char bytes[BOOK_NUM_RANDOM * 8];
+  book_keys_t *keys;
+  FILE *handle;
+  size_t got;
+  int i;
+
+  if (!path) {
+    if (!(keys = malloc(sizeof(book_keys_t) ))) return NULL;
+    for (i = 0; i < BOOK_NUM_RANDOM; i++) keys->random[i] = book_random64[i];
+    return keys;
+  }
+
+  handle = fopen(path, "rb");
+  if (!handle) return NULL;
+  got = fread(bytes, 1, sizeof(bytes), handle);
+  /* Exactly 781 words: a longer file isn't a Random64 table */
+  if (got != sizeof(bytes) || fgetc(handle) != EOF) {
+    fclose(handle);
+    return NULL;
+  }
+  fclose(handle);
+
+  if (!(keys = malloc(sizeof(book_keys_t) ))) return NULL;
+  for (i = 0; i < BOOK_NUM_RANDOM; i++)
+    keys->random[i] = read_be(&bytes[i * 8], 8);
+  return keys;
+}
+
+/*
+ *   book_keys_destroy
+ * Cleanup a Random64 table
+ */
+void book_keys_destroy(book_keys_t *keys)
+{
+  free(keys);
+}
+
+/*
+ *   book_key
+ * Compute the Polyglot key of a position: one Random64 word per piece on
+ * its square, per castling right, for an en passant file (only when a
+ * pawn can actually capture, which is when board->en_passant is set)
+ * and for WHITE to move
+ *   @param keys the Random64 table
+ *   @param board the position
+ *   @return the Polyglot key
+ */
+uint64_t book_key(const book_keys_t *keys, board_t *board)
+{
+  static const int castle_bits[4] = {
+    CASTLE_WHITE_KING, CASTLE_WHITE_QUEEN,
+    CASTLE_BLACK_KING, CASTLE_BLACK_QUEEN
+  };
+  uint64_t key = 0;
+  int rank, file, i;
+  piece_t *piece;
+
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (piece)
+        key ^= keys->random[64 * piece_kind(piece) + 8 * rank + file];
+    }
+  }
+  for (i = 0; i < 4; i++) {
+    if (board->castle_rights & castle_bits[i])
+      key ^= keys->random[BOOK_RANDOM_CASTLE + i];
+  }
+  if (board->en_passant != NO_SQUARE)
+    key ^= keys->random[BOOK_RANDOM_EN_PASSANT +
+                        SQUARE_FILE(board->en_passant)];
+  if (board->moves_next == WHITE)
+    key ^= keys->random[BOOK_RANDOM_TURN];
+  return key;
+}
+
+/*
+ *   book_open
+ * Map a book read-only.  The kernel is told access will be random, so it
+ * doesn't read ahead pages a binary search will never touch.
+ *   @param path the .bin book file
+ *   @param keys the Random64 table (ownership passes to the book)
+ *   @return a * to the book, or NULL on failure
+ */
+book_t* book_open(const char *path, book_keys_t *keys)
+{
+  struct stat info;
+  book_t *book;
+  void *mapping;
+  int fd;
+
+  if (!path || !keys) {
+    book_keys_destroy(keys);
+    return NULL;
+  }
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    book_keys_destroy(keys);
+    return NULL;
+  }
+  if (fstat(fd, &info) || info.st_size <= 0 ||
+      info.st_size % BOOK_ENTRY_SIZE) {
+    close(fd);
+    book_keys_destroy(keys);
+    return NULL;
+  }
+
+  mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    book_keys_destroy(keys);
+    return NULL;
+  }
+  madvise(mapping, info.st_size, MADV_RANDOM);
+
+  if (!(book = malloc(sizeof(book_t) ))) {
+    munmap(mapping, info.st_size);
+    book_keys_destroy(keys);
+    return NULL;
+  }
+  book->entries = mapping;
+  book->size = info.st_size;
+  book->num_entries = info.st_size / BOOK_ENTRY_SIZE;
+  book->keys = keys;
+  book->random_state = 0x9E3779B97F4A7C15ULL;
+  return book;
+}
+
+/*
+ *   book_close
+ * Unmap the book and cleanup its resources
+ *   @param book the book to close
+ */
+void book_close(book_t *book)
+{
+  if (!book) return;
+  munmap((void *)book->entries, book->size);
+  book_keys_destroy(book->keys);
+  free(book);
+}
+
+/*
+ *   book_seed
+ * Seed the generator used for weighted selection
+ *   @param book the book to seed
+ *   @param seed any value (0 is replaced by a fixed non-zero one)
+ */
+void book_seed(book_t *book, uint64_t seed)
+{
+  book->random_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+/*
+ *   book_moves
+ * Collect the book moves stored for a position.  Entries whose move
+ * isn't legal here (a key collision or a corrupt book) are skipped.
+ *   @param book the book to probe
+ *   @param board the position
+ *   @param moves receives the moves and weights
+ *   @param max the room in 'moves'
+ *   @return the number of moves written
+ */
+int
+book_moves(book_t *book, board_t *board, book_move_t *moves, int max)
+{
+  uint64_t key = book_key(book->keys, board);
+  size_t index = lower_bound(book, key);
+  const unsigned char *entry;
+  int count = 0;
+  uint16_t move;
+
+  for (; index < book->num_entries && count < max; index++) {
+    entry = &book->entries[index * BOOK_ENTRY_SIZE];
+    if (read_be(entry, 8) != key) break;
+
+    move = from_polyglot_move(board, (uint16_t)read_be(entry + 8, 2));
+    if (move == MOVE_NONE) continue;
+    moves[count].move = move;
+    moves[count].weight = (uint16_t)read_be(entry + 10, 2);
+    count++;
+  }
+  return count;
+}
+
+/*
+ *   book_probe
+ * Choose a book move for a position
+ *   @param book the book to probe
+ *   @param board the position
+ *   @param select best weight or weighted random
+ *   @param out receives the chosen (legal) move
+ *   @return true if the position had a usable book move
+ */
+bool
+book_probe(book_t *book, board_t *board, book_select_t select, move_t *out)
+{
+  book_move_t moves[BOOK_MAX_MOVES];
+  int count = book_moves(book, board, moves, BOOK_MAX_MOVES);
+  int i, chosen = 0;
+  uint64_t total = 0, pick;
+
+  if (count == 0) return false;
+
+  if (select == BOOK_SELECT_BEST) {
+    for (i = 1; i < count; i++) {
+      if (moves[i].weight > moves[chosen].weight) chosen = i;
+    }
+  }
+  else {
+    for (i = 0; i < count; i++) total += moves[i].weight;
+    /* All-zero weights: every move is equally good */
+    if (total == 0) {
+      chosen = next_random(book) % count;
+    }
+    else {
+      pick = next_random(book) % total;
+      for (chosen = 0; pick >= moves[chosen].weight; chosen++)
+        pick -= moves[chosen].weight;
+    }
+  }
+  return move_gen_find_packed(board, moves[chosen].move, out);
+}
+
+/*
+ *   book_polyglot_move
+ * Convert a move to Polyglot's encoding, the inverse of
+ * from_polyglot_move
+ *   @param move the move
+ *   @return the Polyglot move
+ */
+uint16_t book_polyglot_move(move_t *move)
+{
+  uint16_t packed = move_pack(move);
+  int from = packed & 63, to = (packed >> 6) & 63;
+
+  if (move->flags & MOVE_CASTLE)
+    to = SQUARE_INDEX(SQUARE_RANK(to), SQUARE_FILE(to) == 6 ? 7 : 0);
+  return to | from << 6 | (packed & 0x7000);
+}
+
+/*
+ *   read_be
+ * Read a big-endian unsigned integer of 'count' bytes
+ */
+static uint64_t read_be(const unsigned char *bytes, int count)
+{
+  uint64_t value = 0;
+  int i;
+  for (i = 0; i < count; i++) value = (value << 8) | bytes[i];
+  return value;
+}
+
+/*
+ *   lower_bound
+ * Binary search for the first entry with a key >= 'key'
+ */
+static size_t lower_bound(book_t *book, uint64_t key)
+{
+  size_t low = 0, high = book->num_entries, middle;
+
+  while (low < high) {
+    middle = low + (high - low) / 2;
+    if (read_be(&book->entries[middle * BOOK_ENTRY_SIZE], 8) < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+/*
+ *   from_polyglot_move
+ * Convert a Polyglot move to a packed move.  Polyglot puts the to-square
+ * in the low bits and writes castling as the king taking its own rook.
+ *   @return the packed move, or MOVE_NONE if it isn't legal here
+ */
+static uint16_t from_polyglot_move(board_t *board, uint16_t raw)
+{
+  int to = raw & 63, from = (raw >> 6) & 63, promo = (raw >> 12) & 7;
+  piece_t *mover = board->spaces[SQUARE_RANK(from)][SQUARE_FILE(from)]->piece;
+  piece_t *target = board->spaces[SQUARE_RANK(to)][SQUARE_FILE(to)]->piece;
+  move_t move;
+
+  if (mover && mover->type == KING && target && target->type == ROOK &&
+      target->color == mover->color)
+    to = SQUARE_INDEX(SQUARE_RANK(to), SQUARE_FILE(to) > SQUARE_FILE(from)
+                                       ? 6 : 2);
+
+  uint16_t packed = from | to << 6 | promo << 12;
+  return move_gen_find_packed(board, packed, &move) ? packed : MOVE_NONE;
+}
+
+/*
+ *   piece_kind
+ * Polyglot's piece numbering: black pawn 0, white pawn 1, black knight
+ * 2, ... white king 11
+ */
+static int piece_kind(piece_t *piece)
+{
+  int kind;
+  switch (piece->type) {
+    case PAWN:   kind = 0; break;
+    case KNIGHT: kind = 1; break;
+    case BISHOP: kind = 2; break;
+    case ROOK:   kind = 3; break;
+    case QUEEN:  kind = 4; break;
+    default:     kind = 5; break;
+  }
+  return 2 * kind + (piece->color == WHITE ? 1 : 0);
+}
+
+/*
+ *   next_random
+ * xorshift64* step for weighted selection
+ */
+static uint64_t next_random(book_t *book)
+{
+  book->random_state ^= book->random_state >> 12;
+  book->random_state ^= book->random_state << 25;
+  book->random_state ^= book->random_state >> 27;
+  return book->random_state * 0x2545F4914F6CDD1DULL;
+}
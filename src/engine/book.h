@@ -0,0 +1,101 @@
+#ifndef _BOOK_H
+#define _BOOK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../model/board.h"
+#include "../model/move.h"
+
+/*
+ * Polyglot opening books.  A .bin book is a flat array of 16-byte
+ * big-endian entries (key, move, weight, learn) sorted by key, where the
+ * key is the Polyglot hash of the position.  The book is mmap'd read-only
+ * and probed by binary search straight from the mapping: nothing is
+ * parsed at open time, and every engine process on the host shares the
+ * same page-cache copy.
+ *
+ * Polyglot keys are built from the standard 781-entry Random64 table,
+ * which is compiled in (book_random64.h).  A different table may be
+ * loaded from a file of 781 big-endian 64-bit words in Random64 order,
+ * for books keyed with one.
+ */
+
+#define BOOK_ENTRY_SIZE       16
+#define BOOK_NUM_RANDOM       781
+#define BOOK_MAX_MOVES        64
+
+/* Offsets into the Random64 table */
+#define BOOK_RANDOM_CASTLE      768
+#define BOOK_RANDOM_EN_PASSANT  772
+#define BOOK_RANDOM_TURN        780
+
+/* How to choose among the book moves of a position */
+enum book_select {
+  BOOK_SELECT_BEST,     /* Always the highest weight */
+  BOOK_SELECT_WEIGHTED  /* Random, in proportion to weight */
+};
+typedef enum book_select book_select_t;
+
+struct book_keys {
+  uint64_t random[BOOK_NUM_RANDOM];
+};
+typedef struct book_keys book_keys_t;
+
+/* A book move with its weight */
+struct book_move {
+  uint16_t move;        /* Packed as in move_pack */
+  uint16_t weight;
+};
+typedef struct book_move book_move_t;
+
+struct book {
+  const unsigned char *entries; /* (strong) The mapping */
+  size_t size;                  /* Bytes mapped */
+  size_t num_entries;
+  book_keys_t *keys;            /* (strong) */
+  uint64_t random_state;        /* For BOOK_SELECT_WEIGHTED */
+};
+typedef struct book book_t;
+
+/* Load a Random64 table; NULL path means the standard, compiled-in
+ * one.  Returns NULL if the file is missing or has the wrong size.
+ */
+book_keys_t* book_keys_load(const char *path);
+
+/* Cleanup a Random64 table */
+void book_keys_destroy(book_keys_t *keys);
+
+/* The Polyglot key of a position */
+uint64_t book_key(const book_keys_t *keys, board_t *board);
+
+/* Map a book file.  The book takes ownership of 'keys'.  Returns NULL
+ * (and frees 'keys') on failure.
+ */
+book_t* book_open(const char *path, book_keys_t *keys);
+
+/* Unmap the book and cleanup its resources */
+void book_close(book_t *book);
+
+/* Seed the generator used for weighted selection */
+void book_seed(book_t *book, uint64_t seed);
+
+/* List the book moves for a position, at most 'max'.  Returns how many
+ * were written.
+ */
+int
+book_moves(book_t *book, board_t *board, book_move_t *moves, int max);
+
+/* Pick a book move for the position.  Returns true and fills 'out' with
+ * the legal move if the position is in the book.
+ */
+bool
+book_probe(book_t *book, board_t *board, book_select_t select, move_t *out);
+
+/* A move as Polyglot stores it (to-square in the low bits, castling as
+ * the king taking its own rook), for writing books
+ */
+uint16_t book_polyglot_move(move_t *move);
+
+#endif
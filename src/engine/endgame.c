@@ -0,0 +1,414 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "endgame.h"
+#include "material.h"
+#include "eval.h"
+#include "../model/board.h"
+#include "../model/piece.h"
+
+/* A specialized evaluator registered for an exact material signature */
+struct endgame_eval_entry {
+  const char *code;
+  endgame_eval_fn eval_fn;
+};
+
+static const struct endgame_eval_entry eval_entries[] = {
+  {"KBNvK", endgame_eval_kbnk},
+  {"KNNvK", endgame_eval_knnk},
+  {"KRvKP", endgame_eval_krkp},
+  {"KRvKB", endgame_eval_krkb},
+  {"KRvKN", endgame_eval_krkn},
+  {"KQvKP", endgame_eval_kqkp},
+  {"KQvKR", endgame_eval_kqkr},
+};
+#define NUM_EVAL_ENTRIES (sizeof(eval_entries) / sizeof(eval_entries[0]))
+
+static bool find_piece(board_t *board, color_t color, piece_type_t type,
+                       int *rank, int *file);
+static int push_to_edge(int rank, int file);
+static int push_close(int distance);
+static int non_pawn_count(uint64_t key, color_t color);
+
+/*
+ *   endgame_material_key
+ * Translate a signature such as "KRvKP" into the matching material key.
+ *   @param code the signature; letters before 'v' belong to strong_side
+ *   @param strong_side the color owning the first half of the code
+ *   @return the material key, or 0 for an unparsable code
+ */
+uint64_t endgame_material_key(const char *code, color_t strong_side)
+{
+  uint64_t key = 0;
+  color_t side = strong_side;
+  piece_type_t type;
+
+  for (; *code; code++) {
+    switch (*code) {
+      case 'K': type = KING; break;
+      case 'Q': type = QUEEN; break;
+      case 'R': type = ROOK; break;
+      case 'B': type = BISHOP; break;
+      case 'N': type = KNIGHT; break;
+      case 'P': type = PAWN; break;
+      case 'v':
+        side = strong_side == WHITE ? BLACK : WHITE;
+        continue;
+      default:
+        return 0;
+    }
+    key += 1ULL << MATERIAL_KEY_SHIFT(side, type);
+  }
+  return key;
+}
+
+/*
+ *   endgame_classify
+ * Attach specialized evaluation/scaling functions to a material entry.
+ * Exact signatures are checked first, then the generic families (lone
+ * king, bishop and pawns, opposite-colored bishops).
+ *   @param entry the material entry to classify (its key must be set)
+ */
+void endgame_classify(material_entry_t *entry)
+{
+  uint64_t key = entry->key;
+  color_t strong, weak;
+  size_t i;
+
+  for (i = 0; i < NUM_EVAL_ENTRIES; i++) {
+    for (strong = WHITE; strong <= BLACK; strong++) {
+      if (endgame_material_key(eval_entries[i].code, strong) == key) {
+        entry->eval_fn = eval_entries[i].eval_fn;
+        entry->eval_strong_side = strong;
+        return;
+      }
+    }
+  }
+
+  for (strong = WHITE; strong <= BLACK; strong++) {
+    weak = strong == WHITE ? BLACK : WHITE;
+    bool weak_is_bare = non_pawn_count(key, weak) == 0 &&
+                        MATERIAL_KEY_COUNT(key, weak, PAWN) == 0;
+
+    /* A lone king against at least a rook's worth of material */
+    if (weak_is_bare &&
+        (MATERIAL_KEY_COUNT(key, strong, QUEEN) > 0 ||
+         MATERIAL_KEY_COUNT(key, strong, ROOK) > 0 ||
+         MATERIAL_KEY_COUNT(key, strong, BISHOP) >= 2 ||
+         (MATERIAL_KEY_COUNT(key, strong, BISHOP) > 0 &&
+          MATERIAL_KEY_COUNT(key, strong, KNIGHT) > 0))) {
+      entry->eval_fn = endgame_eval_kxk;
+      entry->eval_strong_side = strong;
+      return;
+    }
+
+    /* Bishop and pawns against king (and maybe pawns): wrong rook pawn */
+    if (non_pawn_count(key, weak) == 0 &&
+        MATERIAL_KEY_COUNT(key, strong, BISHOP) == 1 &&
+        non_pawn_count(key, strong) == 1 &&
+        MATERIAL_KEY_COUNT(key, strong, PAWN) > 0)
+      entry->scale_fn[strong] = endgame_scale_kbpsk;
+  }
+
+  /* One bishop each and nothing but pawns otherwise */
+  if (MATERIAL_KEY_COUNT(key, WHITE, BISHOP) == 1 &&
+      MATERIAL_KEY_COUNT(key, BLACK, BISHOP) == 1 &&
+      non_pawn_count(key, WHITE) == 1 && non_pawn_count(key, BLACK) == 1) {
+    entry->scale_fn[WHITE] = endgame_scale_opposite_bishops;
+    entry->scale_fn[BLACK] = endgame_scale_opposite_bishops;
+  }
+}
+
+/*
+ *   endgame_eval_kxk
+ * Mate with a lone king on the other side: drive the weak king to the
+ * edge and bring the strong king in to help.
+ */
+int endgame_eval_kxk(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int sk_rank, sk_file, wk_rank, wk_file, type;
+  int score = EVAL_KNOWN_WIN;
+
+  find_piece(board, strong_side, KING, &sk_rank, &sk_file);
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+
+  for (type = ROOK; type <= PAWN; type++)
+    if (type != KING)
+      score += eval_piece_value[type] *
+               board_material_count(board, strong_side, type);
+
+  score += push_to_edge(wk_rank, wk_file);
+  score += push_close(eval_king_distance(sk_rank, sk_file, wk_rank, wk_file));
+  return score;
+}
+
+/*
+ *   endgame_eval_kbnk
+ * Bishop and knight mate: the weak king has to be driven into a corner
+ * the bishop can cover, so distance to those two corners dominates.
+ */
+int endgame_eval_kbnk(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int sk_rank, sk_file, wk_rank, wk_file, b_rank, b_file;
+  int corner_one, corner_two;
+
+  find_piece(board, strong_side, KING, &sk_rank, &sk_file);
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+  find_piece(board, strong_side, BISHOP, &b_rank, &b_file);
+
+  /* a1 and h8 are dark squares, a8 and h1 are light */
+  if ((b_rank + b_file) % 2 == 0) {
+    corner_one = eval_king_distance(wk_rank, wk_file, 0, 0);
+    corner_two = eval_king_distance(wk_rank, wk_file, 7, 7);
+  }
+  else {
+    corner_one = eval_king_distance(wk_rank, wk_file, 7, 0);
+    corner_two = eval_king_distance(wk_rank, wk_file, 0, 7);
+  }
+
+  return EVAL_KNOWN_WIN + eval_piece_value[BISHOP] + eval_piece_value[KNIGHT]
+         + push_close(eval_king_distance(sk_rank, sk_file, wk_rank, wk_file))
+         + 40 * (7 - (corner_one < corner_two ? corner_one : corner_two));
+}
+
+/*
+ *   endgame_eval_knnk
+ * Two knights cannot force mate against a bare king
+ */
+int endgame_eval_knnk(board_t *board, color_t strong_side)
+{
+  return EVAL_DRAW;
+}
+
+/*
+ *   endgame_eval_krkp
+ * Rook against pawn is a race: the rook wins easily if its king is in
+ * front of the pawn or the defending king is far away, otherwise the
+ * result depends on how far the pawn has run.
+ */
+int endgame_eval_krkp(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int sk_rank, sk_file, wk_rank, wk_file, r_rank, r_file, p_rank, p_file;
+  int queen_rank = weak_side == WHITE ? 7 : 0;
+  int push = weak_side == WHITE ? 1 : -1;
+  int tempo = board->moves_next == strong_side ? 1 : 0;
+  int result;
+
+  find_piece(board, strong_side, KING, &sk_rank, &sk_file);
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+  find_piece(board, strong_side, ROOK, &r_rank, &r_file);
+  find_piece(board, weak_side, PAWN, &p_rank, &p_file);
+
+  int sk_to_pawn = eval_king_distance(sk_rank, sk_file, p_rank, p_file);
+  int wk_to_pawn = eval_king_distance(wk_rank, wk_file, p_rank, p_file);
+  int wk_to_rook = eval_king_distance(wk_rank, wk_file, r_rank, r_file);
+  bool sk_in_front = sk_file == p_file && (sk_rank - p_rank) * push > 0;
+
+  /* Strong king blocks the pawn's path, or the defender is out of play */
+  if (sk_in_front || (wk_to_pawn >= 3 + tempo && wk_to_rook >= 3))
+    result = eval_piece_value[ROOK] - eval_piece_value[PAWN] - sk_to_pawn;
+
+  /* Advanced pawn supported by its king and the attacker far away */
+  else if ((p_rank - queen_rank) * push >= -2 && wk_to_pawn == 1 &&
+           sk_to_pawn > 2 + tempo)
+    result = 80 - 8 * sk_to_pawn;
+
+  else {
+    int front_rank = p_rank + push;
+    result = 200 - 8 * (eval_king_distance(sk_rank, sk_file, front_rank, p_file)
+                        - eval_king_distance(wk_rank, wk_file, front_rank, p_file)
+                        - abs(queen_rank - p_rank));
+  }
+  return result;
+}
+
+/*
+ *   endgame_eval_krkb
+ * Rook against bishop is usually a draw; reward pushing the weak king
+ * to the edge so the search can find the rare wins.
+ */
+int endgame_eval_krkb(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int wk_rank, wk_file;
+
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+  return push_to_edge(wk_rank, wk_file) / 2;
+}
+
+/*
+ *   endgame_eval_krkn
+ * Rook against knight: like KRKB, but separating the knight from its
+ * king is what produces winning chances.
+ */
+int endgame_eval_krkn(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int wk_rank, wk_file, n_rank, n_file;
+
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+  find_piece(board, weak_side, KNIGHT, &n_rank, &n_file);
+  return push_to_edge(wk_rank, wk_file) / 2 +
+         10 * eval_king_distance(wk_rank, wk_file, n_rank, n_file);
+}
+
+/*
+ *   endgame_eval_kqkp
+ * Queen against pawn wins, except against a rook or bishop pawn on the
+ * seventh rank supported by its king.
+ */
+int endgame_eval_kqkp(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int sk_rank, sk_file, wk_rank, wk_file, p_rank, p_file;
+  int seventh = weak_side == WHITE ? 6 : 1;
+
+  find_piece(board, strong_side, KING, &sk_rank, &sk_file);
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+  find_piece(board, weak_side, PAWN, &p_rank, &p_file);
+
+  int result = push_close(eval_king_distance(sk_rank, sk_file, wk_rank, wk_file));
+  bool drawish_file = p_file == 0 || p_file == 2 || p_file == 5 || p_file == 7;
+
+  if (p_rank != seventh || !drawish_file ||
+      eval_king_distance(wk_rank, wk_file, p_rank, p_file) != 1)
+    result += eval_piece_value[QUEEN] - eval_piece_value[PAWN];
+
+  return result;
+}
+
+/*
+ *   endgame_eval_kqkr
+ * Queen against rook is a slow but certain win: push the defending king
+ * to the edge and keep the kings close.
+ */
+int endgame_eval_kqkr(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int sk_rank, sk_file, wk_rank, wk_file;
+
+  find_piece(board, strong_side, KING, &sk_rank, &sk_file);
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+
+  return eval_piece_value[QUEEN] - eval_piece_value[ROOK]
+         + push_to_edge(wk_rank, wk_file)
+         + push_close(eval_king_distance(sk_rank, sk_file, wk_rank, wk_file));
+}
+
+/*
+ *   endgame_scale_kbpsk
+ * Bishop and rook pawns of a single file cannot win when the bishop does
+ * not control the queening square and the defending king reaches it.
+ */
+int endgame_scale_kbpsk(board_t *board, color_t strong_side)
+{
+  color_t weak_side = strong_side == WHITE ? BLACK : WHITE;
+  int rank, file, pawn_file = -1;
+  int b_rank, b_file, wk_rank, wk_file;
+  piece_t *piece;
+
+  /* Every strong pawn must be on the same rook file */
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (!piece || piece->color != strong_side || piece->type != PAWN)
+        continue;
+      if (file != 0 && file != 7) return SCALE_NONE;
+      if (pawn_file >= 0 && file != pawn_file) return SCALE_NONE;
+      pawn_file = file;
+    }
+  }
+  if (pawn_file < 0) return SCALE_NONE;
+
+  int queen_rank = strong_side == WHITE ? 7 : 0;
+  find_piece(board, strong_side, BISHOP, &b_rank, &b_file);
+  find_piece(board, weak_side, KING, &wk_rank, &wk_file);
+
+  bool bishop_is_dark = (b_rank + b_file) % 2 == 0;
+  bool corner_is_dark = (queen_rank + pawn_file) % 2 == 0;
+  if (bishop_is_dark != corner_is_dark &&
+      eval_king_distance(wk_rank, wk_file, queen_rank, pawn_file) <= 1)
+    return SCALE_DRAW;
+
+  return SCALE_NONE;
+}
+
+/*
+ *   endgame_scale_opposite_bishops
+ * Bishops of opposite colors with only pawns besides are notoriously
+ * drawish; the more pawns the attacker has, the less so.
+ */
+int endgame_scale_opposite_bishops(board_t *board, color_t strong_side)
+{
+  int w_rank, w_file, b_rank, b_file;
+
+  find_piece(board, WHITE, BISHOP, &w_rank, &w_file);
+  find_piece(board, BLACK, BISHOP, &b_rank, &b_file);
+  if ((w_rank + w_file) % 2 == (b_rank + b_file) % 2) return SCALE_NONE;
+
+  return 16 + 4 * board_material_count(board, strong_side, PAWN);
+}
+
+/*
+ *   find_piece
+ * Locate the first piece of the given color and type on the board
+ *   @param rank set to the piece's rank when found
+ *   @param file set to the piece's file when found
+ *   @return true if a matching piece was found
+ */
+static bool find_piece(board_t *board, color_t color, piece_type_t type,
+                       int *rank, int *file)
+{
+  int r, f;
+  piece_t *piece;
+
+  for (r = 0; r < BOARD_SIZE; r++) {
+    for (f = 0; f < BOARD_SIZE; f++) {
+      piece = board->spaces[r][f]->piece;
+      if (piece && piece->color == color && piece->type == type) {
+        *rank = r;
+        *file = f;
+        return true;
+      }
+    }
+  }
+  *rank = 0;
+  *file = 0;
+  return false;
+}
+
+/*
+ *   push_to_edge
+ * Bonus for a defending king far from the center of the board
+ */
+static int push_to_edge(int rank, int file)
+{
+  int rank_off = rank < 4 ? 3 - rank : rank - 4;
+  int file_off = file < 4 ? 3 - file : file - 4;
+  return 20 * (rank_off + file_off);
+}
+
+/*
+ *   push_close
+ * Bonus for the attacking king being near the defending one
+ */
+static int push_close(int distance)
+{
+  return 140 - 20 * distance;
+}
+
+/*
+ *   non_pawn_count
+ * Number of knights, bishops, rooks and queens a side has
+ */
+static int non_pawn_count(uint64_t key, color_t color)
+{
+  return MATERIAL_KEY_COUNT(key, color, KNIGHT) +
+         MATERIAL_KEY_COUNT(key, color, BISHOP) +
+         MATERIAL_KEY_COUNT(key, color, ROOK) +
+         MATERIAL_KEY_COUNT(key, color, QUEEN);
+}
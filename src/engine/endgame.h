@@ -0,0 +1,40 @@
+#ifndef _ENDGAME_H
+#define _ENDGAME_H
+
+#include <stdint.h>
+#include "../model/board.h"
+#include "material.h"
+
+/*
+ * Specialized knowledge for endgames where the general evaluation is
+ * either too slow or simply wrong: mating patterns with a lone king,
+ * KBNK's corner, KRKP races, opposite-colored bishops and so on.  The
+ * functions are looked up by material signature when a material table
+ * entry is first computed, never during evaluation itself.
+ */
+
+/* Build a material key from a code such as "KBNvK".  The pieces before
+ * the 'v' belong to strong_side, the pieces after it to the other side.
+ */
+uint64_t endgame_material_key(const char *code, color_t strong_side);
+
+/* Attach any specialized evaluation and scaling functions that apply to
+ * the entry's material key.
+ */
+void endgame_classify(material_entry_t *entry);
+
+/* Evaluation functions, scored from strong_side's point of view */
+int endgame_eval_kxk(board_t *board, color_t strong_side);
+int endgame_eval_kbnk(board_t *board, color_t strong_side);
+int endgame_eval_knnk(board_t *board, color_t strong_side);
+int endgame_eval_krkp(board_t *board, color_t strong_side);
+int endgame_eval_krkb(board_t *board, color_t strong_side);
+int endgame_eval_krkn(board_t *board, color_t strong_side);
+int endgame_eval_kqkp(board_t *board, color_t strong_side);
+int endgame_eval_kqkr(board_t *board, color_t strong_side);
+
+/* Scaling functions, returning a factor out of SCALE_NORMAL */
+int endgame_scale_kbpsk(board_t *board, color_t strong_side);
+int endgame_scale_opposite_bishops(board_t *board, color_t strong_side);
+
+#endif
@@ -0,0 +1,399 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "material.h"
+#include "trans_table.h"
+#include "search.h"
+#include "book.h"
+#include "tablebase.h"
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/move_gen.h"
+
+static void* think(void *engine_as_void);
+static bool busy(engine_t *engine);
+static int push_game_hash(engine_t *engine, uint64_t hash);
+
+/*
+ *   engine_init
+ * Create an engine set up in the starting position
+ *   @param hash_mb the size of the transposition table in megabytes
+ *   @return a * to the new engine, or NULL on failure
+ */
+engine_t* engine_init(size_t hash_mb)
+{
+  engine_t *engine = calloc(1, sizeof(engine_t) );
+  if (!engine) return NULL;
+
+  engine->board = board_init_start();
+  engine->material = material_table_init(ENGINE_MATERIAL_ENTRIES);
+  engine->table = trans_table_init(hash_mb);
+  if (engine->material && engine->table)
+    engine->search = search_init(engine->material, engine->table);
+
+  if (!engine->board || !engine->search) {
+    board_destroy(engine->board);
+    material_table_destroy(engine->material);
+    trans_table_destroy(engine->table);
+    free(engine);
+    return NULL;
+  }
+  pthread_mutex_init(&engine->lock, NULL);
+  pthread_cond_init(&engine->stop_signal, NULL);
+  return engine;
+}
+
+/*
+ *   engine_destroy
+ * Stop any search and cleanup all resources held by the engine
+ *   @param engine the engine to destroy
+ */
+void engine_destroy(engine_t *engine)
+{
+  if (!engine) return;
+  engine_stop(engine);
+  engine_wait(engine);
+
+  search_destroy(engine->search);
+  book_close(engine->book);
+  tablebase_close(engine->tablebase);
+  trans_table_destroy(engine->table);
+  material_table_destroy(engine->material);
+  board_destroy(engine->board);
+  free(engine->game_hashes);
+  pthread_cond_destroy(&engine->stop_signal);
+  pthread_mutex_destroy(&engine->lock);
+  free(engine);
+}
+
+/*
+ *   engine_set_callbacks
+ * Register the functions the search thread reports through
+ *   @param engine the engine to report on
+ *   @param on_info called after every completed iteration
+ *   @param on_bestmove called once when a search finishes
+ *   @param user passed back to both callbacks untouched
+ */
+void
+engine_set_callbacks(engine_t *engine, search_info_fn on_info,
+                     engine_bestmove_fn on_bestmove, void *user)
+{
+  engine->on_info = on_info;
+  engine->on_bestmove = on_bestmove;
+  engine->user = user;
+}
+
+/*
+ *   engine_set_hash
+ * Resize the transposition table (its contents are lost)
+ *   @param engine the engine to configure
+ *   @param hash_mb the new size in megabytes
+ *   @return 0 on success, -1 while thinking or on allocation failure
+ */
+int engine_set_hash(engine_t *engine, size_t hash_mb)
+{
+  trans_table_t *table;
+
+  if (busy(engine)) return -1;
+  if (!(table = trans_table_init(hash_mb))) return -1;
+
+  trans_table_destroy(engine->table);
+  engine->table = table;
+  engine->search->table = table;
+  return 0;
+}
+
+/*
+ *   engine_set_book
+ * Open (or close) the opening book consulted before each search
+ *   @param engine the engine to configure
+ *   @param book_path the Polyglot .bin file, or NULL to stop using a book
+ *   @param keys_path the Random64 table, or NULL for the default one
+ *   @param select how to choose among book moves
+ *   @return 0 on success, -1 while thinking or on failure
+ */
+int
+engine_set_book(engine_t *engine, const char *book_path,
+                const char *keys_path, book_select_t select)
+{
+  book_t *book = NULL;
+
+  if (busy(engine)) return -1;
+  if (book_path && !(book = book_open(book_path, book_keys_load(keys_path))))
+    return -1;
+
+  book_close(engine->book);
+  engine->book = book;
+  engine->book_select = select;
+  return 0;
+}
+
+/*
+ *   engine_set_tablebase
+ * Map (or drop) the endgame tables the search probes
+ *   @param engine the engine to configure
+ *   @param dir the directory holding the tables, or NULL for none
+ *   @return 0 on success, -1 while thinking or on failure
+ */
+int engine_set_tablebase(engine_t *engine, const char *dir)
+{
+  tablebase_t *tablebase = NULL;
+
+  if (busy(engine)) return -1;
+  if (dir && !(tablebase = tablebase_open(dir))) return -1;
+
+  search_set_tablebase(engine->search, tablebase);
+  tablebase_close(engine->tablebase);
+  engine->tablebase = tablebase;
+  return 0;
+}
+
+/*
+ *   engine_new_game
+ * Back to the starting position with empty tables
+ *   @param engine the engine to reset
+ *   @return 0 on success, -1 while thinking
+ */
+int engine_new_game(engine_t *engine)
+{
+  if (engine_set_position(engine, NULL)) return -1;
+  trans_table_clear(engine->table);
+  search_clear(engine->search);
+  return 0;
+}
+
+/*
+ *   engine_set_position
+ * Replace the game position.  The moves leading to it are unknown, so
+ * repetitions are only detected from here on.
+ *   @param engine the engine to set up
+ *   @param position the new position (ownership passes to the engine), or
+ *          NULL for the starting position
+ *   @return 0 on success, -1 while thinking or on failure
+ */
+int engine_set_position(engine_t *engine, board_t *position)
+{
+  if (busy(engine)) {
+    board_destroy(position);
+    return -1;
+  }
+  if (!position && !(position = board_init_start())) return -1;
+
+  board_destroy(engine->board);
+  engine->board = position;
+  engine->num_game_hashes = 0;
+  return 0;
+}
+
+/*
+ *   engine_play_move
+ * Play a move in the game position
+ *   @param engine the engine to play on
+ *   @param text the move in coordinate notation
+ *   @return 0 on success, -1 if the move is illegal or while thinking
+ */
+int engine_play_move(engine_t *engine, const char *text)
+{
+  move_t move;
+  board_undo_t undo;
+
+  if (busy(engine)) return -1;
+  if (!move_gen_find_string(engine->board, text, &move)) return -1;
+  if (push_game_hash(engine, engine->board->hash)) return -1;
+
+  board_make_move(engine->board, &move, &undo);
+  return 0;
+}
+
+/*
+ *   engine_set_game_history
+ * Replace the record of earlier game positions, which the search uses to
+ * spot repetitions
+ *   @param engine the engine to set up
+ *   @param hashes the hash of each position before a game move, oldest
+ *          first
+ *   @param count how many hashes
+ *   @return 0 on success, -1 while thinking or on allocation failure
+ */
+int
+engine_set_game_history(engine_t *engine, const uint64_t *hashes, int count)
+{
+  int i;
+
+  if (busy(engine)) return -1;
+  engine->num_game_hashes = 0;
+  for (i = 0; i < count; i++) {
+    if (push_game_hash(engine, hashes[i])) return -1;
+  }
+  return 0;
+}
+
+/*
+ *   engine_go
+ * Start a search of the current position on its own thread.  The result
+ * is delivered through the bestmove callback.
+ *   @param engine the engine to think with
+ *   @param limits when the search should end
+ *   @return 0 on success, -1 if already thinking or on failure
+ */
+int engine_go(engine_t *engine, const search_limits_t *limits)
+{
+  if (busy(engine)) return -1;
+
+  engine->search_board = board_copy_deep(engine->board);
+  if (!engine->search_board) return -1;
+
+  engine->limits = *limits;
+  engine->stop_requested = false;
+  engine->pondering = limits->ponder;
+  search_reset_stop(engine->search);
+  search_set_game_history(engine->search, engine->game_hashes,
+                          engine->num_game_hashes);
+  search_set_info_callback(engine->search, engine->on_info, engine->user);
+
+  engine->thinking = true;
+  if (pthread_create(&engine->thread, NULL, think, engine)) {
+    engine->thinking = false;
+    board_destroy(engine->search_board);
+    engine->search_board = NULL;
+    return -1;
+  }
+  engine->thread_started = true;
+  return 0;
+}
+
+/*
+ *   engine_ponderhit
+ * The opponent played the move we pondered on; keep searching, but now
+ * on our own clock
+ *   @param engine the pondering engine
+ *   @return 0 on success, -1 if the engine wasn't pondering
+ */
+int engine_ponderhit(engine_t *engine)
+{
+  int result = -1;
+
+  pthread_mutex_lock(&engine->lock);
+  if (engine->thinking && engine->pondering) {
+    engine->pondering = false;
+    search_ponderhit(engine->search);
+    pthread_cond_broadcast(&engine->stop_signal);
+    result = 0;
+  }
+  pthread_mutex_unlock(&engine->lock);
+  return result;
+}
+
+/*
+ *   engine_stop
+ * Ask the running search to wrap up.  Does nothing when idle.
+ *   @param engine the engine to stop
+ */
+void engine_stop(engine_t *engine)
+{
+  pthread_mutex_lock(&engine->lock);
+  engine->stop_requested = true;
+  search_stop(engine->search);
+  pthread_cond_broadcast(&engine->stop_signal);
+  pthread_mutex_unlock(&engine->lock);
+}
+
+/*
+ *   engine_wait
+ * Block until the running search has reported its best move
+ *   @param engine the engine to wait for
+ */
+void engine_wait(engine_t *engine)
+{
+  if (!engine->thread_started) return;
+  pthread_join(engine->thread, NULL);
+  engine->thread_started = false;
+  board_destroy(engine->search_board);
+  engine->search_board = NULL;
+}
+
+/*
+ *   engine_is_thinking
+ * Whether a search is running (and hasn't reported yet)
+ *   @param engine the engine to ask
+ *   @return true while thinking
+ */
+bool engine_is_thinking(engine_t *engine)
+{
+  bool thinking;
+  pthread_mutex_lock(&engine->lock);
+  thinking = engine->thinking;
+  pthread_mutex_unlock(&engine->lock);
+  return thinking;
+}
+
+/*
+ *   think
+ * Body of the search thread.  After an infinite search, or a ponder
+ * search that finished before the ponderhit, the best move is held back
+ * until engine_stop (or engine_ponderhit), as UCI requires.
+ */
+static void* think(void *engine_as_void)
+{
+  engine_t *engine = (engine_t *)engine_as_void;
+  uint16_t best, ponder = MOVE_NONE;
+  move_t book_move;
+
+  /* Book moves are for play; analysis and pondering always search */
+  if (engine->book && !engine->limits.infinite && !engine->limits.ponder &&
+      engine->limits.multipv <= 1 &&
+      book_probe(engine->book, engine->search_board, engine->book_select,
+                 &book_move))
+    best = move_pack(&book_move);
+  else
+    best = search_run(engine->search, engine->search_board, &engine->limits,
+                      &ponder);
+
+  pthread_mutex_lock(&engine->lock);
+  while ((engine->limits.infinite || engine->pondering) &&
+         !engine->stop_requested)
+    pthread_cond_wait(&engine->stop_signal, &engine->lock);
+  pthread_mutex_unlock(&engine->lock);
+
+  if (engine->on_bestmove) engine->on_bestmove(best, ponder, engine->user);
+
+  pthread_mutex_lock(&engine->lock);
+  engine->thinking = false;
+  pthread_mutex_unlock(&engine->lock);
+  return NULL;
+}
+
+/*
+ *   busy
+ * Reap a search thread that has finished.  Returns true if one is still
+ * running, in which case the game state must not be touched.
+ */
+static bool busy(engine_t *engine)
+{
+  if (engine_is_thinking(engine)) return true;
+  engine_wait(engine);
+  return false;
+}
+
+/*
+ *   push_game_hash
+ * Record the hash of a position before a game move is played on it
+ *   @return 0 on success, -1 on allocation failure
+ */
+static int push_game_hash(engine_t *engine, uint64_t hash)
+{
+  if (engine->num_game_hashes == engine->game_hashes_capacity) {
+    int capacity = engine->game_hashes_capacity ?
+                   2 * engine->game_hashes_capacity : 128;
+    uint64_t *grown = realloc(engine->game_hashes,
+                              capacity * sizeof(uint64_t) );
+    if (!grown) return -1;
+    engine->game_hashes = grown;
+    engine->game_hashes_capacity = capacity;
+  }
+  engine->game_hashes[engine->num_game_hashes++] = hash;
+  return 0;
+}
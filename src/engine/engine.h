@@ -0,0 +1,148 @@
+#ifndef _ENGINE_H
+#define _ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "../model/board.h"
+#include "material.h"
+#include "trans_table.h"
+#include "search.h"
+#include "book.h"
+#include "tablebase.h"
+
+/*
+ * The engine_t struct is the reentrant front door to the chess model and
+ * search: it owns a game position, the tables the search shares between
+ * moves, and the thread a search runs on.  Nothing here touches the
+ * display, so front ends (the GLUT board, the UCI executable) and any
+ * number of engine instances in one process each hold their own
+ * engine_t instead of sharing globals.
+ *
+ * Searches run on a private copy of the game board, so the game board
+ * may be read (e.g. drawn) while the engine thinks.  Results come back
+ * through callbacks invoked on the search thread.
+ *
+ * To ponder, play the expected reply on the game board and go with
+ * limits.ponder set.  If the opponent plays that move, engine_ponderhit
+ * turns the search into a normal timed one, keeping everything searched
+ * so far; otherwise engine_stop it, discard its best move, and search
+ * the real position.
+ */
+
+#define ENGINE_MATERIAL_ENTRIES 8192
+
+/* Called once per search with the chosen move and expected reply,
+ * both packed (MOVE_NONE if there is none)
+ */
+typedef void (*engine_bestmove_fn)(uint16_t best, uint16_t ponder, void *user);
+
+struct engine {
+  board_t *board;               /* (strong) The current game position */
+  material_table_t *material;   /* (strong) */
+  trans_table_t *table;         /* (strong) */
+  search_t *search;             /* (strong) */
+  board_t *search_board;        /* (strong) Copy being searched, or NULL */
+  book_t *book;                 /* (strong) Opening book, or NULL */
+  book_select_t book_select;
+  tablebase_t *tablebase;       /* (strong) Endgame tables, or NULL */
+
+  uint64_t *game_hashes;        /* (strong) Positions before each move */
+  int num_game_hashes;
+  int game_hashes_capacity;
+
+  search_limits_t limits;       /* Limits of the running search */
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t stop_signal;   /* Broadcast by engine_stop */
+  bool thread_started;          /* A search thread exists, not yet joined */
+  bool thinking;                /* That thread hasn't reported yet */
+  bool stop_requested;
+  bool pondering;               /* Searching on the opponent's time */
+
+  search_info_fn on_info;
+  engine_bestmove_fn on_bestmove;
+  void *user;
+};
+typedef struct engine engine_t;
+
+/* Create an engine in the starting position with a hash_mb transposition
+ * table
+ */
+engine_t* engine_init(size_t hash_mb);
+
+/* Stop any search and cleanup all resources held by the engine */
+void engine_destroy(engine_t *engine);
+
+/* Register the search callbacks (either may be NULL) */
+void
+engine_set_callbacks(engine_t *engine, search_info_fn on_info,
+                     engine_bestmove_fn on_bestmove, void *user);
+
+/* Replace the transposition table with one of hash_mb megabytes.
+ * Returns 0 on success, -1 while thinking or on allocation failure.
+ */
+int engine_set_hash(engine_t *engine, size_t hash_mb);
+
+/* Open a Polyglot book to play from before searching, replacing any
+ * book in use.  keys_path NULL means the default Random64 table; a NULL
+ * book_path closes the book.  Returns 0 on success, -1 while thinking or
+ * if the book or its keys can't be loaded.
+ */
+int
+engine_set_book(engine_t *engine, const char *book_path,
+                const char *keys_path, book_select_t select);
+
+/* Map the endgame tables in a directory for the search to probe,
+ * replacing any in use; NULL stops probing.  Returns 0 on success, -1
+ * while thinking or if the directory can't be read.
+ */
+int engine_set_tablebase(engine_t *engine, const char *dir);
+
+/* Start a new game: starting position, and everything learned from the
+ * previous game forgotten.  Returns 0 on success, -1 while thinking.
+ */
+int engine_new_game(engine_t *engine);
+
+/* Set up a position to play on.  The engine takes ownership of
+ * 'position'; NULL means the starting position.  Returns 0 on success,
+ * -1 while thinking or on failure.
+ */
+int engine_set_position(engine_t *engine, board_t *position);
+
+/* Play a move given in coordinate notation ("e2e4", "e7e8q").  Returns 0
+ * on success, -1 if the move is illegal or the engine is thinking.
+ */
+int engine_play_move(engine_t *engine, const char *text);
+
+/* Replace the positions the game went through before the current one
+ * (hashes, oldest first), for a front end that plays moves on
+ * engine->board itself.  Returns 0 on success, -1 while thinking or on
+ * allocation failure.
+ */
+int
+engine_set_game_history(engine_t *engine, const uint64_t *hashes, int count);
+
+/* Start searching the current position on a background thread.  Returns
+ * 0 on success, -1 if a search is already running.
+ */
+int engine_go(engine_t *engine, const search_limits_t *limits);
+
+/* The opponent played the expected move during a ponder search (started
+ * with limits.ponder): the search carries on, now against our clock, and
+ * reports when that says so.  Returns -1 if the engine isn't pondering.
+ */
+int engine_ponderhit(engine_t *engine);
+
+/* Ask the running search to finish and report its best move */
+void engine_stop(engine_t *engine);
+
+/* Block until the running search (if any) has reported */
+void engine_wait(engine_t *engine);
+
+/* Whether a search is running */
+bool engine_is_thinking(engine_t *engine);
+
+#endif
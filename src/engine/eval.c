@@ -0,0 +1,175 @@
+#include <stdlib.h>
+
+#include "eval.h"
+#include "material.h"
+#include "../model/board.h"
+#include "../model/piece.h"
+#include "../model/timer.h"
+
+/* Piece values in centipawns, indexed with piece_type_t */
+const int eval_piece_value[6] = {
+  500, /* ROOK */
+  320, /* KNIGHT */
+  330, /* BISHOP */
+  0,   /* KING */
+  900, /* QUEEN */
+  100  /* PAWN */
+};
+
+/*
+ * Piece-square tables from WHITE's point of view.  They are laid out the
+ * way a diagram is read, so row 0 is the eighth rank: index them with
+ * [7 - rank][file] for WHITE and [rank][file] for BLACK.
+ */
+static const int pst_pawn[8][8] = {
+  {  0,  0,  0,  0,  0,  0,  0,  0},
+  { 50, 50, 50, 50, 50, 50, 50, 50},
+  { 10, 10, 20, 30, 30, 20, 10, 10},
+  {  5,  5, 10, 25, 25, 10,  5,  5},
+  {  0,  0,  0, 20, 20,  0,  0,  0},
+  {  5, -5,-10,  0,  0,-10, -5,  5},
+  {  5, 10, 10,-20,-20, 10, 10,  5},
+  {  0,  0,  0,  0,  0,  0,  0,  0}
+};
+
+static const int pst_knight[8][8] = {
+  {-50,-40,-30,-30,-30,-30,-40,-50},
+  {-40,-20,  0,  0,  0,  0,-20,-40},
+  {-30,  0, 10, 15, 15, 10,  0,-30},
+  {-30,  5, 15, 20, 20, 15,  5,-30},
+  {-30,  0, 15, 20, 20, 15,  0,-30},
+  {-30,  5, 10, 15, 15, 10,  5,-30},
+  {-40,-20,  0,  5,  5,  0,-20,-40},
+  {-50,-40,-30,-30,-30,-30,-40,-50}
+};
+
+static const int pst_bishop[8][8] = {
+  {-20,-10,-10,-10,-10,-10,-10,-20},
+  {-10,  0,  0,  0,  0,  0,  0,-10},
+  {-10,  0,  5, 10, 10,  5,  0,-10},
+  {-10,  5,  5, 10, 10,  5,  5,-10},
+  {-10,  0, 10, 10, 10, 10,  0,-10},
+  {-10, 10, 10, 10, 10, 10, 10,-10},
+  {-10,  5,  0,  0,  0,  0,  5,-10},
+  {-20,-10,-10,-10,-10,-10,-10,-20}
+};
+
+static const int pst_rook[8][8] = {
+  {  0,  0,  0,  0,  0,  0,  0,  0},
+  {  5, 10, 10, 10, 10, 10, 10,  5},
+  { -5,  0,  0,  0,  0,  0,  0, -5},
+  { -5,  0,  0,  0,  0,  0,  0, -5},
+  { -5,  0,  0,  0,  0,  0,  0, -5},
+  { -5,  0,  0,  0,  0,  0,  0, -5},
+  { -5,  0,  0,  0,  0,  0,  0, -5},
+  {  0,  0,  0,  5,  5,  0,  0,  0}
+};
+
+static const int pst_queen[8][8] = {
+  {-20,-10,-10, -5, -5,-10,-10,-20},
+  {-10,  0,  0,  0,  0,  0,  0,-10},
+  {-10,  0,  5,  5,  5,  5,  0,-10},
+  { -5,  0,  5,  5,  5,  5,  0, -5},
+  {  0,  0,  5,  5,  5,  5,  0, -5},
+  {-10,  5,  5,  5,  5,  5,  0,-10},
+  {-10,  0,  5,  0,  0,  0,  0,-10},
+  {-20,-10,-10, -5, -5,-10,-10,-20}
+};
+
+static const int pst_king_middle[8][8] = {
+  {-30,-40,-40,-50,-50,-40,-40,-30},
+  {-30,-40,-40,-50,-50,-40,-40,-30},
+  {-30,-40,-40,-50,-50,-40,-40,-30},
+  {-30,-40,-40,-50,-50,-40,-40,-30},
+  {-20,-30,-30,-40,-40,-30,-30,-20},
+  {-10,-20,-20,-20,-20,-20,-20,-10},
+  { 20, 20,  0,  0,  0,  0, 20, 20},
+  { 20, 30, 10,  0,  0, 10, 30, 20}
+};
+
+static const int pst_king_end[8][8] = {
+  {-50,-40,-30,-20,-20,-30,-40,-50},
+  {-30,-20,-10,  0,  0,-10,-20,-30},
+  {-30,-10, 20, 30, 30, 20,-10,-30},
+  {-30,-10, 30, 40, 40, 30,-10,-30},
+  {-30,-10, 30, 40, 40, 30,-10,-30},
+  {-30,-10, 20, 30, 30, 20,-10,-30},
+  {-30,-30,  0,  0,  0,  0,-30,-30},
+  {-50,-30,-30,-30,-30,-30,-30,-50}
+};
+
+/* Middlegame and endgame tables, indexed with piece_type_t */
+static const int (*const pst_middle[6])[8] = {
+  pst_rook, pst_knight, pst_bishop, pst_king_middle, pst_queen, pst_pawn
+};
+static const int (*const pst_end[6])[8] = {
+  pst_rook, pst_knight, pst_bishop, pst_king_end, pst_queen, pst_pawn
+};
+
+/*
+ *   eval_evaluate
+ * Evaluate a position for the side to move.  The material table is
+ * probed first: known endgames are handed to their specialized
+ * evaluator, everything else gets material and piece-square scores
+ * tapered by game phase, with the endgame half scaled down in drawish
+ * material configurations.
+ *   @param board the position to evaluate
+ *   @param table the material table to consult (and fill)
+ *   @return the score in centipawns from the side to move's view
+ */
+int eval_evaluate(board_t *board, material_table_t *table)
+{
+  TIMER_PROFILE_SCOPE(PROFILE_EVAL);
+  material_entry_t *entry = material_table_probe(table, board);
+  int score;
+
+  if (entry->eval_fn) {
+    score = entry->eval_fn(board, entry->eval_strong_side);
+    return board->moves_next == entry->eval_strong_side ? score : -score;
+  }
+
+  int middle = entry->imbalance, end = entry->imbalance;
+  int rank, file, row;
+  piece_t *piece;
+
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (!piece) continue;
+
+      row = piece->color == WHITE ? 7 - rank : rank;
+      if (piece->color == WHITE) {
+        middle += eval_piece_value[piece->type] + pst_middle[piece->type][row][file];
+        end += eval_piece_value[piece->type] + pst_end[piece->type][row][file];
+      }
+      else {
+        middle -= eval_piece_value[piece->type] + pst_middle[piece->type][row][file];
+        end -= eval_piece_value[piece->type] + pst_end[piece->type][row][file];
+      }
+    }
+  }
+
+  /* Scale the endgame score for the side that is ahead */
+  color_t strong = end > 0 ? WHITE : BLACK;
+  int scale = entry->default_scale[strong];
+  if (entry->scale_fn[strong]) {
+    int fn_scale = entry->scale_fn[strong](board, strong);
+    if (fn_scale != SCALE_NONE) scale = fn_scale;
+  }
+  end = end * scale / SCALE_NORMAL;
+
+  score = (middle * entry->phase + end * (PHASE_MAX - entry->phase)) / PHASE_MAX;
+  return board->moves_next == WHITE ? score : -score;
+}
+
+/*
+ *   eval_king_distance
+ * The number of king moves needed to get from one square to another
+ *   @return the Chebyshev distance between the two squares
+ */
+int eval_king_distance(int rank1, int file1, int rank2, int file2)
+{
+  int rank_dist = abs(rank1 - rank2);
+  int file_dist = abs(file1 - file2);
+  return rank_dist > file_dist ? rank_dist : file_dist;
+}
@@ -0,0 +1,30 @@
+#ifndef _EVAL_H
+#define _EVAL_H
+
+#include "../model/board.h"
+#include "../model/piece.h"
+#include "material.h"
+
+/*
+ * Static evaluation of a position.  Scores are in centipawns and are
+ * always returned from the point of view of the side to move, which is
+ * what a negamax search expects.
+ */
+
+#define EVAL_DRAW       0
+#define EVAL_KNOWN_WIN  10000
+#define EVAL_MATE       30000
+#define EVAL_INFINITE   32000
+
+/* Piece values in centipawns, indexed with piece_type_t */
+extern const int eval_piece_value[6];
+
+/* Evaluate the board for the side to move.  The material table decides
+ * whether a specialized endgame function replaces the full evaluation.
+ */
+int eval_evaluate(board_t *board, material_table_t *table);
+
+/* Number of king moves between two squares, used by endgame heuristics */
+int eval_king_distance(int rank1, int file1, int rank2, int file2);
+
+#endif
@@ -0,0 +1,689 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "explorer.h"
+#include "book.h"
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/pgn.h"
+
+#define RUN_IO_BUFFER  (1 << 20)
+#define MAP_MIN_SIZE   4096
+#define BOOK_MAX_WEIGHT 0xFFFF
+
+/* One reading thread's counts */
+struct map {
+  explorer_entry_t *entries;  /* (strong) games == 0 marks a free slot */
+  size_t mask;                /* Slots - 1 */
+  size_t count;
+  size_t limit;               /* Spill beyond this many */
+  struct map *next;           /* (weak) In the builder's list */
+};
+typedef struct map map_t;
+
+struct builder {
+  const book_keys_t *keys;    /* (weak) */
+  explorer_options_t options;
+  size_t map_size;            /* Slots per map */
+  pthread_key_t key;          /* Each thread's map */
+  pthread_mutex_t lock;       /* Guards the list and the run count */
+  map_t *maps;                /* (strong) */
+  int num_runs;
+  int first_run;              /* Those before were merged into later runs */
+  atomic_bool failed;
+  atomic_long games;
+};
+typedef struct builder builder_t;
+
+/* A run being merged, with its next entry */
+struct run {
+  FILE *handle;               /* (strong) */
+  explorer_entry_t head;
+};
+typedef struct run run_t;
+
+static bool explore_game(const pgn_game_t *game, void *user);
+static map_t* thread_map(builder_t *builder);
+static explorer_entry_t* map_find(map_t *map, uint64_t key, uint16_t move);
+static bool spill(builder_t *builder, map_t *map);
+static int compare_entries(const void *a, const void *b);
+static void run_path(builder_t *builder, int run, char *path, size_t size);
+static bool merge_passes(builder_t *builder);
+static int merge(builder_t *builder, FILE *explorer, FILE *book);
+static int open_runs(builder_t *builder, int count, run_t *runs,
+                     run_t **heap);
+static void close_runs(run_t *runs, int count);
+static bool write_book(FILE *book, explorer_entry_t *entries, int count,
+                       uint32_t min_games);
+static int compare_weights(const void *a, const void *b);
+static uint32_t book_weight(const explorer_entry_t *entry);
+static void add_entry(explorer_entry_t *sum, const explorer_entry_t *entry);
+static bool run_next(run_t *run);
+static void sift_down(run_t **heap, int count, int i);
+static int tag_number(const pgn_game_t *game, const char *name);
+static void write_be(unsigned char *bytes, uint64_t value, int count);
+
+/*
+ *   explorer_default_options
+ * Fill in the default build options
+ *   @param options the options to fill
+ */
+void explorer_default_options(explorer_options_t *options)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  options->threads = cores > 0 ? cores : 1;
+  options->memory = (size_t)1 << 30;
+  options->temp_dir = ".";
+  options->max_ply = 40;
+  options->book_min_games = 5;
+}
+
+/*
+ *   explorer_build
+ * Count every move of every game into per-thread maps, spilling sorted
+ * runs when a map fills, then merge the runs into the explorer table and
+ * the book.  Both are written under temporary names and renamed at the
+ * end.
+ *   @param pgn_path the games
+ *   @param explorer_path the explorer table to write
+ *   @param book_path the Polyglot book to write, or NULL
+ *   @param keys the Polyglot Random64 table
+ *   @param options how to build
+ *   @param log progress messages, or NULL
+ *   @return 0 on success, -1 on failure
+ */
+int explorer_build(const char *pgn_path, const char *explorer_path,
+                   const char *book_path, const book_keys_t *keys,
+                   const explorer_options_t *options, FILE *log)
+{
+  char path[1024], explorer_temp[1024], book_temp[1024];
+  FILE *explorer = NULL, *book = NULL;
+  builder_t builder;
+  map_t *map, *next;
+  pgn_file_t *file;
+  long games;
+  int status = 0, run;
+
+  if (!keys || !(file = pgn_open(pgn_path))) return -1;
+
+  builder.keys = keys;
+  builder.options = *options;
+  if (builder.options.threads < 1) builder.options.threads = 1;
+  builder.map_size = MAP_MIN_SIZE;
+  while (builder.map_size * 2 * sizeof(explorer_entry_t) <=
+         options->memory / builder.options.threads)
+    builder.map_size *= 2;
+  builder.maps = NULL;
+  builder.num_runs = 0;
+  builder.first_run = 0;
+  atomic_init(&builder.failed, false);
+  atomic_init(&builder.games, 0);
+  pthread_key_create(&builder.key, NULL);
+  pthread_mutex_init(&builder.lock, NULL);
+
+  games = pgn_read_parallel(file, builder.options.threads, true,
+                            explore_game, &builder);
+  pgn_close(file);
+
+  for (map = builder.maps; map; map = next) {
+    next = map->next;
+    if (games >= 0 && map->count && !spill(&builder, map))
+      atomic_store(&builder.failed, true);
+    free(map->entries);
+    free(map);
+  }
+  pthread_key_delete(builder.key);
+  pthread_mutex_destroy(&builder.lock);
+  if (games < 0 || atomic_load(&builder.failed)) status = -1;
+  if (log && !status)
+    fprintf(log, "%ld games, %d runs\n", games, builder.num_runs);
+
+  snprintf(explorer_temp, sizeof(explorer_temp), "%s.tmp", explorer_path);
+  if (book_path) snprintf(book_temp, sizeof(book_temp), "%s.tmp", book_path);
+  if (!status && !merge_passes(&builder)) status = -1;
+  if (!status && (!(explorer = fopen(explorer_temp, "wb")) ||
+                  (book_path && !(book = fopen(book_temp, "wb")))))
+    status = -1;
+  if (!status) status = merge(&builder, explorer, book);
+
+  if (explorer && fclose(explorer)) status = -1;
+  if (book && fclose(book)) status = -1;
+  if (!status && (rename(explorer_temp, explorer_path) ||
+                  (book_path && rename(book_temp, book_path))))
+    status = -1;
+  if (status) {
+    remove(explorer_temp);
+    if (book_path) remove(book_temp);
+  }
+
+  for (run = 0; run < builder.num_runs; run++) {
+    run_path(&builder, run, path, sizeof(path));
+    remove(path);
+  }
+  return status;
+}
+
+/*
+ *   explorer_open
+ * Map an explorer table and check its header
+ *   @param path the table file
+ *   @return a * to the explorer, or NULL on failure
+ */
+explorer_t* explorer_open(const char *path)
+{
+  const explorer_header_t *header;
+  explorer_t *explorer;
+  struct stat info;
+  void *mapping;
+  int fd;
+
+  if (!path || (fd = open(path, O_RDONLY)) < 0) return NULL;
+  if (fstat(fd, &info) || (size_t)info.st_size < sizeof(explorer_header_t)) {
+    close(fd);
+    return NULL;
+  }
+  mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return NULL;
+  madvise(mapping, info.st_size, MADV_RANDOM);
+
+  header = mapping;
+  if (header->magic != EXPLORER_MAGIC || header->version != EXPLORER_VERSION ||
+      header->num_entries != (info.st_size - sizeof(explorer_header_t)) /
+                             sizeof(explorer_entry_t) ||
+      !(explorer = malloc(sizeof(explorer_t) ))) {
+    munmap(mapping, info.st_size);
+    return NULL;
+  }
+  explorer->mapping = mapping;
+  explorer->size = info.st_size;
+  explorer->header = header;
+  explorer->entries = (const explorer_entry_t *)(header + 1);
+  return explorer;
+}
+
+/*
+ *   explorer_close
+ * Unmap the table and cleanup its resources
+ *   @param explorer the table to close
+ */
+void explorer_close(explorer_t *explorer)
+{
+  if (!explorer) return;
+  munmap((void *)explorer->mapping, explorer->size);
+  free(explorer);
+}
+
+/*
+ *   explorer_moves
+ * Binary search for a position's first entry and copy out its moves
+ *   @param explorer the table
+ *   @param key the position's Polyglot key
+ *   @param entries receives the moves
+ *   @param max the room in 'entries'
+ *   @return the number of moves written
+ */
+int explorer_moves(explorer_t *explorer, uint64_t key,
+                   explorer_entry_t *entries, int max)
+{
+  uint64_t low = 0, high = explorer->header->num_entries, mid;
+  int count = 0;
+
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (explorer->entries[mid].key < key) low = mid + 1;
+    else high = mid;
+  }
+  for (; low < explorer->header->num_entries && count < max &&
+         explorer->entries[low].key == key; low++)
+    entries[count++] = explorer->entries[low];
+  return count;
+}
+
+/*
+ *   explore_game
+ * The reader's callback: count each move of the game's opening in the
+ * calling thread's map
+ *   @param game the game read
+ *   @param user the builder
+ *   @return false to stop reading after a failure
+ */
+static bool explore_game(const pgn_game_t *game, void *user)
+{
+  builder_t *builder = user;
+  map_t *map = thread_map(builder);
+  board_undo_t undo[PGN_MAX_PLIES];
+  board_t *board = game->board;
+  move_t *moves = (move_t *)game->moves;
+  int white_elo = tag_number(game, "WhiteElo");
+  int black_elo = tag_number(game, "BlackElo");
+  int plies = game->num_moves, ply;
+  explorer_entry_t *entry;
+
+  if (!map) return false;
+  if (plies > builder->options.max_ply) plies = builder->options.max_ply;
+  if (map->count + plies > map->limit && !spill(builder, map)) {
+    atomic_store(&builder->failed, true);
+    return false;
+  }
+
+  for (ply = 0; ply < plies; ply++) {
+    entry = map_find(map, book_key(builder->keys, board),
+                     book_polyglot_move(&moves[ply]));
+    entry->side = board->moves_next;
+    entry->games++;
+    entry->white_wins += game->result == PGN_RESULT_WHITE;
+    entry->draws += game->result == PGN_RESULT_DRAW;
+    entry->black_wins += game->result == PGN_RESULT_BLACK;
+    if (white_elo > 0 && black_elo > 0) {
+      entry->rated_games++;
+      entry->rating_sum += (white_elo + black_elo) / 2;
+    }
+    board_make_move(board, &moves[ply], &undo[ply]);
+  }
+  while (ply--) board_unmake_move(board, &moves[ply], &undo[ply]);
+
+  atomic_fetch_add_explicit(&builder->games, 1, memory_order_relaxed);
+  return true;
+}
+
+/*
+ *   thread_map
+ * The calling thread's map, created on its first game
+ *   @param builder the builder
+ *   @return the map, or NULL if it couldn't be allocated
+ */
+static map_t* thread_map(builder_t *builder)
+{
+  map_t *map = pthread_getspecific(builder->key);
+
+  if (map) return map;
+  if (!(map = malloc(sizeof(map_t) )) ||
+      !(map->entries = calloc(builder->map_size, sizeof(explorer_entry_t)))) {
+    free(map);
+    atomic_store(&builder->failed, true);
+    return NULL;
+  }
+  map->mask = builder->map_size - 1;
+  map->count = 0;
+  map->limit = builder->map_size / 4 * 3;
+  pthread_setspecific(builder->key, map);
+
+  pthread_mutex_lock(&builder->lock);
+  map->next = builder->maps;
+  builder->maps = map;
+  pthread_mutex_unlock(&builder->lock);
+  return map;
+}
+
+/*
+ *   map_find
+ * Find or insert the entry for a position and move, by linear probing
+ *   @param map the map
+ *   @param key the position's Polyglot key
+ *   @param move the Polyglot move
+ *   @return the entry (games == 0 if new)
+ */
+static explorer_entry_t* map_find(map_t *map, uint64_t key, uint16_t move)
+{
+  uint64_t hash = (key ^ (move * 0x9E3779B97F4A7C15ULL)) * 0xFF51AFD7ED558CCDULL;
+  size_t slot = (hash >> 20) & map->mask;
+  explorer_entry_t *entry;
+
+  for (;; slot = (slot + 1) & map->mask) {
+    entry = &map->entries[slot];
+    if (!entry->games) break;
+    if (entry->key == key && entry->move == move) return entry;
+  }
+  entry->key = key;
+  entry->move = move;
+  map->count++;
+  return entry;
+}
+
+/*
+ *   spill
+ * Pack a map's entries to the front, sort them and write them out as
+ * the next run file, then empty the map
+ *   @param builder the builder
+ *   @param map the map to spill
+ *   @return true on success
+ */
+static bool spill(builder_t *builder, map_t *map)
+{
+  size_t used = 0, i;
+  char path[1024];
+  FILE *handle;
+  bool ok;
+  int run;
+
+  for (i = 0; i <= map->mask; i++)
+    if (map->entries[i].games) map->entries[used++] = map->entries[i];
+  qsort(map->entries, used, sizeof(explorer_entry_t), compare_entries);
+
+  pthread_mutex_lock(&builder->lock);
+  run = builder->num_runs++;
+  pthread_mutex_unlock(&builder->lock);
+
+  run_path(builder, run, path, sizeof(path));
+  ok = (handle = fopen(path, "wb")) != NULL;
+  if (ok) {
+    ok = fwrite(map->entries, sizeof(explorer_entry_t), used, handle) == used;
+    ok = !fclose(handle) && ok;
+  }
+  memset(map->entries, 0, (map->mask + 1) * sizeof(explorer_entry_t));
+  map->count = 0;
+  return ok;
+}
+
+/*
+ *   compare_entries
+ * qsort order: by key, then move
+ */
+static int compare_entries(const void *a, const void *b)
+{
+  const explorer_entry_t *x = a, *y = b;
+
+  if (x->key != y->key) return x->key < y->key ? -1 : 1;
+  return (int)x->move - (int)y->move;
+}
+
+/*
+ *   run_path
+ * The file name of a run
+ */
+static void run_path(builder_t *builder, int run, char *path, size_t size)
+{
+  snprintf(path, size, "%s/explorer-%d-%d.run", builder->options.temp_dir,
+           (int)getpid(), run);
+}
+
+/*
+ *   merge_passes
+ * Merge the oldest runs, EXPLORER_MERGE_WAYS at a time, into a new run
+ * at the end, adding up entries for the same position and move, until
+ * the final merge can take the rest at once.  Merged runs are removed
+ * as soon as they are done with.
+ *   @param builder the builder, with its runs written
+ *   @return true on success
+ */
+static bool merge_passes(builder_t *builder)
+{
+  run_t runs[EXPLORER_MERGE_WAYS], *heap[EXPLORER_MERGE_WAYS];
+  explorer_entry_t current;
+  char path[1024];
+  FILE *out;
+  int count, i;
+  bool ok = true;
+
+  while (ok && builder->num_runs - builder->first_run > EXPLORER_MERGE_WAYS) {
+    if ((count = open_runs(builder, EXPLORER_MERGE_WAYS, runs, heap)) < 0)
+      return false;
+    run_path(builder, builder->num_runs, path, sizeof(path));
+    if (!(out = fopen(path, "wb"))) {
+      close_runs(runs, EXPLORER_MERGE_WAYS);
+      return false;
+    }
+    builder->num_runs++;
+    setvbuf(out, NULL, _IOFBF, RUN_IO_BUFFER);
+
+    /* Take the smallest head, then add up the heads equal to it */
+    while (count && ok) {
+      current = heap[0]->head;
+      for (;;) {
+        if (!run_next(heap[0])) heap[0] = heap[--count];
+        sift_down(heap, count, 0);
+        if (!count || compare_entries(&heap[0]->head, &current)) break;
+        add_entry(&current, &heap[0]->head);
+      }
+      ok = fwrite(&current, sizeof(current), 1, out) == 1;
+    }
+    ok = !fclose(out) && ok;
+    close_runs(runs, EXPLORER_MERGE_WAYS);
+    for (i = 0; i < EXPLORER_MERGE_WAYS; i++) {
+      run_path(builder, builder->first_run++, path, sizeof(path));
+      remove(path);
+    }
+  }
+  return ok;
+}
+
+/*
+ *   merge
+ * Merge the runs through a heap, adding up entries for the same position
+ * and move.  Each finished entry goes to the explorer table; each
+ * position's entries, once all are in, go to the book.
+ *   @param builder the builder, with at most EXPLORER_MERGE_WAYS runs
+ *                  left
+ *   @param explorer the explorer file
+ *   @param book the book file, or NULL
+ *   @return 0 on success, -1 on failure
+ */
+static int merge(builder_t *builder, FILE *explorer, FILE *book)
+{
+  run_t runs[EXPLORER_MERGE_WAYS], *heap[EXPLORER_MERGE_WAYS];
+  explorer_entry_t position[EXPLORER_MAX_MOVES], current, *next;
+  int opened = builder->num_runs - builder->first_run, count, moves = 0;
+  explorer_header_t header;
+  bool ok, have = false;
+
+  memset(&header, 0, sizeof(header));
+  if ((count = open_runs(builder, opened, runs, heap)) < 0) return -1;
+  ok = fwrite(&header, sizeof(header), 1, explorer) == 1;
+
+  /* Each head either adds to the current entry or completes it; the
+   * last pass, with the runs exhausted, completes the final one */
+  while (ok) {
+    next = count ? &heap[0]->head : NULL;
+    if (have && next && !compare_entries(next, &current)) {
+      add_entry(&current, next);
+    }
+    else {
+      if (have) {
+        ok = fwrite(&current, sizeof(current), 1, explorer) == 1;
+        header.num_entries++;
+        if (moves < EXPLORER_MAX_MOVES) position[moves++] = current;
+        if (!next || next->key != current.key) {
+          ok = ok && (!book || write_book(book, position, moves,
+                                          builder->options.book_min_games));
+          moves = 0;
+        }
+      }
+      if (!next) break;
+      current = *next;
+      have = true;
+    }
+    if (!run_next(heap[0])) heap[0] = heap[--count];
+    sift_down(heap, count, 0);
+  }
+  close_runs(runs, opened);
+
+  header.magic = EXPLORER_MAGIC;
+  header.version = EXPLORER_VERSION;
+  header.num_games = atomic_load(&builder->games);
+  ok = ok && !fseek(explorer, 0, SEEK_SET) &&
+       fwrite(&header, sizeof(header), 1, explorer) == 1;
+  return ok ? 0 : -1;
+}
+
+/*
+ *   open_runs
+ * Open the oldest runs still unmerged and heap them by their first
+ * entries
+ *   @param builder the builder
+ *   @param count how many runs, at most EXPLORER_MERGE_WAYS
+ *   @param runs receives the open runs
+ *   @param heap receives the runs that aren't empty, in heap order
+ *   @return the number of runs in the heap, or -1 if one couldn't be
+ *           opened (none are left open then)
+ */
+static int open_runs(builder_t *builder, int count, run_t *runs,
+                     run_t **heap)
+{
+  char path[1024];
+  int live = 0, i;
+
+  for (i = 0; i < count; i++) {
+    run_path(builder, builder->first_run + i, path, sizeof(path));
+    if (!(runs[i].handle = fopen(path, "rb"))) {
+      close_runs(runs, i);
+      return -1;
+    }
+    setvbuf(runs[i].handle, NULL, _IOFBF, RUN_IO_BUFFER);
+    if (run_next(&runs[i])) heap[live++] = &runs[i];
+  }
+  for (i = live / 2 - 1; i >= 0; i--) sift_down(heap, live, i);
+  return live;
+}
+
+/*
+ *   close_runs
+ * Close the first 'count' runs
+ */
+static void close_runs(run_t *runs, int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++) fclose(runs[i].handle);
+}
+
+/*
+ *   write_book
+ * Write one position's book entries: those played often enough that
+ * scored at all, best first, as 16-byte big-endian Polyglot entries
+ *   @param book the book file
+ *   @param entries the position's moves
+ *   @param count how many
+ *   @param min_games the fewest games a book move needs
+ *   @return true on success
+ */
+static bool write_book(FILE *book, explorer_entry_t *entries, int count,
+                       uint32_t min_games)
+{
+  unsigned char bytes[BOOK_ENTRY_SIZE * EXPLORER_MAX_MOVES];
+  uint32_t weight, most = 0;
+  int kept = 0, i;
+
+  for (i = 0; i < count; i++) {
+    if (entries[i].games < min_games || !book_weight(&entries[i])) continue;
+    entries[kept++] = entries[i];
+    if (book_weight(&entries[i]) > most) most = book_weight(&entries[i]);
+  }
+  qsort(entries, kept, sizeof(explorer_entry_t), compare_weights);
+
+  memset(bytes, 0, sizeof(bytes));
+  for (i = 0; i < kept; i++) {
+    weight = book_weight(&entries[i]);
+    if (most > BOOK_MAX_WEIGHT)
+      weight = (uint64_t)weight * BOOK_MAX_WEIGHT / most;
+    if (!weight) weight = 1;
+    write_be(bytes + i * BOOK_ENTRY_SIZE, entries[i].key, 8);
+    write_be(bytes + i * BOOK_ENTRY_SIZE + 8, entries[i].move, 2);
+    write_be(bytes + i * BOOK_ENTRY_SIZE + 10, weight, 2);
+  }
+  return fwrite(bytes, BOOK_ENTRY_SIZE, kept, book) == (size_t)kept;
+}
+
+/*
+ *   compare_weights
+ * qsort order: heaviest book weight first, then by move
+ */
+static int compare_weights(const void *a, const void *b)
+{
+  const explorer_entry_t *x = a, *y = b;
+  uint32_t wx = book_weight(x), wy = book_weight(y);
+
+  if (wx != wy) return wx > wy ? -1 : 1;
+  return (int)x->move - (int)y->move;
+}
+
+/*
+ *   book_weight
+ * Two points per win and one per draw, for the side playing the move
+ */
+static uint32_t book_weight(const explorer_entry_t *entry)
+{
+  uint32_t wins = entry->side == WHITE ? entry->white_wins
+                                       : entry->black_wins;
+  return 2 * wins + entry->draws;
+}
+
+/*
+ *   add_entry
+ * Add the counts of one entry to another for the same position and move
+ */
+static void add_entry(explorer_entry_t *sum, const explorer_entry_t *entry)
+{
+  sum->games += entry->games;
+  sum->white_wins += entry->white_wins;
+  sum->draws += entry->draws;
+  sum->black_wins += entry->black_wins;
+  sum->rated_games += entry->rated_games;
+  sum->rating_sum += entry->rating_sum;
+}
+
+/*
+ *   run_next
+ * Read a run's next entry into its head
+ *   @return false at the end of the run
+ */
+static bool run_next(run_t *run)
+{
+  return fread(&run->head, sizeof(explorer_entry_t), 1, run->handle) == 1;
+}
+
+/*
+ *   sift_down
+ * Restore the heap order below 'i'
+ */
+static void sift_down(run_t **heap, int count, int i)
+{
+  run_t *moved = heap[i];
+  int child;
+
+  while ((child = 2 * i + 1) < count) {
+    if (child + 1 < count &&
+        compare_entries(&heap[child + 1]->head, &heap[child]->head) < 0)
+      child++;
+    if (compare_entries(&heap[child]->head, &moved->head) >= 0) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (count) heap[i] = moved;
+}
+
+/*
+ *   tag_number
+ * The numeric value of a tag, or 0 if it is missing or not a number
+ */
+static int tag_number(const pgn_game_t *game, const char *name)
+{
+  char value[16];
+
+  if (pgn_tag_value(game, name, value, sizeof(value)) < 0) return 0;
+  return atoi(value);
+}
+
+/*
+ *   write_be
+ * Write an unsigned integer big-endian in 'count' bytes
+ */
+static void write_be(unsigned char *bytes, uint64_t value, int count)
+{
+  int i;
+
+  for (i = count - 1; i >= 0; i--) {
+    bytes[i] = value & 0xFF;
+    value >>= 8;
+  }
+}
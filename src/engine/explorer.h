@@ -0,0 +1,103 @@
+#ifndef _EXPLORER_H
+#define _EXPLORER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../model/board.h"
+#include "book.h"
+
+/*
+ * Opening explorer: for each position reached in a game database, every
+ * move played from it with how often, how the games ended and the
+ * average rating of the players.  Positions are named by their Polyglot
+ * key, so the same build produces an explorer table and a Polyglot book
+ * from one sorted stream.
+ *
+ * Building replays the games on the parallel PGN reader.  Each thread
+ * counts into its own open-addressing hash map; when a map passes its
+ * share of the memory budget it is sorted and spilled to a run file and
+ * emptied.  Runs are then merged, adding up the counts of entries with
+ * the same position and move, so the database may be far larger than
+ * memory.  No more than EXPLORER_MERGE_WAYS runs are open at once: while
+ * there are more, the oldest are merged into a new run.
+ *
+ * The explorer file is a header and the merged entries sorted by key and
+ * move, probed by binary search from a read-only mapping.
+ */
+
+#define EXPLORER_MERGE_WAYS  64
+#define EXPLORER_MAX_MOVES   256    /* Moves kept per position */
+
+/* Counts for one move from one position */
+struct explorer_entry {
+  uint64_t key;           /* Polyglot key of the position */
+  uint64_t rating_sum;    /* Over rated games: mean of both Elos */
+  uint32_t games;
+  uint32_t white_wins;
+  uint32_t draws;
+  uint32_t black_wins;
+  uint32_t rated_games;
+  uint16_t move;          /* Polyglot encoding, as in books */
+  uint8_t side;           /* The color that played the move */
+  uint8_t unused;
+};
+typedef struct explorer_entry explorer_entry_t;
+
+struct explorer_options {
+  int threads;
+  size_t memory;          /* Bytes for all threads' maps together */
+  const char *temp_dir;   /* Where run files go */
+  int max_ply;            /* Positions deeper than this are left out */
+  uint32_t book_min_games;/* Rarer moves are left out of the book */
+};
+typedef struct explorer_options explorer_options_t;
+
+#define EXPLORER_MAGIC   0x58454A47u /* "GJEX" */
+#define EXPLORER_VERSION 1
+struct explorer_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t num_entries;
+  uint64_t num_games;
+};
+typedef struct explorer_header explorer_header_t;
+
+struct explorer {
+  const unsigned char *mapping;     /* (strong) The whole file */
+  size_t size;
+  const explorer_header_t *header;  /* Into the mapping */
+  const explorer_entry_t *entries;  /* Into the mapping */
+};
+typedef struct explorer explorer_t;
+
+/* Fill in the default options: every core, 1 GB, the current directory,
+ * 40 plies and 5 games per book move
+ */
+void explorer_default_options(explorer_options_t *options);
+
+/* Build an explorer table at 'explorer_path' and, if 'book_path' isn't
+ * NULL, a Polyglot book, from the games in 'pgn_path'.  Book weights
+ * are 2 per win and 1 per draw for the side playing the move, scaled to
+ * fit 16 bits; moves that never scored are left out.  Progress goes to
+ * 'log' if non-NULL.  Returns 0, or -1 on failure.
+ */
+int explorer_build(const char *pgn_path, const char *explorer_path,
+                   const char *book_path, const book_keys_t *keys,
+                   const explorer_options_t *options, FILE *log);
+
+/* Map an explorer table.  Returns NULL if missing or damaged. */
+explorer_t* explorer_open(const char *path);
+
+/* Unmap the table and cleanup its resources */
+void explorer_close(explorer_t *explorer);
+
+/* The moves stored for a Polyglot key (see book_key), at most 'max'.
+ * Returns the number written to 'entries'.
+ */
+int explorer_moves(explorer_t *explorer, uint64_t key,
+                   explorer_entry_t *entries, int max);
+
+#endif
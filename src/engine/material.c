@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "material.h"
+#include "endgame.h"
+#include "eval.h"
+#include "../model/board.h"
+#include "../model/piece.h"
+
+/* Phase contribution of each piece type, indexed with piece_type_t */
+static const int phase_weight[6] = {
+  2, /* ROOK */
+  1, /* KNIGHT */
+  1, /* BISHOP */
+  0, /* KING */
+  4, /* QUEEN */
+  0  /* PAWN */
+};
+
+static int compute_imbalance(uint64_t key);
+static void compute_default_scale(material_entry_t *entry);
+static int non_pawn_material(uint64_t key, color_t color);
+
+/*
+ *   material_table_init
+ * Allocate a material table.  The number of entries is rounded up to
+ * the next power of two so probing can mask instead of dividing.
+ *   @param num_entries the minimum number of entries to allocate
+ *   @return a * to the new material_table_t, or NULL on failure
+ */
+material_table_t* material_table_init(int num_entries)
+{
+  if (num_entries <= 0) return NULL;
+
+  material_table_t *table = malloc(sizeof(material_table_t) );
+  if (!table) return NULL;
+
+  int size = 1;
+  while (size < num_entries) size <<= 1;
+
+  table->entries = calloc(size, sizeof(material_entry_t) );
+  if (!table->entries) {
+    free(table);
+    return NULL;
+  }
+  table->num_entries = size;
+  return table;
+}
+
+/*
+ *   material_table_destroy
+ * Cleanup all resources held by a material table
+ *   @param table the material_table_t to destroy
+ */
+void material_table_destroy(material_table_t *table)
+{
+  if (!table) return;
+  free(table->entries);
+  free(table);
+}
+
+/*
+ *   material_table_probe
+ * Look up the entry for the board's material key, computing and caching
+ * it on a miss.  Since the key only changes on captures and promotions
+ * consecutive probes during search almost always hit.
+ *   @param table the material table to probe
+ *   @param board the board whose material is being evaluated
+ *   @return a * to the entry describing the board's material
+ */
+material_entry_t*
+material_table_probe(material_table_t *table, board_t *board)
+{
+  uint64_t key = board->material_key;
+  uint64_t index = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+  material_entry_t *entry = &table->entries[index & (table->num_entries - 1)];
+
+  if (entry->valid && entry->key == key) return entry;
+
+  material_entry_compute(entry, key);
+  return entry;
+}
+
+/*
+ *   material_entry_compute
+ * Work out everything that depends only on material for the given key
+ *   @param entry the entry to fill in
+ *   @param key the material key to describe
+ */
+void material_entry_compute(material_entry_t *entry, uint64_t key)
+{
+  int type, phase = 0;
+
+  entry->key = key;
+  entry->eval_fn = NULL;
+  entry->eval_strong_side = WHITE;
+  entry->scale_fn[WHITE] = NULL;
+  entry->scale_fn[BLACK] = NULL;
+
+  /* Sum phase weights for both sides, clamped for promoted material */
+  for (type = ROOK; type <= PAWN; type++) {
+    phase += phase_weight[type] * MATERIAL_KEY_COUNT(key, WHITE, type);
+    phase += phase_weight[type] * MATERIAL_KEY_COUNT(key, BLACK, type);
+  }
+  entry->phase = phase > PHASE_MAX ? PHASE_MAX : phase;
+
+  entry->imbalance = compute_imbalance(key);
+  compute_default_scale(entry);
+  endgame_classify(entry);
+  entry->valid = true;
+}
+
+/*
+ *   compute_imbalance
+ * A small set of material-only adjustments: the bishop pair, knights
+ * gaining and rooks losing value as pawns come off, and redundancy
+ * between major pieces.
+ *   @param key the material key to inspect
+ *   @return the imbalance in centipawns from WHITE's point of view
+ */
+static int compute_imbalance(uint64_t key)
+{
+  int score[2] = {0, 0};
+  color_t color;
+
+  for (color = WHITE; color <= BLACK; color++) {
+    int pawns = MATERIAL_KEY_COUNT(key, color, PAWN);
+    int knights = MATERIAL_KEY_COUNT(key, color, KNIGHT);
+    int bishops = MATERIAL_KEY_COUNT(key, color, BISHOP);
+    int rooks = MATERIAL_KEY_COUNT(key, color, ROOK);
+    int queens = MATERIAL_KEY_COUNT(key, color, QUEEN);
+
+    if (bishops >= 2) score[color] += 40;
+    score[color] += knights * (pawns - 5) * 6;
+    score[color] -= rooks * (pawns - 5) * 12;
+    if (rooks >= 2) score[color] -= 16;
+    if (queens >= 1 && rooks >= 1) score[color] -= 8;
+  }
+
+  return score[WHITE] - score[BLACK];
+}
+
+/*
+ *   compute_default_scale
+ * A side without pawns needs a clear piece advantage to win.  Record
+ * how far its winning chances shrink when it is only a minor ahead.
+ *   @param entry the entry whose default_scale array is filled in
+ */
+static void compute_default_scale(material_entry_t *entry)
+{
+  color_t us;
+
+  for (us = WHITE; us <= BLACK; us++) {
+    color_t them = us == WHITE ? BLACK : WHITE;
+    int our_npm = non_pawn_material(entry->key, us);
+    int their_npm = non_pawn_material(entry->key, them);
+
+    entry->default_scale[us] = SCALE_NORMAL;
+    if (MATERIAL_KEY_COUNT(entry->key, us, PAWN) == 0 &&
+        our_npm - their_npm <= eval_piece_value[BISHOP]) {
+      if (our_npm < eval_piece_value[ROOK])
+        entry->default_scale[us] = SCALE_DRAW;
+      else if (their_npm <= eval_piece_value[BISHOP])
+        entry->default_scale[us] = 4;
+      else
+        entry->default_scale[us] = 14;
+    }
+  }
+}
+
+/*
+ *   non_pawn_material
+ * Sum the values of a side's knights, bishops, rooks and queens
+ *   @param key the material key to read counts from
+ *   @param color the side to total
+ *   @return the non-pawn material in centipawns
+ */
+static int non_pawn_material(uint64_t key, color_t color)
+{
+  return MATERIAL_KEY_COUNT(key, color, KNIGHT) * eval_piece_value[KNIGHT] +
+         MATERIAL_KEY_COUNT(key, color, BISHOP) * eval_piece_value[BISHOP] +
+         MATERIAL_KEY_COUNT(key, color, ROOK) * eval_piece_value[ROOK] +
+         MATERIAL_KEY_COUNT(key, color, QUEEN) * eval_piece_value[QUEEN];
+}
@@ -0,0 +1,65 @@
+#ifndef _MATERIAL_H
+#define _MATERIAL_H
+
+#include <stdint.h>
+#include "../model/board.h"
+#include "../model/chess.h"
+
+/*
+ * The material table caches everything that can be worked out from the
+ * board's material key alone: the imbalance adjustment, the game phase,
+ * and whether the material signature is a known endgame with its own
+ * evaluation or scaling function.  The evaluator probes it once per node
+ * and can skip the general evaluation entirely for recognized endgames.
+ */
+
+/* Game phase runs from PHASE_MAX (all minor and major pieces on the
+ * board) down to 0 (pawns and kings only).
+ */
+#define PHASE_MAX 24
+
+/* Scale factors shrink the endgame half of a score.  SCALE_NONE is
+ * returned by a scaling function that has no opinion about a position.
+ */
+#define SCALE_NORMAL 64
+#define SCALE_DRAW   0
+#define SCALE_NONE   -1
+
+/* Specialized endgame evaluators return a score from the point of view
+ * of strong_side.  Scaling functions return a factor out of SCALE_NORMAL.
+ */
+typedef int (*endgame_eval_fn)(board_t *board, color_t strong_side);
+typedef int (*endgame_scale_fn)(board_t *board, color_t strong_side);
+
+struct material_entry {
+  uint64_t key;                 /* Material key this entry describes */
+  int imbalance;                /* Adjustment in centipawns, WHITE's view */
+  int phase;                    /* 0 .. PHASE_MAX */
+  endgame_eval_fn eval_fn;      /* Replaces the full eval when non-NULL */
+  color_t eval_strong_side;     /* The side eval_fn scores for */
+  endgame_scale_fn scale_fn[2]; /* Indexed by the side that is ahead */
+  int default_scale[2];         /* Used when scale_fn is absent/undecided */
+  bool valid;
+};
+typedef struct material_entry material_entry_t;
+
+struct material_table {
+  material_entry_t *entries;
+  int num_entries;              /* Always a power of two */
+};
+typedef struct material_table material_table_t;
+
+/* Allocate a table; num_entries is rounded up to a power of two */
+material_table_t* material_table_init(int num_entries);
+
+/* Cleanup all resources held by the table */
+void material_table_destroy(material_table_t *table);
+
+/* Return the (possibly freshly computed) entry for the board's material */
+material_entry_t*
+material_table_probe(material_table_t *table, board_t *board);
+
+/* Fill in an entry for the given material key without caching it */
+void material_entry_compute(material_entry_t *entry, uint64_t key);
+
+#endif
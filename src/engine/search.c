@@ -0,0 +1,736 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "search.h"
+#include "eval.h"
+#include "material.h"
+#include "trans_table.h"
+#include "time_manager.h"
+#include "tablebase.h"
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/move_list.h"
+#include "../model/move_gen.h"
+#include "../model/timer.h"
+#include "../model/history_stack.h"
+
+/* Move ordering bands, highest searched first */
+#define ORDER_TT_MOVE   (1u << 30)
+#define ORDER_CAPTURE   (1u << 28)
+#define ORDER_KILLER    (1u << 27)
+#define HISTORY_MAX     (1 << 26)
+
+static int negamax(search_t *search, int alpha, int beta, int depth, int ply,
+                   bool allow_null);
+static int quiesce(search_t *search, int alpha, int beta, int ply);
+static void score_moves(search_t *search, move_list_t *moves, int ply,
+                        uint16_t tt_move);
+static move_t* pick_next(move_list_t *moves, int index);
+static void update_pv(search_t *search, int ply, uint16_t move);
+static void update_quiet_stats(search_t *search, move_t *move, int ply,
+                               int depth);
+static bool is_draw(search_t *search);
+static bool should_stop(search_t *search);
+static bool has_non_pawn_material(board_t *board, color_t side);
+static int score_to_table(int score, int ply);
+static int score_from_table(int score, int ply);
+static void report(search_t *search, int line);
+static bool is_excluded(search_t *search, uint16_t move);
+static bool clock_applies(search_t *search);
+static int tablebase_score(const tb_result_t *result, int ply);
+
+/*
+ *   search_init
+ * Create a search workspace.  The material and transposition tables may
+ * be shared with other searches that run one after the other.
+ *   @param material the material table used by the evaluation
+ *   @param table the transposition table
+ *   @return a * to the new search, or NULL on failure
+ */
+search_t* search_init(material_table_t *material, trans_table_t *table)
+{
+  int ply;
+  search_t *search = calloc(1, sizeof(search_t) );
+  if (!search) return NULL;
+
+  for (ply = 0; ply < SEARCH_MAX_PLY; ply++) {
+    search->moves[ply] = move_list_new();
+    if (!search->moves[ply]) {
+      search_destroy(search);
+      return NULL;
+    }
+  }
+  search->material = material;
+  search->table = table;
+  atomic_init(&search->stop, false);
+  atomic_init(&search->pondering, false);
+  return search;
+}
+
+/*
+ *   search_destroy
+ * Cleanup the workspace.  The shared tables are left alone.
+ *   @param search the search to destroy
+ */
+void search_destroy(search_t *search)
+{
+  int ply;
+  if (!search) return;
+  for (ply = 0; ply < SEARCH_MAX_PLY; ply++)
+    move_list_destroy(search->moves[ply]);
+  free(search);
+}
+
+/*
+ *   search_set_info_callback
+ * Register the function called after every completed iteration
+ *   @param search the search to report on
+ *   @param on_info the callback (NULL for none)
+ *   @param user passed back to the callback untouched
+ */
+void
+search_set_info_callback(search_t *search, search_info_fn on_info, void *user)
+{
+  search->on_info = on_info;
+  search->info_user = user;
+}
+
+/*
+ *   search_set_game_history
+ * Record the hashes of the positions played before the one to search.
+ * Only the most recent ones are kept if there are too many; older
+ * positions can't repeat anyway once a pawn has moved or a piece has
+ * been captured.
+ *   @param search the search to configure
+ *   @param hashes the position hashes, oldest first
+ *   @param count the number of hashes
+ */
+void
+search_set_game_history(search_t *search, const uint64_t *hashes, int count)
+{
+  int room = SEARCH_MAX_HISTORY - SEARCH_MAX_PLY;
+  if (count > room) {
+    hashes += count - room;
+    count = room;
+  }
+  memcpy(search->hashes, hashes, count * sizeof(uint64_t) );
+  search->num_game_hashes = count;
+  search->num_hashes = count;
+}
+
+/*
+ *   search_set_tablebase
+ * Attach endgame tables to probe during the search
+ *   @param search the search to configure
+ *   @param tablebase the tables, or NULL to stop probing
+ */
+void search_set_tablebase(search_t *search, tablebase_t *tablebase)
+{
+  search->tablebase = tablebase;
+}
+
+/*
+ *   search_clear
+ * Forget everything learned from earlier searches (but not the shared
+ * transposition table, which the owner clears)
+ *   @param search the search to reset
+ */
+void search_clear(search_t *search)
+{
+  memset(search->killers, 0, sizeof(search->killers) );
+  memset(search->history, 0, sizeof(search->history) );
+  search->num_game_hashes = 0;
+  search->num_hashes = 0;
+}
+
+/*
+ *   search_run
+ * Iterative deepening: search to depth 1, 2, ... until a limit is hit,
+ * reporting after each completed line of each iteration.  A line cut
+ * short by a limit is thrown away, except for the very first one.
+ *   @param search the workspace to search with
+ *   @param board the position to search; left as it was on return
+ *   @param limits when to stop
+ *   @param ponder if non-NULL, receives the expected reply
+ *   @return the best move packed, or MOVE_NONE with no legal moves
+ */
+uint16_t
+search_run(search_t *search, board_t *board, const search_limits_t *limits,
+           uint16_t *ponder)
+{
+  TIMER_PROFILE_SCOPE(PROFILE_SEARCH);
+  uint16_t best = MOVE_NONE, reply = MOVE_NONE;
+  int depth, max_depth, score, line, color, from, to;
+  bool changed, stopped = false;
+
+  timer_reset(&search->clock);
+  timer_start(&search->clock);
+  search->board = board;
+  search->limits = *limits;
+  search->nodes = 0;
+  search->tb_hits = 0;
+  search->seldepth = 0;
+  search->num_hashes = search->num_game_hashes;
+  search->repetition_floor = 0;
+  memset(search->killers, 0, sizeof(search->killers) );
+  for (color = 0; color < 2; color++)
+    for (from = 0; from < NUM_SQUARES; from++)
+      for (to = 0; to < NUM_SQUARES; to++)
+        search->history[color][from][to] /= 2;
+
+  /* While pondering the clock isn't ours yet: search without deadlines
+   * and arm the time manager at the ponderhit
+   */
+  atomic_store(&search->pondering, limits->ponder);
+  search->clock_pending = limits->ponder;
+  time_manager_init(&search->time, clock_applies(search) ? &limits->time
+                                                         : NULL);
+  trans_table_new_search(search->table);
+
+  /* There is always a move to play, even if the first iteration is cut */
+  move_list_clear(search->moves[0]);
+  if (!move_gen_legal(board, search->moves[0])) {
+    if (ponder) *ponder = MOVE_NONE;
+    return MOVE_NONE;
+  }
+  best = move_pack(&search->moves[0]->moves[0]);
+
+  search->num_lines = limits->multipv > 1 ? limits->multipv : 1;
+  if (search->num_lines > SEARCH_MAX_MULTIPV)
+    search->num_lines = SEARCH_MAX_MULTIPV;
+  if (search->num_lines > search->moves[0]->num_moves)
+    search->num_lines = search->moves[0]->num_moves;
+  for (line = 0; line < search->num_lines; line++)
+    search->lines[line].pv_length = 0;
+
+  max_depth = SEARCH_MAX_PLY - 1;
+  if (limits->depth > 0 && limits->depth < max_depth) max_depth = limits->depth;
+
+  for (depth = 1; depth <= max_depth && !stopped; depth++) {
+    for (line = 0; line < search->num_lines && !stopped; line++) {
+      search->num_excluded = line;
+      score = negamax(search, -EVAL_INFINITE, EVAL_INFINITE, depth, 0, false);
+
+      /* A line cut short is thrown away, unless it is all there is */
+      stopped = atomic_load(&search->stop);
+      if (stopped && (depth > 1 || line > 0)) break;
+      if (search->pv_length[0] == 0) break;
+
+      search->lines[line].depth = depth;
+      search->lines[line].score = score;
+      search->lines[line].pv_length = search->pv_length[0];
+      memcpy(search->lines[line].pv, search->pv[0],
+             search->pv_length[0] * sizeof(uint16_t) );
+      if (!stopped) report(search, line);
+    }
+
+    changed = false;
+    if (search->lines[0].pv_length > 0) {
+      changed = search->lines[0].pv[0] != best;
+      best = search->lines[0].pv[0];
+      reply = search->lines[0].pv_length > 1 ? search->lines[0].pv[1]
+                                             : MOVE_NONE;
+    }
+    if (stopped) break;
+
+    score = search->lines[0].score;
+    if (clock_applies(search) &&
+        !time_manager_iteration_done(&search->time, changed, score))
+      break;
+    /* A forced mate found within the searched depth won't get shorter */
+    if (!limits->infinite && search->num_lines == 1 &&
+        abs(score) >= SEARCH_MATE_BOUND && EVAL_MATE - abs(score) <= depth)
+      break;
+  }
+
+  if (ponder) *ponder = reply;
+  return best;
+}
+
+/*
+ *   search_stop
+ * Ask a running search to return.  Safe to call from any thread; the
+ * search notices at its next node.
+ *   @param search the search to stop
+ */
+void search_stop(search_t *search)
+{
+  atomic_store(&search->stop, true);
+}
+
+/*
+ *   search_ponderhit
+ * Turn a ponder search into a normal one.  The search thread arms its
+ * time manager at its next node, so the clock starts counting now while
+ * the tree, tables and iteration state built so far are all kept.
+ *   @param search the running ponder search
+ */
+void search_ponderhit(search_t *search)
+{
+  atomic_store(&search->pondering, false);
+}
+
+/*
+ *   search_reset_stop
+ * Withdraw a stop request so the next search_run can proceed
+ *   @param search the search to re-arm
+ */
+void search_reset_stop(search_t *search)
+{
+  atomic_store(&search->stop, false);
+}
+
+/*
+ *   negamax
+ * Principal-variation alpha-beta search.  The first move is searched
+ * with the full window and the rest with a null window, re-searching
+ * only those that unexpectedly beat alpha.
+ *   @return the score from the side to move's view, or 0 when stopped
+ */
+static int negamax(search_t *search, int alpha, int beta, int depth, int ply,
+                   bool allow_null)
+{
+  board_t *board = search->board;
+  bool pv_node = beta - alpha > 1;
+  bool in_check, quiet;
+  int original_alpha = alpha, best_score = -EVAL_INFINITE;
+  int score, legal = 0, reduction, bound, i;
+  uint16_t tt_move = MOVE_NONE, best_move = MOVE_NONE, packed;
+  trans_entry_t *entry;
+  tb_result_t tb_result;
+  move_list_t *moves;
+  move_t *move;
+
+  search->pv_length[ply] = ply;
+  if (ply >= SEARCH_MAX_PLY - 1) return eval_evaluate(board, search->material);
+
+  if (ply > 0) {
+    if (is_draw(search)) return EVAL_DRAW;
+
+    /* The tables know the result; they hold no castling or en passant */
+    if (search->tablebase && !board->castle_rights &&
+        board->en_passant == NO_SQUARE &&
+        tablebase_probe(search->tablebase, board, &tb_result)) {
+      search->tb_hits++;
+      return tablebase_score(&tb_result, ply);
+    }
+
+    /* No line from here can beat a mate that is already shorter */
+    if (alpha < -EVAL_MATE + ply) alpha = -EVAL_MATE + ply;
+    if (beta > EVAL_MATE - ply - 1) beta = EVAL_MATE - ply - 1;
+    if (alpha >= beta) return alpha;
+  }
+
+  in_check = move_gen_in_check(board, board->moves_next);
+  if (in_check) depth++;
+  if (depth <= 0) return quiesce(search, alpha, beta, ply);
+
+  search->nodes++;
+  if (should_stop(search)) return 0;
+
+  entry = trans_table_probe(search->table, board->hash);
+  if (entry) {
+    tt_move = entry->move;
+    if (!pv_node && entry->depth >= depth) {
+      score = score_from_table(entry->score, ply);
+      if (entry->bound == TT_BOUND_EXACT ||
+          (entry->bound == TT_BOUND_LOWER && score >= beta) ||
+          (entry->bound == TT_BOUND_UPPER && score <= alpha))
+        return score;
+    }
+  }
+
+  /* Null move: if passing still beats beta, a real move surely will.
+   * Skipped without pieces, where zugzwang makes passing unsound.
+   */
+  if (!pv_node && !in_check && allow_null && depth >= 3 &&
+      has_non_pawn_material(board, board->moves_next) &&
+      eval_evaluate(board, search->material) >= beta) {
+    int floor = search->repetition_floor;
+    reduction = 2 + depth / 4;
+
+    search->hashes[search->num_hashes++] = board->hash;
+    search->repetition_floor = search->num_hashes;
+    board_make_null_move(board, &search->undo[ply]);
+    score = -negamax(search, -beta, -beta + 1, depth - 1 - reduction, ply + 1,
+                     false);
+    board_unmake_null_move(board, &search->undo[ply]);
+    search->repetition_floor = floor;
+    search->num_hashes--;
+
+    if (atomic_load_explicit(&search->stop, memory_order_relaxed)) return 0;
+    if (score >= beta) return score >= SEARCH_MATE_BOUND ? beta : score;
+  }
+
+  moves = search->moves[ply];
+  move_list_clear(moves);
+  move_gen_pseudo_legal(board, moves);
+  score_moves(search, moves, ply, tt_move);
+
+  for (i = 0; i < moves->num_moves; i++) {
+    move = pick_next(moves, i);
+    packed = move_pack(move);
+    quiet = !(move->flags & (MOVE_CAPTURE | MOVE_PROMOTION));
+    if (ply == 0 && is_excluded(search, packed)) continue;
+
+    search->hashes[search->num_hashes++] = board->hash;
+    board_make_move(board, move, &search->undo[ply]);
+    if (move_gen_left_in_check(board)) {
+      board_unmake_move(board, move, &search->undo[ply]);
+      search->num_hashes--;
+      continue;
+    }
+    legal++;
+
+    if (legal == 1) {
+      score = -negamax(search, -beta, -alpha, depth - 1, ply + 1, true);
+    }
+    else {
+      /* Late quiet moves are rarely best: look at them less deeply first */
+      reduction = 0;
+      if (depth >= 3 && legal > 4 && quiet && !in_check &&
+          !move_gen_in_check(board, board->moves_next))
+        reduction = legal > 12 ? 2 : 1;
+
+      score = -negamax(search, -alpha - 1, -alpha, depth - 1 - reduction,
+                       ply + 1, true);
+      if (score > alpha && reduction)
+        score = -negamax(search, -alpha - 1, -alpha, depth - 1, ply + 1, true);
+      if (score > alpha && score < beta)
+        score = -negamax(search, -beta, -alpha, depth - 1, ply + 1, true);
+    }
+
+    board_unmake_move(board, move, &search->undo[ply]);
+    search->num_hashes--;
+    if (atomic_load_explicit(&search->stop, memory_order_relaxed)) return 0;
+
+    if (score > best_score) {
+      best_score = score;
+      best_move = packed;
+      if (score > alpha) {
+        alpha = score;
+        update_pv(search, ply, packed);
+        if (score >= beta) {
+          if (quiet) update_quiet_stats(search, move, ply, depth);
+          break;
+        }
+      }
+    }
+  }
+
+  if (!legal) return in_check ? -EVAL_MATE + ply : EVAL_DRAW;
+
+  /* A root search with moves left out says nothing about the position */
+  if (ply == 0 && search->num_excluded) return best_score;
+
+  if (best_score >= beta) bound = TT_BOUND_LOWER;
+  else if (best_score > original_alpha) bound = TT_BOUND_EXACT;
+  else bound = TT_BOUND_UPPER;
+  trans_table_store(search->table, board->hash, best_move,
+                    score_to_table(best_score, ply), depth, bound);
+  return best_score;
+}
+
+/*
+ *   quiesce
+ * Resolve captures at the horizon so the static evaluation is only
+ * trusted in quiet positions.  The side to move may 'stand pat' on the
+ * static evaluation instead of capturing.
+ *   @return the score from the side to move's view, or 0 when stopped
+ */
+static int quiesce(search_t *search, int alpha, int beta, int ply)
+{
+  board_t *board = search->board;
+  int best_score, score, i;
+  move_list_t *moves;
+  move_t *move;
+
+  search->pv_length[ply] = ply;
+  search->nodes++;
+  if (ply > search->seldepth) search->seldepth = ply;
+  if (should_stop(search)) return 0;
+
+  best_score = eval_evaluate(board, search->material);
+  if (ply >= SEARCH_MAX_PLY - 1 || best_score >= beta) return best_score;
+  if (best_score > alpha) alpha = best_score;
+
+  moves = search->moves[ply];
+  move_list_clear(moves);
+  move_gen_captures(board, moves);
+  score_moves(search, moves, ply, MOVE_NONE);
+
+  for (i = 0; i < moves->num_moves; i++) {
+    move = pick_next(moves, i);
+
+    board_make_move(board, move, &search->undo[ply]);
+    if (move_gen_left_in_check(board)) {
+      board_unmake_move(board, move, &search->undo[ply]);
+      continue;
+    }
+    score = -quiesce(search, -beta, -alpha, ply + 1);
+    board_unmake_move(board, move, &search->undo[ply]);
+    if (atomic_load_explicit(&search->stop, memory_order_relaxed)) return 0;
+
+    if (score > best_score) {
+      best_score = score;
+      if (score > alpha) {
+        alpha = score;
+        if (score >= beta) break;
+      }
+    }
+  }
+  return best_score;
+}
+
+/*
+ *   score_moves
+ * Give every move its ordering score: the table move, then captures by
+ * most valuable victim / least valuable attacker, then killers, then
+ * quiet moves by history
+ */
+static void score_moves(search_t *search, move_list_t *moves, int ply,
+                        uint16_t tt_move)
+{
+  color_t us = search->board->moves_next;
+  move_t *move;
+  int i, victim, attacker;
+  uint16_t packed;
+
+  for (i = 0; i < moves->num_moves; i++) {
+    move = &moves->moves[i];
+    packed = move_pack(move);
+
+    if (packed == tt_move) {
+      move->score = ORDER_TT_MOVE;
+    }
+    else if (move->flags & (MOVE_CAPTURE | MOVE_PROMOTION)) {
+      victim = 0;
+      if (move->flags & MOVE_EN_PASSANT)
+        victim = eval_piece_value[PAWN];
+      else if (move->to_square->piece)
+        victim = eval_piece_value[move->to_square->piece->type];
+      if (move->flags & MOVE_PROMOTION)
+        victim += eval_piece_value[move->promotion];
+      attacker = eval_piece_value[move->from_square->piece->type];
+      move->score = ORDER_CAPTURE + victim * 16 - attacker / 16;
+    }
+    else if (packed == search->killers[ply][0]) {
+      move->score = ORDER_KILLER + 1;
+    }
+    else if (packed == search->killers[ply][1]) {
+      move->score = ORDER_KILLER;
+    }
+    else {
+      move->score = search->history[us]
+        [SQUARE_INDEX(move->from_square->rank, move->from_square->file)]
+        [SQUARE_INDEX(move->to_square->rank, move->to_square->file)];
+    }
+  }
+}
+
+/*
+ *   pick_next
+ * Selection sort one step at a time: swap the best remaining move into
+ * 'index'.  Cheaper than a full sort because most nodes cut off early.
+ */
+static move_t* pick_next(move_list_t *moves, int index)
+{
+  int i, best = index;
+  move_t swap;
+
+  for (i = index + 1; i < moves->num_moves; i++) {
+    if (moves->moves[i].score > moves->moves[best].score) best = i;
+  }
+  if (best != index) {
+    swap = moves->moves[index];
+    moves->moves[index] = moves->moves[best];
+    moves->moves[best] = swap;
+  }
+  return &moves->moves[index];
+}
+
+/*
+ *   update_pv
+ * The principal variation at 'ply' becomes 'move' followed by the one
+ * just found a ply deeper
+ */
+static void update_pv(search_t *search, int ply, uint16_t move)
+{
+  int i;
+  search->pv[ply][ply] = move;
+  for (i = ply + 1; i < search->pv_length[ply + 1]; i++)
+    search->pv[ply][i] = search->pv[ply + 1][i];
+  search->pv_length[ply] = search->pv_length[ply + 1] > ply + 1
+                         ? search->pv_length[ply + 1] : ply + 1;
+}
+
+/*
+ *   update_quiet_stats
+ * A quiet move caused a cutoff: remember it as a killer for this ply and
+ * credit it in the history table
+ */
+static void update_quiet_stats(search_t *search, move_t *move, int ply,
+                               int depth)
+{
+  uint16_t packed = move_pack(move);
+  int *entry = &search->history[search->board->moves_next]
+    [SQUARE_INDEX(move->from_square->rank, move->from_square->file)]
+    [SQUARE_INDEX(move->to_square->rank, move->to_square->file)];
+
+  if (search->killers[ply][0] != packed) {
+    search->killers[ply][1] = search->killers[ply][0];
+    search->killers[ply][0] = packed;
+  }
+  *entry += depth * depth;
+  if (*entry > HISTORY_MAX) *entry = HISTORY_MAX;
+}
+
+/*
+ *   is_draw
+ * Fifty-move rule or a repetition.  Only positions since the last
+ * capture or pawn move (and the last null move) can repeat, and only
+ * every other one has the same side to move.
+ */
+static bool is_draw(search_t *search)
+{
+  board_t *board = search->board;
+  int oldest = search->num_hashes - board->halfmove_clock;
+
+  if (board->halfmove_clock >= 100) return true;
+  if (oldest < search->repetition_floor) oldest = search->repetition_floor;
+
+  return history_stack_repeated(search->hashes, search->num_hashes, oldest,
+                                board->hash, 1);
+}
+
+/*
+ *   should_stop
+ * Checks every limit; a hit latches the stop flag so the whole tree
+ * unwinds
+ */
+static bool should_stop(search_t *search)
+{
+  if (atomic_load_explicit(&search->stop, memory_order_relaxed)) return true;
+
+  if (search->clock_pending &&
+      !atomic_load_explicit(&search->pondering, memory_order_relaxed)) {
+    search->clock_pending = false;
+    if (clock_applies(search))
+      time_manager_init(&search->time, &search->limits.time);
+  }
+
+  if ((search->limits.nodes && search->nodes >= search->limits.nodes) ||
+      time_manager_should_stop(&search->time, search->nodes)) {
+    atomic_store(&search->stop, true);
+    return true;
+  }
+  return false;
+}
+
+/*
+ *   has_non_pawn_material
+ * Whether a side has anything besides king and pawns
+ */
+static bool has_non_pawn_material(board_t *board, color_t side)
+{
+  return board_material_count(board, side, KNIGHT) ||
+         board_material_count(board, side, BISHOP) ||
+         board_material_count(board, side, ROOK) ||
+         board_material_count(board, side, QUEEN);
+}
+
+/*
+ *   score_to_table
+ * Mate scores are stored relative to the node, not the root, so they
+ * stay correct when the position is reached at another ply
+ */
+static int score_to_table(int score, int ply)
+{
+  if (score >= SEARCH_MATE_BOUND) return score + ply;
+  if (score <= -SEARCH_MATE_BOUND) return score - ply;
+  return score;
+}
+
+/*
+ *   score_from_table
+ * Undo score_to_table for the ply the entry was found at
+ */
+static int score_from_table(int score, int ply)
+{
+  if (score >= SEARCH_MATE_BOUND) return score - ply;
+  if (score <= -SEARCH_MATE_BOUND) return score + ply;
+  return score;
+}
+
+/*
+ *   report
+ * Pass a completed line to the info callback
+ */
+static void report(search_t *search, int line)
+{
+  search_line_t *result = &search->lines[line];
+  search_info_t info;
+
+  if (!search->on_info) return;
+
+  info.multipv = line + 1;
+  info.depth = result->depth;
+  info.seldepth = search->seldepth > result->depth ? search->seldepth
+                                                   : result->depth;
+  info.score = result->score;
+  info.nodes = search->nodes;
+  info.time_ms = timer_elapsed_ms(&search->clock);
+  info.hashfull = trans_table_hashfull(search->table);
+  info.tb_hits = search->tb_hits;
+  info.pv_length = result->pv_length;
+  memcpy(info.pv, result->pv, result->pv_length * sizeof(uint16_t) );
+  search->on_info(&info, search->info_user);
+}
+
+/*
+ *   is_excluded
+ * Whether a root move already heads an earlier MultiPV line
+ */
+static bool is_excluded(search_t *search, uint16_t move)
+{
+  int line;
+  for (line = 0; line < search->num_excluded; line++) {
+    if (search->lines[line].pv[0] == move) return true;
+  }
+  return false;
+}
+
+/*
+ *   clock_applies
+ * Whether the time manager should limit the search right now: a clock
+ * was given, the search isn't infinite, and it isn't (still) pondering
+ */
+static bool clock_applies(search_t *search)
+{
+  return search->limits.use_time && !search->limits.infinite &&
+         !search->clock_pending;
+}
+
+/*
+ *   tablebase_score
+ * Turn a table result into a search score.  Mates too far away to fit
+ * the mate score range (or of unknown distance) score as known wins,
+ * still preferring the shorter ones.
+ *   @param result the probe result for the side to move
+ *   @param ply the distance from the root
+ *   @return the score from the side to move's view
+ */
+static int tablebase_score(const tb_result_t *result, int ply)
+{
+  int score;
+
+  if (result->wdl == TB_DRAW) return EVAL_DRAW;
+  if (result->dtm == TB_DTM_UNKNOWN || ply + result->dtm >= SEARCH_MAX_PLY)
+    score = EVAL_KNOWN_WIN - result->dtm;
+  else
+    score = EVAL_MATE - ply - result->dtm;
+  return result->wdl == TB_WIN ? score : -score;
+}
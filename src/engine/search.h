@@ -0,0 +1,168 @@
+#ifndef _SEARCH_H
+#define _SEARCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "../model/board.h"
+#include "../model/move.h"
+#include "../model/move_list.h"
+#include "material.h"
+#include "eval.h"
+#include "trans_table.h"
+#include "time_manager.h"
+#include "tablebase.h"
+
+/*
+ * The search picks a move for the side to move with iterative deepening
+ * over a principal-variation alpha-beta search, followed by a
+ * captures-only quiescence search at the horizon.  Moves are ordered by
+ * the transposition table move, then captures (most valuable victim
+ * first), killer moves and the history heuristic.  Null-move pruning and
+ * late move reductions cut the tree further.
+ *
+ * In MultiPV mode every iteration searches the root once per line: line
+ * N is the best move with the moves of lines 1..N-1 excluded.  The lines
+ * share the transposition table and move ordering, so later lines are
+ * much cheaper than independent searches.
+ *
+ * With endgame tables attached, positions they cover are scored from
+ * the tables instead of being searched: won and lost positions get a
+ * mate score at the stored distance.
+ *
+ * A search_t is a private workspace: it holds no globals, so any number
+ * of searches may run in parallel as long as each has its own board.
+ * All moves crossing the API are packed (see move_pack).
+ */
+
+#define SEARCH_MAX_PLY      64
+#define SEARCH_MAX_HISTORY  1024  /* Game + search positions tracked */
+#define SEARCH_MAX_MULTIPV  64
+
+/* Scores beyond this bound are mates, EVAL_MATE - plies to mate */
+#define SEARCH_MATE_BOUND (EVAL_MATE - SEARCH_MAX_PLY)
+
+/* What ends the search; zero fields mean 'no limit of this kind' */
+struct search_limits {
+  int depth;              /* Maximum iterative-deepening depth */
+  uint64_t nodes;         /* Node budget */
+  time_control_t time;    /* Clock situation, used when use_time is set */
+  bool use_time;
+  bool infinite;          /* Search until stopped, ignoring the clock */
+  bool ponder;            /* Searching on the opponent's time: the clock
+                             only applies from search_ponderhit on */
+  int multipv;            /* Number of best lines wanted (0 = 1) */
+};
+typedef struct search_limits search_limits_t;
+
+/* One principal variation at the root */
+struct search_line {
+  int depth;
+  int score;
+  int pv_length;
+  uint16_t pv[SEARCH_MAX_PLY];
+};
+typedef struct search_line search_line_t;
+
+/* Progress report after each completed line of an iteration */
+struct search_info {
+  int multipv;            /* Which line this is, from 1 */
+  int depth;
+  int seldepth;           /* Deepest ply reached, quiescence included */
+  int score;              /* Centipawns, side to move's view */
+  uint64_t nodes;
+  int64_t time_ms;
+  int hashfull;           /* Permille */
+  uint64_t tb_hits;       /* Positions scored from endgame tables */
+  int pv_length;
+  uint16_t pv[SEARCH_MAX_PLY];
+};
+typedef struct search_info search_info_t;
+
+typedef void (*search_info_fn)(const search_info_t *info, void *user);
+
+struct search {
+  board_t *board;               /* (weak) Position being searched */
+  material_table_t *material;   /* (weak) */
+  trans_table_t *table;         /* (weak) */
+  tablebase_t *tablebase;       /* (weak) Endgame tables, or NULL */
+  time_manager_t time;
+  chess_timer_t clock;          /* Since search_run started, for reports */
+  search_limits_t limits;
+  atomic_bool stop;             /* Raised by search_stop from any thread */
+  atomic_bool pondering;        /* Lowered by search_ponderhit */
+  bool clock_pending;           /* Pondering: time manager not yet armed */
+  uint64_t nodes;
+  uint64_t tb_hits;
+  int seldepth;
+
+  move_list_t *moves[SEARCH_MAX_PLY];   /* (strong) One list per ply */
+  board_undo_t undo[SEARCH_MAX_PLY];
+  uint16_t killers[SEARCH_MAX_PLY][2];
+  int history[2][NUM_SQUARES][NUM_SQUARES];
+  uint16_t pv[SEARCH_MAX_PLY][SEARCH_MAX_PLY];
+  int pv_length[SEARCH_MAX_PLY];
+
+  search_line_t lines[SEARCH_MAX_MULTIPV]; /* Best line first */
+  int num_lines;
+  int num_excluded;             /* Root skips the first moves of these lines */
+
+  /* Hashes of the positions before the current one, game moves first */
+  uint64_t hashes[SEARCH_MAX_HISTORY];
+  int num_game_hashes;
+  int num_hashes;
+  int repetition_floor;         /* No repetitions across a null move */
+
+  search_info_fn on_info;
+  void *info_user;
+};
+typedef struct search search_t;
+
+/* Create a search workspace using the given (shared) tables */
+search_t* search_init(material_table_t *material, trans_table_t *table);
+
+/* Cleanup all resources held by the search (not the shared tables) */
+void search_destroy(search_t *search);
+
+/* Register a callback for per-iteration progress reports */
+void
+search_set_info_callback(search_t *search, search_info_fn on_info, void *user);
+
+/* Tell the search which positions occurred earlier in the game, oldest
+ * first, so repetitions of them are scored as draws
+ */
+void
+search_set_game_history(search_t *search, const uint64_t *hashes, int count);
+
+/* Score positions the tables cover from them (NULL to stop probing).
+ * The tables are shared, not owned, and must outlive their use here.
+ */
+void search_set_tablebase(search_t *search, tablebase_t *tablebase);
+
+/* Forget killers and history (on a new game) */
+void search_clear(search_t *search);
+
+/* Search the position on 'board' (restored on return) within 'limits'.
+ * Returns the best move packed, or MOVE_NONE if there is no legal move.
+ * 'ponder', if non-NULL, receives the expected reply or MOVE_NONE.
+ */
+uint16_t
+search_run(search_t *search, board_t *board, const search_limits_t *limits,
+           uint16_t *ponder);
+
+/* Ask a running search to return as soon as possible (thread-safe).
+ * The request stays in force, also for later runs, until cleared with
+ * search_reset_stop, so a stop sent just before a run starts isn't lost.
+ */
+void search_stop(search_t *search);
+
+/* The opponent played the move being pondered on: from now on the
+ * running search keeps to the clock given in its limits (thread-safe)
+ */
+void search_ponderhit(search_t *search);
+
+/* Clear a stop request before starting the next run */
+void search_reset_stop(search_t *search);
+
+#endif
@@ -0,0 +1,499 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tablebase.h"
+#include "eval.h"
+#include "../model/board.h"
+#include "../model/piece.h"
+#include "../model/chess.h"
+
+/* A piece found on a board while indexing */
+struct placed_piece {
+  color_t color;
+  piece_type_t type;
+  int square;
+};
+typedef struct placed_piece placed_piece_t;
+
+/* The a1-d1-d4 triangle the first king is confined to without pawns */
+static const int triangle_squares[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+static const char piece_letters[6] = {'R', 'N', 'B', 'K', 'Q', 'P'};
+
+static int parse_side(const char *text, int length, piece_type_t *types);
+static int side_value(const piece_type_t *types, int count);
+static void sort_types(piece_type_t *types, int count);
+static void write_side(char *buffer, const piece_type_t *types, int count);
+static uint64_t swap_material_key(uint64_t key);
+static int king_squares(const tb_layout_t *layout);
+static int king_region_index(const tb_layout_t *layout, int square);
+static int transform_square(int square, int symmetry);
+static tb_table_t** find_slot(tablebase_t *tablebase, uint64_t key);
+
+/*
+ *   tb_layout_parse
+ * Work out the slots and size of a table from its signature.  The side
+ * with more material becomes WHITE, so "KvKQ" and "KQvK" describe the
+ * same table.
+ *   @param name the signature, e.g. "KRPvKR"
+ *   @param layout receives the layout
+ *   @return 0 on success, -1 if the signature is malformed or too big
+ */
+int tb_layout_parse(const char *name, tb_layout_t *layout)
+{
+  piece_type_t sides[2][TB_MAX_PIECES], *strong, *weak;
+  int counts[2], strong_count, weak_count, i, slot = 0, squares;
+  const char *split = strchr(name, 'v');
+
+  if (!split) return -1;
+  counts[0] = parse_side(name, split - name, sides[0]);
+  counts[1] = parse_side(split + 1, strlen(split + 1), sides[1]);
+  if (counts[0] < 0 || counts[1] < 0) return -1;
+  if (counts[0] + counts[1] + 2 > TB_MAX_PIECES) return -1;
+
+  /* Stronger side first: more material, then more pieces, then name */
+  int order = side_value(sides[0], counts[0]) - side_value(sides[1], counts[1]);
+  if (!order) order = counts[0] - counts[1];
+  for (i = 0; !order && i < counts[0]; i++)
+    order = (int)sides[0][i] - (int)sides[1][i];
+  strong = order >= 0 ? sides[0] : sides[1];
+  weak = order >= 0 ? sides[1] : sides[0];
+  strong_count = order >= 0 ? counts[0] : counts[1];
+  weak_count = order >= 0 ? counts[1] : counts[0];
+
+  memset(layout, 0, sizeof(tb_layout_t) );
+  layout->colors[slot] = WHITE;
+  layout->types[slot++] = KING;
+  layout->colors[slot] = BLACK;
+  layout->types[slot++] = KING;
+  for (i = 0; i < strong_count; i++) {
+    layout->colors[slot] = WHITE;
+    layout->types[slot++] = strong[i];
+  }
+  for (i = 0; i < weak_count; i++) {
+    layout->colors[slot] = BLACK;
+    layout->types[slot++] = weak[i];
+  }
+  layout->num_pieces = slot;
+
+  for (i = 0; i < slot; i++) {
+    if (layout->types[i] == PAWN) layout->has_pawns = true;
+    layout->material_key +=
+      1ULL << MATERIAL_KEY_SHIFT(layout->colors[i], layout->types[i]);
+  }
+
+  squares = king_squares(layout);
+  layout->num_positions = 2 * (uint64_t)squares;
+  for (i = 1; i < slot; i++) layout->num_positions *= NUM_SQUARES;
+
+  layout->name[0] = 'K';
+  write_side(layout->name + 1, strong, strong_count);
+  i = strlen(layout->name);
+  layout->name[i++] = 'v';
+  layout->name[i++] = 'K';
+  write_side(layout->name + i, weak, weak_count);
+  return 0;
+}
+
+/*
+ *   tb_layout_index
+ * Compute the canonical index of a position.  Of all the symmetric
+ * images of the position that put the first king in its region, the one
+ * with the smallest index is used, and pieces of the same kind fill
+ * their slots in square order; so every image of a position maps to the
+ * same entry.
+ *   @param layout the table's layout
+ *   @param board the position
+ *   @param flip whether to swap colors (and mirror ranks) first
+ *   @return the index, or -1 if the position doesn't fit the layout
+ */
+int64_t tb_layout_index(const tb_layout_t *layout, board_t *board, bool flip)
+{
+  placed_piece_t placed[TB_MAX_PIECES];
+  int count = 0, rank, file, symmetry, slot, i, best_piece, square;
+  int num_symmetries = layout->has_pawns ? 2 : 8;
+  int region = king_squares(layout);
+  bool used[TB_MAX_PIECES];
+  int64_t index, best = -1;
+  color_t stm;
+  piece_t *piece;
+
+  uint64_t key = flip ? swap_material_key(board->material_key)
+                      : board->material_key;
+  if (key != layout->material_key) return -1;
+
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      if (!(piece = board->spaces[rank][file]->piece)) continue;
+      placed[count].color = flip ? OTHER_COLOR(piece->color) : piece->color;
+      placed[count].type = piece->type;
+      placed[count].square = SQUARE_INDEX(flip ? 7 - rank : rank, file);
+      count++;
+    }
+  }
+  stm = flip ? OTHER_COLOR(board->moves_next) : board->moves_next;
+
+  for (symmetry = 0; symmetry < num_symmetries; symmetry++) {
+    memset(used, 0, sizeof(used) );
+    index = 0;
+    for (slot = 0; slot < layout->num_pieces; slot++) {
+      best_piece = -1;
+      for (i = 0; i < count; i++) {
+        if (used[i] || placed[i].color != layout->colors[slot] ||
+            placed[i].type != layout->types[slot])
+          continue;
+        square = transform_square(placed[i].square, symmetry);
+        if (best_piece < 0 ||
+            square < transform_square(placed[best_piece].square, symmetry))
+          best_piece = i;
+      }
+      used[best_piece] = true;
+      square = transform_square(placed[best_piece].square, symmetry);
+
+      if (slot == 0) {
+        if ((index = king_region_index(layout, square)) < 0) break;
+        index += (int64_t)stm * region;
+      }
+      else {
+        index = index * NUM_SQUARES + square;
+      }
+    }
+    if (index >= 0 && slot == layout->num_pieces && (best < 0 || index < best))
+      best = index;
+  }
+  return best;
+}
+
+/*
+ *   tb_layout_decode
+ * Recover the squares and side to move of an index.  The result may not
+ * be canonical; compare tb_layout_index of the position with 'index' to
+ * find out.
+ *   @param layout the table's layout
+ *   @param index the index to decode
+ *   @param squares receives one square per slot
+ *   @param side_to_move receives the side to move
+ *   @return false if the index names no position
+ */
+bool
+tb_layout_decode(const tb_layout_t *layout, uint64_t index, int *squares,
+                 color_t *side_to_move)
+{
+  int region = king_squares(layout), slot, other, rank;
+
+  for (slot = layout->num_pieces - 1; slot > 0; slot--) {
+    squares[slot] = index % NUM_SQUARES;
+    index /= NUM_SQUARES;
+  }
+  squares[0] = layout->has_pawns
+             ? SQUARE_INDEX((index % region) / 4, (index % region) % 4)
+             : triangle_squares[index % region];
+  *side_to_move = index / region ? BLACK : WHITE;
+
+  for (slot = 0; slot < layout->num_pieces; slot++) {
+    rank = SQUARE_RANK(squares[slot]);
+    if (layout->types[slot] == PAWN && (rank == 0 || rank == 7)) return false;
+    for (other = 0; other < slot; other++) {
+      if (squares[other] == squares[slot]) return false;
+    }
+  }
+  return true;
+}
+
+/*
+ *   tablebase_init
+ * Create a tablebase with no tables
+ *   @return a * to the tablebase, or NULL on failure
+ */
+tablebase_t* tablebase_init()
+{
+  return calloc(1, sizeof(tablebase_t) );
+}
+
+/*
+ *   tablebase_open
+ * Map all table files in a directory
+ *   @param dir the directory to scan
+ *   @return a * to the tablebase, or NULL if the directory can't be read
+ */
+tablebase_t* tablebase_open(const char *dir)
+{
+  char path[4096];
+  struct dirent *entry;
+  tablebase_t *tablebase;
+  size_t length, extension = strlen(TB_FILE_EXTENSION);
+  DIR *handle = opendir(dir);
+
+  if (!handle) return NULL;
+  if (!(tablebase = tablebase_init())) {
+    closedir(handle);
+    return NULL;
+  }
+
+  while ((entry = readdir(handle))) {
+    length = strlen(entry->d_name);
+    if (length <= extension ||
+        strcmp(entry->d_name + length - extension, TB_FILE_EXTENSION))
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    tablebase_load(tablebase, path);
+  }
+  closedir(handle);
+  return tablebase;
+}
+
+/*
+ *   tablebase_load
+ * Map one table file and check that its header is consistent
+ *   @param tablebase the tablebase to add the table to
+ *   @param path the table file
+ *   @return 0 on success, -1 on failure
+ */
+int tablebase_load(tablebase_t *tablebase, const char *path)
+{
+  struct stat info;
+  tb_header_t header;
+  tb_table_t *table, **slot;
+  void *mapping;
+  int fd;
+
+  if (tablebase->num_tables >= TB_HASH_SLOTS / 2) return -1;
+  if ((fd = open(path, O_RDONLY)) < 0) return -1;
+  if (fstat(fd, &info) || info.st_size < (off_t)sizeof(tb_header_t) ) {
+    close(fd);
+    return -1;
+  }
+  mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return -1;
+
+  memcpy(&header, mapping, sizeof(header) );
+  header.name[sizeof(header.name) - 1] = '\0';
+  table = malloc(sizeof(tb_table_t) );
+  if (!table || header.magic != TB_MAGIC || header.version != TB_VERSION ||
+      tb_layout_parse(header.name, &table->layout) ||
+      table->layout.material_key != header.material_key ||
+      table->layout.num_positions != header.num_positions ||
+      header.wdl_offset + (header.num_positions + 3) / 4 > (uint64_t)info.st_size ||
+      header.dtm_offset + header.num_positions > (uint64_t)info.st_size ||
+      *(slot = find_slot(tablebase, header.material_key))) {
+    free(table);
+    munmap(mapping, info.st_size);
+    return -1;
+  }
+
+  table->mapping = mapping;
+  table->size = info.st_size;
+  table->wdl = (const uint8_t *)mapping + header.wdl_offset;
+  table->dtm = (const uint8_t *)mapping + header.dtm_offset;
+  *slot = table;
+  tablebase->num_tables++;
+  if (table->layout.num_pieces > tablebase->max_pieces)
+    tablebase->max_pieces = table->layout.num_pieces;
+  return 0;
+}
+
+/*
+ *   tablebase_close
+ * Unmap every table and cleanup
+ *   @param tablebase the tablebase to close
+ */
+void tablebase_close(tablebase_t *tablebase)
+{
+  int i;
+  if (!tablebase) return;
+  for (i = 0; i < TB_HASH_SLOTS; i++) {
+    if (!tablebase->slots[i]) continue;
+    munmap((void *)tablebase->slots[i]->mapping, tablebase->slots[i]->size);
+    free(tablebase->slots[i]);
+  }
+  free(tablebase);
+}
+
+/*
+ *   tablebase_probe
+ * Look a position up.  Read-only on shared mappings, so safe to call
+ * from any number of threads at once.
+ *   @param tablebase the tables to search
+ *   @param board the position
+ *   @param result receives the result for the side to move
+ *   @return true if a table covers the position
+ */
+bool
+tablebase_probe(tablebase_t *tablebase, board_t *board, tb_result_t *result)
+{
+  tb_table_t *table;
+  int64_t index;
+  int pieces = 0, i;
+  bool flip = false;
+
+  for (i = 0; i < 12; i++) pieces += (board->material_key >> (4 * i)) & 0xF;
+  if (pieces > tablebase->max_pieces) return false;
+
+  if (!(table = *find_slot(tablebase, board->material_key))) {
+    flip = true;
+    table = *find_slot(tablebase, swap_material_key(board->material_key));
+    if (!table) return false;
+  }
+  if ((index = tb_layout_index(&table->layout, board, flip)) < 0) return false;
+
+  result->wdl = (table->wdl[index >> 2] >> ((index & 3) * 2)) & 3;
+  result->dtm = table->dtm[index];
+  return result->wdl != TB_NONE;
+}
+
+/*
+ *   parse_side
+ * Read one side of a signature ("KRB"): exactly one king plus pieces
+ *   @return the number of non-king pieces, or -1 if malformed
+ */
+static int parse_side(const char *text, int length, piece_type_t *types)
+{
+  int i, type, count = 0, kings = 0;
+
+  for (i = 0; i < length; i++) {
+    for (type = 0; type < 6 && piece_letters[type] != text[i]; type++) ;
+    if (type == 6) return -1;
+    if (type == KING) {
+      kings++;
+      continue;
+    }
+    if (count == TB_MAX_PIECES - 2) return -1;
+    types[count++] = type;
+  }
+  if (kings != 1) return -1;
+  sort_types(types, count);
+  return count;
+}
+
+/*
+ *   side_value
+ * Total material value of a side's non-king pieces
+ */
+static int side_value(const piece_type_t *types, int count)
+{
+  int i, total = 0;
+  for (i = 0; i < count; i++) total += eval_piece_value[types[i]];
+  return total;
+}
+
+/*
+ *   sort_types
+ * Order piece types most valuable first (ties by enum order), which is
+ * both the slot order and the naming order
+ */
+static void sort_types(piece_type_t *types, int count)
+{
+  int i, j;
+  piece_type_t swap;
+
+  for (i = 1; i < count; i++) {
+    for (j = i; j > 0; j--) {
+      if (eval_piece_value[types[j]] < eval_piece_value[types[j - 1]] ||
+          (eval_piece_value[types[j]] == eval_piece_value[types[j - 1]] &&
+           types[j] > types[j - 1]))
+        break;
+      swap = types[j];
+      types[j] = types[j - 1];
+      types[j - 1] = swap;
+    }
+  }
+}
+
+/*
+ *   write_side
+ * Append a side's piece letters (without the king) to a name
+ */
+static void write_side(char *buffer, const piece_type_t *types, int count)
+{
+  int i;
+  for (i = 0; i < count; i++) buffer[i] = piece_letters[types[i]];
+  buffer[count] = '\0';
+}
+
+/*
+ *   swap_material_key
+ * The material key of the same pieces with colors exchanged
+ */
+static uint64_t swap_material_key(uint64_t key)
+{
+  uint64_t swapped = 0;
+  int type;
+
+  for (type = 0; type < 6; type++) {
+    swapped |= (uint64_t)MATERIAL_KEY_COUNT(key, WHITE, type)
+               << MATERIAL_KEY_SHIFT(BLACK, type);
+    swapped |= (uint64_t)MATERIAL_KEY_COUNT(key, BLACK, type)
+               << MATERIAL_KEY_SHIFT(WHITE, type);
+  }
+  return swapped;
+}
+
+/*
+ *   king_squares
+ * How many squares the first king may stand on
+ */
+static int king_squares(const tb_layout_t *layout)
+{
+  return layout->has_pawns ? 32 : 10;
+}
+
+/*
+ *   king_region_index
+ * Position of a square within the first king's region, or -1 if the
+ * square is outside it
+ */
+static int king_region_index(const tb_layout_t *layout, int square)
+{
+  int rank = SQUARE_RANK(square), file = SQUARE_FILE(square), i;
+
+  if (file > 3) return -1;
+  if (layout->has_pawns) return rank * 4 + file;
+
+  for (i = 0; i < 10; i++) {
+    if (triangle_squares[i] == square) return i;
+  }
+  return -1;
+}
+
+/*
+ *   transform_square
+ * Apply one of the 8 board symmetries: bit 0 mirrors files, bit 1
+ * mirrors ranks, bit 2 swaps ranks and files (in that order)
+ */
+static int transform_square(int square, int symmetry)
+{
+  int rank = SQUARE_RANK(square), file = SQUARE_FILE(square), swap;
+
+  if (symmetry & 1) file = 7 - file;
+  if (symmetry & 2) rank = 7 - rank;
+  if (symmetry & 4) {
+    swap = rank;
+    rank = file;
+    file = swap;
+  }
+  return SQUARE_INDEX(rank, file);
+}
+
+/*
+ *   find_slot
+ * Open-addressing lookup by material key: the slot holding the table, or
+ * the empty slot where it would go
+ */
+static tb_table_t** find_slot(tablebase_t *tablebase, uint64_t key)
+{
+  int slot = (key * 0x9E3779B97F4A7C15ULL) >> 54;
+
+  while (tablebase->slots[slot] &&
+         tablebase->slots[slot]->layout.material_key != key)
+    slot = (slot + 1) % TB_HASH_SLOTS;
+  return &tablebase->slots[slot];
+}
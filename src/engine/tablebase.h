@@ -0,0 +1,128 @@
+#ifndef _TABLEBASE_H
+#define _TABLEBASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../model/board.h"
+#include "../model/chess.h"
+#include "../model/piece.h"
+
+/*
+ * Endgame tablebases: for every position of a small material signature
+ * ("KRvKN") a table stores the win/draw/loss result for the side to move
+ * (2 bits, packed four to a byte) and the distance to mate in plies (one
+ * byte, saturating at TB_DTM_UNKNOWN).  Tables are produced offline by
+ * tablebase_gen.c and probed here straight from read-only mmap'd files,
+ * so any number of search threads may probe without locks.
+ *
+ * Positions are indexed by piece squares in a fixed slot order: the
+ * stronger side's king, the other king, then the stronger side's pieces
+ * and the other side's pieces, each group ordered by piece type.  Board
+ * symmetry shrinks the tables: without pawns the first king is confined
+ * to the a1-d1-d4 triangle (8 symmetries), with pawns to files a-d
+ * (left-right mirror only).  Tables are stored with the stronger side as
+ * WHITE; positions with colors the other way round are probed
+ * color-flipped.  En passant and castling rights are not represented.
+ */
+
+#define TB_MAX_PIECES     5
+#define TB_FILE_EXTENSION ".jtb"
+#define TB_DTM_UNKNOWN    255   /* Distance too long to store */
+
+/* Results, always from the side to move's point of view */
+enum tb_wdl {TB_NONE=0, TB_LOSS=1, TB_DRAW=2, TB_WIN=3};
+typedef enum tb_wdl tb_wdl_t;
+
+/* What a material signature's table looks like */
+struct tb_layout {
+  int num_pieces;
+  color_t colors[TB_MAX_PIECES];    /* Per slot, WHITE = stronger side */
+  piece_type_t types[TB_MAX_PIECES];
+  bool has_pawns;
+  uint64_t num_positions;
+  uint64_t material_key;            /* As board_t.material_key */
+  char name[2 * TB_MAX_PIECES + 2]; /* e.g. "KRvKN" */
+};
+typedef struct tb_layout tb_layout_t;
+
+/* Fixed-size file header; sections follow at the given offsets */
+#define TB_MAGIC    0x4254474Au /* "JGTB" */
+#define TB_VERSION  1
+struct tb_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t material_key;
+  uint64_t num_positions;
+  uint64_t wdl_offset;    /* 2 bits per position */
+  uint64_t dtm_offset;    /* 1 byte per position */
+  char name[16];
+};
+typedef struct tb_header tb_header_t;
+
+struct tb_table {
+  tb_layout_t layout;
+  const unsigned char *mapping; /* (strong) The whole file */
+  size_t size;
+  const uint8_t *wdl;           /* Into the mapping */
+  const uint8_t *dtm;
+};
+typedef struct tb_table tb_table_t;
+
+#define TB_HASH_SLOTS 1024
+struct tablebase {
+  tb_table_t *slots[TB_HASH_SLOTS]; /* (strong) By material key */
+  int num_tables;
+  int max_pieces;                   /* Most pieces in any loaded table */
+};
+typedef struct tablebase tablebase_t;
+
+/* A probe result */
+struct tb_result {
+  tb_wdl_t wdl;
+  int dtm;          /* Plies to mate, or TB_DTM_UNKNOWN */
+};
+typedef struct tb_result tb_result_t;
+
+/* Parse a signature such as "KQvKR" (either side may come first).
+ * Returns 0 on success, -1 if it isn't a signature of 2..TB_MAX_PIECES
+ * pieces with one king per side.
+ */
+int tb_layout_parse(const char *name, tb_layout_t *layout);
+
+/* The canonical index of a position with the layout's material, with
+ * colors flipped first if 'flip' is set.  Returns -1 if the position
+ * doesn't match the layout.
+ */
+int64_t tb_layout_index(const tb_layout_t *layout, board_t *board, bool flip);
+
+/* Turn an index back into per-slot squares and the side to move.
+ * Returns false for indexes that name no position (overlapping pieces,
+ * pawns on the first or last rank).
+ */
+bool
+tb_layout_decode(const tb_layout_t *layout, uint64_t index, int *squares,
+                 color_t *side_to_move);
+
+/* Create an empty tablebase */
+tablebase_t* tablebase_init();
+
+/* Map every table file found in a directory.  Returns NULL if the
+ * directory can't be read.
+ */
+tablebase_t* tablebase_open(const char *dir);
+
+/* Map one table file into the tablebase.  Returns 0 on success, -1 if
+ * the file is missing or malformed.
+ */
+int tablebase_load(tablebase_t *tablebase, const char *path);
+
+/* Unmap every table and cleanup */
+void tablebase_close(tablebase_t *tablebase);
+
+/* Look a position up.  Returns false if no table covers it. */
+bool
+tablebase_probe(tablebase_t *tablebase, board_t *board, tb_result_t *result);
+
+#endif
@@ -0,0 +1,769 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tablebase_gen.h"
+#include "tablebase.h"
+#include "../model/board.h"
+#include "../model/piece.h"
+#include "../model/move.h"
+#include "../model/move_list.h"
+#include "../model/move_gen.h"
+#include "../model/chess.h"
+
+#define GEN_UNDECIDED 0     /* Otherwise a tb_wdl_t, or GEN_ILLEGAL */
+#define GEN_ILLEGAL   4
+#define GEN_NO_EXIT   0xFFFF
+#define GEN_DRAW_EXIT 0xFFFF
+
+#define GEN_MAX_THREADS 64
+#define GEN_MAX_UNMOVES 128
+
+/* The state of one table being generated, shared by all workers */
+struct tb_gen {
+  tb_layout_t layout;
+  tablebase_t *deps;          /* (weak) The tables exits lead to */
+  _Atomic uint8_t *result;    /* (strong) Per position */
+  _Atomic uint16_t *dtm;      /* (strong) Plies to mate once decided */
+  _Atomic uint8_t *pending;   /* (strong) In-table successors not yet won */
+  uint16_t *exit_win;         /* (strong) Quickest win leaving the table */
+  uint16_t *exit_floor;       /* (strong) Slowest loss leaving the table,
+                                 or GEN_DRAW_EXIT if an exit draws */
+  int pass;
+  int max_exit;               /* Last pass an exit can decide anything */
+  atomic_bool changed;
+  atomic_bool failed;
+};
+typedef struct tb_gen tb_gen_t;
+
+enum tb_phase {PHASE_INIT, PHASE_UNMOVE, PHASE_DECIDE};
+typedef enum tb_phase tb_phase_t;
+
+/* One thread's slice of a phase and its private board */
+struct tb_worker {
+  tb_gen_t *gen;
+  tb_phase_t phase;
+  uint64_t begin, end;
+  board_t *board;                     /* (strong) */
+  piece_t *pieces[TB_MAX_PIECES];     /* (weak) One per slot */
+  bool placed;                        /* Whether the pieces are on board */
+  move_list_t *moves;                 /* (strong) */
+  int max_exit;
+  pthread_t thread;
+};
+typedef struct tb_worker tb_worker_t;
+
+static const char piece_letters[6] = {'R', 'N', 'B', 'K', 'Q', 'P'};
+static const piece_type_t promotion_types[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+static const int knight_steps[8][2] = {
+  {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+};
+static const int king_steps[8][2] = {
+  {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+static const int line_dirs[8][2] = {
+  {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+
+static int ensure_table(const char *name, const char *dir, int threads,
+                        FILE *log);
+static int generate_table(const tb_layout_t *layout, const char *dir,
+                          int threads, FILE *log);
+static int generate_dependencies(const tb_layout_t *layout, const char *dir,
+                                 int threads, FILE *log);
+static void signature_name(const color_t *colors, const piece_type_t *types,
+                           int count, char *buffer);
+static int table_path(const char *dir, const char *name, char *buffer,
+                      size_t size);
+static int write_table(tb_gen_t *gen, const char *dir);
+static bool worker_init(tb_worker_t *worker, tb_gen_t *gen);
+static void worker_destroy(tb_worker_t *worker);
+static void worker_place(tb_worker_t *worker, const int *squares,
+                         color_t side_to_move);
+static void run_phase(tb_worker_t *workers, int threads, tb_phase_t phase);
+static void* worker_main(void *arg);
+static void init_position(tb_worker_t *worker, uint64_t index);
+static void unmove_position(tb_worker_t *worker, uint64_t index,
+                            uint8_t result);
+static int add_unmove(tb_worker_t *worker, piece_t *piece, int rank,
+                      int file, int64_t *preds, int count);
+static void decide_position(tb_gen_t *gen, uint64_t index);
+static bool probe_exit(tb_gen_t *gen, board_t *board, tb_result_t *result);
+static bool next_multiset(int *items, int size, int range);
+
+/*
+ *   tablebase_generate
+ * Generate one table, first generating any smaller table it needs that
+ * isn't already in the directory.  The table itself is always rebuilt.
+ *   @param name the signature
+ *   @param dir the directory holding the tables
+ *   @param threads how many threads to use
+ *   @param log where progress goes, or NULL
+ *   @return 0 on success, -1 on failure
+ */
+int
+tablebase_generate(const char *name, const char *dir, int threads, FILE *log)
+{
+  tb_layout_t layout;
+
+  if (tb_layout_parse(name, &layout) || layout.num_pieces < 3) return -1;
+  if (generate_dependencies(&layout, dir, threads, log)) return -1;
+  return generate_table(&layout, dir, threads, log);
+}
+
+/*
+ *   tablebase_generate_all
+ * Generate every table with 3..max_pieces pieces, skipping tables that
+ * already exist
+ *   @param max_pieces the largest tables wanted
+ *   @param dir the directory holding the tables
+ *   @param threads how many threads to use
+ *   @param log where progress goes, or NULL
+ *   @return 0 on success, -1 on the first failure
+ */
+int tablebase_generate_all(int max_pieces, const char *dir, int threads,
+                           FILE *log)
+{
+  /* Non-king pieces, by letter, in the order signatures list them */
+  static const char letters[5] = {'Q', 'R', 'B', 'N', 'P'};
+  int strong[TB_MAX_PIECES], weak[TB_MAX_PIECES];
+  int total, size, i, length;
+  char name[2 * TB_MAX_PIECES + 2];
+
+  if (max_pieces > TB_MAX_PIECES) return -1;
+
+  for (total = 1; total <= max_pieces - 2; total++) {
+    for (size = total; size >= (total + 1) / 2; size--) {
+      memset(strong, 0, sizeof(strong) );
+      do {
+        memset(weak, 0, sizeof(weak) );
+        do {
+          length = 0;
+          name[length++] = 'K';
+          for (i = 0; i < size; i++) name[length++] = letters[strong[i]];
+          name[length++] = 'v';
+          name[length++] = 'K';
+          for (i = 0; i < total - size; i++)
+            name[length++] = letters[weak[i]];
+          name[length] = '\0';
+          if (ensure_table(name, dir, threads, log)) return -1;
+        } while (next_multiset(weak, total - size, 5) );
+      } while (next_multiset(strong, size, 5) );
+    }
+  }
+  return 0;
+}
+
+/*
+ *   ensure_table
+ * Generate a table (and its dependencies) unless its file exists
+ *   @return 0 on success, -1 on failure
+ */
+static int ensure_table(const char *name, const char *dir, int threads,
+                        FILE *log)
+{
+  tb_layout_t layout;
+  char path[4096];
+
+  if (tb_layout_parse(name, &layout) ) return -1;
+  if (layout.num_pieces < 3) return 0;
+  if (table_path(dir, layout.name, path, sizeof(path)) ) return -1;
+  if (!access(path, R_OK) ) return 0;
+
+  if (generate_dependencies(&layout, dir, threads, log)) return -1;
+  return generate_table(&layout, dir, threads, log);
+}
+
+/*
+ *   generate_dependencies
+ * Make sure every table a capture or promotion can lead to exists
+ *   @return 0 on success, -1 on failure
+ */
+static int generate_dependencies(const tb_layout_t *layout, const char *dir,
+                                 int threads, FILE *log)
+{
+  color_t colors[TB_MAX_PIECES];
+  piece_type_t types[TB_MAX_PIECES];
+  char name[2 * TB_MAX_PIECES + 2];
+  int slot, i, count;
+
+  /* Captures: any piece but a king disappears */
+  for (slot = 2; slot < layout->num_pieces; slot++) {
+    for (i = 0, count = 0; i < layout->num_pieces; i++) {
+      if (i == slot) continue;
+      colors[count] = layout->colors[i];
+      types[count++] = layout->types[i];
+    }
+    signature_name(colors, types, count, name);
+    if (ensure_table(name, dir, threads, log)) return -1;
+  }
+
+  /* Promotions: a pawn turns into another piece */
+  for (slot = 2; slot < layout->num_pieces; slot++) {
+    if (layout->types[slot] != PAWN) continue;
+    memcpy(colors, layout->colors, sizeof(colors) );
+    memcpy(types, layout->types, sizeof(types) );
+    for (i = 0; i < 4; i++) {
+      types[slot] = promotion_types[i];
+      signature_name(colors, types, layout->num_pieces, name);
+      if (ensure_table(name, dir, threads, log)) return -1;
+    }
+  }
+  return 0;
+}
+
+/*
+ *   generate_table
+ * Run the retrograde analysis for one table and write its file.  All
+ * the tables it depends on must already exist in 'dir'.
+ *   @return 0 on success, -1 on failure
+ */
+static int generate_table(const tb_layout_t *layout, const char *dir,
+                          int threads, FILE *log)
+{
+  tb_worker_t workers[GEN_MAX_THREADS];
+  uint64_t n = layout->num_positions, i, slice;
+  tb_gen_t gen;
+  int started = 0, status = -1;
+
+  if (threads < 1) threads = 1;
+  if (threads > GEN_MAX_THREADS) threads = GEN_MAX_THREADS;
+
+  memset(&gen, 0, sizeof(gen) );
+  gen.layout = *layout;
+  atomic_init(&gen.changed, false);
+  atomic_init(&gen.failed, false);
+  gen.deps = tablebase_open(dir);
+  gen.result = calloc(n, sizeof(*gen.result) );
+  gen.dtm = calloc(n, sizeof(*gen.dtm) );
+  gen.pending = calloc(n, sizeof(*gen.pending) );
+  gen.exit_win = malloc(n * sizeof(*gen.exit_win) );
+  gen.exit_floor = calloc(n, sizeof(*gen.exit_floor) );
+  if (!gen.deps || !gen.result || !gen.dtm || !gen.pending ||
+      !gen.exit_win || !gen.exit_floor)
+    goto cleanup;
+  for (i = 0; i < n; i++) gen.exit_win[i] = GEN_NO_EXIT;
+
+  slice = (n + threads - 1) / threads;
+  for (started = 0; started < threads; started++) {
+    if (!worker_init(&workers[started], &gen)) goto cleanup;
+    workers[started].begin = started * slice < n ? started * slice : n;
+    workers[started].end = (started + 1) * slice < n ? (started + 1) * slice : n;
+  }
+
+  if (log) fprintf(log, "%s: %llu positions\n", layout->name,
+                   (unsigned long long)n);
+
+  /* Pass 0: mates, stalemates and exits */
+  run_phase(workers, threads, PHASE_INIT);
+  if (atomic_load(&gen.failed)) goto cleanup;
+  for (i = 0; i < (uint64_t)threads; i++)
+    if (workers[i].max_exit > gen.max_exit) gen.max_exit = workers[i].max_exit;
+
+  /* Pass n decides the positions at distance n */
+  for (gen.pass = 1; ; gen.pass++) {
+    atomic_store(&gen.changed, false);
+    run_phase(workers, threads, PHASE_UNMOVE);
+    run_phase(workers, threads, PHASE_DECIDE);
+    if (!atomic_load(&gen.changed) && gen.pass >= gen.max_exit) break;
+  }
+  if (log) fprintf(log, "%s: %d passes\n", layout->name, gen.pass);
+
+  status = write_table(&gen, dir);
+
+cleanup:
+  for (i = 0; i < (uint64_t)started; i++) worker_destroy(&workers[i]);
+  tablebase_close(gen.deps);
+  free(gen.result);
+  free(gen.dtm);
+  free(gen.pending);
+  free(gen.exit_win);
+  free(gen.exit_floor);
+  return status;
+}
+
+/*
+ *   write_table
+ * Pack the results into a table file: written under a temporary name and
+ * renamed, so a reader never maps a half-written table
+ *   @return 0 on success, -1 on failure
+ */
+static int write_table(tb_gen_t *gen, const char *dir)
+{
+  static const unsigned char padding[64];
+  uint64_t n = gen->layout.num_positions, i;
+  char path[4096], temp[4096 + 8];
+  tb_header_t header;
+  uint8_t *wdl, *dtm, result;
+  unsigned distance;
+  bool ok;
+  FILE *out;
+
+  memset(&header, 0, sizeof(header) );
+  header.magic = TB_MAGIC;
+  header.version = TB_VERSION;
+  header.material_key = gen->layout.material_key;
+  header.num_positions = n;
+  header.wdl_offset = (sizeof(header) + 63) & ~63ULL;
+  header.dtm_offset = (header.wdl_offset + (n + 3) / 4 + 63) & ~63ULL;
+  strncpy(header.name, gen->layout.name, sizeof(header.name) - 1);
+
+  wdl = calloc((n + 3) / 4, 1);
+  dtm = calloc(n, 1);
+  if (!wdl || !dtm) {
+    free(wdl);
+    free(dtm);
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    result = atomic_load_explicit(&gen->result[i], memory_order_relaxed);
+    if (result == GEN_ILLEGAL) continue;
+    if (result == GEN_UNDECIDED) result = TB_DRAW;
+    wdl[i >> 2] |= result << ((i & 3) * 2);
+    if (result == TB_DRAW) continue;
+    distance = atomic_load_explicit(&gen->dtm[i], memory_order_relaxed);
+    dtm[i] = distance < TB_DTM_UNKNOWN ? distance : TB_DTM_UNKNOWN;
+  }
+
+  table_path(dir, gen->layout.name, path, sizeof(path) );
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+  if (!(out = fopen(temp, "wb")) ) {
+    free(wdl);
+    free(dtm);
+    return -1;
+  }
+  ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+       fwrite(padding, header.wdl_offset - sizeof(header), 1, out) <= 1 &&
+       fwrite(wdl, (n + 3) / 4, 1, out) == 1 &&
+       fwrite(padding, header.dtm_offset - header.wdl_offset - (n + 3) / 4,
+              1, out) <= 1 &&
+       fwrite(dtm, n, 1, out) == 1;
+  ok = !fclose(out) && ok;
+  free(wdl);
+  free(dtm);
+
+  if (!ok || rename(temp, path) ) {
+    remove(temp);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ *   worker_init
+ * Give a worker its own board and one piece per slot
+ *   @return false if out of memory
+ */
+static bool worker_init(tb_worker_t *worker, tb_gen_t *gen)
+{
+  int slot;
+
+  memset(worker, 0, sizeof(tb_worker_t) );
+  worker->gen = gen;
+  worker->board = board_init();
+  worker->moves = move_list_new();
+  if (!worker->board || !worker->moves) {
+    worker_destroy(worker);
+    return false;
+  }
+  worker->board->castle_rights = 0;
+  worker->board->en_passant = NO_SQUARE;
+
+  for (slot = 0; slot < gen->layout.num_pieces; slot++) {
+    worker->pieces[slot] = piece_init_alive(gen->layout.colors[slot],
+                                            gen->layout.types[slot], 0, 0);
+    if (!worker->pieces[slot]) {
+      worker_destroy(worker);
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ *   worker_destroy
+ * Free a worker's board and pieces
+ */
+static void worker_destroy(tb_worker_t *worker)
+{
+  int slot;
+
+  /* Placed pieces belong to the board */
+  if (!worker->placed) {
+    for (slot = 0; slot < TB_MAX_PIECES; slot++)
+      if (worker->pieces[slot]) piece_destroy(worker->pieces[slot]);
+  }
+  if (worker->board) board_destroy(worker->board);
+  if (worker->moves) move_list_destroy(worker->moves);
+}
+
+/*
+ *   worker_place
+ * Set the worker's board up with the pieces on the given squares
+ */
+static void worker_place(tb_worker_t *worker, const int *squares,
+                         color_t side_to_move)
+{
+  int slot, count = worker->gen->layout.num_pieces;
+  board_t *board = worker->board;
+  piece_t *piece;
+
+  for (slot = 0; worker->placed && slot < count; slot++) {
+    piece = worker->pieces[slot];
+    board_remove_piece(board, piece->rank, piece->file);
+  }
+  for (slot = 0; slot < count; slot++) {
+    board_add_piece(board, worker->pieces[slot], SQUARE_RANK(squares[slot]),
+                    SQUARE_FILE(squares[slot]) );
+  }
+  worker->placed = true;
+  board->moves_next = side_to_move;
+}
+
+/*
+ *   run_phase
+ * Run one phase over the whole table, one index range per thread, and
+ * wait for all of them
+ */
+static void run_phase(tb_worker_t *workers, int threads, tb_phase_t phase)
+{
+  int i;
+
+  for (i = 0; i < threads; i++) workers[i].phase = phase;
+  if (threads == 1) {
+    worker_main(&workers[0]);
+    return;
+  }
+  for (i = 0; i < threads; i++)
+    pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+  for (i = 0; i < threads; i++) pthread_join(workers[i].thread, NULL);
+}
+
+/*
+ *   worker_main
+ * Thread body: apply the current phase to the worker's index range
+ */
+static void* worker_main(void *arg)
+{
+  tb_worker_t *worker = arg;
+  tb_gen_t *gen = worker->gen;
+  uint64_t index;
+  uint8_t result;
+  unsigned distance;
+
+  for (index = worker->begin; index < worker->end; index++) {
+    switch (worker->phase) {
+      case PHASE_INIT:
+        init_position(worker, index);
+        break;
+      case PHASE_UNMOVE:
+        result = atomic_load_explicit(&gen->result[index], memory_order_acquire);
+        if (result != TB_WIN && result != TB_LOSS) break;
+        distance = atomic_load_explicit(&gen->dtm[index], memory_order_relaxed);
+        if (distance == (unsigned)gen->pass - 1)
+          unmove_position(worker, index, result);
+        break;
+      case PHASE_DECIDE:
+        decide_position(gen, index);
+        break;
+    }
+  }
+  return NULL;
+}
+
+/*
+ *   init_position
+ * Pass 0 for one index: weed out illegal and non-canonical indexes,
+ * score mates and stalemates, count the successors inside the table and
+ * look up the results of moves leaving it
+ */
+static void init_position(tb_worker_t *worker, uint64_t index)
+{
+  tb_gen_t *gen = worker->gen;
+  board_t *board = worker->board;
+  int squares[TB_MAX_PIECES], num_children = 0, i, j;
+  int64_t children[GEN_MAX_UNMOVES], child;
+  unsigned exit_win = GEN_NO_EXIT, exit_floor = 0;
+  tb_result_t exit;
+  board_undo_t undo;
+  color_t stm;
+  move_t *move;
+
+  if (!tb_layout_decode(&gen->layout, index, squares, &stm)) {
+    atomic_store_explicit(&gen->result[index], GEN_ILLEGAL, memory_order_relaxed);
+    return;
+  }
+  worker_place(worker, squares, stm);
+  if (tb_layout_index(&gen->layout, board, false) != (int64_t)index ||
+      move_gen_in_check(board, OTHER_COLOR(stm)) ) {
+    atomic_store_explicit(&gen->result[index], GEN_ILLEGAL, memory_order_relaxed);
+    return;
+  }
+
+  move_list_clear(worker->moves);
+  if (!move_gen_legal(board, worker->moves)) {
+    atomic_store_explicit(&gen->result[index],
+                          move_gen_in_check(board, stm) ? TB_LOSS : TB_DRAW,
+                          memory_order_relaxed);
+    return;
+  }
+
+  for (i = 0; i < worker->moves->num_moves; i++) {
+    move = &worker->moves->moves[i];
+    board_make_move(board, move, &undo);
+
+    if (move->flags & (MOVE_CAPTURE | MOVE_PROMOTION)) {
+      if (!probe_exit(gen, board, &exit)) {
+        atomic_store(&gen->failed, true);
+      }
+      else if (exit.wdl == TB_LOSS && exit.dtm + 1u < exit_win) {
+        exit_win = exit.dtm + 1;
+      }
+      else if (exit.wdl == TB_DRAW) {
+        exit_floor = GEN_DRAW_EXIT;
+      }
+      else if (exit.wdl == TB_WIN && exit_floor != GEN_DRAW_EXIT &&
+               exit.dtm + 1u > exit_floor) {
+        exit_floor = exit.dtm + 1;
+      }
+    }
+    else {
+      child = tb_layout_index(&gen->layout, board, false);
+      for (j = 0; j < num_children && children[j] != child; j++) ;
+      if (j == num_children && num_children < GEN_MAX_UNMOVES)
+        children[num_children++] = child;
+    }
+    board_unmake_move(board, move, &undo);
+  }
+
+  atomic_store_explicit(&gen->pending[index], num_children, memory_order_relaxed);
+  gen->exit_win[index] = exit_win;
+  gen->exit_floor[index] = exit_floor;
+  if (exit_win != GEN_NO_EXIT && (int)exit_win > worker->max_exit)
+    worker->max_exit = exit_win;
+  if (exit_floor != GEN_DRAW_EXIT && (int)exit_floor > worker->max_exit)
+    worker->max_exit = exit_floor;
+}
+
+/*
+ *   unmove_position
+ * Walk a position decided in the previous pass back to each position
+ * one move earlier.  Those are won if this one is lost; if it is won,
+ * they have one undecided successor less.
+ */
+static void unmove_position(tb_worker_t *worker, uint64_t index,
+                            uint8_t result)
+{
+  tb_gen_t *gen = worker->gen;
+  board_t *board = worker->board;
+  int squares[TB_MAX_PIECES], slot, i, rank, file, r, f, dir, step;
+  int64_t preds[GEN_MAX_UNMOVES];
+  int count = 0;
+  uint8_t expected;
+  color_t stm, mover;
+  piece_t *piece;
+
+  tb_layout_decode(&gen->layout, index, squares, &stm);
+  worker_place(worker, squares, stm);
+  mover = OTHER_COLOR(stm);
+  board->moves_next = mover;
+
+  for (slot = 0; slot < gen->layout.num_pieces; slot++) {
+    piece = worker->pieces[slot];
+    if (piece->color != mover) continue;
+    rank = piece->rank;
+    file = piece->file;
+
+    switch (piece->type) {
+      case PAWN:
+        /* Back one square, or two from the double-push rank */
+        dir = mover == WHITE ? 1 : -1;
+        r = rank - dir;
+        if (r == (mover == WHITE ? 0 : 7) || board->spaces[r][file]->piece)
+          break;
+        count = add_unmove(worker, piece, r, file, preds, count);
+        if (rank == (mover == WHITE ? 3 : 4) &&
+            !board->spaces[r - dir][file]->piece)
+          count = add_unmove(worker, piece, r - dir, file, preds, count);
+        break;
+      case KNIGHT:
+      case KING:
+        for (i = 0; i < 8; i++) {
+          r = rank + (piece->type == KNIGHT ? knight_steps : king_steps)[i][0];
+          f = file + (piece->type == KNIGHT ? knight_steps : king_steps)[i][1];
+          if (r < 0 || r >= BOARD_SIZE || f < 0 || f >= BOARD_SIZE ||
+              board->spaces[r][f]->piece)
+            continue;
+          count = add_unmove(worker, piece, r, f, preds, count);
+        }
+        break;
+      default:
+        /* Rooks use the first four directions, bishops the last four */
+        for (i = piece->type == BISHOP ? 4 : 0;
+             i < (piece->type == ROOK ? 4 : 8); i++) {
+          for (step = 1; ; step++) {
+            r = rank + line_dirs[i][0] * step;
+            f = file + line_dirs[i][1] * step;
+            if (r < 0 || r >= BOARD_SIZE || f < 0 || f >= BOARD_SIZE ||
+                board->spaces[r][f]->piece)
+              break;
+            count = add_unmove(worker, piece, r, f, preds, count);
+          }
+        }
+        break;
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    expected = GEN_UNDECIDED;
+    if (atomic_load_explicit(&gen->result[preds[i]], memory_order_relaxed) !=
+        GEN_UNDECIDED)
+      continue;
+    if (result == TB_LOSS) {
+      /* The distance goes first: a reader that sees the result must not
+       * mistake it for one decided in the previous pass.  Racing writers
+       * all store the same distance.
+       */
+      atomic_store_explicit(&gen->dtm[preds[i]], gen->pass,
+                            memory_order_relaxed);
+      if (atomic_compare_exchange_strong(&gen->result[preds[i]], &expected,
+                                         TB_WIN))
+        atomic_store_explicit(&gen->changed, true, memory_order_relaxed);
+    }
+    else {
+      atomic_fetch_sub(&gen->pending[preds[i]], 1);
+    }
+  }
+}
+
+/*
+ *   add_unmove
+ * Move a piece back to rank/file, record the index of the position that
+ * makes (unless seen already or illegal) and put the piece back
+ *   @return the new number of predecessors
+ */
+static int add_unmove(tb_worker_t *worker, piece_t *piece, int rank,
+                      int file, int64_t *preds, int count)
+{
+  tb_gen_t *gen = worker->gen;
+  board_t *board = worker->board;
+  int from_rank = piece->rank, from_file = piece->file, i;
+  int64_t index;
+
+  board_remove_piece(board, from_rank, from_file);
+  board_add_piece(board, piece, rank, file);
+  index = tb_layout_index(&gen->layout, board, false);
+  board_remove_piece(board, rank, file);
+  board_add_piece(board, piece, from_rank, from_file);
+
+  if (index < 0 || count == GEN_MAX_UNMOVES ||
+      atomic_load_explicit(&gen->result[index], memory_order_relaxed) ==
+      GEN_ILLEGAL)
+    return count;
+  for (i = 0; i < count; i++)
+    if (preds[i] == index) return count;
+  preds[count] = index;
+  return count + 1;
+}
+
+/*
+ *   decide_position
+ * Second half of a pass: win through an exit, or lose once every move
+ * (in or out of the table) leads to a position won for the opponent
+ */
+static void decide_position(tb_gen_t *gen, uint64_t index)
+{
+  unsigned pass = gen->pass;
+
+  if (atomic_load_explicit(&gen->result[index], memory_order_relaxed) !=
+      GEN_UNDECIDED)
+    return;
+
+  if (gen->exit_win[index] == pass) {
+    atomic_store_explicit(&gen->result[index], TB_WIN, memory_order_relaxed);
+  }
+  else if (gen->exit_win[index] == GEN_NO_EXIT &&
+           gen->exit_floor[index] != GEN_DRAW_EXIT &&
+           gen->exit_floor[index] <= pass &&
+           !atomic_load_explicit(&gen->pending[index], memory_order_relaxed)) {
+    atomic_store_explicit(&gen->result[index], TB_LOSS, memory_order_relaxed);
+  }
+  else {
+    return;
+  }
+  atomic_store_explicit(&gen->dtm[index], pass, memory_order_relaxed);
+  atomic_store_explicit(&gen->changed, true, memory_order_relaxed);
+}
+
+/*
+ *   probe_exit
+ * The result of a position reached by capturing or promoting, from the
+ * smaller tables.  Bare kings are a draw without a table.
+ *   @return false if the needed table is missing
+ */
+static bool probe_exit(tb_gen_t *gen, board_t *board, tb_result_t *result)
+{
+  uint64_t kings = (1ULL << MATERIAL_KEY_SHIFT(WHITE, KING)) +
+                   (1ULL << MATERIAL_KEY_SHIFT(BLACK, KING));
+
+  if (board->material_key == kings) {
+    result->wdl = TB_DRAW;
+    result->dtm = 0;
+    return true;
+  }
+  return tablebase_probe(gen->deps, board, result);
+}
+
+/*
+ *   signature_name
+ * Write the signature of a set of pieces
+ */
+static void signature_name(const color_t *colors, const piece_type_t *types,
+                           int count, char *buffer)
+{
+  int side, i, length = 0;
+
+  for (side = 0; side < 2; side++) {
+    if (side) buffer[length++] = 'v';
+    buffer[length++] = 'K';
+    for (i = 0; i < count; i++) {
+      if (colors[i] == (side ? BLACK : WHITE) && types[i] != KING)
+        buffer[length++] = piece_letters[types[i]];
+    }
+  }
+  buffer[length] = '\0';
+}
+
+/*
+ *   table_path
+ * The file a table lives in
+ *   @return 0 on success, -1 if the path doesn't fit
+ */
+static int table_path(const char *dir, const char *name, char *buffer,
+                      size_t size)
+{
+  int length = snprintf(buffer, size, "%s/%s%s", dir, name, TB_FILE_EXTENSION);
+  return length < 0 || (size_t)length >= size ? -1 : 0;
+}
+
+/*
+ *   next_multiset
+ * Step a non-decreasing sequence of 'size' values below 'range' to the
+ * next one
+ *   @return false once every sequence has been visited
+ */
+static bool next_multiset(int *items, int size, int range)
+{
+  int i, j;
+
+  for (i = size - 1; i >= 0 && items[i] == range - 1; i--) ;
+  if (i < 0) return false;
+  items[i]++;
+  for (j = i + 1; j < size; j++) items[j] = items[i];
+  return true;
+}
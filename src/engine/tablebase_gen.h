@@ -0,0 +1,39 @@
+#ifndef _TABLEBASE_GEN_H
+#define _TABLEBASE_GEN_H
+
+#include <stdio.h>
+
+#include "tablebase.h"
+
+/*
+ * Offline generation of tablebase files by retrograde analysis.  Every
+ * position of a signature is scored once up front: checkmates,
+ * stalemates, and the results of moves leaving the table (captures and
+ * promotions, looked up in the smaller tables they lead to).  Then,
+ * pass by pass, the positions decided in the previous pass are walked
+ * backwards ("unmoves") to their predecessors: a predecessor of a lost
+ * position is won, and a predecessor whose moves all lead to won
+ * positions is lost.  What is still undecided when nothing changes is
+ * drawn.
+ *
+ * Each pass is split over worker threads by index range; a position's
+ * count of undecided successors is decremented atomically, so workers
+ * never lock.  Missing smaller tables are generated first, in the same
+ * directory.
+ */
+
+/* Generate the table for a signature such as "KRvKN" (and any missing
+ * table it depends on) into 'dir', using up to 'threads' threads.
+ * Progress goes to 'log' if it isn't NULL.  Returns 0 on success, -1 on
+ * a bad signature, I/O error or lack of memory.
+ */
+int
+tablebase_generate(const char *name, const char *dir, int threads, FILE *log);
+
+/* Generate every table of 3..'max_pieces' pieces into 'dir'.  Returns 0
+ * on success, -1 on the first failure.
+ */
+int tablebase_generate_all(int max_pieces, const char *dir, int threads,
+                           FILE *log);
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "time_manager.h"
+#include "../model/timer.h"
+
+/* Assumed number of moves left in sudden-death games */
+#define DEFAULT_MOVES_TO_GO 40
+/* The hard deadline never exceeds this many times the optimum... */
+#define MAXIMUM_RATIO 5
+/* ...nor this percentage of the remaining clock */
+#define MAXIMUM_CLOCK_PERCENT 80
+/* Never plan on less than this per move */
+#define MINIMUM_MOVE_MS 10
+
+static int64_t clamp_ms(int64_t value, int64_t low, int64_t high);
+
+/*
+ *   time_manager_init
+ * Work out the soft and hard deadlines for a search and start its clock.
+ * The optimum spreads the remaining time (plus future increments) over
+ * the moves left to the time control; the maximum allows a few times
+ * that for unstable positions but never risks the clock.
+ *   @param tm the time manager to initialize
+ *   @param control the clock situation, or NULL for an unlimited search
+ */
+void time_manager_init(time_manager_t *tm, const time_control_t *control)
+{
+  timer_reset(&tm->clock);
+  timer_start(&tm->clock);
+
+  tm->best_move_changes = 0.0;
+  tm->previous_score = 0;
+  tm->have_previous_score = false;
+  tm->check_interval = TIME_MANAGER_CHECK_NODES;
+  tm->next_check = TIME_MANAGER_CHECK_NODES;
+  tm->limited = false;
+  tm->optimum_ms = tm->maximum_ms = tm->target_ms = INT64_MAX;
+
+  if (!control) return;
+
+  /* A fixed time per move uses all of it and nothing more */
+  if (control->move_time_ms > 0) {
+    tm->limited = true;
+    tm->optimum_ms = tm->maximum_ms = tm->target_ms =
+      clamp_ms(control->move_time_ms - control->overhead_ms,
+               1, control->move_time_ms);
+    return;
+  }
+
+  if (control->remaining_ms <= 0) return;
+  tm->limited = true;
+
+  int moves_to_go = control->moves_to_go > 0 ? control->moves_to_go
+                                              : DEFAULT_MOVES_TO_GO;
+  if (moves_to_go > 50) moves_to_go = 50;
+
+  int64_t usable = control->remaining_ms
+                 + control->increment_ms * (moves_to_go - 1)
+                 - control->overhead_ms * (moves_to_go + 1);
+  int64_t safe_max = control->remaining_ms * MAXIMUM_CLOCK_PERCENT / 100
+                   - control->overhead_ms;
+  if (safe_max < 1) safe_max = 1;
+
+  tm->optimum_ms = clamp_ms(usable / moves_to_go, MINIMUM_MOVE_MS, safe_max);
+  tm->maximum_ms = clamp_ms(tm->optimum_ms * MAXIMUM_RATIO,
+                            tm->optimum_ms, safe_max);
+  tm->target_ms = tm->optimum_ms;
+
+  /* Read the clock more often when the budget is tiny */
+  if (tm->maximum_ms < 100) {
+    tm->check_interval = TIME_MANAGER_CHECK_NODES / 8;
+    tm->next_check = tm->check_interval;
+  }
+}
+
+/*
+ *   time_manager_iteration_done
+ * Adjust the soft deadline after an iteration of iterative deepening.
+ * A best move that keeps changing or a falling score buys extra time; a
+ * best move that has held for several iterations gives time back.  The
+ * next iteration is only started if it has a realistic chance of
+ * finishing, i.e. if less than about half of the target has been used.
+ *   @param tm the time manager for the running search
+ *   @param best_move_changed whether this iteration changed the best move
+ *   @param score the score the iteration returned
+ *   @return true if another iteration should be started
+ */
+bool
+time_manager_iteration_done(time_manager_t *tm, bool best_move_changed,
+                            int score)
+{
+  if (!tm->limited) return true;
+
+  tm->best_move_changes = tm->best_move_changes * 0.5 +
+                          (best_move_changed ? 1.0 : 0.0);
+
+  /* 0.75 for a long-stable best move up to 2.0 for a flip-flopping one */
+  double factor = tm->best_move_changes < 0.1 ? 0.75
+                                              : 1.0 + tm->best_move_changes;
+  if (factor > 2.0) factor = 2.0;
+
+  /* Spend up to 50% more when the score is falling */
+  if (tm->have_previous_score) {
+    int drop = tm->previous_score - score;
+    if (drop > 20) {
+      if (drop > 150) drop = 150;
+      factor *= 1.0 + drop / 300.0;
+    }
+  }
+  tm->previous_score = score;
+  tm->have_previous_score = true;
+
+  tm->target_ms = clamp_ms((int64_t)(tm->optimum_ms * factor),
+                           1, tm->maximum_ms);
+  return time_manager_elapsed_ms(tm) < tm->target_ms / 2;
+}
+
+/*
+ *   time_manager_should_stop
+ * Called at every search node.  Only every check_interval nodes does it
+ * actually read the clock, so the common path is a single comparison.
+ *   @param tm the time manager for the running search
+ *   @param nodes the number of nodes searched so far
+ *   @return true if the hard deadline has passed
+ */
+bool time_manager_should_stop(time_manager_t *tm, uint64_t nodes)
+{
+  if (nodes < tm->next_check) return false;
+  tm->next_check = nodes + tm->check_interval;
+
+  if (!tm->limited) return false;
+  return time_manager_elapsed_ms(tm) >= tm->maximum_ms;
+}
+
+/*
+ *   time_manager_elapsed_ms
+ * Time spent on the current search so far
+ *   @param tm the time manager for the running search
+ *   @return the elapsed time in milliseconds
+ */
+int64_t time_manager_elapsed_ms(time_manager_t *tm)
+{
+  return timer_elapsed_ms(&tm->clock);
+}
+
+/*
+ *   clamp_ms
+ * Clamp a duration into [low, high]
+ */
+static int64_t clamp_ms(int64_t value, int64_t low, int64_t high)
+{
+  if (value < low) return low;
+  if (value > high) return high;
+  return value;
+}
@@ -0,0 +1,63 @@
+#ifndef _TIME_MANAGER_H
+#define _TIME_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../model/timer.h"
+
+/*
+ * The time manager turns the clock situation for the side to move into
+ * two deadlines for a search.  The soft deadline ('optimum') decides
+ * whether another iterative-deepening iteration is worth starting and is
+ * stretched or shrunk as the search reports on best-move stability and
+ * score swings.  The hard deadline ('maximum') aborts a search outright.
+ */
+
+/* Clock situation for the side to move, all times in milliseconds */
+struct time_control {
+  int64_t remaining_ms;   /* Time left on our clock (0 = not given) */
+  int64_t increment_ms;   /* Time added to our clock after each move */
+  int moves_to_go;        /* Moves until the next time control (0 = rest) */
+  int64_t move_time_ms;   /* Fixed time for this move (0 = not given) */
+  int64_t overhead_ms;    /* Reserve for communication/GUI lag */
+};
+typedef struct time_control time_control_t;
+
+struct time_manager {
+  chess_timer_t clock;      /* Started when the search starts */
+  bool limited;             /* False for infinite/depth-only searches */
+  int64_t optimum_ms;       /* Soft deadline before adjustments */
+  int64_t maximum_ms;       /* Hard deadline */
+  int64_t target_ms;        /* Soft deadline after adjustments */
+  double best_move_changes; /* Decaying count of best-move changes */
+  int previous_score;       /* Score of the previous iteration */
+  bool have_previous_score;
+  uint64_t check_interval;  /* Nodes between clock reads */
+  uint64_t next_check;      /* Node count at which to read the clock next */
+};
+typedef struct time_manager time_manager_t;
+
+/* Default node interval between clock reads */
+#define TIME_MANAGER_CHECK_NODES 2048
+
+/* Set up deadlines for a new search and start its clock.  A NULL
+ * time_control means the search has no time limit.
+ */
+void time_manager_init(time_manager_t *tm, const time_control_t *control);
+
+/* Report a finished iteration.  Returns true if another iteration should
+ * be started within the (adjusted) soft deadline.
+ */
+bool
+time_manager_iteration_done(time_manager_t *tm, bool best_move_changed,
+                            int score);
+
+/* Cheap per-node check of the hard deadline.  The clock is only read
+ * once every check_interval nodes.
+ */
+bool time_manager_should_stop(time_manager_t *tm, uint64_t nodes);
+
+/* Milliseconds since the search started */
+int64_t time_manager_elapsed_ms(time_manager_t *tm);
+
+#endif
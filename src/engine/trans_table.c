@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "trans_table.h"
+
+static trans_entry_t* bucket_for(trans_table_t *table, uint64_t key);
+
+/*
+ *   trans_table_init
+ * Allocate an empty table.  The bucket count is the largest power of two
+ * that fits in the requested size.
+ *   @param size_mb the memory budget in megabytes
+ *   @return a * to the new table, or NULL on failure
+ */
+trans_table_t* trans_table_init(size_t size_mb)
+{
+  size_t bucket_bytes = TRANS_TABLE_BUCKET_SIZE * sizeof(trans_entry_t);
+  uint64_t budget = (uint64_t)size_mb * 1024 * 1024 / bucket_bytes;
+  uint64_t buckets = 1;
+
+  while (buckets * 2 <= budget) buckets *= 2;
+
+  trans_table_t *table = malloc(sizeof(trans_table_t) );
+  if (!table) return NULL;
+
+  table->entries = calloc(buckets * TRANS_TABLE_BUCKET_SIZE,
+                          sizeof(trans_entry_t) );
+  if (!table->entries) {
+    free(table);
+    return NULL;
+  }
+  table->num_buckets = buckets;
+  table->generation = 0;
+  return table;
+}
+
+/*
+ *   trans_table_destroy
+ * Cleanup all resources held by the table
+ *   @param table the table to destroy
+ */
+void trans_table_destroy(trans_table_t *table)
+{
+  if (!table) return;
+  free(table->entries);
+  free(table);
+}
+
+/*
+ *   trans_table_clear
+ * Forget every stored position (e.g. on a new game)
+ *   @param table the table to clear
+ */
+void trans_table_clear(trans_table_t *table)
+{
+  memset(table->entries, 0,
+         table->num_buckets * TRANS_TABLE_BUCKET_SIZE * sizeof(trans_entry_t));
+  table->generation = 0;
+}
+
+/*
+ *   trans_table_new_search
+ * Bump the generation, so entries written by earlier searches are the
+ * first to be replaced
+ *   @param table the table to age
+ */
+void trans_table_new_search(trans_table_t *table)
+{
+  table->generation++;
+}
+
+/*
+ *   trans_table_probe
+ * Look a position up
+ *   @param table the table to search
+ *   @param key the position's Zobrist hash
+ *   @return a * to the matching entry, or NULL
+ */
+trans_entry_t* trans_table_probe(trans_table_t *table, uint64_t key)
+{
+  trans_entry_t *bucket = bucket_for(table, key);
+  int i;
+
+  for (i = 0; i < TRANS_TABLE_BUCKET_SIZE; i++) {
+    if (bucket[i].bound != TT_BOUND_NONE && bucket[i].key == key)
+      return &bucket[i];
+  }
+  return NULL;
+}
+
+/*
+ *   trans_table_store
+ * Record a search result.  An existing entry for the position is
+ * overwritten (keeping its move if the new result has none); otherwise
+ * the entry with the lowest depth, penalized by age, is replaced.
+ *   @param table the table to write into
+ *   @param key the position's Zobrist hash
+ *   @param move the best move found, packed, or MOVE_NONE
+ *   @param score the score, already adjusted for mate distance
+ *   @param depth the remaining depth the score was searched to
+ *   @param bound one of TT_BOUND_UPPER/LOWER/EXACT
+ */
+void
+trans_table_store(trans_table_t *table, uint64_t key, uint16_t move,
+                  int score, int depth, int bound)
+{
+  trans_entry_t *bucket = bucket_for(table, key);
+  trans_entry_t *victim = &bucket[0];
+  int i, worth, victim_worth = INT32_MAX;
+
+  for (i = 0; i < TRANS_TABLE_BUCKET_SIZE; i++) {
+    if (bucket[i].bound == TT_BOUND_NONE || bucket[i].key == key) {
+      victim = &bucket[i];
+      break;
+    }
+    /* Each search of age costs an entry as much as 8 plies of depth */
+    worth = bucket[i].depth
+          - 8 * (uint8_t)(table->generation - bucket[i].generation);
+    if (worth < victim_worth) {
+      victim_worth = worth;
+      victim = &bucket[i];
+    }
+  }
+
+  if (victim->key != key || move) victim->move = move;
+  victim->key = key;
+  victim->score = (int16_t)score;
+  victim->depth = (int8_t)depth;
+  victim->bound = (uint8_t)bound;
+  victim->generation = table->generation;
+}
+
+/*
+ *   trans_table_hashfull
+ * Estimate the table's occupancy by current-search entries, as the UCI
+ * 'hashfull' field expects
+ *   @param table the table to sample
+ *   @return permille of sampled entries in use
+ */
+int trans_table_hashfull(trans_table_t *table)
+{
+  uint64_t sample = table->num_buckets * TRANS_TABLE_BUCKET_SIZE;
+  uint64_t i, used = 0;
+
+  if (sample > 1000) sample = 1000;
+  for (i = 0; i < sample; i++) {
+    if (table->entries[i].bound != TT_BOUND_NONE &&
+        table->entries[i].generation == table->generation)
+      used++;
+  }
+  return (int)(used * 1000 / sample);
+}
+
+/*
+ *   bucket_for
+ * The first entry of the bucket a key maps to
+ */
+static trans_entry_t* bucket_for(trans_table_t *table, uint64_t key)
+{
+  return &table->entries[(key & (table->num_buckets - 1))
+                         * TRANS_TABLE_BUCKET_SIZE];
+}
@@ -0,0 +1,66 @@
+#ifndef _TRANS_TABLE_H
+#define _TRANS_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The transposition table remembers the result of searching a position,
+ * keyed by the board's Zobrist hash, so positions reached through a
+ * different move order are not searched twice.  Entries are grouped into
+ * buckets of TRANS_TABLE_BUCKET_SIZE that share one cache line; a store
+ * replaces the entry of the same position or else the least valuable
+ * one (shallowest, from the oldest search).
+ */
+
+/* What the stored score says about the true score */
+#define TT_BOUND_NONE   0
+#define TT_BOUND_UPPER  1 /* Failed low: true score <= score */
+#define TT_BOUND_LOWER  2 /* Failed high: true score >= score */
+#define TT_BOUND_EXACT  3
+
+#define TRANS_TABLE_BUCKET_SIZE 4
+#define TRANS_TABLE_DEFAULT_MB  16
+
+struct trans_entry {
+  uint64_t key;       /* Full hash of the position */
+  uint16_t move;      /* Best/refutation move, packed (see move_pack) */
+  int16_t score;
+  int8_t depth;
+  uint8_t bound;      /* TT_BOUND_* */
+  uint8_t generation; /* Search that last wrote the entry */
+};
+typedef struct trans_entry trans_entry_t;
+
+struct trans_table {
+  trans_entry_t *entries;
+  uint64_t num_buckets; /* Always a power of two */
+  uint8_t generation;
+};
+typedef struct trans_table trans_table_t;
+
+/* Allocate a table of at most size_mb megabytes (at least one bucket) */
+trans_table_t* trans_table_init(size_t size_mb);
+
+/* Cleanup all resources held by the table */
+void trans_table_destroy(trans_table_t *table);
+
+/* Forget every stored position */
+void trans_table_clear(trans_table_t *table);
+
+/* Age the table at the start of a search so old entries get replaced */
+void trans_table_new_search(trans_table_t *table);
+
+/* Find the entry for a position, or NULL if it isn't stored */
+trans_entry_t* trans_table_probe(trans_table_t *table, uint64_t key);
+
+/* Record a search result for a position */
+void
+trans_table_store(trans_table_t *table, uint64_t key, uint16_t move,
+                  int score, int depth, int bound);
+
+/* How full the table is, in permille, sampled from its first buckets */
+int trans_table_hashfull(trans_table_t *table);
+
+#endif
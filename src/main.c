@@ -9,28 +9,39 @@
 #include "model/board.h"
 #include "model/square.h"
 #include "model/piece.h"
+#include "model/journal.h"
+#include "model/board_snapshot.h"
+#include "model/timer.h"
+
+/* Import the engine context owning the game */
+#include "engine/engine.h"
+#include "engine/trans_table.h"
 
 /* Import Objects from Display code */
 #include "display/chess-screen.h"
 #include "display/window-params.h"
 #include "display/display-data.h"
-/* A global board representing the current state of the game */
-board_t *game_board;
+#include "display/cpu-player.h"
+
+static void main_report_profile(void);
 
 int main()
 {
   int error=0;
 
+  /* The display leaves with exit(); print the profile then if asked */
+  if (getenv(TIMER_PROFILE_ENV)) atexit(main_report_profile);
+
   /* Initialize the Chess Model (Quit on Failure) */
-  error=main_init_model();
-  if (error)
+  engine_t *engine=main_init_model();
+  if (!engine)
   {
     printf("Error initializing model\n");
     exit(0);
   }
 
   /* Initialize UI component of app (Quit on Failure */
-  error=main_init_display();
+  error=main_init_display(engine);
   if (error) {
     printf("Error initializing display\n");
     exit(0);
@@ -43,21 +54,15 @@ int main()
 /*
  *    main_init_model
  *  This function initializes the Chess Model..in simpler terms it
- *  is responsible for setting up the global board, and any other
- *  structs that will be used for emulating Chess Rules.
+ *  is responsible for setting up the engine context, which owns the
+ *  game board and any other structs used for emulating Chess Rules.
  *
- *  Ret: 0 on success, 1 on failure
+ *  Ret: the engine context on success, NULL on failure
  */
-int main_init_model()
+engine_t* main_init_model()
 {
-  /* Set-up the game board */
-  game_board=board_init_start();
-
-  /* If gameBoard is still NULL, our init failed */
-  if (!game_board) return 1;
-
-  /* ...otherwise we're fine! */
-  return 0;
+  /* Set-up the engine (and with it the game board) */
+  return engine_init(TRANS_TABLE_DEFAULT_MB);
 }
 
 
@@ -70,11 +75,36 @@ int main_init_model()
  *
  *  Ret: a status integer: 0 on success, 1 on a failure
  */
-int main_init_display()
+int main_init_display(engine_t *engine)
 {
   pthread_t disp_thread;
-  display_data_t *disp = display_data_init_default_window_params(game_board);
+  display_data_t *disp =
+    display_data_init_default_window_params(engine->board);
+  if (!disp) return 1;
+
+  /* Resume the game in the journal, if the last run left one */
+  disp->journal = journal_open(JOURNAL_DEFAULT_PATH, engine->board,
+                               disp->history);
+  /* Its fsyncs and compactions go to the save/load worker (model_poll) */
+  if (disp->journal && disp->io) disp->journal->background = true;
+
+  /* The computer plays through the engine, on the engine's thread */
+  disp->cpu = cpu_player_init(engine);
+
+  /* The renderer draws published positions only; publish the resumed one */
+  board_snapshot_publish(disp->snapshot, engine->board);
 
   pthread_create(&disp_thread,NULL,chess_screen_main, (void *)disp);
   return 0;
 }
+
+
+/*
+ *    main_report_profile
+ *  atexit handler printing the profiling counters (see timer.h), when
+ *  TIMER_PROFILE_ENV is set
+ */
+static void main_report_profile(void)
+{
+  timer_profile_report(stderr);
+}
@@ -2,16 +2,18 @@
 #ifndef _MAIN_H_
 #define _MAIN_H_
 
-/* Responsible for initializing global structures
- * representing the chess rules and pieces involved in the
- * game being played.  Start point of the whole Chess Model
+#include "engine/engine.h"
+
+/* Responsible for initializing the engine context that owns
+ * the chess rules and pieces involved in the game being
+ * played.  Start point of the whole Chess Model
  */
-int main_init_model();
+engine_t* main_init_model();
 
 /* Responsible for initializing the UI data structures and
  * threads responsible for displaying game progress visually
  * (via OpenGL), and handling user input (maybe)
  */
-int main_init_display();
+int main_init_display(engine_t *engine);
 
 #endif
@@ -1,14 +1,33 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "board.h"
 #include "chess.h"
 #include "square.h"
 #include "piece.h"
+#include "move.h"
+#include "zobrist.h"
 #include "file-utils.h"
 
 /* Declare static helper functions implemented below */
 static int valid_board_init(board_t *boardToCheck);
 static int add_opening_pieces(board_t* empty_board);
+static void init_game_state(board_t *board);
+static bool enemy_pawn_beside(board_t *board, int rank, int file, color_t enemy);
+
+/* Castling rights that survive a move touching each square: moving a
+ * king or rook, or capturing a rook, gives up the matching rights.
+ */
+static const int castle_mask[NUM_SQUARES] = {
+  13, 15, 15, 15, 12, 15, 15, 14,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+   7, 15, 15, 15,  3, 15, 15, 11
+};
 /*
  *   board_init
  * This function creates a board in the standard
@@ -24,8 +43,12 @@ board_t* board_init()
   if (!newBoard)
     return NULL;
 
+  /* Make sure the hash keys exist before any piece is placed */
+  zobrist_init();
+
   /* It is white's turn to move by default */
   newBoard->moves_next = WHITE;
+  init_game_state(newBoard);
 
   /* Initialize all squares on the board */
   int rank=0;
@@ -61,6 +84,10 @@ board_t* board_init_start()
 
   /* Place starting pieces on board */
   add_opening_pieces(new_board);
+
+  /* Both sides may still castle either way */
+  new_board->castle_rights = CASTLE_ALL;
+  new_board->hash ^= zobrist_castle[CASTLE_ALL];
   return new_board;
 }
 
@@ -82,8 +109,20 @@ board_t* board_copy_deep(board_t *orig)
 
   /* Alloc mem for new board obj */
   board_t *deep = malloc(sizeof(board_t) );
+  if (!deep) return NULL;
 
   deep->moves_next = orig->moves_next;
+  init_game_state(deep);
+  deep->castle_rights = orig->castle_rights;
+  deep->en_passant = orig->en_passant;
+  deep->halfmove_clock = orig->halfmove_clock;
+  deep->fullmove_number = orig->fullmove_number;
+
+  /* Captured pieces are copied too, so moves can be unmade on the copy */
+  int i;
+  for (i = 0; i < orig->num_dead; i++)
+    deep->dead[i] = piece_copy_deep(orig->dead[i]);
+  deep->num_dead = orig->num_dead;
 
   /* Copy each square_t object*/
   int rank=0, file=0;
@@ -92,6 +131,7 @@ board_t* board_copy_deep(board_t *orig)
       deep->spaces[rank][file] = square_copy_deep(orig->spaces[rank][file]);
 
   if (!valid_board_init(deep) ) return NULL;
+  board_refresh(deep);
 
   /* Return success */
   return deep;
@@ -108,6 +148,8 @@ board_t* board_copy_deep(board_t *orig)
  */
 void board_destroy(board_t *board_to_delete)
 {
+  if (!board_to_delete) return;
+
   /* Free each square on the board */
   int rank = 0, file = 0;
   for (rank = 0; rank < BOARD_SIZE; rank++) {
@@ -118,6 +160,13 @@ void board_destroy(board_t *board_to_delete)
       }
     }
   }
+
+  /* Free the pieces waiting in the dead-queue */
+  int i;
+  for (i = 0; i < board_to_delete->num_dead; i++)
+    piece_destroy(board_to_delete->dead[i]);
+
+  free(board_to_delete);
 }
 
 /*
@@ -154,87 +203,517 @@ bool board_equal(board_t *board_one, board_t *board_two)
  *   board_load_from_file
  * This function loads a board and all associated resources
  * from a file, and returns the collected object as a board_t
- * struct.  For information about the file format used to store
- * board information, see documentation for board_save_to_file.
+ * struct.  The file holds one packed position, see board_pack.
  *   @param fileIn The file read the board information from.
  *   @return board_t* with the loaded file, or NULL if error occurred
  */
 board_t* board_load_from_file(const char *fileIn)
 {
-  if (!fileIn) return NULL;
+  board_packed_t packed;
+  board_t *loaded;
+  FILE *loadFile;
 
-  /* Initialize a board struct */
-  board_t *loaded= malloc(sizeof(board_t) );
-  if (!loaded) return NULL;
+  if (!fileIn) return NULL;
 
   /* Open file and check for errors */
-  FILE *loadFile = fopen(fileIn,"r");
+  loadFile = fopen(fileIn, "rb");
   if (!loadFile) return NULL;
-
-  /* First read in the 'moves_next' */
-  fread(&(loaded->moves_next),sizeof(loaded->moves_next),1,loadFile);
-
-  int rank=0, file=0,pieceFlag=0;
-
-  /* Load each square on board (pieces are recursively loaded too) */
-  for (rank=0;rank<BOARD_SIZE;rank++)
-    for (file=0;file<BOARD_SIZE;file++)
-      loaded->spaces[rank][file] = square_load_from_file(loadFile);
-
+  if (board_read_packed(loadFile, &packed, 1) != 1) {
+    fclose(loadFile);
+    return NULL;
+  }
   fclose(loadFile);
 
-  /* Check for errors in board init */
-  if (!valid_board_init(loaded) )
-  {
+  /* Build the board from the record */
+  loaded = board_init();
+  if (!loaded) return NULL;
+  if (board_unpack(loaded, &packed)) {
     board_destroy(loaded);
     return NULL;
   }
-
-  /* Return valid board! */
   return loaded;
 }
 
 /*
  *   board_save_to_file
- * Write a chess board_t struct to a file at the given filename.
+ * Write a chess board_t struct to a file at the given filename, as one
+ * packed position (see board_pack).
  *   @param file_out the filename to save the board_t to
  *   @param to_save the board_t* to save
  *   @param overwrite a flag deciding whether we can overwrite existing file
- *   @return -1 for NULL args, -2 if we can't overwrite, 0 on success
+ *   @return -1 for NULL args, -2 if we can't overwrite, -3 if the file
+ *           can't be written, -4 if the board can't be packed, 0 on success
  */
 int
 board_save_to_file(const char *file_out, board_t *to_save, bool overwrite)
 {
-  if (file_out == NULL || to_save == NULL) return -1;
+  board_packed_t packed;
+  FILE *saveHandle;
+  int write_res;
 
-  /* Check to see if file exists */
-  bool exists_already;
-  exists_already = file_utils_exists(file_out);
+  if (file_out == NULL || to_save == NULL) return -1;
 
   /* Return if it already exists, but we cant want to overwrite */
-  if (exists_already && !overwrite)
+  if (file_utils_exists(file_out) && !overwrite)
     return -2;
+  if (board_pack(to_save, &packed)) return -4;
 
   /* Open file for writing..return w/ error on failure */
-  FILE *saveHandle=fopen(file_out,"w+");
+  saveHandle = fopen(file_out, "wb");
   if (!saveHandle)
     return -3;
 
-  int write_res;
-  /* Write the moves_next enum */
-  write_res = fwrite(&(to_save->moves_next), sizeof(color_t), 1, saveHandle);
+  write_res = board_write_packed(saveHandle, &packed, 1);
+  if (fclose(saveHandle) || write_res != 1) return -3;
+  return 0;
+}
 
-  /* Iterate through the squares on the board */
-  int rank=0, file =0;
-  for (rank=0;rank<BOARD_SIZE;rank++)
-    for (file=0;file<BOARD_SIZE;file++)
-      write_res = square_save_to_file(saveHandle, to_save->spaces[rank][file]);
+/*
+ *   board_pack
+ * Encode the position into the fixed 32-byte record described in
+ * board.h.  Multi-byte fields are written big-endian byte by byte, so
+ * records are portable between hosts.
+ *   @param board the position to encode
+ *   @param packed receives the record
+ *   @return 0 on success, -1 if the position doesn't fit a record
+ */
+int board_pack(board_t *board, board_packed_t *packed)
+{
+  uint8_t *bytes = packed->bytes;
+  uint64_t occupancy = 0;
+  int square, count = 0, i, code;
+  piece_t *piece;
+
+  memset(packed, 0, sizeof(board_packed_t) );
+  for (square = 0; square < NUM_SQUARES; square++) {
+    piece = board->spaces[SQUARE_RANK(square)][SQUARE_FILE(square)]->piece;
+    if (!piece) continue;
+    if (count == 32 || (piece->color != WHITE && piece->color != BLACK))
+      return -1;
+
+    occupancy |= 1ULL << square;
+    code = piece->color << 3 | piece->type;
+    bytes[8 + count / 2] |= count % 2 ? code : code << 4;
+    count++;
+  }
+
+  for (i = 0; i < 8; i++) bytes[i] = occupancy >> (56 - 8 * i);
+  bytes[24] = board->moves_next | board->castle_rights << 1;
+  bytes[25] = board->en_passant == NO_SQUARE ? 0xFF : board->en_passant;
+  bytes[26] = board->halfmove_clock >> 8;
+  bytes[27] = board->halfmove_clock;
+  bytes[28] = board->fullmove_number >> 8;
+  bytes[29] = board->fullmove_number;
+  return 0;
+}
+
+/*
+ *   board_unpack
+ * Replace the board's pieces and game state with a packed position.
+ * The whole record is checked before the board is touched.
+ *   @param board the board to fill
+ *   @param packed the record to decode
+ *   @return 0 on success, -1 if the record is malformed or out of memory
+ */
+int board_unpack(board_t *board, const board_packed_t *packed)
+{
+  const uint8_t *bytes = packed->bytes;
+  piece_t *pieces[32];
+  uint64_t occupancy = 0;
+  int square, count = 0, i, code;
+
+  for (i = 0; i < 8; i++) occupancy = occupancy << 8 | bytes[i];
+  if ((bytes[24] & 0xE0) || (bytes[25] != 0xFF && bytes[25] >= NUM_SQUARES) ||
+      bytes[30] || bytes[31])
+    return -1;
+
+  /* Check the codes and allocate the pieces up front */
+  for (square = 0; square < NUM_SQUARES; square++) {
+    if (!(occupancy >> square & 1)) continue;
+    code = count < 32 ? bytes[8 + count / 2] >> (count % 2 ? 0 : 4) & 0xF : 0xF;
+    if (count == 32 || (code & 7) > PAWN ||
+        !(pieces[count] = piece_init_alive(code >> 3, code & 7,
+                                           SQUARE_RANK(square),
+                                           SQUARE_FILE(square))) ) {
+      for (i = 0; i < count; i++) piece_destroy(pieces[i]);
+      return -1;
+    }
+    count++;
+  }
+
+  board_clear(board);
+  for (square = 0, i = 0; square < NUM_SQUARES; square++) {
+    if (occupancy >> square & 1)
+      board_add_piece(board, pieces[i++], SQUARE_RANK(square),
+                      SQUARE_FILE(square) );
+  }
+  board->moves_next = bytes[24] & 1 ? BLACK : WHITE;
+  board->castle_rights = bytes[24] >> 1;
+  board->en_passant = bytes[25] == 0xFF ? NO_SQUARE : bytes[25];
+  board->halfmove_clock = bytes[26] << 8 | bytes[27];
+  board->fullmove_number = bytes[28] << 8 | bytes[29];
+  board_refresh(board);
+  return 0;
+}
+
+/*
+ *   board_write_packed
+ * Write an array of packed positions with a single fwrite
+ *   @param handle the stream to write to
+ *   @param positions the records
+ *   @param count how many records
+ *   @return the number of records written
+ */
+size_t
+board_write_packed(FILE *handle, const board_packed_t *positions, size_t count)
+{
+  if (!handle || !positions) return 0;
+  return fwrite(positions, sizeof(board_packed_t), count, handle);
+}
+
+/*
+ *   board_read_packed
+ * Read an array of packed positions with a single fread
+ *   @param handle the stream to read from
+ *   @param positions receives the records
+ *   @param count the most records to read
+ *   @return the number of records read
+ */
+size_t board_read_packed(FILE *handle, board_packed_t *positions, size_t count)
+{
+  if (!handle || !positions) return 0;
+  return fread(positions, sizeof(board_packed_t), count, handle);
+}
+
+/*
+ *   board_clear
+ * Destroy every piece on the board and in the dead-queue, and reset the
+ * game state (castling, en passant, clocks) to that of an empty board
+ *   @param board the board to clear
+ */
+void board_clear(board_t *board)
+{
+  int rank, file, i;
+
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      if (!board->spaces[rank][file]->piece) continue;
+      piece_destroy(board->spaces[rank][file]->piece);
+      board->spaces[rank][file]->piece = NULL;
+    }
+  }
+  for (i = 0; i < board->num_dead; i++) piece_destroy(board->dead[i]);
+  init_game_state(board);
+}
 
-  /* Close file and return */
-  fclose(saveHandle);
+/*
+ *   board_add_piece
+ * Places a piece on the board at the given rank and file, and adds it to
+ * the board's material key.  Ownership of the piece passes to the board.
+ *   @param board the board to place the piece on
+ *   @param added the piece to place
+ *   @param rank the rank of the destination square
+ *   @param file the file of the destination square
+ *   @return 0 on success, -1 on invalid args, -2 if the square is occupied
+ */
+int board_add_piece(board_t *board, piece_t *added, int rank, int file)
+{
+  if (!board || !added) return -1;
+  if (rank < 0 || rank >= BOARD_SIZE || file < 0 || file >= BOARD_SIZE)
+    return -1;
+
+  int result = square_add_piece(board->spaces[rank][file], added);
+  if (result != 0) return result;
+
+  board->material_key += 1ULL << MATERIAL_KEY_SHIFT(added->color, added->type);
+  board->hash ^= zobrist_piece[added->color][added->type][SQUARE_INDEX(rank, file)];
+  if (added->type == KING) board->kings[added->color] = added;
   return 0;
 }
 
+/*
+ *   board_remove_piece
+ * Lifts the piece off the square at rank/file and removes it from the
+ * material key.  The piece is not destroyed; the caller becomes its owner.
+ *   @param board the board to remove the piece from
+ *   @param rank the rank of the square to clear
+ *   @param file the file of the square to clear
+ *   @return the removed piece_t*, or NULL if there was nothing to remove
+ */
+piece_t* board_remove_piece(board_t *board, int rank, int file)
+{
+  if (!board) return NULL;
+  if (rank < 0 || rank >= BOARD_SIZE || file < 0 || file >= BOARD_SIZE)
+    return NULL;
+
+  square_t *location = board->spaces[rank][file];
+  piece_t *removed = location->piece;
+  if (!removed) return NULL;
+
+  location->piece = NULL;
+  board->material_key -= 1ULL << MATERIAL_KEY_SHIFT(removed->color, removed->type);
+  board->hash ^= zobrist_piece[removed->color][removed->type][SQUARE_INDEX(rank, file)];
+  if (board->kings[removed->color] == removed) board->kings[removed->color] = NULL;
+  return removed;
+}
+
+/*
+ *   board_material_count
+ * Reads the number of pieces of one color and type out of the
+ * board's material key.
+ *   @param board the board to count pieces on
+ *   @param color the side to count (WHITE or BLACK)
+ *   @param type the type of piece to count
+ *   @return the number of matching pieces on the board
+ */
+int board_material_count(board_t *board, color_t color, piece_type_t type)
+{
+  if (!board) return 0;
+  return MATERIAL_KEY_COUNT(board->material_key, color, type);
+}
+
+/*
+ *   board_refresh
+ * Rebuilds the material key, hash and king pointers from scratch by
+ * scanning every square.  Used when a board is assembled without going
+ * through board_add_piece, or after fields were edited directly.
+ *   @param board the board whose derived state should be rebuilt
+ */
+void board_refresh(board_t *board)
+{
+  int rank, file;
+  piece_t *piece;
+
+  board->material_key = 0;
+  board->kings[WHITE] = NULL;
+  board->kings[BLACK] = NULL;
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (!piece) continue;
+      board->material_key += 1ULL << MATERIAL_KEY_SHIFT(piece->color, piece->type);
+      if (piece->type == KING) board->kings[piece->color] = piece;
+    }
+  }
+  board->hash = board_compute_hash(board);
+}
+
+/*
+ *   board_compute_hash
+ * Computes the Zobrist hash of the position without relying on the
+ * incrementally maintained board->hash
+ *   @param board the board to hash
+ *   @return the position's hash
+ */
+uint64_t board_compute_hash(board_t *board)
+{
+  int rank, file;
+  piece_t *piece;
+  uint64_t hash = 0;
+
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (piece)
+        hash ^= zobrist_piece[piece->color][piece->type][SQUARE_INDEX(rank, file)];
+    }
+  }
+  hash ^= zobrist_castle[board->castle_rights];
+  if (board->en_passant != NO_SQUARE)
+    hash ^= zobrist_en_passant[SQUARE_FILE(board->en_passant)];
+  if (board->moves_next == BLACK)
+    hash ^= zobrist_side;
+  return hash;
+}
+
+/*
+ *   board_make_move
+ * Plays a move on the board, keeping the material key and hash current.
+ * A captured piece is killed and pushed onto the dead-queue rather than
+ * destroyed, so unmaking the move can put the very same piece back.
+ *   @param board the board to play on
+ *   @param move a move generated for this position
+ *   @param undo receives the state needed by board_unmake_move
+ */
+void board_make_move(board_t *board, move_t *move, board_undo_t *undo)
+{
+  color_t us = board->moves_next;
+  int from_rank = move->from_square->rank, from_file = move->from_square->file;
+  int to_rank = move->to_square->rank, to_file = move->to_square->file;
+  piece_t *mover, *captured;
+  bool pawn_move;
+
+  undo->castle_rights = board->castle_rights;
+  undo->en_passant = board->en_passant;
+  undo->halfmove_clock = board->halfmove_clock;
+  undo->hash = board->hash;
+  undo->captured = false;
+
+  if (board->en_passant != NO_SQUARE)
+    board->hash ^= zobrist_en_passant[SQUARE_FILE(board->en_passant)];
+  board->en_passant = NO_SQUARE;
+
+  /* Send a captured piece to the dead-queue */
+  if (move->flags & MOVE_CAPTURE) {
+    int captured_rank = (move->flags & MOVE_EN_PASSANT) ? from_rank : to_rank;
+    captured = board_remove_piece(board, captured_rank, to_file);
+    if (captured) {
+      piece_kill(captured);
+      board->dead[board->num_dead++] = captured;
+      undo->captured = true;
+    }
+  }
+
+  mover = board_remove_piece(board, from_rank, from_file);
+  pawn_move = mover->type == PAWN;
+  if (move->flags & MOVE_PROMOTION) mover->type = move->promotion;
+  board_add_piece(board, mover, to_rank, to_file);
+
+  /* Castling also moves the rook */
+  if (move->flags & MOVE_CASTLE) {
+    int rook_from = to_file == 6 ? 7 : 0;
+    int rook_to = to_file == 6 ? 5 : 3;
+    board_add_piece(board, board_remove_piece(board, from_rank, rook_from),
+                    from_rank, rook_to);
+  }
+
+  int rights = board->castle_rights
+             & castle_mask[SQUARE_INDEX(from_rank, from_file)]
+             & castle_mask[SQUARE_INDEX(to_rank, to_file)];
+  board->hash ^= zobrist_castle[board->castle_rights] ^ zobrist_castle[rights];
+  board->castle_rights = rights;
+
+  /* Only record an en passant square that an enemy pawn could use */
+  if ((move->flags & MOVE_DOUBLE_PUSH) &&
+      enemy_pawn_beside(board, to_rank, to_file, OTHER_COLOR(us))) {
+    board->en_passant = SQUARE_INDEX((from_rank + to_rank) / 2, to_file);
+    board->hash ^= zobrist_en_passant[to_file];
+  }
+
+  if (pawn_move || undo->captured) board->halfmove_clock = 0;
+  else board->halfmove_clock++;
+  if (us == BLACK) board->fullmove_number++;
+
+  board->moves_next = OTHER_COLOR(us);
+  board->hash ^= zobrist_side;
+}
+
+/*
+ *   board_unmake_move
+ * Takes back a move played with board_make_move, restoring any captured
+ * piece from the dead-queue
+ *   @param board the board the move was played on
+ *   @param move the move to take back
+ *   @param undo the record filled in by board_make_move
+ */
+void board_unmake_move(board_t *board, move_t *move, board_undo_t *undo)
+{
+  color_t us = OTHER_COLOR(board->moves_next);
+  int from_rank = move->from_square->rank, from_file = move->from_square->file;
+  int to_rank = move->to_square->rank, to_file = move->to_square->file;
+  piece_t *mover, *captured;
+
+  board->moves_next = us;
+  if (us == BLACK) board->fullmove_number--;
+
+  if (move->flags & MOVE_CASTLE) {
+    int rook_from = to_file == 6 ? 7 : 0;
+    int rook_to = to_file == 6 ? 5 : 3;
+    board_add_piece(board, board_remove_piece(board, from_rank, rook_to),
+                    from_rank, rook_from);
+  }
+
+  mover = board_remove_piece(board, to_rank, to_file);
+  if (move->flags & MOVE_PROMOTION) mover->type = PAWN;
+  board_add_piece(board, mover, from_rank, from_file);
+
+  if (undo->captured) {
+    int captured_rank = (move->flags & MOVE_EN_PASSANT) ? from_rank : to_rank;
+    captured = board->dead[--board->num_dead];
+    captured->health = ALIVE;
+    board_add_piece(board, captured, captured_rank, to_file);
+  }
+
+  board->castle_rights = undo->castle_rights;
+  board->en_passant = undo->en_passant;
+  board->halfmove_clock = undo->halfmove_clock;
+  board->hash = undo->hash;
+}
+
+/*
+ *   board_make_null_move
+ * Hands the move to the other side without moving a piece
+ *   @param board the board to pass on
+ *   @param undo receives the state needed by board_unmake_null_move
+ */
+void board_make_null_move(board_t *board, board_undo_t *undo)
+{
+  undo->castle_rights = board->castle_rights;
+  undo->en_passant = board->en_passant;
+  undo->halfmove_clock = board->halfmove_clock;
+  undo->hash = board->hash;
+  undo->captured = false;
+
+  if (board->en_passant != NO_SQUARE)
+    board->hash ^= zobrist_en_passant[SQUARE_FILE(board->en_passant)];
+  board->en_passant = NO_SQUARE;
+  board->halfmove_clock++;
+  board->moves_next = OTHER_COLOR(board->moves_next);
+  board->hash ^= zobrist_side;
+}
+
+/*
+ *   board_unmake_null_move
+ * Takes back a null move
+ *   @param board the board that passed
+ *   @param undo the record filled in by board_make_null_move
+ */
+void board_unmake_null_move(board_t *board, board_undo_t *undo)
+{
+  board->moves_next = OTHER_COLOR(board->moves_next);
+  board->en_passant = undo->en_passant;
+  board->halfmove_clock = undo->halfmove_clock;
+  board->hash = undo->hash;
+}
+
+/*
+ *   init_game_state
+ * Gives the non-square fields of a freshly allocated board their
+ * defaults: no castling, no en passant square, move 1, empty dead-queue.
+ *   @param board the board to initialize
+ */
+static void init_game_state(board_t *board)
+{
+  board->material_key = 0;
+  board->hash = board->moves_next == BLACK ? zobrist_side : 0;
+  board->castle_rights = 0;
+  board->en_passant = NO_SQUARE;
+  board->halfmove_clock = 0;
+  board->fullmove_number = 1;
+  board->kings[WHITE] = NULL;
+  board->kings[BLACK] = NULL;
+  board->num_dead = 0;
+}
+
+/*
+ *   enemy_pawn_beside
+ * Checks whether a pawn of the given color stands directly beside a
+ * square, i.e. could capture en passant onto the square behind it
+ */
+static bool enemy_pawn_beside(board_t *board, int rank, int file, color_t enemy)
+{
+  piece_t *piece;
+
+  if (file > 0) {
+    piece = board->spaces[rank][file - 1]->piece;
+    if (piece && piece->type == PAWN && piece->color == enemy) return true;
+  }
+  if (file < BOARD_SIZE - 1) {
+    piece = board->spaces[rank][file + 1]->piece;
+    if (piece && piece->type == PAWN && piece->color == enemy) return true;
+  }
+  return false;
+}
 
 /*
  *   valid_board_init
@@ -269,36 +748,33 @@ int valid_board_init(board_t *boardToCheck)
 static int add_opening_pieces(board_t *empty)
 {
   /* Set up WHITE's back row */
-  square_add_piece(empty->spaces[0][0], piece_init_alive(WHITE,ROOK,0,0));
-  square_add_piece(empty->spaces[0][1], piece_init_alive(WHITE,KNIGHT,0,1));
-  square_add_piece(empty->spaces[0][2], piece_init_alive(WHITE,BISHOP,0,2));
-  square_add_piece(empty->spaces[0][3], piece_init_alive(WHITE,QUEEN,0,3));
-  square_add_piece(empty->spaces[0][4], piece_init_alive(WHITE,KING,0,4));
-  square_add_piece(empty->spaces[0][5], piece_init_alive(WHITE,BISHOP,0,5));
-  square_add_piece(empty->spaces[0][6], piece_init_alive(WHITE,KNIGHT,0,6));
-  square_add_piece(empty->spaces[0][7], piece_init_alive(WHITE,ROOK,0,7));
+  board_add_piece(empty, piece_init_alive(WHITE,ROOK,0,0), 0, 0);
+  board_add_piece(empty, piece_init_alive(WHITE,KNIGHT,0,1), 0, 1);
+  board_add_piece(empty, piece_init_alive(WHITE,BISHOP,0,2), 0, 2);
+  board_add_piece(empty, piece_init_alive(WHITE,QUEEN,0,3), 0, 3);
+  board_add_piece(empty, piece_init_alive(WHITE,KING,0,4), 0, 4);
+  board_add_piece(empty, piece_init_alive(WHITE,BISHOP,0,5), 0, 5);
+  board_add_piece(empty, piece_init_alive(WHITE,KNIGHT,0,6), 0, 6);
+  board_add_piece(empty, piece_init_alive(WHITE,ROOK,0,7), 0, 7);
 
   /* Set up WHITE's pawn row */
   int file=0;
   for (file=0;file<BOARD_SIZE;file++)
-    square_add_piece(empty->spaces[1][file], piece_init_alive(WHITE,PAWN,1,file));
+    board_add_piece(empty, piece_init_alive(WHITE,PAWN,1,file), 1, file);
 
   /* Set up BLACK's back row */
-  square_add_piece(empty->spaces[7][0], piece_init_alive(BLACK,ROOK,7,0));
-  square_add_piece(empty->spaces[7][1], piece_init_alive(BLACK,KNIGHT,7,1));
-  square_add_piece(empty->spaces[7][2], piece_init_alive(BLACK,BISHOP,7,2));
-  square_add_piece(empty->spaces[7][3], piece_init_alive(BLACK,QUEEN,7,3));
-  square_add_piece(empty->spaces[7][4], piece_init_alive(BLACK,KING,7,4));
-  square_add_piece(empty->spaces[7][5], piece_init_alive(BLACK,BISHOP,7,5));
-  square_add_piece(empty->spaces[7][6], piece_init_alive(BLACK,KNIGHT,7,6));
-  square_add_piece(empty->spaces[7][7], piece_init_alive(BLACK,ROOK,7,7));
+  board_add_piece(empty, piece_init_alive(BLACK,ROOK,7,0), 7, 0);
+  board_add_piece(empty, piece_init_alive(BLACK,KNIGHT,7,1), 7, 1);
+  board_add_piece(empty, piece_init_alive(BLACK,BISHOP,7,2), 7, 2);
+  board_add_piece(empty, piece_init_alive(BLACK,QUEEN,7,3), 7, 3);
+  board_add_piece(empty, piece_init_alive(BLACK,KING,7,4), 7, 4);
+  board_add_piece(empty, piece_init_alive(BLACK,BISHOP,7,5), 7, 5);
+  board_add_piece(empty, piece_init_alive(BLACK,KNIGHT,7,6), 7, 6);
+  board_add_piece(empty, piece_init_alive(BLACK,ROOK,7,7), 7, 7);
 
   /* Set up BLACK's pawn row */
   for (file=0;file<BOARD_SIZE;file++) {
-    square_add_piece(
-      empty->spaces[6][file],
-      piece_init_alive(BLACK, PAWN, 6, file)
-    );
+    board_add_piece(empty, piece_init_alive(BLACK, PAWN, 6, file), 6, file);
   }
 
   return 0;
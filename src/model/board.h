@@ -1,9 +1,14 @@
 #ifndef _BOARD_H
 #define _BOARD_H
 
+#include <stdio.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "chess.h"
 #include "square.h"
+#include "piece.h"
+#include "move.h"
 /**
   The board_t is a wrapper around a variety of other structs, most notably
   a 2D array of square structs.  More importantly it provides
@@ -16,13 +21,46 @@
 
 /* Declare board struct */
 
+/* Captured pieces wait here (in capture order) until they are either
+ * restored by an unmade move or destroyed with the board
+ */
+#define BOARD_MAX_DEAD 32
+
 struct board {
   square_t *spaces[8][8];/* An arr rep-ing each square of the board */
   color_t moves_next;/* The color of the player moving next */
-
+  uint64_t material_key;/* Packed piece counts, see MATERIAL_KEY_SHIFT */
+  uint64_t hash;/* Zobrist hash of the position, see zobrist.h */
+  int castle_rights;/* CASTLE_* bits still available */
+  int en_passant;/* Square index a pawn may capture onto, or NO_SQUARE */
+  int halfmove_clock;/* Plies since the last capture or pawn move */
+  int fullmove_number;/* Starts at 1, incremented after BLACK moves */
+  piece_t *kings[2];/* (weak) Each side's king, indexed by color */
+  piece_t *dead[BOARD_MAX_DEAD];/* (strong) The dead-queue of captures */
+  int num_dead;
 };
 typedef struct board board_t;
 
+/* Everything board_make_move changes that cannot be recomputed from the
+ * move itself.  Filled by board_make_move, consumed by board_unmake_move.
+ */
+struct board_undo {
+  int castle_rights;
+  int en_passant;
+  int halfmove_clock;
+  uint64_t hash;
+  bool captured;/* Whether the move pushed a piece onto the dead-queue */
+};
+typedef struct board_undo board_undo_t;
+
+/* The material key packs a 4-bit piece count for every (color, type)
+ * pair, so two boards with the same material share the same key and the
+ * counts can be read straight back out of it.
+ */
+#define MATERIAL_KEY_SHIFT(color, type) (((color) * 6 + (type)) * 4)
+#define MATERIAL_KEY_COUNT(key, color, type) \
+  ((int)(((key) >> MATERIAL_KEY_SHIFT(color, type)) & 0xF))
+
 /* This function initializes a game board by allocating memory for
  * all resources and setting initial values.  It doesn't place
  * pieces on the board by default.
@@ -52,6 +90,24 @@ void board_destroy(board_t *boardToDel);
  */
 bool board_equal(board_t *board_one, board_t *board_two);
 
+/* The packed position: a fixed 32-byte record, the same on every host.
+ *   bytes  0-7   occupancy bitboard, big-endian (bit n = square n)
+ *   bytes  8-23  one 4-bit code per occupied square in square order,
+ *                high nibble first: color << 3 | piece_type_t
+ *   byte  24     side to move (bit 0) | castle rights << 1
+ *   byte  25     en passant square, or 0xFF
+ *   bytes 26-27  halfmove clock, big-endian
+ *   bytes 28-29  fullmove number, big-endian
+ *   bytes 30-31  zero
+ * Records are plain bytes, so arrays of them go to and from files in one
+ * I/O call.  The dead-queue is not part of a position and isn't stored.
+ */
+#define BOARD_PACKED_SIZE 32
+struct board_packed {
+  uint8_t bytes[BOARD_PACKED_SIZE];
+};
+typedef struct board_packed board_packed_t;
+
 /* This function loads a board and all associated resources
  * from a file, and returns the collected object as a board_t
  * struct.
@@ -67,6 +123,68 @@ board_t* board_load_from_file(const char *fileIn);
 int
 board_save_to_file(const char *file_out, board_t *to_save, bool overwrite);
 
+/* Encode a position into a packed record.  Returns 0 on success, -1 if
+ * the board holds more than 32 pieces or a piece of an invalid color.
+ */
+int board_pack(board_t *board, board_packed_t *packed);
+
+/* Replace the board's position with a packed one.  Returns 0 on success,
+ * or -1 (leaving the board untouched) if the record is malformed.
+ */
+int board_unpack(board_t *board, const board_packed_t *packed);
+
+/* Write 'count' packed positions in one buffered call.  Returns the
+ * number written.
+ */
+size_t
+board_write_packed(FILE *handle, const board_packed_t *positions, size_t count);
+
+/* Read up to 'count' packed positions in one buffered call.  Returns the
+ * number read.
+ */
+size_t board_read_packed(FILE *handle, board_packed_t *positions, size_t count);
+
+/* Destroy every piece (dead-queue included) and reset the game state,
+ * leaving an empty board with the same side to move
+ */
+void board_clear(board_t *board);
+
+/* Places a piece on the square at rank/file, keeping the board's
+ * material key up to date.  The board takes ownership of the piece.
+ */
+int board_add_piece(board_t *board, piece_t *added, int rank, int file);
+
+/* Lifts the piece off the square at rank/file (updating the material key)
+ * and hands ownership of it back to the caller.  Returns NULL if the
+ * square was empty.
+ */
+piece_t* board_remove_piece(board_t *board, int rank, int file);
+
+/* Returns the number of pieces of the given color and type on the board */
+int board_material_count(board_t *board, color_t color, piece_type_t type);
+
+/* Recompute the derived state (material key, hash, king pointers) after
+ * fields or squares have been edited directly
+ */
+void board_refresh(board_t *board);
+
+/* Compute the board's Zobrist hash from scratch */
+uint64_t board_compute_hash(board_t *board);
+
+/* Play a move on the board.  The move must come from the move generator
+ * for this position; legality is not checked.  'undo' receives what is
+ * needed to take the move back.
+ */
+void board_make_move(board_t *board, move_t *move, board_undo_t *undo);
+
+/* Take back a move played with board_make_move */
+void board_unmake_move(board_t *board, move_t *move, board_undo_t *undo);
+
+/* Pass the turn without moving (used by the search's null-move pruning) */
+void board_make_null_move(board_t *board, board_undo_t *undo);
+
+/* Take back a null move */
+void board_unmake_null_move(board_t *board, board_undo_t *undo);
 
 
 #endif
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "board_snapshot.h"
+#include "board.h"
+#include "chess.h"
+
+static void store_words(_Atomic uint64_t *words, const board_packed_t *packed);
+
+/*
+ *   board_snapshot_init
+ * Create a snapshot and fill it with the board's position
+ *   @param board the board to publish from
+ *   @return a * to the new board_snapshot_t, or NULL on failure
+ */
+board_snapshot_t* board_snapshot_init(board_t *board)
+{
+  board_snapshot_t *snapshot;
+  board_packed_t packed;
+
+  if (board_pack(board, &packed) != 0) return NULL;
+  snapshot = malloc(sizeof(board_snapshot_t) );
+  if (!snapshot) return NULL;
+
+  store_words(snapshot->words[0], &packed);
+  store_words(snapshot->words[1], &packed);
+  atomic_init(&snapshot->sequence, 0);
+  return snapshot;
+}
+
+/*
+ *   board_snapshot_destroy
+ * Cleanup a snapshot
+ *   @param snapshot the board_snapshot_t to destroy
+ */
+void board_snapshot_destroy(board_snapshot_t *snapshot)
+{
+  free(snapshot);
+}
+
+/*
+ *   board_snapshot_publish
+ * Make the board's position the latest.  The sequence goes odd before
+ * the buffer is written, so a reader that saw any of the new words also
+ * sees that the buffer changed.
+ *   @param snapshot the snapshot to publish to
+ *   @param board the board, owned by the calling thread
+ *   @return 0 on success, -1 if the board can't be packed
+ */
+int board_snapshot_publish(board_snapshot_t *snapshot, board_t *board)
+{
+  uint_fast64_t sequence;
+  board_packed_t packed;
+
+  if (board_pack(board, &packed) != 0) return -1;
+
+  /* Only this thread writes the sequence, so a relaxed load is current */
+  sequence = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&snapshot->sequence, sequence + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  store_words(snapshot->words[(sequence / 2 + 1) & 1], &packed);
+  atomic_store_explicit(&snapshot->sequence, sequence + 2,
+                        memory_order_release);
+  return 0;
+}
+
+/*
+ *   board_snapshot_read
+ * Copy the latest published position.  The copy is good unless the
+ * publisher went on to write the same buffer again (two publications
+ * later) meanwhile, which the sequence shows; then it is read again.
+ *   @param snapshot the snapshot to read
+ *   @param packed receives the position
+ *   @return the position's version
+ */
+uint64_t board_snapshot_read(board_snapshot_t *snapshot,
+                             board_packed_t *packed)
+{
+  uint_fast64_t before, after, version;
+  uint64_t word;
+  int i, j;
+
+  do {
+    before = atomic_load_explicit(&snapshot->sequence, memory_order_acquire);
+    version = before / 2;
+    for (i = 0; i < BOARD_SNAPSHOT_WORDS; i++) {
+      word = atomic_load_explicit(&snapshot->words[version & 1][i],
+                                  memory_order_relaxed);
+      for (j = 0; j < 8; j++)
+        packed->bytes[i * 8 + j] = (uint8_t)(word >> (56 - 8 * j) );
+    }
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+  } while (after > 2 * version + 2);
+
+  return version;
+}
+
+/*
+ *   board_snapshot_version
+ * Check how many positions have been published
+ *   @param snapshot the snapshot to check
+ *   @return the latest complete position's version
+ */
+uint64_t board_snapshot_version(board_snapshot_t *snapshot)
+{
+  return atomic_load_explicit(&snapshot->sequence, memory_order_acquire) / 2;
+}
+
+/*
+ *   board_snapshot_squares
+ * Decode the pieces of a packed position, square by square
+ *   @param packed the position
+ *   @param squares receives NUM_SQUARES codes
+ */
+void board_snapshot_squares(const board_packed_t *packed, uint8_t *squares)
+{
+  const uint8_t *bytes = packed->bytes;
+  uint64_t occupancy = 0;
+  int square, count = 0, i;
+
+  for (i = 0; i < 8; i++) occupancy = occupancy << 8 | bytes[i];
+  for (square = 0; square < NUM_SQUARES; square++) {
+    if (!(occupancy >> square & 1) || count == 32) {
+      squares[square] = BOARD_SNAPSHOT_EMPTY;
+      continue;
+    }
+    squares[square] = count % 2 ? bytes[8 + count / 2] & 0xF :
+                                  bytes[8 + count / 2] >> 4;
+    count++;
+  }
+}
+
+/*
+ *   store_words
+ * Store a packed position as big-endian atomic words
+ */
+static void store_words(_Atomic uint64_t *words, const board_packed_t *packed)
+{
+  uint64_t word;
+  int i, j;
+
+  for (i = 0; i < BOARD_SNAPSHOT_WORDS; i++) {
+    for (word = 0, j = 0; j < 8; j++)
+      word = word << 8 | packed->bytes[i * 8 + j];
+    atomic_store_explicit(&words[i], word, memory_order_relaxed);
+  }
+}
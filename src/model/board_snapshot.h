@@ -0,0 +1,60 @@
+#ifndef _BOARD_SNAPSHOT_H
+#define _BOARD_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "board.h"
+
+/*
+ * A board_snapshot publishes immutable copies of a position from the
+ * thread that owns a board to any number of threads that only look at
+ * it (the renderer), without locks: the owner never waits on a reader
+ * and readers never see a half-made move.
+ *
+ * A copy is the position's board_packed_t, held as BOARD_SNAPSHOT_WORDS
+ * atomic words.  There are two buffers: publication n goes into buffer
+ * n & 1, so a publication never touches the copy readers are most
+ * likely reading.  A sequence count, odd while a publication is being
+ * written, tells a reader when the buffer it read was reused under it
+ * (two publications in the time of one read), and it reads again.
+ *
+ * Only one thread may publish to a snapshot.
+ */
+
+#define BOARD_SNAPSHOT_WORDS (BOARD_PACKED_SIZE / 8)
+#define BOARD_SNAPSHOT_EMPTY 0xFF /* See board_snapshot_squares */
+
+struct board_snapshot {
+  atomic_uint_fast64_t sequence;  /* 2 * publications, + 1 while writing */
+  _Atomic uint64_t words[2][BOARD_SNAPSHOT_WORDS];
+};
+typedef struct board_snapshot board_snapshot_t;
+
+/* Create a snapshot holding the board's position (version 0).  Returns
+ * NULL on failure.
+ */
+board_snapshot_t* board_snapshot_init(board_t *board);
+
+/* Cleanup a snapshot */
+void board_snapshot_destroy(board_snapshot_t *snapshot);
+
+/* Publish the board's current position.  Never blocks.  Returns 0 on
+ * success, or -1 if the board can't be packed.
+ */
+int board_snapshot_publish(board_snapshot_t *snapshot, board_t *board);
+
+/* Copy the latest position into 'packed'.  Never blocks the publisher.
+ * Returns the position's version: how many publications came before it.
+ */
+uint64_t board_snapshot_read(board_snapshot_t *snapshot,
+                             board_packed_t *packed);
+
+/* The version of the latest position, to check for a new one cheaply */
+uint64_t board_snapshot_version(board_snapshot_t *snapshot);
+
+/* Unpack a position's pieces into one code per square (square index
+ * order): color << 3 | piece_type_t, or BOARD_SNAPSHOT_EMPTY.
+ */
+void board_snapshot_squares(const board_packed_t *packed, uint8_t *squares);
+
+#endif
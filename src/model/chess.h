@@ -2,9 +2,25 @@
 #define _CHESS_H_
 
 #define BOARD_SIZE  8
+#define NUM_SQUARES (BOARD_SIZE * BOARD_SIZE)
 /* Enum defined for color of pieces/squares */
 enum color {WHITE=0,BLACK=1,RED=2,GREEN=3,BLUE=4,
             ORANGE=5,YELLOW=6,PURPLE=7,GREY=8};
 typedef enum color color_t;
 
+#define OTHER_COLOR(color) ((color) == WHITE ? BLACK : WHITE)
+
+/* Squares can also be addressed by a single index: a1 = 0, h8 = 63 */
+#define SQUARE_INDEX(rank, file) ((rank) * BOARD_SIZE + (file))
+#define SQUARE_RANK(index)       ((index) / BOARD_SIZE)
+#define SQUARE_FILE(index)       ((index) % BOARD_SIZE)
+#define NO_SQUARE                (-1)
+
+/* Castling rights, OR'd together */
+#define CASTLE_WHITE_KING   1
+#define CASTLE_WHITE_QUEEN  2
+#define CASTLE_BLACK_KING   4
+#define CASTLE_BLACK_QUEEN  8
+#define CASTLE_ALL          15
+
 #endif
@@ -0,0 +1,482 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "fen.h"
+#include "board.h"
+#include "chess.h"
+#include "piece.h"
+#include "square.h"
+#include "move_gen.h"
+
+#define FEN_EMPTY (-1)
+
+/* A position read from text, before it is put on a board */
+struct fen_record {
+  int8_t codes[NUM_SQUARES];    /* color << 3 | piece_type_t, or FEN_EMPTY */
+  color_t moves_next;
+  int castle_rights;
+  int en_passant;
+  int halfmove_clock;
+  int fullmove_number;
+};
+typedef struct fen_record fen_record_t;
+
+/* FEN letters by piece_type_t; upper case is WHITE */
+static const char piece_letters[6] = {'R', 'N', 'B', 'K', 'Q', 'P'};
+
+static int8_t piece_code(char letter);
+static size_t skip_spaces(const char *text, size_t length, size_t at);
+static size_t parse_number(const char *text, size_t length, size_t at,
+                           int *number);
+static int place_pieces(board_t *board, const fen_record_t *record);
+static int write_fields(board_t *board, char *out, bool counters);
+static int write_number(char *out, int number);
+
+/*
+ *   fen_parse
+ * Parse a FEN or EPD record into a board.  The text is read in one pass
+ * into a fen_record_t, so a syntax error leaves the board alone.
+ *   @param board the board to fill
+ *   @param text the record (need not be NUL-terminated)
+ *   @param length the bytes available at 'text'
+ *   @param consumed if non-NULL, receives the offset past the position
+ *   @return 0 on success, -1 on a syntax error, -2 if illegal, -3 if
+ *           out of memory
+ */
+int fen_parse(board_t *board, const char *text, size_t length,
+              size_t *consumed)
+{
+  fen_record_t record;
+  size_t at = skip_spaces(text, length, 0), counter;
+  int rank = BOARD_SIZE - 1, file = 0;
+  int8_t code;
+  char c;
+
+  /* Piece placement, rank 8 first */
+  memset(record.codes, FEN_EMPTY, sizeof(record.codes) );
+  for (; at < length && text[at] != ' ' && text[at] != '\t'; at++) {
+    c = text[at];
+    if (c == '/') {
+      if (file != BOARD_SIZE || rank == 0) return -1;
+      rank--;
+      file = 0;
+    }
+    else if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > BOARD_SIZE) return -1;
+    }
+    else {
+      code = piece_code(c);
+      if (file == BOARD_SIZE || code == FEN_EMPTY) return -1;
+      record.codes[SQUARE_INDEX(rank, file++)] = code;
+    }
+  }
+  if (rank != 0 || file != BOARD_SIZE) return -1;
+
+  /* Side to move */
+  at = skip_spaces(text, length, at);
+  if (at >= length || (text[at] != 'w' && text[at] != 'b')) return -1;
+  record.moves_next = text[at++] == 'w' ? WHITE : BLACK;
+
+  /* Castling rights */
+  at = skip_spaces(text, length, at);
+  record.castle_rights = 0;
+  if (at < length && text[at] == '-') {
+    at++;
+  }
+  else {
+    for (; at < length && text[at] != ' ' && text[at] != '\t'; at++) {
+      switch (text[at]) {
+        case 'K': record.castle_rights |= CASTLE_WHITE_KING; break;
+        case 'Q': record.castle_rights |= CASTLE_WHITE_QUEEN; break;
+        case 'k': record.castle_rights |= CASTLE_BLACK_KING; break;
+        case 'q': record.castle_rights |= CASTLE_BLACK_QUEEN; break;
+        default: return -1;
+      }
+    }
+    if (!record.castle_rights) return -1;
+  }
+
+  /* En passant square */
+  at = skip_spaces(text, length, at);
+  if (at < length && text[at] == '-') {
+    record.en_passant = NO_SQUARE;
+    at++;
+  }
+  else if (at + 1 < length && text[at] >= 'a' && text[at] <= 'h' &&
+           (text[at + 1] == '3' || text[at + 1] == '6')) {
+    record.en_passant = SQUARE_INDEX(text[at + 1] - '1', text[at] - 'a');
+    at += 2;
+  }
+  else {
+    return -1;
+  }
+  if (at < length && text[at] != ' ' && text[at] != '\t' &&
+      text[at] != '\n' && text[at] != '\r')
+    return -1;
+
+  /* Move counters: both or neither */
+  record.halfmove_clock = 0;
+  record.fullmove_number = 1;
+  counter = skip_spaces(text, length, at);
+  if (counter < length && text[counter] >= '0' && text[counter] <= '9') {
+    at = parse_number(text, length, counter, &record.halfmove_clock);
+    at = skip_spaces(text, length, at);
+    if (at >= length || text[at] < '0' || text[at] > '9') return -1;
+    at = parse_number(text, length, at, &record.fullmove_number);
+    if (record.fullmove_number < 1) record.fullmove_number = 1;
+  }
+  if (consumed) *consumed = skip_spaces(text, length, at);
+
+  if (place_pieces(board, &record)) return -3;
+  return fen_validate(board);
+}
+
+/*
+ *   fen_board
+ * Create a board holding the position of a NUL-terminated FEN
+ *   @param text the FEN
+ *   @return a * to the new board, or NULL if the FEN is bad or illegal
+ */
+board_t* fen_board(const char *text)
+{
+  board_t *board;
+
+  if (!text || !(board = board_init()) ) return NULL;
+  if (fen_parse(board, text, strlen(text), NULL)) {
+    board_destroy(board);
+    return NULL;
+  }
+  return board;
+}
+
+/*
+ *   fen_validate
+ * Reject positions that can't occur in a game and drop castling rights
+ * and en passant squares that don't apply
+ *   @param board the position to check (rights may be cleared)
+ *   @return 0 if legal, -2 if not
+ */
+int fen_validate(board_t *board)
+{
+  static const int rook_squares[4] = {7, 0, 63, 56};
+  static const int king_squares[4] = {4, 4, 60, 60};
+  color_t us = board->moves_next, them = OTHER_COLOR(us);
+  int color, type, count, right, ep_rank, ep_file, dir, pawn_rank;
+  int origin_rank, rights = board->castle_rights, en_passant = board->en_passant;
+  bool capturer;
+  piece_t *piece, *rook, *king;
+
+  for (color = WHITE; color <= BLACK; color++) {
+    for (type = 0, count = 0; type < 6; type++)
+      count += MATERIAL_KEY_COUNT(board->material_key, color, type);
+    if (count > 16 || MATERIAL_KEY_COUNT(board->material_key, color, KING) != 1 ||
+        MATERIAL_KEY_COUNT(board->material_key, color, PAWN) > 8)
+      return -2;
+  }
+  for (ep_file = 0; ep_file < BOARD_SIZE; ep_file++) {
+    piece = board->spaces[0][ep_file]->piece;
+    if (piece && piece->type == PAWN) return -2;
+    piece = board->spaces[BOARD_SIZE - 1][ep_file]->piece;
+    if (piece && piece->type == PAWN) return -2;
+  }
+  if (move_gen_in_check(board, them)) return -2;
+
+  /* Castling needs the king and the rook on their starting squares */
+  for (right = 0; right < 4; right++) {
+    if (!(board->castle_rights & (1 << right))) continue;
+    color = right < 2 ? WHITE : BLACK;
+    king = board->spaces[SQUARE_RANK(king_squares[right])]
+                        [SQUARE_FILE(king_squares[right])]->piece;
+    rook = board->spaces[SQUARE_RANK(rook_squares[right])]
+                        [SQUARE_FILE(rook_squares[right])]->piece;
+    if (!king || king->type != KING || king->color != (color_t)color ||
+        !rook || rook->type != ROOK || rook->color != (color_t)color)
+      board->castle_rights &= ~(1 << right);
+  }
+
+  /* En passant: behind a pawn that just double-pushed, and (as kept by
+   * board_make_move) only when a pawn stands ready to capture
+   */
+  if (board->en_passant != NO_SQUARE &&
+      SQUARE_RANK(board->en_passant) != (us == WHITE ? 5 : 2))
+    board->en_passant = NO_SQUARE;
+  if (board->en_passant != NO_SQUARE) {
+    ep_rank = SQUARE_RANK(board->en_passant);
+    ep_file = SQUARE_FILE(board->en_passant);
+    pawn_rank = ep_rank + (us == WHITE ? -1 : 1);
+    origin_rank = ep_rank - (us == WHITE ? -1 : 1);
+    piece = board->spaces[pawn_rank][ep_file]->piece;
+    if (board->spaces[ep_rank][ep_file]->piece ||
+        board->spaces[origin_rank][ep_file]->piece ||
+        !piece || piece->type != PAWN || piece->color != them)
+      board->en_passant = NO_SQUARE;
+
+    for (dir = -1, capturer = false; dir <= 1; dir += 2) {
+      if (ep_file + dir < 0 || ep_file + dir >= BOARD_SIZE) continue;
+      piece = board->spaces[pawn_rank][ep_file + dir]->piece;
+      if (piece && piece->type == PAWN && piece->color == us) capturer = true;
+    }
+    if (!capturer) board->en_passant = NO_SQUARE;
+  }
+  if (board->castle_rights != rights || board->en_passant != en_passant)
+    board->hash = board_compute_hash(board);
+  return 0;
+}
+
+/*
+ *   fen_write
+ * Write the board as FEN
+ *   @param board the position
+ *   @param buffer receives the NUL-terminated FEN
+ *   @param size the size of 'buffer'
+ *   @return the length written, or -1 if it doesn't fit
+ */
+int fen_write(board_t *board, char *buffer, size_t size)
+{
+  char out[FEN_MAX_LENGTH];
+  int length = write_fields(board, out, true);
+
+  if ((size_t)length >= size) return -1;
+  memcpy(buffer, out, length + 1);
+  return length;
+}
+
+/*
+ *   fen_write_epd
+ * Write the board as the four position fields of EPD
+ *   @param board the position
+ *   @param buffer receives the NUL-terminated text
+ *   @param size the size of 'buffer'
+ *   @return the length written, or -1 if it doesn't fit
+ */
+int fen_write_epd(board_t *board, char *buffer, size_t size)
+{
+  char out[FEN_MAX_LENGTH];
+  int length = write_fields(board, out, false);
+
+  if ((size_t)length >= size) return -1;
+  memcpy(buffer, out, length + 1);
+  return length;
+}
+
+/*
+ *   fen_epd_operation
+ * Look up one EPD operation: 'opcode operand...;'
+ *   @param operations the text after the position fields
+ *   @param length the bytes available
+ *   @param opcode the operation wanted, e.g. "bm"
+ *   @param value receives the operand(s), quotes stripped
+ *   @param size the size of 'value'
+ *   @return true if found and copied
+ */
+bool fen_epd_operation(const char *operations, size_t length,
+                       const char *opcode, char *value, size_t size)
+{
+  size_t opcode_length = strlen(opcode), at = 0, start, end;
+  bool quoted, match;
+
+  while ((at = skip_spaces(operations, length, at)) < length &&
+         operations[at] != '\n' && operations[at] != '\r') {
+    start = at;
+    while (at < length && operations[at] != ' ' && operations[at] != ';' &&
+           operations[at] != '\n')
+      at++;
+    match = at - start == opcode_length &&
+                 !memcmp(operations + start, opcode, opcode_length);
+
+    /* Operands run to the ';', which may appear inside quotes */
+    at = skip_spaces(operations, length, at);
+    start = at;
+    for (quoted = false; at < length && operations[at] != '\n' &&
+         (quoted || operations[at] != ';'); at++)
+      if (operations[at] == '"') quoted = !quoted;
+    end = at;
+    if (at < length && operations[at] == ';') at++;
+
+    if (!match) continue;
+    while (end > start && operations[end - 1] == ' ') end--;
+    if (end - start >= 2 && operations[start] == '"' &&
+        operations[end - 1] == '"') {
+      start++;
+      end--;
+    }
+    if (end - start >= size) return false;
+    memcpy(value, operations + start, end - start);
+    value[end - start] = '\0';
+    return true;
+  }
+  return false;
+}
+
+/*
+ *   piece_code
+ * The code of a FEN piece letter, or FEN_EMPTY
+ */
+static int8_t piece_code(char letter)
+{
+  /* Indexed by character; 0 means not a piece letter */
+  static const int8_t codes[128] = {
+    ['R'] = 1 + ROOK, ['N'] = 1 + KNIGHT, ['B'] = 1 + BISHOP,
+    ['K'] = 1 + KING, ['Q'] = 1 + QUEEN, ['P'] = 1 + PAWN,
+    ['r'] = 1 + (BLACK << 3 | ROOK), ['n'] = 1 + (BLACK << 3 | KNIGHT),
+    ['b'] = 1 + (BLACK << 3 | BISHOP), ['k'] = 1 + (BLACK << 3 | KING),
+    ['q'] = 1 + (BLACK << 3 | QUEEN), ['p'] = 1 + (BLACK << 3 | PAWN),
+  };
+
+  if ((unsigned char)letter >= 128) return FEN_EMPTY;
+  return codes[(unsigned char)letter] - 1;
+}
+
+/*
+ *   skip_spaces
+ * The offset of the next non-blank byte at or after 'at'
+ */
+static size_t skip_spaces(const char *text, size_t length, size_t at)
+{
+  while (at < length && (text[at] == ' ' || text[at] == '\t')) at++;
+  return at;
+}
+
+/*
+ *   parse_number
+ * Read a decimal number (saturating well above any real clock)
+ *   @return the offset past the digits
+ */
+static size_t parse_number(const char *text, size_t length, size_t at,
+                           int *number)
+{
+  *number = 0;
+  for (; at < length && text[at] >= '0' && text[at] <= '9'; at++) {
+    if (*number < 100000) *number = *number * 10 + (text[at] - '0');
+  }
+  return at;
+}
+
+/*
+ *   place_pieces
+ * Put a parsed record on the board.  The board's piece_t structs (on
+ * squares or in the dead-queue) are reused; only a shortfall is
+ * allocated.
+ *   @return 0 on success, -1 if out of memory (board left empty)
+ */
+static int place_pieces(board_t *board, const fen_record_t *record)
+{
+  piece_t *pool[NUM_SQUARES + BOARD_MAX_DEAD], *piece;
+  int pooled = 0, square, rank, file, i;
+  square_t *space;
+
+  for (square = 0; square < NUM_SQUARES; square++) {
+    space = board->spaces[SQUARE_RANK(square)][SQUARE_FILE(square)];
+    if (space->piece) pool[pooled++] = space->piece;
+    space->piece = NULL;
+  }
+  for (i = 0; i < board->num_dead; i++) pool[pooled++] = board->dead[i];
+  board->num_dead = 0;
+
+  for (square = 0; square < NUM_SQUARES; square++) {
+    if (record->codes[square] == FEN_EMPTY) continue;
+    rank = SQUARE_RANK(square);
+    file = SQUARE_FILE(square);
+    if (pooled) {
+      piece = pool[--pooled];
+      piece->color = record->codes[square] >> 3;
+      piece->type = record->codes[square] & 7;
+      piece->health = ALIVE;
+    }
+    else if (!(piece = piece_init_alive(record->codes[square] >> 3,
+                                        record->codes[square] & 7,
+                                        rank, file)) ) {
+      board_clear(board);
+      return -1;
+    }
+    piece->rank = rank;
+    piece->file = file;
+    board->spaces[rank][file]->piece = piece;
+  }
+  while (pooled) piece_destroy(pool[--pooled]);
+
+  board->moves_next = record->moves_next;
+  board->castle_rights = record->castle_rights;
+  board->en_passant = record->en_passant;
+  board->halfmove_clock = record->halfmove_clock;
+  board->fullmove_number = record->fullmove_number;
+  board_refresh(board);
+  return 0;
+}
+
+/*
+ *   write_fields
+ * Write the FEN fields into 'out' (at least FEN_MAX_LENGTH bytes)
+ *   @return the length written
+ */
+static int write_fields(board_t *board, char *out, bool counters)
+{
+  static const char castle_letters[4] = {'K', 'Q', 'k', 'q'};
+  int rank, file, empty, length = 0, right;
+  piece_t *piece;
+  char letter;
+
+  for (rank = BOARD_SIZE - 1; rank >= 0; rank--) {
+    for (file = 0, empty = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (!piece) {
+        empty++;
+        continue;
+      }
+      if (empty) out[length++] = '0' + empty;
+      empty = 0;
+      letter = piece_letters[piece->type];
+      out[length++] = piece->color == BLACK ? letter - 'A' + 'a' : letter;
+    }
+    if (empty) out[length++] = '0' + empty;
+    if (rank) out[length++] = '/';
+  }
+
+  out[length++] = ' ';
+  out[length++] = board->moves_next == WHITE ? 'w' : 'b';
+  out[length++] = ' ';
+  if (!board->castle_rights) out[length++] = '-';
+  for (right = 0; right < 4; right++) {
+    if (board->castle_rights & (1 << right))
+      out[length++] = castle_letters[right];
+  }
+  out[length++] = ' ';
+  if (board->en_passant == NO_SQUARE) {
+    out[length++] = '-';
+  }
+  else {
+    out[length++] = 'a' + SQUARE_FILE(board->en_passant);
+    out[length++] = '1' + SQUARE_RANK(board->en_passant);
+  }
+
+  if (counters) {
+    out[length++] = ' ';
+    length += write_number(out + length, board->halfmove_clock);
+    out[length++] = ' ';
+    length += write_number(out + length, board->fullmove_number);
+  }
+  out[length] = '\0';
+  return length;
+}
+
+/*
+ *   write_number
+ * Write a non-negative decimal number (no NUL)
+ *   @return the number of digits written
+ */
+static int write_number(char *out, int number)
+{
+  char digits[12];
+  int count = 0, i;
+
+  if (number < 0) number = 0;
+  do {
+    digits[count++] = '0' + number % 10;
+    number /= 10;
+  } while (number);
+  for (i = 0; i < count; i++) out[i] = digits[count - 1 - i];
+  return count;
+}
@@ -0,0 +1,64 @@
+#ifndef _FEN_H
+#define _FEN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "board.h"
+
+/*
+ * Forsyth-Edwards Notation: one line of text per position, the format
+ * every other chess tool speaks.  EPD is FEN without the two move
+ * counters, followed by operations such as 'bm e4; id "test 1";'.
+ *
+ * The parser reads straight out of a caller's buffer (a line read with
+ * fgets, or a memory-mapped file) without copying or tokenizing it, and
+ * refills an existing board in place, recycling its piece_t structs, so
+ * converting a large file costs no allocation per line.
+ */
+
+#define FEN_MAX_LENGTH 128   /* Longest FEN written, NUL included */
+#define FEN_START_POSITION \
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+/* Parse one FEN or EPD record: the first 'length' bytes of 'text', up to
+ * the end of the line.  The move counters are optional (EPD); when they
+ * are missing the halfmove clock is 0 and the move number 1.
+ * 'consumed', if non-NULL, receives the offset just past the position
+ * (and counters), where EPD operations start.
+ * Returns 0 on success, -1 on a syntax error (the board is untouched),
+ * -2 if the position is illegal (the board then holds it anyway), or -3
+ * if out of memory for its pieces (the board is then left empty).
+ */
+int fen_parse(board_t *board, const char *text, size_t length,
+              size_t *consumed);
+
+/* Create a board from a NUL-terminated FEN.  Returns NULL if the FEN
+ * isn't a legal position.
+ */
+board_t* fen_board(const char *text);
+
+/* Check that a position could arise in a game: one king per side, at
+ * most 16 pieces and 8 pawns per side, no pawns on the first or last
+ * rank, and the side that just moved not in check.  Castling rights
+ * without the king and rook at home, and en passant squares no pawn
+ * can capture on, are dropped.  Returns 0 if legal, -2 otherwise.
+ */
+int fen_validate(board_t *board);
+
+/* Write the board's FEN into 'buffer' (NUL-terminated).  Returns the
+ * length written, or -1 if it doesn't fit in 'size' bytes.
+ */
+int fen_write(board_t *board, char *buffer, size_t size);
+
+/* As fen_write, but only the four EPD fields (no move counters) */
+int fen_write_epd(board_t *board, char *buffer, size_t size);
+
+/* Find the operand of an EPD operation ("bm", "id", ...) in the text
+ * after the position, copying it into 'value' without surrounding
+ * quotes.  Returns true if the operation is present and fits.
+ */
+bool fen_epd_operation(const char *operations, size_t length,
+                       const char *opcode, char *value, size_t size);
+
+#endif
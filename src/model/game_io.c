@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "game_io.h"
+#include "board.h"
+#include "move.h"
+#include "move_gen.h"
+#include "history_stack.h"
+#include "journal.h"
+#include "pgn.h"
+#include "queue.h"
+
+#define PGN_BYTES_PER_PLY 16    /* "123... Qxe8=Q+ " and a little more */
+#define PGN_HEADER_BYTES  1024  /* Tags, FEN and result */
+
+static game_io_request_t* request_init(game_io_type_t type, const char *path);
+static int take_snapshot(game_io_request_t *request, board_t *board,
+                         history_stack_t *stack);
+static int submit(game_io_t *io, game_io_request_t *request);
+static int post_sync(game_io_t *io, journal_t *journal, const char *path);
+static void* work(void *io_as_void);
+static int save(game_io_request_t *request);
+static int load(game_io_request_t *request);
+static bool first_game(const pgn_game_t *game, void *user);
+static bool write_file(const char *path, const char *data, size_t size);
+
+/*
+ *   game_io_init
+ * Create the queues and start the worker thread
+ *   @return a * to the new game_io_t, or NULL on failure
+ */
+game_io_t* game_io_init(void)
+{
+  game_io_t *io = malloc(sizeof(game_io_t) );
+  if (!io) return NULL;
+
+  io->requests = queue_init(GAME_IO_QUEUE_SIZE);
+  io->done = queue_init(GAME_IO_QUEUE_SIZE);
+  atomic_init(&io->closing, false);
+  atomic_init(&io->pending, 0);
+  pthread_mutex_init(&io->lock, NULL);
+  pthread_cond_init(&io->wake, NULL);
+  if (!io->requests || !io->done ||
+      pthread_create(&io->thread, NULL, work, io)) {
+    queue_destroy(io->requests);
+    queue_destroy(io->done);
+    pthread_mutex_destroy(&io->lock);
+    pthread_cond_destroy(&io->wake);
+    free(io);
+    return NULL;
+  }
+  return io;
+}
+
+/*
+ *   game_io_destroy
+ * Let the worker finish what it was given, then release everything
+ *   @param io the game_io_t to destroy
+ */
+void game_io_destroy(game_io_t *io)
+{
+  game_io_request_t *request;
+
+  if (!io) return;
+  pthread_mutex_lock(&io->lock);
+  atomic_store(&io->closing, true);
+  pthread_cond_signal(&io->wake);
+  pthread_mutex_unlock(&io->lock);
+  pthread_join(io->thread, NULL);
+
+  while ((request = queue_pop(io->done)) ) game_io_release(request);
+  queue_destroy(io->requests);
+  queue_destroy(io->done);
+  pthread_mutex_destroy(&io->lock);
+  pthread_cond_destroy(&io->wake);
+  free(io);
+}
+
+/*
+ *   game_io_save
+ * Snapshot a game and queue it for saving.  Only the snapshot is done
+ * here: packing the start position and copying the packed moves.
+ *   @param io the worker
+ *   @param path where to save
+ *   @param board the game's board
+ *   @param stack the game's history
+ *   @return 0 if queued, -1 on failure
+ */
+int game_io_save(game_io_t *io, const char *path, board_t *board,
+                 history_stack_t *stack)
+{
+  game_io_request_t *request = request_init(GAME_IO_SAVE, path);
+
+  if (!request || take_snapshot(request, board, stack) != 0) {
+    game_io_release(request);
+    return -1;
+  }
+  return submit(io, request);
+}
+
+/*
+ *   game_io_load
+ * Queue a PGN file to be read
+ *   @param io the worker
+ *   @param path the file
+ *   @return 0 if queued, -1 on failure
+ */
+int game_io_load(game_io_t *io, const char *path)
+{
+  game_io_request_t *request = request_init(GAME_IO_LOAD, path);
+
+  if (!request) return -1;
+  return submit(io, request);
+}
+
+/*
+ *   game_io_poll
+ * Take a finished request off the done queue without waiting
+ *   @param io the worker
+ *   @return the request, or NULL if none has finished
+ */
+game_io_request_t* game_io_poll(game_io_t *io)
+{
+  game_io_request_t *request = queue_pop(io->done);
+
+  if (request) atomic_fetch_sub(&io->pending, 1);
+  return request;
+}
+
+/*
+ *   game_io_busy
+ * Check for requests that haven't been polled yet
+ *   @param io the worker
+ *   @return true if any are queued, running or done but not polled
+ */
+bool game_io_busy(game_io_t *io)
+{
+  return atomic_load(&io->pending) > 0;
+}
+
+/*
+ *   game_io_journal
+ * Hand a background journal's due compaction or sync to the worker.  A
+ * compaction carries a snapshot of the game and its generation; a sync
+ * carries a duplicate of the journal's descriptor, which stays valid
+ * if a compaction replaces the journal's own meanwhile.
+ *   @param io the worker
+ *   @param journal the game's journal
+ *   @return 0 if posted or nothing was due, -1 on failure
+ */
+int game_io_journal(game_io_t *io, journal_t *journal)
+{
+  char temp[GAME_IO_MAX_PATH];
+  game_io_request_t *request;
+
+  switch (journal_due(journal)) {
+    case JOURNAL_DUE_COMPACT:
+      journal_temp_path(journal, temp, sizeof(temp));
+      request = request_init(GAME_IO_JOURNAL_COMPACT, temp);
+      if (!request ||
+          take_snapshot(request, journal->board, journal->stack) != 0) {
+        game_io_release(request);
+        return -1;
+      }
+      request->generation = journal->generation;
+      if (submit(io, request) != 0) return -1;
+      journal->compacting = true;
+      return 0;
+    case JOURNAL_DUE_SYNC:
+      if (post_sync(io, journal, NULL) != 0) return -1;
+      journal->unsynced = 0;
+      return 0;
+    default:
+      return 0;
+  }
+}
+
+/*
+ *   game_io_journal_done
+ * Collect a finished journal request: a compaction's file is renamed
+ * into place here, on the game's thread, where no record can be
+ * appended in between, and the directory is then synced by the worker
+ *   @param io the worker
+ *   @param request a journal request from game_io_poll
+ *   @param journal the game's journal
+ *   @return the request's status, or -1 if the file wasn't put in place
+ */
+int game_io_journal_done(game_io_t *io, const game_io_request_t *request,
+                         journal_t *journal)
+{
+  if (request->type != GAME_IO_JOURNAL_COMPACT) return request->status;
+  if (journal_install(journal, request->status == 0, request->generation,
+                      request->snapshot.num_moves) != 0)
+    return -1;
+  post_sync(io, journal, journal->path);
+  return 0;
+}
+
+/*
+ *   game_io_apply
+ * Replace the game on a board and history stack with a loaded one
+ *   @param request a finished load
+ *   @param board the board to set up
+ *   @param stack the history to fill
+ *   @return 0 on success, -1 if the snapshot doesn't play
+ */
+int game_io_apply(const game_io_request_t *request, board_t *board,
+                  history_stack_t *stack)
+{
+  const game_snapshot_t *snapshot = &request->snapshot;
+  move_t move;
+  int i;
+
+  if (request->status != 0 || board_unpack(board, &snapshot->start) != 0)
+    return -1;
+  history_stack_clear(stack);
+  for (i = 0; i < snapshot->num_moves; i++) {
+    if (!move_gen_find_packed(board, snapshot->moves[i], &move) ||
+        history_stack_push(stack, board, &move) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+/*
+ *   game_io_release
+ * Cleanup a request
+ *   @param request the game_io_request_t to release
+ */
+void game_io_release(game_io_request_t *request)
+{
+  if (!request) return;
+  if (request->fd >= 0) close(request->fd);
+  free(request->snapshot.moves);
+  free(request);
+}
+
+/*
+ *   request_init
+ * Create an empty request
+ *   @return a * to the new request, or NULL on failure
+ */
+static game_io_request_t* request_init(game_io_type_t type, const char *path)
+{
+  game_io_request_t *request;
+
+  if (strlen(path) >= GAME_IO_MAX_PATH) return NULL;
+  request = calloc(1, sizeof(game_io_request_t) );
+  if (!request) return NULL;
+  request->type = type;
+  strcpy(request->path, path);
+  request->status = -1;
+  request->fd = -1;
+  return request;
+}
+
+/*
+ *   take_snapshot
+ * Copy a game into a request: the packed start position and the packed
+ * moves, which is all it takes to play it again
+ *   @return 0 on success, -1 on failure
+ */
+static int take_snapshot(game_io_request_t *request, board_t *board,
+                         history_stack_t *stack)
+{
+  int i;
+
+  request->snapshot.moves = malloc((stack->count + 1) * sizeof(uint16_t) );
+  if (!request->snapshot.moves ||
+      history_stack_pack_start(stack, board, &request->snapshot.start) != 0)
+    return -1;
+  for (i = 0; i < stack->count; i++)
+    request->snapshot.moves[i] = stack->entries[i].move;
+  request->snapshot.num_moves = stack->count;
+  return 0;
+}
+
+/*
+ *   submit
+ * Hand a request to the worker and wake it.  Counting requests in
+ * flight keeps the done queue from ever filling up.
+ *   @return 0 if queued, -1 (releasing the request) if too many are
+ */
+static int submit(game_io_t *io, game_io_request_t *request)
+{
+  if (atomic_fetch_add(&io->pending, 1) >= GAME_IO_QUEUE_SIZE ||
+      !queue_push(io->requests, request)) {
+    atomic_fetch_sub(&io->pending, 1);
+    game_io_release(request);
+    return -1;
+  }
+  pthread_mutex_lock(&io->lock);
+  pthread_cond_signal(&io->wake);
+  pthread_mutex_unlock(&io->lock);
+  return 0;
+}
+
+/*
+ *   post_sync
+ * Queue an fsync of a journal's file, and of its directory if 'path'
+ * is given
+ *   @return 0 if queued, -1 on failure
+ */
+static int post_sync(game_io_t *io, journal_t *journal, const char *path)
+{
+  game_io_request_t *request = request_init(GAME_IO_JOURNAL_SYNC,
+                                            path ? path : "");
+
+  if (!request || (request->fd = dup(journal->fd)) < 0) {
+    game_io_release(request);
+    return -1;
+  }
+  return submit(io, request);
+}
+
+/*
+ *   work
+ * Body of the worker thread: run requests in order, sleeping when there
+ * are none, until closing with nothing left to do
+ */
+static void* work(void *io_as_void)
+{
+  game_io_t *io = (game_io_t *)io_as_void;
+  game_io_request_t *request;
+
+  for (;;) {
+    if (!(request = queue_pop(io->requests)) ) {
+      pthread_mutex_lock(&io->lock);
+      while (queue_empty(io->requests) && !atomic_load(&io->closing))
+        pthread_cond_wait(&io->wake, &io->lock);
+      pthread_mutex_unlock(&io->lock);
+      if (atomic_load(&io->closing) && queue_empty(io->requests)) break;
+      continue;
+    }
+
+    switch (request->type) {
+      case GAME_IO_SAVE:
+        request->status = save(request);
+        break;
+      case GAME_IO_LOAD:
+        request->status = load(request);
+        break;
+      case GAME_IO_JOURNAL_SYNC:
+        request->status = journal_sync_file(request->fd, request->path[0] ?
+                                            request->path : NULL);
+        break;
+      case GAME_IO_JOURNAL_COMPACT:
+        request->status = journal_write_file(request->path,
+                                             &request->snapshot.start,
+                                             request->snapshot.moves,
+                                             request->snapshot.num_moves);
+        break;
+    }
+    queue_push(io->done, request);
+  }
+  return NULL;
+}
+
+/*
+ *   save
+ * Replay a snapshot on a board of the worker's own, write it as PGN and
+ * put the file in place
+ *   @return 0 on success, -1 on failure
+ */
+static int save(game_io_request_t *request)
+{
+  game_snapshot_t *snapshot = &request->snapshot;
+  board_t *board = board_init();
+  board_undo_t *undo = malloc((snapshot->num_moves + 1) *
+                              sizeof(board_undo_t) );
+  move_t *moves = malloc((snapshot->num_moves + 1) * sizeof(move_t) );
+  size_t size = PGN_HEADER_BYTES +
+                (size_t)snapshot->num_moves * PGN_BYTES_PER_PLY;
+  char *text = malloc(size), date[16];
+  pgn_tag_t tags[7] = {
+    { "Event", "jegChess game", 5, 13 }, { "Site", "?", 4, 1 },
+    { "Date", date, 4, 10 }, { "Round", "-", 5, 1 },
+    { "White", "?", 5, 1 }, { "Black", "?", 5, 1 }, { "Result", "*", 6, 1 }
+  };
+  time_t now = time(NULL);
+  int i, played = 0, length = -1;
+
+  strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now) );
+  if (board && undo && moves && text &&
+      board_unpack(board, &snapshot->start) == 0) {
+    for (played = 0; played < snapshot->num_moves; played++) {
+      if (!move_gen_find_packed(board, snapshot->moves[played],
+                                &moves[played]))
+        break;
+      board_make_move(board, &moves[played], &undo[played]);
+    }
+    for (i = played - 1; i >= 0; i--)
+      board_unmake_move(board, &moves[i], &undo[i]);
+    if (played == snapshot->num_moves)
+      length = pgn_write_game(board, tags, 7, moves, played,
+                              PGN_RESULT_UNKNOWN, text, size);
+  }
+
+  if (length >= 0 && !write_file(request->path, text, length)) length = -1;
+  if (board) board_destroy(board);
+  free(undo);
+  free(moves);
+  free(text);
+  return length >= 0 ? 0 : -1;
+}
+
+/*
+ *   load
+ * Read the first game of a PGN file into the request's snapshot
+ *   @return 0 on success, -1 on failure
+ */
+static int load(game_io_request_t *request)
+{
+  pgn_file_t *file = pgn_open(request->path);
+
+  if (!file) return -1;
+  request->status = -1;
+  pgn_read(file, true, first_game, request);
+  pgn_close(file);
+  return request->status;
+}
+
+/*
+ *   first_game
+ * pgn_read callback: keep the first game, if it decodes completely
+ *   @return false, to stop reading
+ */
+static bool first_game(const pgn_game_t *game, void *user)
+{
+  game_io_request_t *request = user;
+  int i;
+
+  if (game->error || board_pack(game->board, &request->snapshot.start) != 0)
+    return false;
+  request->snapshot.moves = malloc((game->num_moves + 1) * sizeof(uint16_t) );
+  if (!request->snapshot.moves) return false;
+  for (i = 0; i < game->num_moves; i++)
+    request->snapshot.moves[i] = move_pack((move_t *)&game->moves[i]);
+  request->snapshot.num_moves = game->num_moves;
+  request->status = 0;
+  return false;
+}
+
+/*
+ *   write_file
+ * Write a file under a temporary name, sync it and rename it into place,
+ * so an interrupted save never leaves half a game behind
+ *   @return true on success
+ */
+static bool write_file(const char *path, const char *data, size_t size)
+{
+  char temp[GAME_IO_MAX_PATH + 8];
+  ssize_t written;
+  bool ok = true;
+  int fd;
+
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+  if ((fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) return false;
+  while (size > 0 && ok) {
+    written = write(fd, data, size);
+    ok = written > 0;
+    if (ok) {
+      data += written;
+      size -= written;
+    }
+  }
+  ok = ok && fsync(fd) == 0;
+  if (close(fd) != 0) ok = false;
+  if (!ok || rename(temp, path) != 0) {
+    remove(temp);
+    return false;
+  }
+  return true;
+}
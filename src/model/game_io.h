@@ -0,0 +1,124 @@
+#ifndef _GAME_IO_H
+#define _GAME_IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "board.h"
+#include "history_stack.h"
+#include "journal.h"
+#include "queue.h"
+
+/*
+ * Saving and loading games on a background thread, so that a slow disk
+ * never stalls the thread asking.  A save takes a snapshot of the game
+ * (its packed start position and moves) on the calling thread, which is
+ * cheap, and the worker turns it into PGN and writes it.  A load reads
+ * the first game of a PGN file into a snapshot on the worker.
+ *
+ * Finished requests come back through a lock-free queue: the requesting
+ * thread polls it whenever convenient (the display does so from a GLUT
+ * timer) and applies a loaded snapshot itself, since only it may touch
+ * its board.  The worker sleeps while there is nothing to do.
+ *
+ * The worker also does a background journal's disk work (see journal.h):
+ * its fsyncs, on a duplicate of the journal's descriptor, and the
+ * writing of its compactions, from a snapshot like a save's.
+ */
+
+#define GAME_IO_DEFAULT_PATH "jegChess-saved.pgn"
+#define GAME_IO_MAX_PATH     4096
+#define GAME_IO_QUEUE_SIZE   16
+
+enum game_io_type {
+  GAME_IO_SAVE,
+  GAME_IO_LOAD,
+  GAME_IO_JOURNAL_SYNC,
+  GAME_IO_JOURNAL_COMPACT
+};
+typedef enum game_io_type game_io_type_t;
+
+/* A game reduced to plain data, safe to hand between threads */
+struct game_snapshot {
+  board_packed_t start;
+  uint16_t *moves;            /* (strong) Packed, see move_pack */
+  int num_moves;
+};
+typedef struct game_snapshot game_snapshot_t;
+
+struct game_io_request {
+  game_io_type_t type;
+  char path[GAME_IO_MAX_PATH];
+  game_snapshot_t snapshot;   /* Saved from, or loaded into */
+  int status;                 /* 0 once done successfully, -1 on failure */
+  int fd;                     /* (strong) Journal sync: what to fsync */
+  uint32_t generation;        /* Journal compaction: the game's, when taken */
+};
+typedef struct game_io_request game_io_request_t;
+
+struct game_io {
+  queue_t *requests;          /* (strong) Waiting for the worker */
+  queue_t *done;              /* (strong) Waiting to be polled */
+  pthread_t thread;
+  pthread_mutex_t lock;       /* Guards sleeping on 'wake' */
+  pthread_cond_t wake;
+  atomic_bool closing;
+  atomic_int pending;         /* Requests not yet polled */
+};
+typedef struct game_io game_io_t;
+
+/* Start the worker thread.  Returns NULL on failure. */
+game_io_t* game_io_init(void);
+
+/* Finish the requests already made, stop the worker and cleanup.
+ * Requests not yet polled are dropped.
+ */
+void game_io_destroy(game_io_t *io);
+
+/* Snapshot the game on 'board' and queue it to be saved as PGN at
+ * 'path'.  Returns 0 if queued, -1 on failure (e.g. too many requests
+ * in flight).
+ */
+int game_io_save(game_io_t *io, const char *path, board_t *board,
+                 history_stack_t *stack);
+
+/* Queue the first game of the PGN file at 'path' to be loaded.
+ * Returns 0 if queued, -1 on failure.
+ */
+int game_io_load(game_io_t *io, const char *path);
+
+/* Take a finished request, or NULL if none has finished.  Never blocks.
+ * Hand it to game_io_release when done with it.
+ */
+game_io_request_t* game_io_poll(game_io_t *io);
+
+/* Whether any request is queued, running or waiting to be polled */
+bool game_io_busy(game_io_t *io);
+
+/* Post the disk work a background journal is due (see journal_due), if
+ * any.  Returns 0 if posted or nothing was due, -1 if it couldn't be
+ * posted (it is due again on the next call).
+ */
+int game_io_journal(game_io_t *io, journal_t *journal);
+
+/* Finish a journal request returned by game_io_poll: put a compaction's
+ * file in place (see journal_install) and post the sync of its
+ * directory.  Returns the request's status, or -1 if the file wasn't
+ * put in place.
+ */
+int game_io_journal_done(game_io_t *io, const game_io_request_t *request,
+                         journal_t *journal);
+
+/* Set up a loaded game: the board gets the start position and the
+ * moves are pushed onto the (cleared) history stack.  Returns 0 on
+ * success, or -1 if a move doesn't play (the moves before it stay).
+ */
+int game_io_apply(const game_io_request_t *request, board_t *board,
+                  history_stack_t *stack);
+
+/* Cleanup a request returned by game_io_poll */
+void game_io_release(game_io_request_t *request);
+
+#endif
@@ -0,0 +1,619 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "game_record.h"
+#include "board.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "piece.h"
+#include "chess.h"
+
+#define VARINT_MAX    10
+#define RANK_BITS     9         /* Ranks of positions with up to 512 moves */
+#define MAX_MOVES     (1 << RANK_BITS)
+#define RESULT_MASK   0x03
+
+/* Ordering keys, see move_key.  Moves with equal keys keep the order
+ * they were generated in.
+ */
+#define KEY_CLASSES   64
+#define KEY_QUIET     16        /* A quiet move gaining nothing */
+#define KEY_CAPTURE   32        /* Captures, 16 classes of them */
+#define KEY_RECAPTURE 48        /* Captures on the square just moved to */
+
+/* Capture classes, indexed with piece_type_t: victims by value, and
+ * attackers the other way round, the king going with the pawn
+ */
+static const int victim_class[6] = { 2, 1, 1, 0, 3, 0 };
+static const int attacker_class[6] = { 1, 2, 2, 3, 0, 3 };
+
+/* Closeness to the centre: 0 on the rim, 3 on the d and e files */
+static const int centre[8] = { 0, 1, 2, 3, 3, 2, 1, 0 };
+
+/* What a pawn push to each file is worth among quiet moves */
+static const int pawn_file[8] = { 0, 1, 3, 4, 4, 3, 1, 0 };
+
+/* The rays out of a square: four along ranks and files, where rooks
+ * pin, then four diagonals, where bishops do
+ */
+static const int ray_dirs[8][2] = {
+  {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+static const piece_type_t ray_slider[8] = {
+  ROOK, ROOK, ROOK, ROOK, BISHOP, BISHOP, BISHOP, BISHOP
+};
+
+/* Bits written most significant first */
+struct bit_writer {
+  uint8_t *out;               /* (weak) */
+  size_t size;
+  size_t length;
+  uint64_t bits;              /* Not yet written, in the low 'count' bits */
+  int count;
+  bool overflow;
+};
+typedef struct bit_writer bit_writer_t;
+
+struct bit_reader {
+  const uint8_t *in;          /* (weak) */
+  const uint8_t *end;
+  uint64_t bits;              /* Not yet read, in the low 'count' bits */
+  int count;
+};
+typedef struct bit_reader bit_reader_t;
+
+/* A keyed move list's moves by key: bucket k chains the moves with the
+ * key k, in generation order
+ */
+struct buckets {
+  uint64_t used;              /* Bit k set if bucket k has moves */
+  int16_t head[KEY_CLASSES];  /* Each used bucket's first move */
+  int16_t next[MAX_MOVES];    /* The next move in its bucket, or -1 */
+};
+typedef struct buckets buckets_t;
+
+/* What legality tests in one position need, worked out on first use */
+struct legality {
+  bool check_known;
+  bool in_check;              /* The mover is in check */
+  bool pins_known;
+  uint64_t pinned;            /* Squares of the mover's pinned pieces */
+};
+typedef struct legality legality_t;
+
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+static board_packed_t start_packed;
+static uint64_t start_hash;
+
+static void start_init(void);
+static bool at_start(board_t *board);
+static int last_square(move_t *moves, int ply);
+static void key_moves(board_t *board, move_list_t *list, int last_to);
+static unsigned int move_key(move_t *move, int last_to, bool queens);
+static void bucket_moves(move_list_t *list, buckets_t *buckets);
+static uint64_t find_pinned(board_t *board);
+static bool is_legal(board_t *board, move_t *move, legality_t *legality);
+static int find_rank(board_t *board, move_list_t *list, uint16_t packed,
+                     unsigned int *rank);
+static move_t* find_ranked(board_t *board, move_list_t *list,
+                           unsigned int rank);
+static void put_golomb(bit_writer_t *writer, unsigned int value);
+static void put_flush(bit_writer_t *writer);
+static bool get_golomb(bit_reader_t *reader, unsigned int *value);
+static size_t put_varint(uint8_t *out, uint64_t value);
+static const uint8_t* get_varint(const uint8_t *in, const uint8_t *end,
+                                 uint64_t *value);
+
+/*
+ *   game_record_encode
+ * Play the game forward, writing each move's rank among the legal moves
+ * of its position, then take the moves back.  The body is written after
+ * a one-byte length and moved up if the length needs more bytes.
+ *   @param board the game's start position (unchanged on return)
+ *   @param moves the game, each legal in turn
+ *   @param num_moves how many plies
+ *   @param result the game's result
+ *   @param buffer where to write the record
+ *   @param size the buffer's size in bytes
+ *   @return the record's length, or -1 on failure
+ */
+int game_record_encode(board_t *board, move_t *moves, int num_moves,
+                       pgn_result_t result, uint8_t *buffer, size_t size)
+{
+  board_undo_t undo[GAME_RECORD_MAX_PLIES];
+  move_t played[GAME_RECORD_MAX_PLIES];
+  uint8_t header[1 + BOARD_PACKED_SIZE + VARINT_MAX], length[VARINT_MAX];
+  size_t header_length = 0, body, prefix;
+  bit_writer_t writer;
+  move_list_t *list;
+  unsigned int rank;
+  int ply, index = 0;
+
+  if (num_moves < 0 || num_moves > GAME_RECORD_MAX_PLIES) return -1;
+
+  /* Result and start position */
+  header[header_length++] = result & RESULT_MASK;
+  if (!at_start(board)) {
+    header[0] |= GAME_RECORD_CUSTOM_START;
+    if (board_pack(board, (board_packed_t *)&header[header_length]) != 0)
+      return -1;
+    header_length += BOARD_PACKED_SIZE;
+  }
+  header_length += put_varint(&header[header_length], num_moves);
+  if (1 + header_length > size) return -1;
+  memcpy(buffer + 1, header, header_length);
+
+  writer.out = buffer + 1 + header_length;
+  writer.size = size - 1 - header_length;
+  writer.length = 0;
+  writer.bits = 0;
+  writer.count = 0;
+  writer.overflow = false;
+
+  if (!(list = move_list_new())) return -1;
+  for (ply = 0; ply < num_moves; ply++) {
+    move_list_clear(list);
+    move_gen_pseudo_legal(board, list);
+    key_moves(board, list, last_square(played, ply));
+    if ((index = find_rank(board, list, move_pack(&moves[ply]), &rank)) < 0)
+      break;
+    put_golomb(&writer, rank);
+    played[ply] = list->moves[index];
+    board_make_move(board, &played[ply], &undo[ply]);
+  }
+  put_flush(&writer);
+  move_list_destroy(list);
+
+  while (ply-- > 0) board_unmake_move(board, &played[ply], &undo[ply]);
+  if (index < 0 || writer.overflow) return -1;
+
+  /* The length goes in front, taking the byte left for it or more */
+  body = header_length + writer.length;
+  prefix = put_varint(length, body);
+  if (prefix + body > size) return -1;
+  if (prefix > 1) memmove(buffer + prefix, buffer + 1, body);
+  memcpy(buffer, length, prefix);
+  return prefix + body;
+}
+
+/*
+ *   game_record_decode
+ * Set up the record's start position and replay its codes, generating
+ * and ordering the moves of each position exactly as the encoder did
+ *   @param board set to the game's start position
+ *   @param data the record
+ *   @param size bytes available at 'data'
+ *   @param moves receives the game
+ *   @param max_moves room in 'moves'
+ *   @param result receives the result, or NULL
+ *   @param consumed receives the record's length, or NULL
+ *   @return the number of plies, or -1 on failure
+ */
+int game_record_decode(board_t *board, const uint8_t *data, size_t size,
+                       move_t *moves, int max_moves, pgn_result_t *result,
+                       size_t *consumed)
+{
+  board_undo_t undo[GAME_RECORD_MAX_PLIES];
+  const uint8_t *p, *end = data + size;
+  uint64_t body, num_moves;
+  bit_reader_t reader;
+  move_list_t *list;
+  unsigned int rank;
+  move_t *move;
+  bool failed = false;
+  int ply, flags;
+
+  pthread_once(&start_once, start_init);
+  if (!(p = get_varint(data, end, &body)) || body > (uint64_t)(end - p) ||
+      body < 2)
+    return -1;
+  end = p + body;
+
+  /* Result and start position */
+  flags = *p++;
+  if (flags & GAME_RECORD_CUSTOM_START) {
+    if (end - p < BOARD_PACKED_SIZE ||
+        board_unpack(board, (const board_packed_t *)p) != 0)
+      return -1;
+    p += BOARD_PACKED_SIZE;
+  }
+  else if (!at_start(board) && board_unpack(board, &start_packed) != 0) {
+    return -1;
+  }
+  if (!(p = get_varint(p, end, &num_moves)) ||
+      num_moves > (uint64_t)max_moves || num_moves > GAME_RECORD_MAX_PLIES)
+    return -1;
+
+  reader.in = p;
+  reader.end = end;
+  reader.bits = 0;
+  reader.count = 0;
+
+  if (!(list = move_list_new())) return -1;
+  for (ply = 0; ply < (int)num_moves; ply++) {
+    move_list_clear(list);
+    move_gen_pseudo_legal(board, list);
+    key_moves(board, list, last_square(moves, ply));
+    if (!get_golomb(&reader, &rank) ||
+        !(move = find_ranked(board, list, rank))) {
+      failed = true;
+      break;
+    }
+    moves[ply] = *move;
+    board_make_move(board, &moves[ply], &undo[ply]);
+  }
+  move_list_destroy(list);
+
+  while (ply-- > 0) board_unmake_move(board, &moves[ply], &undo[ply]);
+  if (failed) return -1;
+
+  if (result) *result = flags & RESULT_MASK;
+  if (consumed) *consumed = end - data;
+  return num_moves;
+}
+
+/*
+ *   start_init
+ * Remember the standard start position, packed and hashed, once
+ */
+static void start_init(void)
+{
+  board_t *board = board_init_start();
+
+  board_pack(board, &start_packed);
+  start_hash = board->hash;
+  board_destroy(board);
+}
+
+/*
+ *   at_start
+ * Check whether a board holds the standard start position, move
+ * counters included
+ */
+static bool at_start(board_t *board)
+{
+  pthread_once(&start_once, start_init);
+  return board->hash == start_hash && board->halfmove_clock == 0 &&
+    board->fullmove_number == 1;
+}
+
+/*
+ *   last_square
+ * The square the previous move went to, or NO_SQUARE on the first ply
+ */
+static int last_square(move_t *moves, int ply)
+{
+  if (ply == 0) return NO_SQUARE;
+  return SQUARE_INDEX(moves[ply - 1].to_square->rank,
+                      moves[ply - 1].to_square->file);
+}
+
+/*
+ *   key_moves
+ * Give every move its ordering key (see move_key).  Whether the enemy
+ * still has a queen is looked up once for the whole list.
+ */
+static void key_moves(board_t *board, move_list_t *list, int last_to)
+{
+  bool queens = MATERIAL_KEY_COUNT(board->material_key,
+                                   OTHER_COLOR(board->moves_next), QUEEN) > 0;
+  int i;
+
+  for (i = 0; i < list->num_moves; i++)
+    list->moves[i].score = move_key(&list->moves[i], last_to, queens);
+}
+
+/*
+ *   move_key
+ * Guess how likely a move is to be played, from the moving piece and the
+ * capture or promotion alone: recaptures first, then queen promotions and
+ * captures by value (most valuable victim, then cheapest attacker), then
+ * castling, developing and centralizing moves.  Under-promotions come
+ * last, and king walks while the enemy has a queen just before them.
+ *   @param last_to the square the previous move went to, or NO_SQUARE
+ *   @param queens whether the enemy has a queen
+ *   @return a key below KEY_CLASSES; higher keys are tried first
+ */
+static unsigned int move_key(move_t *move, int last_to, bool queens)
+{
+  piece_t *piece = move->from_square->piece;
+  int from_rank = move->from_square->rank, from_file = move->from_square->file;
+  int to_rank = move->to_square->rank, to_file = move->to_square->file;
+  int gain = centre[to_rank] + centre[to_file] -
+    centre[from_rank] - centre[from_file];
+  int victim;
+
+  if ((move->flags & MOVE_PROMOTION) && move->promotion != QUEEN) return 0;
+  if (move->flags & MOVE_CAPTURE) {
+    if (move->flags & MOVE_PROMOTION) return KEY_CLASSES - 1;
+    victim = move->flags & MOVE_EN_PASSANT ? PAWN :
+      move->to_square->piece->type;
+    return (SQUARE_INDEX(to_rank, to_file) == last_to ? KEY_RECAPTURE :
+            KEY_CAPTURE) + 4 * victim_class[victim] +
+      attacker_class[piece->type];
+  }
+  if (move->flags & MOVE_PROMOTION) return KEY_RECAPTURE - 1;
+  if (move->flags & MOVE_CASTLE) return KEY_CAPTURE - 1;
+
+  switch (piece->type) {
+  case KNIGHT:
+  case BISHOP:
+    return KEY_QUIET + gain +
+      (from_rank == (piece->color == WHITE ? 0 : 7) ? 7 : 0);
+  case QUEEN:
+  case ROOK:
+    return KEY_QUIET + (centre[to_file] - centre[from_file]) / 2;
+  case KING:
+    return queens ? 1 : KEY_QUIET + gain;
+  default:
+    return KEY_QUIET + pawn_file[to_file];
+  }
+}
+
+/*
+ *   bucket_moves
+ * Sort a keyed list into its buckets, going through it backwards so that
+ * each bucket's chain comes out in generation order
+ */
+static void bucket_moves(move_list_t *list, buckets_t *buckets)
+{
+  unsigned int key;
+  int i;
+
+  buckets->used = 0;
+  for (i = list->num_moves - 1; i >= 0; i--) {
+    key = list->moves[i].score;
+    buckets->next[i] = buckets->used >> key & 1 ? buckets->head[key] : -1;
+    buckets->head[key] = i;
+    buckets->used |= (uint64_t)1 << key;
+  }
+}
+
+/*
+ *   find_pinned
+ * Find the mover's pieces pinned to its king: walk each ray out of the
+ * king past the first piece, if it is the mover's, to the next one
+ *   @return a mask of their squares (bit SQUARE_INDEX)
+ */
+static uint64_t find_pinned(board_t *board)
+{
+  color_t us = board->moves_next;
+  piece_t *king = board->kings[us], *piece, *shield;
+  uint64_t pinned = 0;
+  int d, rank, file;
+
+  for (d = 0; d < 8; d++) {
+    shield = NULL;
+    for (rank = king->rank + ray_dirs[d][0],
+           file = king->file + ray_dirs[d][1];
+         rank >= 0 && rank < BOARD_SIZE && file >= 0 && file < BOARD_SIZE;
+         rank += ray_dirs[d][0], file += ray_dirs[d][1]) {
+      if (!(piece = board->spaces[rank][file]->piece)) continue;
+      if (!shield && piece->color == us) {
+        shield = piece;
+        continue;
+      }
+      if (shield && piece->color != us && (piece->type == QUEEN ||
+                                          piece->type == ray_slider[d]))
+        pinned |= (uint64_t)1 << SQUARE_INDEX(shield->rank, shield->file);
+      break;
+    }
+  }
+  return pinned;
+}
+
+/*
+ *   is_legal
+ * Check that a pseudo-legal move doesn't leave the mover in check.
+ * Castling is generated legal, and a king move is legal if its square
+ * isn't attacked once the king is lifted off its own.  Out of check,
+ * only en passant and moves of pinned pieces can expose the king, and
+ * only pieces sharing a line with it can be pinned, so the position's
+ * pins are looked for on the first such move.  Those moves, and every
+ * move in check, are played.
+ *   @param legality what is known of the position's check and pins
+ */
+static bool is_legal(board_t *board, move_t *move, legality_t *legality)
+{
+  square_t *from = move->from_square;
+  piece_t *king = board->kings[board->moves_next];
+  int rank = from->rank - king->rank, file = from->file - king->file;
+  board_undo_t undo;
+  bool legal;
+
+  if (move->flags & MOVE_CASTLE) return true;
+  if (from->piece == king) {
+    from->piece = NULL;
+    legal = !move_gen_square_attacked(board, move->to_square->rank,
+                                      move->to_square->file,
+                                      OTHER_COLOR(board->moves_next));
+    from->piece = king;
+    return legal;
+  }
+
+  if (!legality->check_known) {
+    legality->in_check = move_gen_in_check(board, board->moves_next);
+    legality->check_known = true;
+  }
+  if (!legality->in_check && !(move->flags & MOVE_EN_PASSANT)) {
+    if (rank != 0 && file != 0 && rank != file && rank != -file) return true;
+    if (!legality->pins_known) {
+      legality->pinned = find_pinned(board);
+      legality->pins_known = true;
+    }
+    if (!(legality->pinned & (uint64_t)1 << SQUARE_INDEX(from->rank,
+                                                          from->file)))
+      return true;
+  }
+
+  board_make_move(board, move, &undo);
+  legal = !move_gen_left_in_check(board);
+  board_unmake_move(board, move, &undo);
+  return legal;
+}
+
+/*
+ *   find_rank
+ * Find a move in a keyed list and count the legal moves ordered before
+ * it.  Only those are tried for legality, usually a handful.
+ *   @param packed the move, see move_pack
+ *   @param rank receives the count
+ *   @return the move's index in the list, or -1 if it isn't legal
+ */
+static int find_rank(board_t *board, move_list_t *list, uint16_t packed,
+                     unsigned int *rank)
+{
+  legality_t legality = { false, false, false, 0 };
+  unsigned int key;
+  int i, index = -1;
+
+  if (list->num_moves > MAX_MOVES) return -1;
+  for (i = 0; i < list->num_moves && index < 0; i++)
+    if (move_pack(&list->moves[i]) == packed) index = i;
+  if (index < 0 || !is_legal(board, &list->moves[index], &legality))
+    return -1;
+
+  key = list->moves[index].score;
+  *rank = 0;
+  for (i = 0; i < list->num_moves; i++)
+    if ((list->moves[i].score > key ||
+         (list->moves[i].score == key && i < index)) &&
+        is_legal(board, &list->moves[i], &legality))
+      (*rank)++;
+  return index;
+}
+
+/*
+ *   find_ranked
+ * Take moves from a keyed list best first, skipping illegal ones, until
+ * the one with the given rank.  Only the buckets down to it are walked.
+ *   @return the move, or NULL if there are too few legal moves
+ */
+static move_t* find_ranked(board_t *board, move_list_t *list,
+                           unsigned int rank)
+{
+  legality_t legality = { false, false, false, 0 };
+  buckets_t buckets;
+  move_t *move;
+  int key, i;
+
+  if (list->num_moves > MAX_MOVES) return NULL;
+  bucket_moves(list, &buckets);
+  for (key = KEY_CLASSES - 1; key >= 0; key--) {
+    if (!(buckets.used >> key & 1)) continue;
+    for (i = buckets.head[key]; i >= 0; i = buckets.next[i]) {
+      move = &list->moves[i];
+      if (is_legal(board, move, &legality) && rank-- == 0) return move;
+    }
+  }
+  return NULL;
+}
+
+/*
+ *   put_golomb
+ * Write an order-0 Exp-Golomb code: value + 1 in binary, after as many
+ * zeros as it has bits after the first
+ */
+static void put_golomb(bit_writer_t *writer, unsigned int value)
+{
+  uint64_t code = (uint64_t)value + 1;
+  int bits = 0;
+
+  while (code >> bits > 1) bits++;
+  writer->bits = writer->bits << (2 * bits + 1) | code;
+  writer->count += 2 * bits + 1;
+  while (writer->count >= 8) {
+    writer->count -= 8;
+    if (writer->length < writer->size)
+      writer->out[writer->length++] = writer->bits >> writer->count;
+    else
+      writer->overflow = true;
+  }
+  writer->bits &= ((uint64_t)1 << writer->count) - 1;
+}
+
+/*
+ *   put_flush
+ * Write out the last bits, padded with zeros to a byte
+ */
+static void put_flush(bit_writer_t *writer)
+{
+  if (writer->count == 0) return;
+  if (writer->length < writer->size)
+    writer->out[writer->length++] = writer->bits << (8 - writer->count);
+  else
+    writer->overflow = true;
+  writer->count = 0;
+}
+
+/*
+ *   get_golomb
+ * Read a code written by put_golomb
+ *   @return false if the record ends first
+ */
+static bool get_golomb(bit_reader_t *reader, unsigned int *value)
+{
+  int zeros = 0;
+
+  for (;;) {
+    if (reader->count == 0) {
+      if (reader->in == reader->end) return false;
+      reader->bits = *reader->in++;
+      reader->count = 8;
+    }
+    if (reader->bits >> (reader->count - 1) & 1) break;
+    reader->count--;
+    if (++zeros > RANK_BITS) return false;
+  }
+
+  while (reader->count < zeros + 1) {
+    if (reader->in == reader->end) return false;
+    reader->bits = reader->bits << 8 | *reader->in++;
+    reader->count += 8;
+  }
+  reader->count -= zeros + 1;
+  *value = (reader->bits >> reader->count) - 1;
+  reader->bits &= ((uint64_t)1 << reader->count) - 1;
+  return true;
+}
+
+/*
+ *   put_varint
+ * Write a value seven bits per byte, low bits first, with the top bit
+ * of each byte set when another follows
+ *   @return the number of bytes written
+ */
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+  size_t length = 0;
+
+  while (value >= 0x80) {
+    out[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+/*
+ *   get_varint
+ * Read a value written by put_varint, without reading past 'end'
+ *   @return the byte after it, or NULL if it's cut off
+ */
+static const uint8_t* get_varint(const uint8_t *in, const uint8_t *end,
+                                 uint64_t *value)
+{
+  int shift = 0;
+
+  *value = 0;
+  do {
+    if (in == end || shift >= 64) return NULL;
+    *value |= (uint64_t)(*in & 0x7F) << shift;
+    shift += 7;
+  } while (*in++ & 0x80);
+  return in;
+}
@@ -0,0 +1,59 @@
+#ifndef _GAME_RECORD_H
+#define _GAME_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "board.h"
+#include "move.h"
+#include "pgn.h"
+
+/*
+ * Compact game records, small enough to keep a whole game archive in
+ * memory.  A move is stored as its rank among the legal moves of its
+ * position, with the moves ordered by a cheap guess at how likely each
+ * is to be played, so played moves usually rank near the top.  The
+ * guess is a small key read from tables by the moving piece and the
+ * capture or promotion (recaptures, captures by value, castling,
+ * development, ...), with no look at what attacks what; moves with
+ * equal keys keep the move generator's order.  Ranks are written as
+ * Exp-Golomb codes: rank 0 takes one bit, ranks 1-2 three bits, ranks
+ * 3-6 five.
+ *
+ * A record is:
+ *   varint   length of the rest of the record, so records concatenate
+ *   byte     result (pgn_result_t, bits 0-1) | GAME_RECORD_CUSTOM_START
+ *   32 bytes board_packed_t start position, only with CUSTOM_START
+ *   varint   number of plies
+ *   bits     one code per ply, most significant bit first, padded with
+ *            zeros to a whole byte
+ *
+ * The ordering is part of the format: changing move_key in
+ * game_record.c, or the order moves are generated in, makes old records
+ * unreadable.
+ */
+
+#define GAME_RECORD_MAX_PLIES    PGN_MAX_PLIES
+#define GAME_RECORD_CUSTOM_START 0x04
+
+/* Encode a game played from the board's position.  The board is played
+ * forward and back again, so it is unchanged on return.
+ * Returns the record's length in bytes, or -1 if a move is illegal, the
+ * game is longer than GAME_RECORD_MAX_PLIES or the record doesn't fit in
+ * 'size' bytes.
+ */
+int game_record_encode(board_t *board, move_t *moves, int num_moves,
+                       pgn_result_t result, uint8_t *buffer, size_t size);
+
+/* Decode the record at the start of 'data'.  The board is set to the
+ * game's start position and left there; the moves' squares point into
+ * it, so the game can be replayed with board_make_move.  'result' and
+ * 'consumed' (the record's length) may be NULL.
+ * Returns the number of plies, or -1 if the record is truncated,
+ * malformed or has more than 'max_moves' plies.
+ */
+int game_record_decode(board_t *board, const uint8_t *data, size_t size,
+                       move_t *moves, int max_moves, pgn_result_t *result,
+                       size_t *consumed);
+
+#endif
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "history_stack.h"
+#include "board.h"
+#include "move.h"
+#include "piece.h"
+#include "chess.h"
+
+static void entry_move(board_t *board, history_entry_t *entry, move_t *move);
+
+/*
+ *   history_stack_init
+ * Create an empty history stack, allocating every entry up front
+ *   @param capacity the most moves the stack will hold
+ *   @return a * to the new history_stack_t, or NULL on failure
+ */
+history_stack_t* history_stack_init(int capacity)
+{
+  history_stack_t *stack;
+
+  if (capacity < 1) return NULL;
+  stack = malloc(sizeof(history_stack_t) );
+  if (!stack) return NULL;
+
+  stack->entries = malloc(capacity * sizeof(history_entry_t) );
+  stack->hashes = malloc(capacity * sizeof(uint64_t) );
+  if (!stack->entries || !stack->hashes) {
+    history_stack_destroy(stack);
+    return NULL;
+  }
+  stack->capacity = capacity;
+  stack->count = 0;
+  stack->redo_count = 0;
+  return stack;
+}
+
+/*
+ *   history_stack_destroy
+ * Cleanup a history stack
+ *   @param stack the history_stack_t to destroy
+ */
+void history_stack_destroy(history_stack_t *stack)
+{
+  if (!stack) return;
+  free(stack->entries);
+  free(stack->hashes);
+  free(stack);
+}
+
+/*
+ *   history_stack_clear
+ * Forget every move, undone ones included
+ *   @param stack the history_stack_t to clear
+ */
+void history_stack_clear(history_stack_t *stack)
+{
+  stack->count = 0;
+  stack->redo_count = 0;
+}
+
+/*
+ *   history_stack_push
+ * Play a move and record it on top of the stack.  A new move ends the
+ * line that undone moves belonged to, so they can't be redone any more.
+ *   @param stack the game's history
+ *   @param board the game's board
+ *   @param move a legal move in the board's position
+ *   @return 0 on success, -1 if the stack is full
+ */
+int history_stack_push(history_stack_t *stack, board_t *board, move_t *move)
+{
+  history_entry_t *entry;
+
+  if (stack->count == stack->capacity) return -1;
+  entry = &stack->entries[stack->count];
+  entry->move = move_pack(move);
+  entry->flags = move->flags;
+  stack->hashes[stack->count] = board->hash;
+  board_make_move(board, move, &entry->undo);
+
+  stack->count++;
+  stack->redo_count = 0;
+  return 0;
+}
+
+/*
+ *   history_stack_undo
+ * Take back the top move
+ *   @param stack the game's history
+ *   @param board the game's board
+ *   @return true if a move was taken back
+ */
+bool history_stack_undo(history_stack_t *stack, board_t *board)
+{
+  history_entry_t *entry;
+  move_t move;
+
+  if (stack->count == 0) return false;
+  entry = &stack->entries[--stack->count];
+  entry_move(board, entry, &move);
+  board_unmake_move(board, &move, &entry->undo);
+  stack->redo_count++;
+  return true;
+}
+
+/*
+ *   history_stack_redo
+ * Play the last undone move again.  Its entry is still in place above
+ * the top of the stack; replaying refills its undo record.
+ *   @param stack the game's history
+ *   @param board the game's board
+ *   @return true if a move was played
+ */
+bool history_stack_redo(history_stack_t *stack, board_t *board)
+{
+  history_entry_t *entry;
+  move_t move;
+
+  if (stack->redo_count == 0) return false;
+  entry = &stack->entries[stack->count];
+  entry_move(board, entry, &move);
+  stack->hashes[stack->count] = board->hash;
+  board_make_move(board, &move, &entry->undo);
+  stack->count++;
+  stack->redo_count--;
+  return true;
+}
+
+/*
+ *   history_stack_last
+ * Rebuild the move on top of the stack, e.g. to highlight it
+ *   @param stack the game's history
+ *   @param board the board the moves were played on
+ *   @param move receives the move
+ *   @return false if no move has been played
+ */
+bool history_stack_last(history_stack_t *stack, board_t *board, move_t *move)
+{
+  if (stack->count == 0) return false;
+  entry_move(board, &stack->entries[stack->count - 1], move);
+  return true;
+}
+
+/*
+ *   history_stack_pack_start
+ * Pack the game's start position.  The undone moves stay above the top
+ * of the stack, so redoing as many as were undone restores the game
+ * exactly, whatever could already be redone included.
+ *   @param stack the game's history
+ *   @param board the game's board (back where it was on return)
+ *   @param packed receives the start position
+ *   @return 0 on success, -1 if board_pack fails
+ */
+int history_stack_pack_start(history_stack_t *stack, board_t *board,
+                             board_packed_t *packed)
+{
+  int i, count = stack->count, status;
+
+  for (i = 0; i < count; i++) history_stack_undo(stack, board);
+  status = board_pack(board, packed);
+  for (i = 0; i < count; i++) history_stack_redo(stack, board);
+  return status;
+}
+
+/*
+ *   history_stack_draw
+ * Check the board's position for a draw the players can claim.  Only
+ * positions since the last capture or pawn move are scanned.
+ *   @param stack the game's history
+ *   @param board the game's board
+ *   @return the reason for the draw, or HISTORY_NO_DRAW
+ */
+history_draw_t history_stack_draw(history_stack_t *stack, board_t *board)
+{
+  if (board->halfmove_clock >= 100) return HISTORY_DRAW_FIFTY_MOVES;
+  if (history_stack_repeated(stack->hashes, stack->count,
+                             stack->count - board->halfmove_clock,
+                             board->hash, 2))
+    return HISTORY_DRAW_REPETITION;
+  return HISTORY_NO_DRAW;
+}
+
+/*
+ *   history_stack_repeated
+ * Count earlier occurrences of a position, newest first, stopping as
+ * soon as there are enough
+ *   @param hashes position hashes, oldest first
+ *   @param count how many hashes; the last is the position before the
+ *          current one
+ *   @param oldest the first index that may be compared
+ *   @param hash the current position
+ *   @param times how many earlier occurrences to look for
+ *   @return true if there are at least 'times'
+ */
+bool history_stack_repeated(const uint64_t *hashes, int count, int oldest,
+                            uint64_t hash, int times)
+{
+  int i;
+
+  if (oldest < 0) oldest = 0;
+  for (i = count - 2; i >= oldest; i -= 2) {
+    if (hashes[i] == hash && --times == 0) return true;
+  }
+  return false;
+}
+
+/*
+ *   entry_move
+ * Turn a stored move back into a move_t on the board's squares
+ */
+static void entry_move(board_t *board, history_entry_t *entry, move_t *move)
+{
+  static const piece_type_t promotions[5] = {
+    QUEEN, KNIGHT, BISHOP, ROOK, QUEEN
+  };
+  int from = entry->move & 63, to = (entry->move >> 6) & 63;
+
+  move->from_square = board->spaces[SQUARE_RANK(from)][SQUARE_FILE(from)];
+  move->to_square = board->spaces[SQUARE_RANK(to)][SQUARE_FILE(to)];
+  move->score = 0;
+  move->flags = entry->flags;
+  move->promotion = promotions[entry->move >> 12];
+}
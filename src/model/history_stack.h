@@ -1,5 +1,10 @@
 #ifndef _HISTORY_STACK_H
 #define _HISTORY_STACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "board.h"
+#include "move.h"
 /*
  * The history_stack struct is a data structure used to record chess moves
  * comprising the game's 'history'.  It can be mentally pictured as a CS stack
@@ -7,13 +12,96 @@
  *
  * This model also provides a framework to allow users to 'UNDO' their most
  * recent move by popping the element from the stack.
-*/
+ *
+ * Entries are preallocated and hold only what board_unmake_move needs:
+ * the packed move and the board_undo_t of the position before it.  A
+ * captured piece waits on the board's dead-queue, so undoing and redoing
+ * a move is O(1) and never copies the board.  Undone entries stay above
+ * the top of the stack until a new move replaces them, which is what
+ * makes redo possible.
+ *
+ * The hash of the position before each move is also kept in an array of
+ * its own, oldest first, so repetition scans touch only hashes (and can
+ * hand the array straight to search_set_game_history).
+ */
 
-/* Declare piece struct */
+#define HISTORY_STACK_DEFAULT_CAPACITY 1024
 
-struct history_stack {
+/* Why the game on the board is drawn, if it is */
+enum history_draw {
+  HISTORY_NO_DRAW,
+  HISTORY_DRAW_REPETITION,    /* The position has occurred three times */
+  HISTORY_DRAW_FIFTY_MOVES    /* 100 plies without a capture or pawn move */
+};
+typedef enum history_draw history_draw_t;
 
+/* One played move */
+struct history_entry {
+  board_undo_t undo;
+  uint16_t move;              /* See move_pack */
+  uint8_t flags;              /* MOVE_* bits */
+};
+typedef struct history_entry history_entry_t;
+
+/* Declare history_stack struct */
+
+struct history_stack {
+  history_entry_t *entries;   /* (strong) 'capacity' of them */
+  uint64_t *hashes;           /* (strong) Position hash before each move */
+  int capacity;
+  int count;                  /* Moves played, the top of the stack */
+  int redo_count;             /* Undone moves above the top */
 };
 typedef struct history_stack history_stack_t;
 
+/* Create an empty stack with room for 'capacity' moves */
+history_stack_t* history_stack_init(int capacity);
+
+/* Cleanup all resources held by the stack */
+void history_stack_destroy(history_stack_t *stack);
+
+/* Forget every move (after setting up a new position) */
+void history_stack_clear(history_stack_t *stack);
+
+/* Play a legal move on the board and push it, dropping any undone moves.
+ * Returns 0 on success, -1 (without playing the move) if the stack is
+ * full.
+ */
+int history_stack_push(history_stack_t *stack, board_t *board, move_t *move);
+
+/* Take back the move on top of the stack.  Returns false if there is
+ * none.
+ */
+bool history_stack_undo(history_stack_t *stack, board_t *board);
+
+/* Play the most recently undone move again.  Returns false if there is
+ * none.
+ */
+bool history_stack_redo(history_stack_t *stack, board_t *board);
+
+/* Rebuild the move on top of the stack ('board' must be the board the
+ * stack was played on).  Returns false if the stack is empty.
+ */
+bool history_stack_last(history_stack_t *stack, board_t *board, move_t *move);
+
+/* Pack the position the game started from, by taking every move back
+ * and replaying them.  Returns 0 on success, -1 if it can't be packed.
+ */
+int history_stack_pack_start(history_stack_t *stack, board_t *board,
+                             board_packed_t *packed);
+
+/* Check whether the game is drawn by threefold repetition or the
+ * fifty-move rule
+ */
+history_draw_t history_stack_draw(history_stack_t *stack, board_t *board);
+
+/* Check whether 'hash' occurs at least 'times' times in 'hashes[oldest ..
+ * count - 2]', stepping back two at a time so that only positions with
+ * the same side to move are compared.  'oldest' is where the last
+ * capture or pawn move happened; nothing before it can repeat.  The
+ * search calls this at every node with 'times' 1.
+ */
+bool history_stack_repeated(const uint64_t *hashes, int count, int oldest,
+                            uint64_t hash, int times);
+
 #endif
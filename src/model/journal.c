@@ -0,0 +1,567 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "board.h"
+#include "move.h"
+#include "move_gen.h"
+#include "history_stack.h"
+
+#define RECORD_MOVE  'M'
+#define RECORD_UNDO  'U'
+#define HEADER_CHECK_INDEX 0xFFFFFFFFu
+
+static int recover(journal_t *journal, const uint8_t *data, size_t size);
+static int append(journal_t *journal, int type, uint16_t move);
+static int write_snapshot(journal_t *journal);
+static int put_in_place(journal_t *journal, const char *temp, int records);
+static void sync_directory(const char *path);
+static bool write_all(int fd, const uint8_t *data, size_t size);
+static uint8_t* read_all(int fd, size_t *size);
+static void put_record(uint8_t *out, uint32_t index, int type, uint16_t move);
+static uint32_t check(uint32_t index, const uint8_t *data, size_t size);
+static void put_u32(uint8_t *out, uint32_t value);
+static uint32_t get_u32(const uint8_t *in);
+
+/*
+ *   journal_open
+ * Open a journal, replaying an existing one or snapshotting the game on
+ * the board into a new one
+ *   @param path the journal file
+ *   @param board the game's board
+ *   @param stack the game's history
+ *   @return a * to the new journal_t, or NULL on failure
+ */
+journal_t* journal_open(const char *path, board_t *board,
+                        history_stack_t *stack)
+{
+  journal_t *journal;
+  uint8_t *data;
+  size_t size;
+  int fd;
+
+  if (strlen(path) >= JOURNAL_MAX_PATH) return NULL;
+  journal = malloc(sizeof(journal_t) );
+  if (!journal) return NULL;
+  strcpy(journal->path, path);
+  journal->fd = -1;
+  journal->board = board;
+  journal->stack = stack;
+  journal->records = 0;
+  journal->unsynced = 0;
+  journal->recovered = 0;
+  journal->stale = false;
+  journal->background = false;
+  journal->compacting = false;
+  journal->generation = 0;
+
+  if ((fd = open(path, O_RDWR)) >= 0) {
+    data = read_all(fd, &size);
+    if (!data || recover(journal, data, size) != 0 ||
+        ftruncate(fd, JOURNAL_HEADER_SIZE +
+                  (off_t)journal->records * JOURNAL_RECORD_SIZE) != 0 ||
+        fsync(fd) != 0) {
+      free(data);
+      close(fd);
+      free(journal);
+      return NULL;
+    }
+    free(data);
+    close(fd);
+    journal->fd = open(path, O_WRONLY | O_APPEND);
+  }
+  else if (errno == ENOENT) {
+    write_snapshot(journal);
+  }
+  if (journal->fd < 0) {
+    free(journal);
+    return NULL;
+  }
+  return journal;
+}
+
+/*
+ *   journal_close
+ * Sync the last records and release the journal
+ *   @param journal the journal to close
+ *   @return 0 on success, -1 if the last sync failed
+ */
+int journal_close(journal_t *journal)
+{
+  int status;
+
+  if (!journal) return 0;
+  status = journal_sync(journal);
+  if (close(journal->fd) != 0) status = -1;
+  free(journal);
+  return status;
+}
+
+/*
+ *   journal_push
+ * Play a move and append its record.  The move stands even if the
+ * record can't be written (see append).
+ *   @param journal the game's journal
+ *   @param move a legal move on the journal's board
+ *   @return 0 if the move was played, -1 if the stack is full
+ */
+int journal_push(journal_t *journal, move_t *move)
+{
+  uint16_t packed = move_pack(move);
+
+  if (history_stack_push(journal->stack, journal->board, move) != 0)
+    return -1;
+  journal->generation++;
+  append(journal, RECORD_MOVE, packed);
+  return 0;
+}
+
+/*
+ *   journal_undo
+ * Take back a move and append an undo record
+ *   @param journal the game's journal
+ *   @return true if a move was taken back, logged or not
+ */
+bool journal_undo(journal_t *journal)
+{
+  if (!history_stack_undo(journal->stack, journal->board)) return false;
+  journal->generation++;
+  append(journal, RECORD_UNDO, MOVE_NONE);
+  return true;
+}
+
+/*
+ *   journal_redo
+ * Replay an undone move.  It is logged as an ordinary move: after a
+ * crash only the line on the board is recovered, not what could have
+ * been redone.
+ *   @param journal the game's journal
+ *   @return true if a move was replayed, logged or not
+ */
+bool journal_redo(journal_t *journal)
+{
+  move_t move;
+
+  if (!history_stack_redo(journal->stack, journal->board)) return false;
+  journal->generation++;
+  history_stack_last(journal->stack, journal->board, &move);
+  append(journal, RECORD_MOVE, move_pack(&move));
+  return true;
+}
+
+/*
+ *   journal_reset
+ * Forget the moves and make the board's position the new start
+ *   @param journal the game's journal
+ *   @return 0 on success, -1 on failure
+ */
+int journal_reset(journal_t *journal)
+{
+  history_stack_clear(journal->stack);
+  journal->generation++;
+  return journal_compact(journal);
+}
+
+/*
+ *   journal_compact
+ * Replace the journal with a snapshot of the current game
+ *   @param journal the game's journal
+ *   @return 0 on success, -1 on failure
+ */
+int journal_compact(journal_t *journal)
+{
+  int old = journal->fd;
+
+  if (write_snapshot(journal) != 0) return -1;
+  close(old);
+  return 0;
+}
+
+/*
+ *   journal_sync
+ * fsync the records written since the last sync, if any
+ *   @param journal the game's journal
+ *   @return 0 on success, -1 on failure
+ */
+int journal_sync(journal_t *journal)
+{
+  if (journal->unsynced == 0) return 0;
+  if (fsync(journal->fd) != 0) return -1;
+  journal->unsynced = 0;
+  return 0;
+}
+
+/*
+ *   journal_invalidate
+ * Note that the game was replaced without going through the journal
+ *   @param journal the game's journal
+ */
+void journal_invalidate(journal_t *journal)
+{
+  journal->stale = true;
+  journal->generation++;
+}
+
+/*
+ *   journal_due
+ * Decide what disk work a journal in the background mode needs.  Only
+ * one compaction is in flight at a time, since they share a file.
+ *   @param journal the game's journal
+ *   @return what to post to the worker, if anything
+ */
+journal_due_t journal_due(const journal_t *journal)
+{
+  if (!journal->compacting &&
+      (journal->stale || journal->records >=
+       (uint32_t)journal->stack->count + JOURNAL_COMPACT_SLACK))
+    return JOURNAL_DUE_COMPACT;
+  if (journal->unsynced >= JOURNAL_SYNC_RECORDS) return JOURNAL_DUE_SYNC;
+  return JOURNAL_DUE_NOTHING;
+}
+
+/*
+ *   journal_temp_path
+ * Name the file a compaction writes
+ *   @param journal the game's journal
+ *   @param path receives the name
+ *   @param size the room in 'path'
+ */
+void journal_temp_path(const journal_t *journal, char *path, size_t size)
+{
+  snprintf(path, size, "%s" JOURNAL_TEMP_SUFFIX, journal->path);
+}
+
+/*
+ *   journal_write_file
+ * Write a header for the start position and a record per move, and
+ * sync the file
+ *   @param path the file to write
+ *   @param start the packed start position
+ *   @param moves the packed moves
+ *   @param num_moves how many moves
+ *   @return 0 on success, -1 on failure (nothing is left behind)
+ */
+int journal_write_file(const char *path, const board_packed_t *start,
+                       const uint16_t *moves, int num_moves)
+{
+  size_t size = JOURNAL_HEADER_SIZE + (size_t)num_moves * JOURNAL_RECORD_SIZE;
+  uint8_t *data;
+  int i, fd;
+  bool ok;
+
+  if (!(data = calloc(size, 1)) ) return -1;
+  memcpy(data, JOURNAL_MAGIC, 4);
+  put_u32(data + 4, JOURNAL_VERSION);
+  memcpy(data + 8, start, sizeof(board_packed_t) );
+  put_u32(data + JOURNAL_HEADER_SIZE - 4,
+          check(HEADER_CHECK_INDEX, data, JOURNAL_HEADER_SIZE - 4));
+  for (i = 0; i < num_moves; i++)
+    put_record(data + JOURNAL_HEADER_SIZE + i * JOURNAL_RECORD_SIZE, i,
+               RECORD_MOVE, moves[i]);
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ok = fd >= 0 && write_all(fd, data, size) && fsync(fd) == 0;
+  if (fd >= 0 && close(fd) != 0) ok = false;
+  free(data);
+  if (!ok) remove(path);
+  return ok ? 0 : -1;
+}
+
+/*
+ *   journal_sync_file
+ * The disk half of a background sync
+ *   @param fd a descriptor of the journal
+ *   @param path the journal, to sync its directory too, or NULL
+ *   @return 0 on success, -1 if the descriptor's fsync failed
+ */
+int journal_sync_file(int fd, const char *path)
+{
+  int status = fsync(fd) == 0 ? 0 : -1;
+
+  if (path) sync_directory(path);
+  return status;
+}
+
+/*
+ *   journal_install
+ * Put a background compaction's file in place, if it still describes
+ * the game
+ *   @param journal the game's journal
+ *   @param written whether the worker wrote the file
+ *   @param generation journal->generation when the snapshot was taken
+ *   @param num_moves the moves in the snapshot
+ *   @return 0 if the file was put in place, -1 if not
+ */
+int journal_install(journal_t *journal, bool written, uint32_t generation,
+                    int num_moves)
+{
+  char temp[JOURNAL_MAX_PATH + sizeof(JOURNAL_TEMP_SUFFIX)];
+  int old = journal->fd;
+
+  journal->compacting = false;
+  journal_temp_path(journal, temp, sizeof(temp));
+  if (!written || generation != journal->generation) {
+    remove(temp);
+    return -1;
+  }
+  if (put_in_place(journal, temp, num_moves) != 0) return -1;
+  close(old);
+  return 0;
+}
+
+/*
+ *   recover
+ * Replay a journal's contents onto the board and history stack.  A bad
+ * header fails; the records are replayed up to the first one that is
+ * cut off, fails its check or isn't a legal move.
+ *   @param data the whole file
+ *   @param size its length
+ *   @return 0 on success, -1 if the header is bad
+ */
+static int recover(journal_t *journal, const uint8_t *data, size_t size)
+{
+  const uint8_t *record;
+  uint16_t packed;
+  move_t move;
+
+  if (size < JOURNAL_HEADER_SIZE || memcmp(data, JOURNAL_MAGIC, 4) ||
+      get_u32(data + 4) != JOURNAL_VERSION ||
+      get_u32(data + JOURNAL_HEADER_SIZE - 4) !=
+        check(HEADER_CHECK_INDEX, data, JOURNAL_HEADER_SIZE - 4) ||
+      board_unpack(journal->board, (const board_packed_t *)(data + 8)) != 0)
+    return -1;
+  history_stack_clear(journal->stack);
+
+  for (record = data + JOURNAL_HEADER_SIZE;
+       record + JOURNAL_RECORD_SIZE <= data + size;
+       record += JOURNAL_RECORD_SIZE) {
+    if (get_u32(record + 4) != check(journal->records, record, 4)) break;
+    packed = record[2] << 8 | record[3];
+    if (record[0] == RECORD_MOVE) {
+      if (!move_gen_find_packed(journal->board, packed, &move) ||
+          history_stack_push(journal->stack, journal->board, &move) != 0)
+        break;
+    }
+    else if (record[0] != RECORD_UNDO ||
+             !history_stack_undo(journal->stack, journal->board)) {
+      break;
+    }
+    journal->records++;
+  }
+  journal->recovered = journal->records;
+  return 0;
+}
+
+/*
+ *   append
+ * Write one record, syncing when a batch is complete and compacting
+ * when the file has grown well past the line it describes (in the
+ * background mode, journal_due reports those instead).  A failed write
+ * may leave part of a record behind, so nothing more is appended after
+ * one: the journal is marked stale and the next record is written as a
+ * snapshot of the whole game instead.
+ *   @return 0 on success, -1 on failure
+ */
+static int append(journal_t *journal, int type, uint16_t move)
+{
+  uint8_t record[JOURNAL_RECORD_SIZE];
+
+  if (journal->stale)
+    return journal->background ? -1 : journal_compact(journal);
+  put_record(record, journal->records, type, move);
+  if (!write_all(journal->fd, record, sizeof(record)) ) {
+    journal->stale = true;
+    return -1;
+  }
+  journal->records++;
+
+  if (journal->background) {
+    journal->unsynced++;
+    return 0;
+  }
+  if (journal->records >=
+      (uint32_t)journal->stack->count + JOURNAL_COMPACT_SLACK)
+    return journal_compact(journal);
+  if (++journal->unsynced >= JOURNAL_SYNC_RECORDS)
+    return journal_sync(journal);
+  return 0;
+}
+
+/*
+ *   write_snapshot
+ * Write the start position and the line on the board to a temporary
+ * file, sync it and rename it over the journal.  On success the
+ * journal's descriptor is the new file; the old one is left open for
+ * the caller to close.
+ *   @return 0 on success, -1 on failure
+ */
+static int write_snapshot(journal_t *journal)
+{
+  history_stack_t *stack = journal->stack;
+  char temp[JOURNAL_MAX_PATH + sizeof(JOURNAL_TEMP_SUFFIX)];
+  board_packed_t start;
+  uint16_t *moves;
+  int i, status = -1;
+
+  if (!(moves = malloc((stack->count + 1) * sizeof(uint16_t)) )) return -1;
+  for (i = 0; i < stack->count; i++) moves[i] = stack->entries[i].move;
+  journal_temp_path(journal, temp, sizeof(temp));
+  if (history_stack_pack_start(stack, journal->board, &start) == 0 &&
+      journal_write_file(temp, &start, moves, stack->count) == 0 &&
+      put_in_place(journal, temp, stack->count) == 0) {
+    sync_directory(journal->path);
+    status = 0;
+  }
+  free(moves);
+  return status;
+}
+
+/*
+ *   put_in_place
+ * Rename a written snapshot over the journal and open it for appending.
+ * If it can't be opened after the rename, the old descriptor is no
+ * longer the journal's file, so the journal is marked stale.
+ *   @param temp the snapshot's file
+ *   @param records the records in it
+ *   @return 0 on success, -1 on failure
+ */
+static int put_in_place(journal_t *journal, const char *temp, int records)
+{
+  int fd;
+
+  if (rename(temp, journal->path) != 0) {
+    remove(temp);
+    return -1;
+  }
+  if ((fd = open(journal->path, O_WRONLY | O_APPEND)) < 0) {
+    journal->stale = true;
+    return -1;
+  }
+  journal->fd = fd;
+  journal->records = records;
+  journal->unsynced = 0;
+  journal->stale = false;
+  return 0;
+}
+
+/*
+ *   sync_directory
+ * fsync the directory holding a file, so a rename in it is durable
+ */
+static void sync_directory(const char *path)
+{
+  char copy[JOURNAL_MAX_PATH];
+  int fd;
+
+  strcpy(copy, path);
+  if ((fd = open(dirname(copy), O_RDONLY)) < 0) return;
+  fsync(fd);
+  close(fd);
+}
+
+/*
+ *   write_all
+ * write() until everything is written or an error other than EINTR
+ */
+static bool write_all(int fd, const uint8_t *data, size_t size)
+{
+  ssize_t written;
+
+  while (size > 0) {
+    written = write(fd, data, size);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+/*
+ *   read_all
+ * Read a whole file into a new buffer
+ *   @param size receives the file's length
+ *   @return the buffer (to free), or NULL on failure
+ */
+static uint8_t* read_all(int fd, size_t *size)
+{
+  struct stat info;
+  uint8_t *data;
+  ssize_t got;
+  size_t length = 0;
+
+  if (fstat(fd, &info) != 0) return NULL;
+  if (!(data = malloc(info.st_size + 1)) ) return NULL;
+  while (length < (size_t)info.st_size) {
+    got = read(fd, data + length, info.st_size - length);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) break;
+    length += got;
+  }
+  *size = length;
+  return data;
+}
+
+/*
+ *   put_record
+ * Fill in a record, its check covering its place in the file
+ */
+static void put_record(uint8_t *out, uint32_t index, int type, uint16_t move)
+{
+  out[0] = type;
+  out[1] = 0;
+  out[2] = move >> 8;
+  out[3] = move & 0xFF;
+  put_u32(out + 4, check(index, out, 4));
+}
+
+/*
+ *   check
+ * A 32-bit FNV-1a hash of some bytes, seeded with an index so a record
+ * only checks out at its own place in the file
+ */
+static uint32_t check(uint32_t index, const uint8_t *data, size_t size)
+{
+  uint32_t hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < 4; i++) {
+    hash ^= (index >> (8 * i)) & 0xFF;
+    hash *= 16777619u;
+  }
+  for (i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*
+ *   put_u32
+ * Write a 32-bit value big-endian
+ */
+static void put_u32(uint8_t *out, uint32_t value)
+{
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+}
+
+/*
+ *   get_u32
+ * Read a big-endian 32-bit value
+ */
+static uint32_t get_u32(const uint8_t *in)
+{
+  return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 |
+         (uint32_t)in[2] << 8 | in[3];
+}
@@ -0,0 +1,150 @@
+#ifndef _JOURNAL_H
+#define _JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "board.h"
+#include "move.h"
+#include "history_stack.h"
+
+/*
+ * An append-only journal of a game: autosave that costs one small write
+ * per move instead of rewriting a board file.
+ *
+ * The file starts with a snapshot: a header holding the packed start
+ * position, followed by a record for every move of the line on the board
+ * when the snapshot was taken.  Every move, undo and redo played through
+ * the journal then appends one JOURNAL_RECORD_SIZE record:
+ *   byte  0     type, 'M' (move) or 'U' (undo)
+ *   byte  1     zero
+ *   bytes 2-3   move_pack, big-endian
+ *   bytes 4-7   check of the record and its position in the file
+ * Records are fsync'd in batches of JOURNAL_SYNC_RECORDS (and by
+ * journal_sync), so a process crash loses nothing and a power cut at
+ * most one batch.  A failed write never takes the move back: the game
+ * goes on, the journal is marked stale and the next record rewrites it
+ * whole as a snapshot instead.
+ *
+ * Opening an existing journal replays it onto the board and history
+ * stack.  A torn or corrupt tail is cut off at the last good record.
+ * Once undos make the file JOURNAL_COMPACT_SLACK records longer than the
+ * line it describes, a fresh snapshot is written under a temporary name
+ * and renamed over the journal.
+ *
+ * A journal in the background mode only ever write()s records itself.
+ * The fsyncs and compactions it is due (journal_due) are left to the
+ * game_io worker: a compaction's file is written and synced there from a
+ * snapshot of the game, and put in place by journal_install back on the
+ * game's thread, unless the game moved on in the meantime.
+ */
+
+#define JOURNAL_DEFAULT_PATH   "jegChess.journal"
+#define JOURNAL_MAGIC          "GJJL"
+#define JOURNAL_VERSION        1
+#define JOURNAL_HEADER_SIZE    (8 + BOARD_PACKED_SIZE + 8)
+#define JOURNAL_RECORD_SIZE    8
+#define JOURNAL_SYNC_RECORDS   16
+#define JOURNAL_COMPACT_SLACK  64
+#define JOURNAL_MAX_PATH       4096
+#define JOURNAL_TEMP_SUFFIX    ".tmp"
+
+/* Disk work a journal in the background mode is due */
+enum journal_due {
+  JOURNAL_DUE_NOTHING,
+  JOURNAL_DUE_SYNC,           /* A batch of records to fsync */
+  JOURNAL_DUE_COMPACT         /* A snapshot to rewrite the file from */
+};
+typedef enum journal_due journal_due_t;
+
+/* Declare journal struct */
+
+struct journal {
+  int fd;                     /* Open for appending */
+  char path[JOURNAL_MAX_PATH];
+  board_t *board;             /* (weak) The game's board */
+  history_stack_t *stack;     /* (weak) The game's moves */
+  uint32_t records;           /* Records after the header */
+  int unsynced;               /* Records written since the last fsync */
+  int recovered;              /* Records replayed by journal_open */
+  bool stale;                 /* A write failed: the file is behind */
+  bool background;            /* Syncs and compactions are left to game_io */
+  bool compacting;            /* A background compaction is in flight */
+  uint32_t generation;        /* Changes to the game, logged or not */
+};
+typedef struct journal journal_t;
+
+/* Open the journal at 'path'.  If it exists the game in it is replayed
+ * onto 'board' and 'stack' (journal->recovered counts the records);
+ * otherwise a new journal is started from the game already on them.
+ * Returns NULL if the file can't be read or written.
+ */
+journal_t* journal_open(const char *path, board_t *board,
+                        history_stack_t *stack);
+
+/* Sync and close the journal.  Returns 0 on success, -1 on an I/O error. */
+int journal_close(journal_t *journal);
+
+/* Play a legal move through the history stack and log it.  Returns 0 if
+ * the move was played, -1 if the stack is full.  Whether it was logged
+ * shows in journal->stale.
+ */
+int journal_push(journal_t *journal, move_t *move);
+
+/* Undo or redo through the history stack and log it.  Returns whether
+ * the board changed: false only if there is nothing to undo or redo.
+ */
+bool journal_undo(journal_t *journal);
+bool journal_redo(journal_t *journal);
+
+/* Start over from the position now on the board, with no moves (a new
+ * game).  Returns 0 on success, -1 on failure.
+ */
+int journal_reset(journal_t *journal);
+
+/* Rewrite the journal as a snapshot of the current game.  Returns 0 on
+ * success, -1 on failure (the old journal is then still in place).
+ */
+int journal_compact(journal_t *journal);
+
+/* Force records written so far to disk.  Returns 0 on success, -1 on
+ * failure.
+ */
+int journal_sync(journal_t *journal);
+
+/* The game on the board was replaced behind the journal's back (e.g. a
+ * loaded game): nothing more is written until a compaction rewrites it.
+ */
+void journal_invalidate(journal_t *journal);
+
+/* The disk work a journal in the background mode is due now */
+journal_due_t journal_due(const journal_t *journal);
+
+/* Where a compaction writes the new file before it is put in place */
+void journal_temp_path(const journal_t *journal, char *path, size_t size);
+
+/* Write a journal file for the game with the packed start position
+ * 'start' and the packed moves 'moves', and fsync it.  Touches nothing
+ * but the file, so any thread may call it.  Returns 0 on success, -1 on
+ * failure.
+ */
+int journal_write_file(const char *path, const board_packed_t *start,
+                       const uint16_t *moves, int num_moves);
+
+/* fsync a descriptor of a journal and, if 'path' is non-NULL, the
+ * directory holding the journal at 'path'.  Any thread may call it.
+ * Returns 0 on success, -1 on failure.
+ */
+int journal_sync_file(int fd, const char *path);
+
+/* Finish a background compaction: if it was 'written' and the game is
+ * still at 'generation', rename the file at journal_temp_path over the
+ * journal, which then holds 'num_moves' records.  Otherwise the file is
+ * removed.  The directory still needs syncing afterwards.  Returns 0 if
+ * the file was put in place, -1 if not.
+ */
+int journal_install(journal_t *journal, bool written, uint32_t generation,
+                    int num_moves);
+
+#endif
@@ -1,8 +1,12 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "move.h"
 #include "square.h"
+#include "piece.h"
+#include "chess.h"
 
 move_t*
 move_init(square_t *from_square, square_t *to_square)
@@ -13,6 +17,8 @@ move_init(square_t *from_square, square_t *to_square)
   new_move->from_square = from_square;
   new_move->to_square = to_square;
   new_move->score = 0;
+  new_move->flags = MOVE_QUIET;
+  new_move->promotion = QUEEN;
   return new_move;
 }
 
@@ -27,3 +33,81 @@ move_set_score(move_t *move, unsigned int score)
 {
   move->score = score;
 }
+
+/*
+ *   move_pack
+ * Squeeze a move into 16 bits for tables and files: 6 bits each for the
+ * from and to squares and 3 bits for the promotion piece (0 = none,
+ * 1 = knight, 2 = bishop, 3 = rook, 4 = queen).
+ *   @param move the move to pack
+ *   @return the packed move
+ */
+uint16_t
+move_pack(move_t *move)
+{
+  uint16_t packed;
+  int promo = 0;
+
+  packed = SQUARE_INDEX(move->from_square->rank, move->from_square->file);
+  packed |= SQUARE_INDEX(move->to_square->rank, move->to_square->file) << 6;
+
+  if (move->flags & MOVE_PROMOTION) {
+    switch (move->promotion) {
+      case KNIGHT: promo = 1; break;
+      case BISHOP: promo = 2; break;
+      case ROOK:   promo = 3; break;
+      default:     promo = 4; break;
+    }
+  }
+  return packed | (promo << 12);
+}
+
+/*
+ *   move_equal
+ * Two moves are equal if they connect the same squares and promote to
+ * the same piece.  Scores and other annotations are ignored.
+ *   @return true if the moves match
+ */
+bool
+move_equal(move_t *move_one, move_t *move_two)
+{
+  if (!move_one || !move_two) return false;
+  return move_pack(move_one) == move_pack(move_two);
+}
+
+/*
+ *   move_to_string
+ * Write a move in the coordinate notation used by UCI
+ *   @param move the move to describe
+ *   @param buffer receives the text; must hold at least 6 chars
+ */
+void
+move_to_string(move_t *move, char *buffer)
+{
+  move_packed_to_string(move_pack(move), buffer);
+}
+
+/*
+ *   move_packed_to_string
+ * Write a packed move in coordinate notation.  MOVE_NONE is written as
+ * "0000", the UCI null move.
+ *   @param packed the packed move (see move_pack)
+ *   @param buffer receives the text; must hold at least 6 chars
+ */
+void
+move_packed_to_string(uint16_t packed, char *buffer)
+{
+  static const char promo_chars[5] = {'\0', 'n', 'b', 'r', 'q'};
+  int from = packed & 63, to = (packed >> 6) & 63, promo = packed >> 12;
+
+  if (packed == MOVE_NONE) {
+    strcpy(buffer, "0000");
+    return;
+  }
+  buffer[0] = 'a' + SQUARE_FILE(from);
+  buffer[1] = '1' + SQUARE_RANK(from);
+  buffer[2] = 'a' + SQUARE_FILE(to);
+  buffer[3] = '1' + SQUARE_RANK(to);
+  buffer[4] = promo <= 4 ? promo_chars[promo] : '\0';
+  buffer[5] = '\0';
+}
@@ -1,7 +1,10 @@
 #ifndef _MOVE_H
 #define _MOVE_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "square.h"
+#include "piece.h"
 /*
  * The 'move' struct encapsulates information concerning a potential chess move.
  * This struct's uses are varied: move enumeration, move ranking, game 'history'
@@ -9,10 +12,23 @@
  * optional pieces of information used only under select circumstances.
  */
 
+/* Special-move flags, OR'd together in move->flags */
+#define MOVE_QUIET        0
+#define MOVE_CAPTURE      1
+#define MOVE_DOUBLE_PUSH  2
+#define MOVE_EN_PASSANT   4
+#define MOVE_CASTLE       8
+#define MOVE_PROMOTION    16
+
+/* Packed moves fit in 16 bits: from | to << 6 | promotion code << 12 */
+#define MOVE_NONE 0
+
 struct move {
   square_t *from_square;  /* Weak ownership */
   square_t *to_square;    /* Weak ownership */
   unsigned int score;
+  int flags;              /* MOVE_* bits */
+  piece_type_t promotion; /* Only meaningful with MOVE_PROMOTION */
 };
 typedef struct move move_t;
 
@@ -27,4 +43,24 @@ move_destroy(move_t *to_destroy);
 /* Set the score for a given move */
 void
 move_set_score(move_t *move, unsigned int score);
+
+/* Pack a move's squares and promotion into 16 bits */
+uint16_t
+move_pack(move_t *move);
+
+/* Check whether two moves go between the same squares (and promote to
+ * the same piece)
+ */
+bool
+move_equal(move_t *move_one, move_t *move_two);
+
+/* Write a move in coordinate notation ("e2e4", "e7e8q") into a buffer of
+ * at least 6 chars
+ */
+void
+move_to_string(move_t *move, char *buffer);
+
+/* Same for a packed move; MOVE_NONE is written as "0000" */
+void
+move_packed_to_string(uint16_t packed, char *buffer);
 #endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "move_cache.h"
+#include "move_gen.h"
+#include "move_list.h"
+#include "board.h"
+#include "chess.h"
+
+static int move_origin(move_t *move);
+static int move_target(move_t *move);
+
+/*
+ *   move_cache_init
+ * Create a cache holding no position yet
+ *   @return a * to the new move_cache_t, or NULL on failure
+ */
+move_cache_t* move_cache_init(void)
+{
+  move_cache_t *cache = malloc(sizeof(move_cache_t) );
+
+  if (!cache) return NULL;
+  cache->legal = move_list_new();
+  if (!cache->legal) {
+    free(cache);
+    return NULL;
+  }
+  cache->valid = false;
+  return cache;
+}
+
+/*
+ *   move_cache_destroy
+ * Cleanup a cache
+ *   @param cache the move_cache_t to destroy
+ */
+void move_cache_destroy(move_cache_t *cache)
+{
+  if (!cache) return;
+  move_list_destroy(cache->legal);
+  free(cache);
+}
+
+/*
+ *   move_cache_invalidate
+ * Forget the cached moves; the board they were generated for changed
+ *   @param cache the cache to invalidate
+ */
+void move_cache_invalidate(move_cache_t *cache)
+{
+  cache->valid = false;
+}
+
+/*
+ *   move_cache_update
+ * Generate the legal moves of the board, if not cached, and sort them by
+ * origin square (a counting sort, keeping generation order within each)
+ *   @param cache the cache to fill
+ *   @param board the board the cache serves
+ *   @return 0 on success, -1 on failure
+ */
+int move_cache_update(move_cache_t *cache, board_t *board)
+{
+  int count, square, i;
+  move_t *move;
+
+  if (cache->valid) return 0;
+
+  move_list_clear(cache->legal);
+  count = move_gen_legal(board, cache->legal);
+  if (count < 0 || count > MOVE_LIST_DEFAULT_CAPACITY) return -1;
+
+  memset(cache->first, 0, sizeof(cache->first) );
+  memset(cache->targets, 0, sizeof(cache->targets) );
+  for (i = 0; i < count; i++) {
+    move = move_list_get_move(cache->legal, i);
+    cache->first[move_origin(move) + 1]++;
+    cache->targets[move_origin(move)] |= 1ULL << move_target(move);
+  }
+  for (square = 0; square < NUM_SQUARES; square++)
+    cache->first[square + 1] += cache->first[square];
+
+  /* Fill each origin's run, using 'first' as its cursor, then restore */
+  for (i = 0; i < count; i++) {
+    move = move_list_get_move(cache->legal, i);
+    cache->moves[cache->first[move_origin(move)]++] = *move;
+  }
+  for (square = NUM_SQUARES; square > 0; square--)
+    cache->first[square] = cache->first[square - 1];
+  cache->first[0] = 0;
+
+  cache->valid = true;
+  return 0;
+}
+
+/*
+ *   move_cache_targets
+ * Look up where a piece may move
+ *   @param cache an updated cache
+ *   @param from the square index of the piece
+ *   @return the destinations, bit n set for square index n
+ */
+uint64_t move_cache_targets(move_cache_t *cache, int from)
+{
+  if (!cache->valid || from < 0 || from >= NUM_SQUARES) return 0;
+  return cache->targets[from];
+}
+
+/*
+ *   move_cache_find
+ * Look up the move between two squares among those from 'from'.  Of
+ * the four promotions to a square, the queen's is the one returned.
+ *   @param cache an updated cache
+ *   @param from the square index moved from
+ *   @param to the square index moved to
+ *   @return a * to the cached move (valid until the cache is next
+ *    regenerated), or NULL if that move isn't legal
+ */
+move_t* move_cache_find(move_cache_t *cache, int from, int to)
+{
+  move_t *found = NULL, *move;
+  int i;
+
+  if (!(move_cache_targets(cache, from) >> to & 1) ) return NULL;
+  for (i = cache->first[from]; i < cache->first[from + 1]; i++) {
+    move = &cache->moves[i];
+    if (move_target(move) != to) continue;
+    if (!(move->flags & MOVE_PROMOTION) || move->promotion == QUEEN)
+      return move;
+    found = move;
+  }
+  return found;
+}
+
+/*
+ *   move_origin
+ * The square index a move starts from
+ */
+static int move_origin(move_t *move)
+{
+  return SQUARE_INDEX(move->from_square->rank, move->from_square->file);
+}
+
+/*
+ *   move_target
+ * The square index a move goes to
+ */
+static int move_target(move_t *move)
+{
+  return SQUARE_INDEX(move->to_square->rank, move->to_square->file);
+}
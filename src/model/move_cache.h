@@ -0,0 +1,53 @@
+#ifndef _MOVE_CACHE_H
+#define _MOVE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "board.h"
+#include "move.h"
+#include "move_list.h"
+#include "chess.h"
+
+/*
+ * A move_cache holds the legal moves of one position, generated once and
+ * grouped by the square they start from, so a front end can show where a
+ * selected piece may go, and check the move it is asked to play, without
+ * generating moves on every key press or frame.
+ *
+ * The moves are only regenerated after move_cache_invalidate: whoever
+ * changes the board invalidates the cache.  Moves refer to the board's
+ * squares, so a cache serves one board.
+ */
+
+struct move_cache {
+  bool valid;                       /* Moves are those of the board */
+  move_list_t *legal;               /* (strong) As generated */
+  move_t moves[MOVE_LIST_DEFAULT_CAPACITY]; /* Sorted by origin */
+  int first[NUM_SQUARES + 1];       /* Moves from square s: first[s]..s+1 */
+  uint64_t targets[NUM_SQUARES];    /* Bit per destination, by origin */
+};
+typedef struct move_cache move_cache_t;
+
+/* Create an empty (invalid) cache.  Returns NULL on failure. */
+move_cache_t* move_cache_init(void);
+
+/* Cleanup a cache */
+void move_cache_destroy(move_cache_t *cache);
+
+/* Note that the board changed; the next update regenerates */
+void move_cache_invalidate(move_cache_t *cache);
+
+/* Generate the board's legal moves, unless the cache already holds them.
+ * Returns 0 on success, -1 on failure.
+ */
+int move_cache_update(move_cache_t *cache, board_t *board);
+
+/* The squares a piece on 'from' may move to, a bit per square index */
+uint64_t move_cache_targets(move_cache_t *cache, int from);
+
+/* The legal move between two squares (promoting to a queen if it
+ * promotes), or NULL if there is none
+ */
+move_t* move_cache_find(move_cache_t *cache, int from, int to);
+
+#endif
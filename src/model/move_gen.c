@@ -0,0 +1,484 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "move_gen.h"
+#include "board.h"
+#include "move.h"
+#include "move_list.h"
+#include "piece.h"
+#include "chess.h"
+#include "timer.h"
+
+static const int knight_steps[8][2] = {
+  {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}
+};
+static const int king_steps[8][2] = {
+  {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+};
+static const int rook_dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int bishop_dirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static const piece_type_t promotion_types[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+
+static int generate(board_t *board, move_list_t *moves, bool captures_only);
+static void add_move(board_t *board, move_list_t *moves, int from_rank,
+                     int from_file, int to_rank, int to_file, int flags,
+                     piece_type_t promotion);
+static void add_pawn_moves(board_t *board, move_list_t *moves, int rank,
+                           int file, color_t us, bool captures_only);
+static void add_step_moves(board_t *board, move_list_t *moves, int rank,
+                           int file, color_t us, const int steps[8][2],
+                           bool captures_only);
+static void add_slider_moves(board_t *board, move_list_t *moves, int rank,
+                             int file, color_t us, const int dirs[4][2],
+                             bool captures_only);
+static void add_castle_moves(board_t *board, move_list_t *moves, color_t us);
+static bool on_board(int rank, int file);
+
+/*
+ *   move_gen_pseudo_legal
+ * Append every move that follows the piece movement rules for the side
+ * to move.  Moves that leave the mover in check are included.
+ *   @param board the position to generate moves for
+ *   @param moves the list to append to
+ *   @return the number of moves added
+ */
+int move_gen_pseudo_legal(board_t *board, move_list_t *moves)
+{
+  return generate(board, moves, false);
+}
+
+/*
+ *   move_gen_captures
+ * Append the pseudo-legal captures and queen promotions only; these are
+ * the moves a quiescence search looks at.
+ *   @param board the position to generate moves for
+ *   @param moves the list to append to
+ *   @return the number of moves added
+ */
+int move_gen_captures(board_t *board, move_list_t *moves)
+{
+  return generate(board, moves, true);
+}
+
+/*
+ *   move_gen_legal
+ * Append every legal move.  Pseudo-legal moves are generated and then
+ * each one is played and taken back to check the mover's king.
+ *   @param board the position to generate moves for
+ *   @param moves the list to append to
+ *   @return the number of moves added
+ */
+int move_gen_legal(board_t *board, move_list_t *moves)
+{
+  int start = moves->num_moves;
+  int kept = start, i;
+  board_undo_t undo;
+
+  generate(board, moves, false);
+  for (i = start; i < moves->num_moves; i++) {
+    board_make_move(board, &moves->moves[i], &undo);
+    if (!move_gen_left_in_check(board))
+      moves->moves[kept++] = moves->moves[i];
+    board_unmake_move(board, &moves->moves[i], &undo);
+  }
+  moves->num_moves = kept;
+  return kept - start;
+}
+
+/*
+ *   move_gen_square_attacked
+ * Check whether any piece of color 'by' attacks a square.  Works outward
+ * from the square: pawn and leaper squares first, then the four rook and
+ * four bishop rays.
+ *   @param board the position to examine
+ *   @param rank the rank of the square
+ *   @param file the file of the square
+ *   @param by the attacking color
+ *   @return true if the square is attacked
+ */
+bool move_gen_square_attacked(board_t *board, int rank, int file, color_t by)
+{
+  int i, r, f;
+  piece_t *piece;
+
+  /* Pawns attack diagonally forward, so look one rank 'behind' */
+  int pawn_rank = by == WHITE ? rank - 1 : rank + 1;
+  for (i = -1; i <= 1; i += 2) {
+    if (!on_board(pawn_rank, file + i)) continue;
+    piece = board->spaces[pawn_rank][file + i]->piece;
+    if (piece && piece->color == by && piece->type == PAWN) return true;
+  }
+
+  for (i = 0; i < 8; i++) {
+    r = rank + knight_steps[i][0];
+    f = file + knight_steps[i][1];
+    if (on_board(r, f)) {
+      piece = board->spaces[r][f]->piece;
+      if (piece && piece->color == by && piece->type == KNIGHT) return true;
+    }
+    r = rank + king_steps[i][0];
+    f = file + king_steps[i][1];
+    if (on_board(r, f)) {
+      piece = board->spaces[r][f]->piece;
+      if (piece && piece->color == by && piece->type == KING) return true;
+    }
+  }
+
+  for (i = 0; i < 4; i++) {
+    for (r = rank + rook_dirs[i][0], f = file + rook_dirs[i][1];
+         on_board(r, f); r += rook_dirs[i][0], f += rook_dirs[i][1]) {
+      piece = board->spaces[r][f]->piece;
+      if (!piece) continue;
+      if (piece->color == by && (piece->type == ROOK || piece->type == QUEEN))
+        return true;
+      break;
+    }
+    for (r = rank + bishop_dirs[i][0], f = file + bishop_dirs[i][1];
+         on_board(r, f); r += bishop_dirs[i][0], f += bishop_dirs[i][1]) {
+      piece = board->spaces[r][f]->piece;
+      if (!piece) continue;
+      if (piece->color == by && (piece->type == BISHOP || piece->type == QUEEN))
+        return true;
+      break;
+    }
+  }
+  return false;
+}
+
+/*
+ *   move_gen_in_check
+ * Check whether a side's king is attacked
+ *   @param board the position to examine
+ *   @param side the side whose king is checked
+ *   @return true if the king is in check (false if there is no king)
+ */
+bool move_gen_in_check(board_t *board, color_t side)
+{
+  piece_t *king = board->kings[side];
+  if (!king) return false;
+  return move_gen_square_attacked(board, king->rank, king->file,
+                                  OTHER_COLOR(side));
+}
+
+/*
+ *   move_gen_left_in_check
+ * To be called right after board_make_move: checks whether the side that
+ * just moved exposed its own king, i.e. whether the move was illegal.
+ *   @param board the position after the move
+ *   @return true if the move left the mover in check
+ */
+bool move_gen_left_in_check(board_t *board)
+{
+  return move_gen_in_check(board, OTHER_COLOR(board->moves_next));
+}
+
+/*
+ *   move_gen_find_packed
+ * Look up the legal move that matches a packed move
+ *   @param board the position the move is played in
+ *   @param packed the packed move (see move_pack)
+ *   @param out receives the fully described move
+ *   @return true if the packed move is legal here
+ */
+bool move_gen_find_packed(board_t *board, uint16_t packed, move_t *out)
+{
+  move_list_t *moves = move_list_new();
+  bool found = false;
+  int i;
+
+  if (!moves) return false;
+  move_gen_legal(board, moves);
+  for (i = 0; i < moves->num_moves && !found; i++) {
+    if (move_pack(&moves->moves[i]) == packed) {
+      *out = moves->moves[i];
+      found = true;
+    }
+  }
+  move_list_destroy(moves);
+  return found;
+}
+
+/*
+ *   move_gen_find_string
+ * Look up the legal move written in coordinate notation
+ *   @param board the position the move is played in
+ *   @param text the move, e.g. "g1f3" or "b7b8n"
+ *   @param out receives the fully described move
+ *   @return true if the text names a legal move here
+ */
+bool move_gen_find_string(board_t *board, const char *text, move_t *out)
+{
+  int promo = 0;
+
+  if (strlen(text) < 4) return false;
+  if (text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8' ||
+      text[2] < 'a' || text[2] > 'h' || text[3] < '1' || text[3] > '8')
+    return false;
+
+  switch (text[4]) {
+    case 'n': promo = 1; break;
+    case 'b': promo = 2; break;
+    case 'r': promo = 3; break;
+    case 'q': promo = 4; break;
+    default:  promo = 0; break;
+  }
+
+  uint16_t packed = SQUARE_INDEX(text[1] - '1', text[0] - 'a')
+                  | SQUARE_INDEX(text[3] - '1', text[2] - 'a') << 6
+                  | promo << 12;
+  return move_gen_find_packed(board, packed, out);
+}
+
+/*
+ *   move_gen_perft
+ * Count the positions reachable in exactly 'depth' plies.  The standard
+ * way of validating a move generator against known totals.
+ *   @param board the position to start from (restored on return)
+ *   @param depth the number of plies to walk
+ *   @return the number of leaf positions
+ */
+uint64_t move_gen_perft(board_t *board, int depth)
+{
+  move_list_t *moves;
+  board_undo_t undo;
+  uint64_t nodes = 0;
+  int i;
+
+  if (depth == 0) return 1;
+  if (!(moves = move_list_new())) return 0;
+
+  move_gen_legal(board, moves);
+  if (depth == 1) {
+    nodes = moves->num_moves;
+  }
+  else {
+    for (i = 0; i < moves->num_moves; i++) {
+      board_make_move(board, &moves->moves[i], &undo);
+      nodes += move_gen_perft(board, depth - 1);
+      board_unmake_move(board, &moves->moves[i], &undo);
+    }
+  }
+  move_list_destroy(moves);
+  return nodes;
+}
+
+/*
+ *   generate
+ * Shared body of the pseudo-legal generators: walk the board and hand
+ * each of the mover's pieces to the generator for its type.
+ */
+static int generate(board_t *board, move_list_t *moves, bool captures_only)
+{
+  TIMER_PROFILE_SCOPE(PROFILE_MOVE_GEN);
+  int start = moves->num_moves;
+  color_t us = board->moves_next;
+  int rank, file;
+  piece_t *piece;
+
+  for (rank = 0; rank < BOARD_SIZE; rank++) {
+    for (file = 0; file < BOARD_SIZE; file++) {
+      piece = board->spaces[rank][file]->piece;
+      if (!piece || piece->color != us) continue;
+
+      switch (piece->type) {
+        case PAWN:
+          add_pawn_moves(board, moves, rank, file, us, captures_only);
+          break;
+        case KNIGHT:
+          add_step_moves(board, moves, rank, file, us, knight_steps,
+                         captures_only);
+          break;
+        case KING:
+          add_step_moves(board, moves, rank, file, us, king_steps,
+                         captures_only);
+          break;
+        case BISHOP:
+          add_slider_moves(board, moves, rank, file, us, bishop_dirs,
+                           captures_only);
+          break;
+        case ROOK:
+          add_slider_moves(board, moves, rank, file, us, rook_dirs,
+                           captures_only);
+          break;
+        case QUEEN:
+          add_slider_moves(board, moves, rank, file, us, bishop_dirs,
+                           captures_only);
+          add_slider_moves(board, moves, rank, file, us, rook_dirs,
+                           captures_only);
+          break;
+      }
+    }
+  }
+
+  if (!captures_only) add_castle_moves(board, moves, us);
+  return moves->num_moves - start;
+}
+
+/*
+ *   add_move
+ * Append one move to the list
+ */
+static void add_move(board_t *board, move_list_t *moves, int from_rank,
+                     int from_file, int to_rank, int to_file, int flags,
+                     piece_type_t promotion)
+{
+  move_t move;
+  move.from_square = board->spaces[from_rank][from_file];
+  move.to_square = board->spaces[to_rank][to_file];
+  move.score = 0;
+  move.flags = flags;
+  move.promotion = promotion;
+  move_list_add_move(moves, &move);
+}
+
+/*
+ *   add_pawn_moves
+ * Pushes, double pushes, captures, en passant and promotions.  In
+ * captures-only mode pushes are skipped except for queen promotions.
+ */
+static void add_pawn_moves(board_t *board, move_list_t *moves, int rank,
+                           int file, color_t us, bool captures_only)
+{
+  int dir = us == WHITE ? 1 : -1;
+  int start_rank = us == WHITE ? 1 : 6;
+  int last_rank = us == WHITE ? 7 : 0;
+  int to_rank = rank + dir;
+  int i, df;
+  piece_t *target;
+
+  /* Pushes */
+  if (!board->spaces[to_rank][file]->piece) {
+    if (to_rank == last_rank) {
+      for (i = 0; i < (captures_only ? 1 : 4); i++)
+        add_move(board, moves, rank, file, to_rank, file, MOVE_PROMOTION,
+                 promotion_types[i]);
+    }
+    else if (!captures_only) {
+      add_move(board, moves, rank, file, to_rank, file, MOVE_QUIET, QUEEN);
+      if (rank == start_rank && !board->spaces[to_rank + dir][file]->piece)
+        add_move(board, moves, rank, file, to_rank + dir, file,
+                 MOVE_DOUBLE_PUSH, QUEEN);
+    }
+  }
+
+  /* Captures */
+  for (df = -1; df <= 1; df += 2) {
+    if (!on_board(to_rank, file + df)) continue;
+    target = board->spaces[to_rank][file + df]->piece;
+
+    if (target && target->color != us) {
+      if (to_rank == last_rank) {
+        for (i = 0; i < 4; i++)
+          add_move(board, moves, rank, file, to_rank, file + df,
+                   MOVE_CAPTURE | MOVE_PROMOTION, promotion_types[i]);
+      }
+      else {
+        add_move(board, moves, rank, file, to_rank, file + df, MOVE_CAPTURE,
+                 QUEEN);
+      }
+    }
+    else if (!target &&
+             board->en_passant == SQUARE_INDEX(to_rank, file + df)) {
+      add_move(board, moves, rank, file, to_rank, file + df,
+               MOVE_CAPTURE | MOVE_EN_PASSANT, QUEEN);
+    }
+  }
+}
+
+/*
+ *   add_step_moves
+ * Moves for pieces that step to a fixed set of squares (knight, king)
+ */
+static void add_step_moves(board_t *board, move_list_t *moves, int rank,
+                           int file, color_t us, const int steps[8][2],
+                           bool captures_only)
+{
+  int i, r, f;
+  piece_t *target;
+
+  for (i = 0; i < 8; i++) {
+    r = rank + steps[i][0];
+    f = file + steps[i][1];
+    if (!on_board(r, f)) continue;
+
+    target = board->spaces[r][f]->piece;
+    if (!target) {
+      if (!captures_only)
+        add_move(board, moves, rank, file, r, f, MOVE_QUIET, QUEEN);
+    }
+    else if (target->color != us) {
+      add_move(board, moves, rank, file, r, f, MOVE_CAPTURE, QUEEN);
+    }
+  }
+}
+
+/*
+ *   add_slider_moves
+ * Moves along rays until the edge of the board or the first piece
+ */
+static void add_slider_moves(board_t *board, move_list_t *moves, int rank,
+                             int file, color_t us, const int dirs[4][2],
+                             bool captures_only)
+{
+  int i, r, f;
+  piece_t *target;
+
+  for (i = 0; i < 4; i++) {
+    for (r = rank + dirs[i][0], f = file + dirs[i][1]; on_board(r, f);
+         r += dirs[i][0], f += dirs[i][1]) {
+      target = board->spaces[r][f]->piece;
+      if (!target) {
+        if (!captures_only)
+          add_move(board, moves, rank, file, r, f, MOVE_QUIET, QUEEN);
+        continue;
+      }
+      if (target->color != us)
+        add_move(board, moves, rank, file, r, f, MOVE_CAPTURE, QUEEN);
+      break;
+    }
+  }
+}
+
+/*
+ *   add_castle_moves
+ * Castling requires the right, empty squares between king and rook, and
+ * that the king is not in, passing through, or landing in check.
+ */
+static void add_castle_moves(board_t *board, move_list_t *moves, color_t us)
+{
+  int rank = us == WHITE ? 0 : 7;
+  int king_side = us == WHITE ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+  int queen_side = us == WHITE ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+  color_t them = OTHER_COLOR(us);
+  square_t **row = board->spaces[rank];
+
+  if (!(board->castle_rights & (king_side | queen_side))) return;
+  if (!row[4]->piece || row[4]->piece->type != KING) return;
+  if (move_gen_square_attacked(board, rank, 4, them)) return;
+
+  if ((board->castle_rights & king_side) &&
+      !row[5]->piece && !row[6]->piece &&
+      row[7]->piece && row[7]->piece->type == ROOK &&
+      !move_gen_square_attacked(board, rank, 5, them) &&
+      !move_gen_square_attacked(board, rank, 6, them))
+    add_move(board, moves, rank, 4, rank, 6, MOVE_CASTLE, QUEEN);
+
+  if ((board->castle_rights & queen_side) &&
+      !row[3]->piece && !row[2]->piece && !row[1]->piece &&
+      row[0]->piece && row[0]->piece->type == ROOK &&
+      !move_gen_square_attacked(board, rank, 3, them) &&
+      !move_gen_square_attacked(board, rank, 2, them))
+    add_move(board, moves, rank, 4, rank, 2, MOVE_CASTLE, QUEEN);
+}
+
+/*
+ *   on_board
+ * Check that a rank/file pair lies on the board
+ */
+static bool on_board(int rank, int file)
+{
+  return rank >= 0 && rank < BOARD_SIZE && file >= 0 && file < BOARD_SIZE;
+}
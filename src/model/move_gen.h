@@ -0,0 +1,46 @@
+#ifndef _MOVE_GEN_H
+#define _MOVE_GEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "board.h"
+#include "move.h"
+#include "move_list.h"
+
+/*
+ * Move generation for the side to move.  Pseudo-legal generation follows
+ * the piece movement rules (including castling through unattacked
+ * squares, en passant and promotions) but may leave the mover's own king
+ * in check; legal generation filters those out by playing each move.
+ */
+
+/* Append all pseudo-legal moves to 'moves'.  Returns the number added. */
+int move_gen_pseudo_legal(board_t *board, move_list_t *moves);
+
+/* Append only captures and promotions (for quiescence search) */
+int move_gen_captures(board_t *board, move_list_t *moves);
+
+/* Append all legal moves to 'moves'.  Returns the number added. */
+int move_gen_legal(board_t *board, move_list_t *moves);
+
+/* Check whether a square is attacked by any piece of color 'by' */
+bool move_gen_square_attacked(board_t *board, int rank, int file, color_t by);
+
+/* Check whether the given side's king is in check */
+bool move_gen_in_check(board_t *board, color_t side);
+
+/* After board_make_move: did the move leave the mover's king attacked? */
+bool move_gen_left_in_check(board_t *board);
+
+/* Find the legal move matching a packed move (see move_pack).  Returns
+ * true and fills 'out' if the move is legal in this position.
+ */
+bool move_gen_find_packed(board_t *board, uint16_t packed, move_t *out);
+
+/* Find the legal move written in coordinate notation ("e2e4", "a7a8q") */
+bool move_gen_find_string(board_t *board, const char *text, move_t *out);
+
+/* Count the leaf nodes of the legal move tree to the given depth */
+uint64_t move_gen_perft(board_t *board, int depth);
+
+#endif
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "move_list.h"
+#include "move.h"
+
+/*
+ *   move_list_new
+ * Create an empty move list with room for any position's moves
+ *   @return a * to the new move_list_t, or NULL on failure
+ */
+move_list_t*
+move_list_new()
+{
+  move_list_t *list = malloc(sizeof(move_list_t) );
+  if (!list) return NULL;
+
+  list->moves = malloc(MOVE_LIST_DEFAULT_CAPACITY * sizeof(move_t) );
+  if (!list->moves) {
+    free(list);
+    return NULL;
+  }
+  list->num_moves = 0;
+  list->capacity = MOVE_LIST_DEFAULT_CAPACITY;
+  return list;
+}
+
+/*
+ *   move_list_destroy
+ * Cleanup a move list and the moves stored in it
+ *   @param moves the move_list_t to destroy
+ */
+void
+move_list_destroy(move_list_t *moves)
+{
+  if (!moves) return;
+  free(moves->moves);
+  free(moves);
+}
+
+/*
+ *   move_list_clear
+ * Empty a move list without releasing its storage
+ *   @param moves the move_list_t to clear
+ */
+void
+move_list_clear(move_list_t *moves)
+{
+  moves->num_moves = 0;
+}
+
+/*
+ *   move_list_add_move
+ * Append a copy of a move to the list, growing the storage if needed
+ *   @param moves the list to append to
+ *   @param added the move to copy into the list
+ *   @return 0 on success, -1 on bad args or allocation failure
+ */
+int
+move_list_add_move(move_list_t *moves, move_t *added)
+{
+  if (!moves || !added) return -1;
+
+  if (moves->num_moves == moves->capacity) {
+    move_t *grown = realloc(moves->moves, 2 * moves->capacity * sizeof(move_t));
+    if (!grown) return -1;
+    moves->moves = grown;
+    moves->capacity *= 2;
+  }
+  moves->moves[moves->num_moves++] = *added;
+  return 0;
+}
+
+/*
+ *   move_list_get_move
+ * Fetch a move from the list by position
+ *   @return a * to the stored move, or NULL if index is out of range
+ */
+move_t*
+move_list_get_move(move_list_t *moves, int index)
+{
+  if (!moves || index < 0 || index >= moves->num_moves) return NULL;
+  return &moves->moves[index];
+}
+
+/*
+ *   move_list_length
+ * The number of moves in the list
+ */
+int
+move_list_length(move_list_t *moves)
+{
+  return moves ? moves->num_moves : 0;
+}
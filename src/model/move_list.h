@@ -8,12 +8,18 @@
  * For a player, this may be used to visually highlight the options for a
  * selected piece.  For a computer player, this is used to rank and select a
  * move.
+ *
+ * Moves are stored by value in a growable array, so generating into an
+ * existing list (after move_list_clear) performs no allocation.
  */
 
+/* Enough room for the moves of any legal chess position */
+#define MOVE_LIST_DEFAULT_CAPACITY 256
+
 struct move_list {
   int num_moves;
   int capacity;
-  move_t *moves
+  move_t *moves;
 };
 typedef struct move_list move_list_t;
 
@@ -23,13 +29,18 @@ move_list_new();
 void
 move_list_destroy(move_list_t *moves);
 
+/* Forget all moves, keeping the storage */
 void
-move_list_add_move(move_t *added);
+move_list_clear(move_list_t *moves);
+
+/* Append a copy of 'added'; returns 0 on success, -1 on failure */
+int
+move_list_add_move(move_list_t *moves, move_t *added);
 
 move_t*
-move_list_get_move(int index);
+move_list_get_move(move_list_t *moves, int index);
 
 int
-move_list_length();
+move_list_length(move_list_t *moves);
 
 #endif
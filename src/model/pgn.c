@@ -0,0 +1,665 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pgn.h"
+#include "board.h"
+#include "move.h"
+#include "san.h"
+#include "fen.h"
+
+#define PGN_GAME_MARK "\n[Event "
+#define PGN_START_EPD "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -"
+
+static const char *result_names[] = { "*", "1-0", "0-1", "1/2-1/2" };
+
+/* One reader per thread: a board to decode on, and the game being read */
+struct reader {
+  const char *base;           /* (weak) Start of the file, for offsets */
+  bool decode;
+  pgn_game_fn fn;
+  void *user;
+  atomic_bool *stop;          /* (weak) Shared by all readers of a file */
+  board_t *board;             /* (strong) */
+  bool custom_start;          /* The board was last set up from a FEN tag */
+  board_undo_t undo[PGN_MAX_PLIES];
+  pgn_game_t game;
+  const char *start;          /* (weak) The slice to read */
+  const char *end;
+  long count;                 /* Games read, or -1 */
+};
+typedef struct reader reader_t;
+
+static reader_t* reader_init(const char *base, bool decode, pgn_game_fn fn,
+                             void *user, atomic_bool *stop);
+static void reader_destroy(reader_t *reader);
+static void* read_slice(void *arg);
+static const char* read_tags(reader_t *reader, const char *p, const char *end);
+static const char* read_movetext(reader_t *reader, const char *p,
+                                 const char *end);
+static void play(reader_t *reader, const char *token, size_t length);
+static void setup(reader_t *reader);
+static const char* skip_variation(const char *p, const char *end);
+static bool line_start(const char *p, const char *base);
+static bool write_tag(const char *name, size_t name_length, const char *value,
+                      size_t value_length, char *buffer, size_t size,
+                      size_t *length);
+static bool write_text(const char *text, size_t text_length, char *buffer,
+                       size_t size, size_t *length);
+
+/*
+ *   pgn_open
+ * Map a PGN file read-only.  It will be read once from front to back,
+ * so the kernel is asked to read ahead aggressively.
+ *   @param path the file to open
+ *   @return a * to the file, or NULL on failure
+ */
+pgn_file_t* pgn_open(const char *path)
+{
+  struct stat info;
+  pgn_file_t *file;
+  void *mapping;
+  int fd;
+
+  if (!path || (fd = open(path, O_RDONLY)) < 0) return NULL;
+  if (fstat(fd, &info) || info.st_size <= 0) {
+    close(fd);
+    return NULL;
+  }
+
+  mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return NULL;
+  madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+
+  if (!(file = malloc(sizeof(pgn_file_t) ))) {
+    munmap(mapping, info.st_size);
+    return NULL;
+  }
+  file->data = mapping;
+  file->size = info.st_size;
+  return file;
+}
+
+/*
+ *   pgn_close
+ * Unmap the file and cleanup its resources
+ *   @param file the file to close
+ */
+void pgn_close(pgn_file_t *file)
+{
+  if (!file) return;
+  munmap((void *)file->data, file->size);
+  free(file);
+}
+
+/*
+ *   pgn_read
+ * Read every game of a file in order
+ *   @param file the mapped file
+ *   @param decode whether to resolve the moves
+ *   @param fn called with each game
+ *   @param user passed through to 'fn'
+ *   @return the number of games read, or -1 on failure
+ */
+long pgn_read(pgn_file_t *file, bool decode, pgn_game_fn fn, void *user)
+{
+  if (!file) return -1;
+  return pgn_read_buffer(file->data, file->size, decode, fn, user);
+}
+
+/*
+ *   pgn_read_buffer
+ * Read every game in a buffer in order
+ *   @param data the PGN text
+ *   @param size its length in bytes
+ *   @param decode whether to resolve the moves
+ *   @param fn called with each game
+ *   @param user passed through to 'fn'
+ *   @return the number of games read, or -1 on failure
+ */
+long pgn_read_buffer(const char *data, size_t size, bool decode,
+                     pgn_game_fn fn, void *user)
+{
+  atomic_bool stop;
+  reader_t *reader;
+  long count;
+
+  atomic_init(&stop, false);
+  if (!data || !(reader = reader_init(data, decode, fn, user, &stop)))
+    return -1;
+  reader->start = data;
+  reader->end = data + size;
+  read_slice(reader);
+  count = reader->count;
+  reader_destroy(reader);
+  return count;
+}
+
+/*
+ *   pgn_read_parallel
+ * Read a file on several threads.  The file is cut into equal slices,
+ * each moved forward to the start of the next game; a thread reads each.
+ *   @param file the mapped file
+ *   @param threads how many threads to read on
+ *   @param decode whether to resolve the moves
+ *   @param fn called with each game, from any thread
+ *   @param user passed through to 'fn'
+ *   @return the number of games read, or -1 on failure
+ */
+long pgn_read_parallel(pgn_file_t *file, int threads, bool decode,
+                       pgn_game_fn fn, void *user)
+{
+  reader_t *readers[PGN_MAX_THREADS];
+  pthread_t ids[PGN_MAX_THREADS];
+  bool started[PGN_MAX_THREADS];
+  const char *cut, *end, *mark;
+  atomic_bool stop;
+  long total = 0;
+  int i;
+
+  if (!file) return -1;
+  if (threads < 1) threads = 1;
+  if (threads > PGN_MAX_THREADS) threads = PGN_MAX_THREADS;
+  if (threads == 1) return pgn_read(file, decode, fn, user);
+
+  atomic_init(&stop, false);
+  end = file->data + file->size;
+  cut = file->data;
+  for (i = 0; i < threads; i++) {
+    readers[i] = reader_init(file->data, decode, fn, user, &stop);
+    started[i] = false;
+    if (!readers[i]) {
+      total = -1;
+      continue;
+    }
+    readers[i]->start = cut;
+
+    /* The slice ends where the first game past its share begins */
+    mark = file->data + file->size / threads * (i + 1);
+    if (mark < cut) mark = cut;
+    while (i < threads - 1 && mark < end) {
+      mark = memchr(mark, '\n', end - mark);
+      if (!mark) break;
+      if ((size_t)(end - mark) >= strlen(PGN_GAME_MARK) &&
+          !memcmp(mark, PGN_GAME_MARK, strlen(PGN_GAME_MARK)))
+        break;
+      mark++;
+    }
+    cut = i < threads - 1 && mark && mark < end ? mark + 1 : end;
+    readers[i]->end = cut;
+  }
+
+  for (i = 0; i < threads && total >= 0; i++)
+    started[i] = !pthread_create(&ids[i], NULL, read_slice, readers[i]);
+
+  /* A thread that didn't start has its slice read here instead */
+  for (i = 0; i < threads && total >= 0; i++)
+    if (!started[i]) read_slice(readers[i]);
+
+  for (i = 0; i < threads; i++) {
+    if (started[i]) pthread_join(ids[i], NULL);
+    if (readers[i] && total >= 0) total += readers[i]->count;
+    reader_destroy(readers[i]);
+  }
+  return total;
+}
+
+/*
+ *   pgn_tag
+ * Find a tag by name
+ *   @param game the game to look in
+ *   @param name the tag name, e.g. "White"
+ *   @return a * to the tag, or NULL
+ */
+const pgn_tag_t* pgn_tag(const pgn_game_t *game, const char *name)
+{
+  size_t length = strlen(name);
+  int i;
+
+  for (i = 0; i < game->num_tags; i++)
+    if (game->tags[i].name_length == length &&
+        !memcmp(game->tags[i].name, name, length))
+      return &game->tags[i];
+  return NULL;
+}
+
+/*
+ *   pgn_tag_value
+ * Copy out a tag value, removing its escapes
+ *   @param game the game to look in
+ *   @param name the tag name
+ *   @param value receives the value
+ *   @param size the size of 'value'
+ *   @return the length of the value, or -1
+ */
+int pgn_tag_value(const pgn_game_t *game, const char *name, char *value,
+                  size_t size)
+{
+  const pgn_tag_t *tag = pgn_tag(game, name);
+  size_t i, length = 0;
+
+  if (!tag) return -1;
+  for (i = 0; i < tag->value_length; i++) {
+    if (tag->value[i] == '\\' && i + 1 < tag->value_length) i++;
+    if (length + 1 >= size) return -1;
+    value[length++] = tag->value[i];
+  }
+  value[length] = '\0';
+  return length;
+}
+
+/*
+ *   pgn_write_game
+ * Write a game as PGN, playing through it on the board to write each
+ * move as SAN.  No move list is generated: the SAN writer only tries the
+ * few pieces that could be confused with the one moving.
+ *   @param board the position the game starts from
+ *   @param tags the tags to write
+ *   @param num_tags how many
+ *   @param moves the moves, in order
+ *   @param num_moves how many
+ *   @param result the result token to end on
+ *   @param buffer receives the text
+ *   @param size the size of 'buffer'
+ *   @return the length written, or -1
+ */
+int pgn_write_game(board_t *board, const pgn_tag_t *tags, int num_tags,
+                   move_t *moves, int num_moves, pgn_result_t result,
+                   char *buffer, size_t size)
+{
+  board_undo_t undo[PGN_MAX_PLIES];
+  char fen[FEN_MAX_LENGTH], token[SAN_MAX_LENGTH + 16];
+  size_t length = 0, line = 0;
+  bool fits = true, has_fen = false;
+  int i, played = 0, token_length;
+
+  if (num_moves > PGN_MAX_PLIES) return -1;
+
+  for (i = 0; i < num_tags && fits; i++) {
+    has_fen |= tags[i].name_length == 3 && !memcmp(tags[i].name, "FEN", 3);
+    fits = write_tag(tags[i].name, tags[i].name_length, tags[i].value,
+                     tags[i].value_length, buffer, size, &length);
+  }
+  fen_write_epd(board, fen, sizeof(fen));
+  if (fits && !has_fen &&
+      (strcmp(fen, PGN_START_EPD) || board->fullmove_number != 1)) {
+    fen_write(board, fen, sizeof(fen));
+    fits = write_tag("SetUp", 5, "1", 1, buffer, size, &length) &&
+           write_tag("FEN", 3, fen, strlen(fen), buffer, size, &length);
+  }
+  if (length) fits = fits && write_text("\n", 1, buffer, size, &length);
+
+  /* Moves, each preceded by its number when white moves (or first) */
+  for (i = 0; i <= num_moves && fits; i++) {
+    token_length = 0;
+    if (i < num_moves && (board->moves_next == WHITE || i == 0))
+      token_length = sprintf(token, board->moves_next == WHITE ? "%d. " :
+                             "%d... ", board->fullmove_number);
+    if (i < num_moves) {
+      token_length += san_write(board, &moves[i], NULL, token + token_length);
+      board_make_move(board, &moves[i], &undo[played++]);
+    }
+    else
+      token_length = sprintf(token, "%s", result_names[result]);
+
+    if (line && line + 1 + token_length > PGN_LINE_LENGTH) {
+      fits = write_text("\n", 1, buffer, size, &length);
+      line = 0;
+    }
+    else if (line) {
+      fits = write_text(" ", 1, buffer, size, &length);
+      line++;
+    }
+    fits = fits && write_text(token, token_length, buffer, size, &length);
+    line += token_length;
+  }
+  fits = fits && write_text("\n\n", 2, buffer, size, &length);
+
+  while (played--)
+    board_unmake_move(board, &moves[played], &undo[played]);
+  return fits ? (int)length : -1;
+}
+
+/*
+ *   reader_init
+ * Create a reader with its own board at the start position
+ *   @return a * to the reader, or NULL on failure
+ */
+static reader_t* reader_init(const char *base, bool decode, pgn_game_fn fn,
+                             void *user, atomic_bool *stop)
+{
+  reader_t *reader = malloc(sizeof(reader_t) );
+
+  if (!reader) return NULL;
+  reader->base = base;
+  reader->decode = decode;
+  reader->fn = fn;
+  reader->user = user;
+  reader->stop = stop;
+  reader->custom_start = false;
+  reader->count = 0;
+  reader->board = decode ? board_init_start() : NULL;
+  if (decode && !reader->board) {
+    free(reader);
+    return NULL;
+  }
+  return reader;
+}
+
+/*
+ *   reader_destroy
+ * Cleanup a reader and its board
+ */
+static void reader_destroy(reader_t *reader)
+{
+  if (!reader) return;
+  if (reader->board) board_destroy(reader->board);
+  free(reader);
+}
+
+/*
+ *   read_slice
+ * Read the games of a reader's slice until it ends or reading stops.
+ * Anything before a game's first tag that isn't movetext, such as '%'
+ * escape lines, is skipped.
+ *   @param arg the reader
+ *   @return NULL
+ */
+static void* read_slice(void *arg)
+{
+  reader_t *reader = arg;
+  pgn_game_t *game = &reader->game;
+  const char *p = reader->start, *end = reader->end;
+  int i;
+
+  while (p < end) {
+    if (atomic_load_explicit(reader->stop, memory_order_relaxed)) break;
+
+    if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+      p++;
+      continue;
+    }
+    if (*p == '%' && line_start(p, reader->base)) {
+      p = memchr(p, '\n', end - p);
+      if (!p) break;
+      continue;
+    }
+
+    game->text = p;
+    game->offset = p - reader->base;
+    game->num_tags = 0;
+    game->num_moves = 0;
+    game->error = false;
+    game->result = PGN_RESULT_UNKNOWN;
+    game->board = reader->board;
+    p = read_tags(reader, p, end);
+    if (reader->decode) setup(reader);
+    p = read_movetext(reader, p, end);
+    game->length = p - game->text;
+
+    /* Hand over the game at its start position */
+    for (i = game->num_moves - 1; i >= 0; i--)
+      board_unmake_move(reader->board, &game->moves[i], &reader->undo[i]);
+
+    reader->count++;
+    if (reader->fn && !reader->fn(game, reader->user))
+      atomic_store(reader->stop, true);
+  }
+  return NULL;
+}
+
+/*
+ *   read_tags
+ * Read the tag pairs at the top of a game, one per line:
+ *   [Name "value"]
+ * A malformed tag marks the game and the rest of its line is skipped.
+ *   @param reader the reader
+ *   @param p the start of the game
+ *   @param end the end of the slice
+ *   @return the start of the movetext
+ */
+static const char* read_tags(reader_t *reader, const char *p, const char *end)
+{
+  pgn_game_t *game = &reader->game;
+  const char *name, *value, *line_end;
+  size_t name_length;
+
+  while (p < end && *p == '[') {
+    line_end = memchr(p, '\n', end - p);
+    if (!line_end) line_end = end;
+
+    for (p++; p < line_end && (*p == ' ' || *p == '\t'); p++) ;
+    for (name = p; p < line_end && *p != ' ' && *p != '\t' && *p != '"' &&
+                   *p != ']'; p++) ;
+    name_length = p - name;
+    for (; p < line_end && (*p == ' ' || *p == '\t'); p++) ;
+
+    if (p < line_end && *p == '"' && name_length) {
+      for (value = ++p; p < line_end && *p != '"'; p++)
+        if (*p == '\\' && p + 1 < line_end) p++;
+      if (p < line_end && game->num_tags < PGN_MAX_TAGS) {
+        game->tags[game->num_tags].name = name;
+        game->tags[game->num_tags].name_length = name_length;
+        game->tags[game->num_tags].value = value;
+        game->tags[game->num_tags].value_length = p - value;
+        game->num_tags++;
+      }
+      else if (p >= line_end)
+        game->error = true;
+    }
+    else
+      game->error = true;
+
+    for (p = line_end; p < end && (*p == '\n' || *p == '\r' || *p == ' ' ||
+                                   *p == '\t'); p++) ;
+  }
+  return p;
+}
+
+/*
+ *   read_movetext
+ * Scan the movetext to the game's result, or to a tag at the start of a
+ * line if the result is missing, playing each move when decoding
+ *   @param reader the reader
+ *   @param p the start of the movetext
+ *   @param end the end of the slice
+ *   @return the end of the game
+ */
+static const char* read_movetext(reader_t *reader, const char *p,
+                                 const char *end)
+{
+  pgn_game_t *game = &reader->game;
+  const char *token;
+
+  game->movetext = p;
+  while (p < end) {
+    switch (*p) {
+      case '\n':
+        p++;
+        if (p < end && *p == '[') {
+          game->movetext_length = p - game->movetext;
+          return p;
+        }
+        if (p < end && *p == '%') {
+          p = memchr(p, '\n', end - p);
+          if (!p) p = end;
+        }
+        continue;
+      case ' ': case '\t': case '\r': case '.': case ')':
+        p++;
+        continue;
+      case '{':
+        p = memchr(p, '}', end - p);
+        p = p ? p + 1 : end;
+        continue;
+      case ';':
+        p = memchr(p, '\n', end - p);
+        if (!p) p = end;
+        continue;
+      case '(':
+        p = skip_variation(p, end);
+        continue;
+      case '$':
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) ;
+        continue;
+      case '*':
+        game->movetext_length = p - game->movetext;
+        return p + 1;
+    }
+
+    /* Results, then move numbers, which may run into the move ("12.e4") */
+    if (end - p >= 7 && !memcmp(p, "1/2-1/2", 7)) {
+      game->result = PGN_RESULT_DRAW;
+      game->movetext_length = p - game->movetext;
+      return p + 7;
+    }
+    if (end - p >= 3 && (!memcmp(p, "1-0", 3) || !memcmp(p, "0-1", 3))) {
+      game->result = p[0] == '1' ? PGN_RESULT_WHITE : PGN_RESULT_BLACK;
+      game->movetext_length = p - game->movetext;
+      return p + 3;
+    }
+    if (*p >= '1' && *p <= '9') {
+      for (token = p; p < end && *p >= '0' && *p <= '9'; p++) ;
+      if (p < end && *p == '.') continue;
+      p = token;
+    }
+
+    for (token = p; p < end && !strchr(" \t\r\n{}();$", *p); p++) ;
+    if (p == token) {
+      p++;
+      continue;
+    }
+    if (reader->decode && !game->error) play(reader, token, p - token);
+  }
+  game->movetext_length = p - game->movetext;
+  return p;
+}
+
+/*
+ *   play
+ * Decode and play one SAN move of the game.  A move that doesn't decode
+ * ends the decoding of the game.
+ *   @param reader the reader
+ *   @param token the move
+ *   @param length its length
+ */
+static void play(reader_t *reader, const char *token, size_t length)
+{
+  pgn_game_t *game = &reader->game;
+  move_t *move = &game->moves[game->num_moves];
+
+  if (game->num_moves >= PGN_MAX_PLIES ||
+      san_parse(reader->board, token, length, move)) {
+    game->error = true;
+    return;
+  }
+  board_make_move(reader->board, move, &reader->undo[game->num_moves]);
+  game->num_moves++;
+}
+
+/*
+ *   setup
+ * Put the reader's board at the game's start position: the FEN tag if
+ * there is one, otherwise the standard start.  The board is left at
+ * its last start position between games, so games from the standard
+ * start cost nothing to set up.
+ *   @param reader the reader
+ */
+static void setup(reader_t *reader)
+{
+  const pgn_tag_t *fen = pgn_tag(&reader->game, "FEN");
+
+  if (fen) {
+    reader->custom_start = true;
+    if (fen_parse(reader->board, fen->value, fen->value_length, NULL))
+      reader->game.error = true;
+  }
+  else if (reader->custom_start) {
+    reader->custom_start = false;
+    fen_parse(reader->board, FEN_START_POSITION, strlen(FEN_START_POSITION),
+              NULL);
+  }
+}
+
+/*
+ *   skip_variation
+ * Skip a parenthesized variation, with any nested inside it and the
+ * comments in it (which may hold unbalanced parentheses)
+ *   @param p the opening parenthesis
+ *   @param end the end of the slice
+ *   @return just past the closing parenthesis
+ */
+static const char* skip_variation(const char *p, const char *end)
+{
+  int depth = 0;
+
+  for (; p < end; p++) {
+    if (*p == '(') depth++;
+    else if (*p == ')' && !--depth) return p + 1;
+    else if (*p == '{') {
+      p = memchr(p, '}', end - p);
+      if (!p) return end;
+    }
+    else if (*p == ';') {
+      p = memchr(p, '\n', end - p);
+      if (!p) return end;
+    }
+  }
+  return end;
+}
+
+/*
+ *   line_start
+ * Whether a character is the first of its line
+ */
+static bool line_start(const char *p, const char *base)
+{
+  return p == base || p[-1] == '\n';
+}
+
+/*
+ *   write_tag
+ * Append a tag pair line, escaping quotes and backslashes in its value
+ *   @return false if it doesn't fit
+ */
+static bool write_tag(const char *name, size_t name_length, const char *value,
+                      size_t value_length, char *buffer, size_t size,
+                      size_t *length)
+{
+  size_t i;
+
+  if (!write_text("[", 1, buffer, size, length) ||
+      !write_text(name, name_length, buffer, size, length) ||
+      !write_text(" \"", 2, buffer, size, length))
+    return false;
+  for (i = 0; i < value_length; i++) {
+    if ((value[i] == '"' || value[i] == '\\') &&
+        !write_text("\\", 1, buffer, size, length))
+      return false;
+    if (!write_text(&value[i], 1, buffer, size, length)) return false;
+  }
+  return write_text("\"]\n", 3, buffer, size, length);
+}
+
+/*
+ *   write_text
+ * Append text, keeping the buffer NUL-terminated
+ *   @return false if it doesn't fit
+ */
+static bool write_text(const char *text, size_t text_length, char *buffer,
+                       size_t size, size_t *length)
+{
+  if (*length + text_length >= size) return false;
+  memcpy(buffer + *length, text, text_length);
+  *length += text_length;
+  buffer[*length] = '\0';
+  return true;
+}
@@ -0,0 +1,129 @@
+#ifndef _PGN_H
+#define _PGN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "move.h"
+
+/*
+ * Portable Game Notation reader.  A PGN file is mmap'd and read in place:
+ * tag names and values, and the movetext, are handed out as pointers
+ * into the mapping, never copied.  Each game is passed to a callback
+ * as soon as it has been read, so a database of any size streams
+ * through in constant memory.
+ *
+ * Optionally the movetext is decoded as well: every SAN move is resolved
+ * against the game's board (the standard start position, or the FEN
+ * tag), and the game carries the moves ready for board_make_move.
+ * Comments, variations, NAGs and move numbers are skipped.
+ *
+ * The parallel reader splits the mapping at "[Event " lines, one slice
+ * per thread, and reads each slice with its own board, so games are
+ * delivered concurrently and out of file order.
+ *
+ * Writing goes the other way: a board, its moves and the tags become
+ * the text of one game (see pgn_export.h to write many to a file).
+ */
+
+#define PGN_MAX_TAGS   32     /* Tags kept per game; more are ignored */
+#define PGN_MAX_PLIES  1024   /* A longer game is reported as an error */
+#define PGN_MAX_THREADS 64
+#define PGN_LINE_LENGTH 79    /* Movetext is wrapped before this column */
+
+enum pgn_result {
+  PGN_RESULT_UNKNOWN,   /* "*", or no result at all */
+  PGN_RESULT_WHITE,     /* 1-0 */
+  PGN_RESULT_BLACK,     /* 0-1 */
+  PGN_RESULT_DRAW       /* 1/2-1/2 */
+};
+typedef enum pgn_result pgn_result_t;
+
+/* A tag pair, pointing into the mapping.  The value still has its
+ * escapes (\" and \\); pgn_tag_value removes them.
+ */
+struct pgn_tag {
+  const char *name;
+  const char *value;
+  uint16_t name_length;
+  uint16_t value_length;
+};
+typedef struct pgn_tag pgn_tag_t;
+
+struct pgn_game {
+  const char *text;           /* (weak) The whole game, tags included */
+  size_t length;
+  size_t offset;              /* Of 'text' in the file */
+  pgn_tag_t tags[PGN_MAX_TAGS];
+  int num_tags;
+  const char *movetext;       /* (weak) */
+  size_t movetext_length;
+  pgn_result_t result;        /* As ending the movetext */
+
+  /* Only filled in when decoding */
+  board_t *board;             /* (weak) At the game's start position */
+  move_t moves[PGN_MAX_PLIES];/* Squares point into 'board' */
+  int num_moves;
+  bool error;                 /* A bad tag, or a move that wouldn't decode;
+                                 'moves' then holds those before it */
+};
+typedef struct pgn_game pgn_game_t;
+
+/* Called for each game read.  The game and its board only live for the
+ * call; the board may be moved through the game's moves but must be
+ * left at the start position.  Return false to stop reading.
+ */
+typedef bool (*pgn_game_fn)(const pgn_game_t *game, void *user);
+
+struct pgn_file {
+  const char *data;           /* (strong) The mapping */
+  size_t size;
+};
+typedef struct pgn_file pgn_file_t;
+
+/* Map a PGN file read-only.  Returns NULL if it can't be opened, or is
+ * empty.
+ */
+pgn_file_t* pgn_open(const char *path);
+
+/* Unmap the file and cleanup its resources */
+void pgn_close(pgn_file_t *file);
+
+/* Read every game of a file in order.  'decode' resolves the movetext
+ * into moves.  Returns the number of games read (including any with
+ * errors), or -1 if a board couldn't be allocated.
+ */
+long pgn_read(pgn_file_t *file, bool decode, pgn_game_fn fn, void *user);
+
+/* As pgn_read, from any buffer; 'data' need not be NUL-terminated */
+long pgn_read_buffer(const char *data, size_t size, bool decode,
+                     pgn_game_fn fn, void *user);
+
+/* Read a file on 'threads' threads at once.  'fn' is called from all of
+ * them concurrently.  Returns as pgn_read.
+ */
+long pgn_read_parallel(pgn_file_t *file, int threads, bool decode,
+                       pgn_game_fn fn, void *user);
+
+/* The tag of a game named 'name', or NULL */
+const pgn_tag_t* pgn_tag(const pgn_game_t *game, const char *name);
+
+/* Copy the value of a tag, unescaped and NUL-terminated, into 'value'.
+ * Returns its length, or -1 if the tag is missing or doesn't fit.
+ */
+int pgn_tag_value(const pgn_game_t *game, const char *name, char *value,
+                  size_t size);
+
+/* Write a game: its tags, in order, then the moves as SAN from the
+ * board's position, and the result.  A SetUp and FEN tag are added if
+ * the board isn't at the standard start and 'tags' has no FEN.  The board
+ * is left where it started.  Returns the length written (NUL-terminated),
+ * or -1 if it doesn't fit in 'size' bytes or there are too many moves.
+ */
+int pgn_write_game(board_t *board, const pgn_tag_t *tags, int num_tags,
+                   move_t *moves, int num_moves, pgn_result_t result,
+                   char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "pgn_export.h"
+#include "board.h"
+#include "move.h"
+#include "pgn.h"
+#include "queue.h"
+
+/* Room for tags, and for each move with its number */
+#define PGN_EXPORT_TAG_BYTES  2048
+#define PGN_EXPORT_PLY_BYTES  16
+
+/* A formatted game on its way to the writer */
+struct item {
+  size_t length;
+  char text[];
+};
+typedef struct item item_t;
+
+static void* writer(void *arg);
+static void flush(pgn_export_t *export);
+
+/*
+ *   pgn_export_open
+ * Open the output file and start the writer thread.  The file's own
+ * buffering is turned off: the batch is the buffer.
+ *   @param path the file to write
+ *   @param append whether to add to the end of an existing file
+ *   @return a * to the exporter, or NULL on failure
+ */
+pgn_export_t* pgn_export_open(const char *path, bool append)
+{
+  pgn_export_t *export = malloc(sizeof(pgn_export_t) );
+
+  if (!export) return NULL;
+  export->queue = queue_init(PGN_EXPORT_QUEUE_SIZE);
+  export->batch = malloc(PGN_EXPORT_BATCH_SIZE);
+  export->handle = path ? fopen(path, append ? "ab" : "wb") : NULL;
+  if (!export->queue || !export->batch || !export->handle) {
+    if (export->handle) fclose(export->handle);
+    queue_destroy(export->queue);
+    free(export->batch);
+    free(export);
+    return NULL;
+  }
+  setvbuf(export->handle, NULL, _IONBF, 0);
+  export->batch_length = 0;
+  atomic_init(&export->closing, false);
+  atomic_init(&export->failed, false);
+  atomic_init(&export->games, 0);
+
+  if (pthread_create(&export->thread, NULL, writer, export)) {
+    fclose(export->handle);
+    queue_destroy(export->queue);
+    free(export->batch);
+    free(export);
+    return NULL;
+  }
+  return export;
+}
+
+/*
+ *   pgn_export_game
+ * Format a game into its own buffer and queue it
+ *   @param export the exporter
+ *   @param board the position the game starts from
+ *   @param tags the game's tags
+ *   @param num_tags how many
+ *   @param moves the game's moves
+ *   @param num_moves how many
+ *   @param result the game's result
+ *   @return 0 on success, -1 on failure
+ */
+int pgn_export_game(pgn_export_t *export, board_t *board,
+                    const pgn_tag_t *tags, int num_tags, move_t *moves,
+                    int num_moves, pgn_result_t result)
+{
+  size_t size = PGN_EXPORT_TAG_BYTES + num_moves * PGN_EXPORT_PLY_BYTES;
+  item_t *item;
+  int length, i;
+
+  if (atomic_load(&export->failed)) return -1;
+  for (i = 0; i < num_tags; i++)
+    size += tags[i].name_length + 2 * tags[i].value_length;
+  if (!(item = malloc(sizeof(item_t) + size))) return -1;
+
+  length = pgn_write_game(board, tags, num_tags, moves, num_moves, result,
+                          item->text, size);
+  if (length < 0) {
+    free(item);
+    return -1;
+  }
+  item->length = length;
+
+  while (!queue_push(export->queue, item)) sched_yield();
+  return 0;
+}
+
+/*
+ *   pgn_export_close
+ * Let the writer drain the queue, then clean up
+ *   @param export the exporter
+ *   @return 0 on success, -1 if any write failed
+ */
+int pgn_export_close(pgn_export_t *export)
+{
+  int status;
+
+  if (!export) return -1;
+  atomic_store(&export->closing, true);
+  pthread_join(export->thread, NULL);
+
+  if (fclose(export->handle)) atomic_store(&export->failed, true);
+  status = atomic_load(&export->failed) ? -1 : 0;
+  queue_destroy(export->queue);
+  free(export->batch);
+  free(export);
+  return status;
+}
+
+/*
+ *   writer
+ * The writer thread: move games from the queue into the batch, writing
+ * the batch out whenever the next game wouldn't fit.  When the queue runs
+ * dry the thread naps, and writes what it has after PGN_EXPORT_IDLE_MS
+ * without a game, so a slow trickle of games still reaches the disk.
+ *   @param arg the exporter
+ *   @return NULL
+ */
+static void* writer(void *arg)
+{
+  pgn_export_t *export = arg;
+  struct timespec nap = { 0, 1000000 };
+  int idle = 0;
+  item_t *item;
+
+  for (;;) {
+    if ((item = queue_pop(export->queue)) ) {
+      idle = 0;
+      if (export->batch_length + item->length > PGN_EXPORT_BATCH_SIZE)
+        flush(export);
+      if (item->length > PGN_EXPORT_BATCH_SIZE) {
+        if (!atomic_load(&export->failed) &&
+            fwrite(item->text, 1, item->length, export->handle) !=
+            item->length)
+          atomic_store(&export->failed, true);
+      }
+      else {
+        memcpy(export->batch + export->batch_length, item->text,
+               item->length);
+        export->batch_length += item->length;
+      }
+      atomic_fetch_add(&export->games, 1);
+      free(item);
+      continue;
+    }
+
+    /* Only stop once closing was asked before finding the queue empty */
+    if (atomic_load(&export->closing) && queue_empty(export->queue)) break;
+    if (++idle >= PGN_EXPORT_IDLE_MS) {
+      flush(export);
+      idle = 0;
+    }
+    nanosleep(&nap, NULL);
+  }
+  flush(export);
+  return NULL;
+}
+
+/*
+ *   flush
+ * Write the batch out in one call
+ *   @param export the exporter
+ */
+static void flush(pgn_export_t *export)
+{
+  if (!export->batch_length) return;
+  if (!atomic_load(&export->failed) &&
+      fwrite(export->batch, 1, export->batch_length, export->handle) !=
+      export->batch_length)
+    atomic_store(&export->failed, true);
+  export->batch_length = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef _PGN_EXPORT_H
+#define _PGN_EXPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "board.h"
+#include "move.h"
+#include "pgn.h"
+#include "queue.h"
+
+/*
+ * Asynchronous PGN export.  Games are formatted on the thread that
+ * finished them and handed to a writer thread through a lock-free queue;
+ * the writer gathers them into one large buffer and writes it out when
+ * it fills, or when no game has arrived for a while.  Any number of
+ * threads may export games to the same file at once, and none of them
+ * ever waits on the disk.
+ */
+
+#define PGN_EXPORT_QUEUE_SIZE 4096          /* Games in flight */
+#define PGN_EXPORT_BATCH_SIZE (1 << 20)     /* Bytes per write */
+#define PGN_EXPORT_IDLE_MS    100           /* Flush after this long idle */
+
+struct pgn_export {
+  FILE *handle;               /* (strong) */
+  queue_t *queue;             /* (strong) Formatted games, oldest first */
+  char *batch;                /* (strong) Games waiting to be written */
+  size_t batch_length;
+  pthread_t thread;
+  atomic_bool closing;
+  atomic_bool failed;         /* A write failed; later games are dropped */
+  atomic_long games;          /* Games taken off the queue */
+};
+typedef struct pgn_export pgn_export_t;
+
+/* Open 'path' for export, truncating it unless 'append', and start the
+ * writer thread.  Returns NULL on failure.
+ */
+pgn_export_t* pgn_export_open(const char *path, bool append);
+
+/* Format a game (as pgn_write_game) and queue it for writing.  The board
+ * is only used during the call.  If the queue is full this yields until
+ * the writer catches up.  Returns 0, or -1 if the game couldn't be
+ * formatted or an earlier write failed.
+ */
+int pgn_export_game(pgn_export_t *export, board_t *board,
+                    const pgn_tag_t *tags, int num_tags, move_t *moves,
+                    int num_moves, pgn_result_t result);
+
+/* Write every queued game, stop the writer and close the file.  Returns 0,
+ * or -1 if any write failed.
+ */
+int pgn_export_close(pgn_export_t *export);
+
+#endif
@@ -0,0 +1,676 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "position_index.h"
+#include "board.h"
+#include "move.h"
+#include "pgn.h"
+
+#define RUN_IO_BUFFER (1 << 20)
+#define VARINT_MAX    10
+
+/* A posting while building: the game offset and ply share one word,
+ * so records sort by hash, then file order
+ */
+struct record {
+  uint64_t hash;
+  uint64_t game_ply;      /* offset << 16 | ply */
+};
+typedef struct record record_t;
+
+/* One reading thread's records */
+struct buffer {
+  record_t *records;      /* (strong) */
+  size_t count;
+  struct buffer *next;    /* (weak) In the builder's list */
+};
+typedef struct buffer buffer_t;
+
+struct builder {
+  const char *temp_dir;
+  size_t capacity;        /* Records per buffer */
+  pthread_key_t key;      /* Each thread's buffer */
+  pthread_mutex_t lock;   /* Guards the list and the run count */
+  buffer_t *buffers;      /* (strong) */
+  int num_runs;
+  int first_run;          /* Those before were merged into later runs */
+  atomic_bool failed;
+  atomic_long games;
+  atomic_long postings;
+};
+typedef struct builder builder_t;
+
+/* A run being merged, with its next record */
+struct run {
+  FILE *handle;           /* (strong) */
+  record_t head;
+};
+typedef struct run run_t;
+
+/* The block being written */
+struct block_writer {
+  FILE *handle;           /* (weak) */
+  unsigned char data[POSITION_INDEX_BLOCK_SIZE + 2 * VARINT_MAX];
+  size_t length;
+  record_t last;
+  position_index_block_t *blocks; /* (strong) */
+  uint64_t num_blocks, capacity, offset;
+  bool open;              /* The last block is still being filled */
+  bool failed;
+};
+typedef struct block_writer block_writer_t;
+
+static bool index_game(const pgn_game_t *game, void *user);
+static bool spill(builder_t *builder, buffer_t *buffer);
+static int compare_records(const void *a, const void *b);
+static void run_path(builder_t *builder, int run, char *path, size_t size);
+static bool merge_passes(builder_t *builder);
+static int merge(builder_t *builder, const char *path, uint64_t num_games,
+                 uint64_t start_hash);
+static int open_runs(builder_t *builder, int count, run_t *runs,
+                     run_t **heap);
+static void close_runs(run_t *runs, int count);
+static bool run_next(run_t *run);
+static void sift_down(run_t **heap, int count, int i);
+static bool run_less(const run_t *a, const run_t *b);
+static void block_add(block_writer_t *writer, const record_t *record);
+static void block_finish(block_writer_t *writer);
+static size_t put_varint(unsigned char *out, uint64_t value);
+static const unsigned char* get_varint(const unsigned char *in,
+                                       uint64_t *value);
+
+/*
+ *   position_index_build
+ * Build an index: read the games on 'threads' threads, spilling sorted
+ * runs as buffers fill, then merge the runs into the index file.  The
+ * file is written under a temporary name and renamed when complete.
+ *   @param pgn_path the games
+ *   @param index_path the index to write
+ *   @param temp_dir where to put run files
+ *   @param threads how many reading threads
+ *   @param memory the budget for all buffers, in bytes
+ *   @param log progress messages, or NULL
+ *   @return 0 on success, -1 on failure
+ */
+int position_index_build(const char *pgn_path, const char *index_path,
+                         const char *temp_dir, int threads, size_t memory,
+                         FILE *log)
+{
+  char path[1024], temp[1024];
+  builder_t builder;
+  buffer_t *buffer, *next;
+  pgn_file_t *file;
+  board_t *start;
+  uint64_t start_hash;
+  long games;
+  int status = 0, run;
+
+  if (threads < 1) threads = 1;
+  if (!(file = pgn_open(pgn_path)) || !(start = board_init_start())) {
+    pgn_close(file);
+    return -1;
+  }
+  start_hash = start->hash;
+  board_destroy(start);
+
+  builder.temp_dir = temp_dir ? temp_dir : ".";
+  builder.capacity = memory / threads / sizeof(record_t);
+  if (builder.capacity < 2 * (PGN_MAX_PLIES + 1))
+    builder.capacity = 2 * (PGN_MAX_PLIES + 1);
+  builder.buffers = NULL;
+  builder.num_runs = 0;
+  builder.first_run = 0;
+  atomic_init(&builder.failed, false);
+  atomic_init(&builder.games, 0);
+  atomic_init(&builder.postings, 0);
+  pthread_key_create(&builder.key, NULL);
+  pthread_mutex_init(&builder.lock, NULL);
+
+  games = pgn_read_parallel(file, threads, true, index_game, &builder);
+  pgn_close(file);
+
+  /* What is left in the buffers becomes the last runs */
+  for (buffer = builder.buffers; buffer; buffer = next) {
+    next = buffer->next;
+    if (games >= 0 && buffer->count && !spill(&builder, buffer))
+      atomic_store(&builder.failed, true);
+    free(buffer->records);
+    free(buffer);
+  }
+  pthread_key_delete(builder.key);
+  pthread_mutex_destroy(&builder.lock);
+
+  if (games < 0 || atomic_load(&builder.failed)) status = -1;
+  if (log && !status)
+    fprintf(log, "%ld games, %ld positions, %d runs\n", games,
+            atomic_load(&builder.postings), builder.num_runs);
+
+  snprintf(temp, sizeof(temp), "%s.tmp", index_path);
+  if (!status && !merge_passes(&builder)) status = -1;
+  if (!status) status = merge(&builder, temp, games, start_hash);
+  if (!status && rename(temp, index_path)) status = -1;
+  if (status) remove(temp);
+
+  for (run = 0; run < builder.num_runs; run++) {
+    run_path(&builder, run, path, sizeof(path));
+    remove(path);
+  }
+  return status;
+}
+
+/*
+ *   position_index_open
+ * Map an index and check its header and block table
+ *   @param path the index file
+ *   @return a * to the index, or NULL on failure
+ */
+position_index_t* position_index_open(const char *path)
+{
+  const position_index_header_t *header;
+  position_index_t *index;
+  struct stat info;
+  board_t *start;
+  void *mapping;
+  int fd;
+
+  if (!path || (fd = open(path, O_RDONLY)) < 0) return NULL;
+  if (fstat(fd, &info) ||
+      (size_t)info.st_size < sizeof(position_index_header_t)) {
+    close(fd);
+    return NULL;
+  }
+  mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return NULL;
+  madvise(mapping, info.st_size, MADV_RANDOM);
+
+  header = mapping;
+  start = board_init_start();
+  if (!start || header->magic != POSITION_INDEX_MAGIC ||
+      header->version != POSITION_INDEX_VERSION ||
+      header->start_hash != start->hash ||
+      header->blocks_offset > (uint64_t)info.st_size ||
+      header->num_blocks > (info.st_size - header->blocks_offset) /
+                           sizeof(position_index_block_t) ||
+      !(index = malloc(sizeof(position_index_t) ))) {
+    if (start) board_destroy(start);
+    munmap(mapping, info.st_size);
+    return NULL;
+  }
+  board_destroy(start);
+
+  index->mapping = mapping;
+  index->size = info.st_size;
+  index->header = header;
+  index->blocks = (const position_index_block_t *)
+                  ((const unsigned char *)mapping + header->blocks_offset);
+  return index;
+}
+
+/*
+ *   position_index_close
+ * Unmap the index and cleanup its resources
+ *   @param index the index to close
+ */
+void position_index_close(position_index_t *index)
+{
+  if (!index) return;
+  munmap((void *)index->mapping, index->size);
+  free(index);
+}
+
+/*
+ *   position_index_query
+ * Find the first block starting past the hash; the hash's postings start
+ * in the block before it (they may continue from there into later
+ * blocks that start with the same hash).  They are sorted by game, then
+ * ply, so a game that came back to the position follows its first
+ * posting and is skipped.
+ *   @param index the index
+ *   @param hash the position's board_t.hash
+ *   @param hits receives the games found
+ *   @param max room in 'hits'
+ *   @return the number of games found
+ */
+long position_index_query(position_index_t *index, uint64_t hash,
+                          position_hit_t *hits, long max)
+{
+  const position_index_block_t *block;
+  const unsigned char *p;
+  uint64_t low = 0, high = index->header->num_blocks, mid, i;
+  uint64_t hash_at = 0, game = 0, last = 0, delta, value, ply;
+  long found = 0;
+
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (index->blocks[mid].first_hash <= hash) low = mid + 1;
+    else high = mid;
+  }
+  if (!low) return 0;
+
+  /* Back up to the first block the hash could start in */
+  for (low--; low > 0 && index->blocks[low].first_hash == hash; low--) ;
+
+  for (; low < index->header->num_blocks; low++) {
+    block = &index->blocks[low];
+    if (block->first_hash > hash ||
+        block->offset + block->length > index->size)
+      break;
+    p = index->mapping + block->offset;
+    for (i = 0; i < block->count; i++) {
+      p = get_varint(p, &delta);
+      hash_at = i ? hash_at + delta : block->first_hash;
+      p = get_varint(p, &value);
+      game = i && !delta ? game + value : value;
+      p = get_varint(p, &ply);
+      if (hash_at > hash) return found;
+      if (hash_at != hash || (found && game == last)) continue;
+      last = game;
+      if (found < max) {
+        hits[found].game = game;
+        hits[found].ply = ply;
+      }
+      found++;
+    }
+  }
+  return found;
+}
+
+/*
+ *   index_game
+ * The reader's callback: play through a game, recording the hash of
+ * each position in the calling thread's buffer, which is created on the
+ * thread's first game
+ *   @param game the game read
+ *   @param user the builder
+ *   @return false to stop reading after a failure
+ */
+static bool index_game(const pgn_game_t *game, void *user)
+{
+  builder_t *builder = user;
+  buffer_t *buffer = pthread_getspecific(builder->key);
+  board_undo_t undo[PGN_MAX_PLIES];
+  board_t *board = game->board;
+  move_t *moves = (move_t *)game->moves;
+  uint64_t offset = (uint64_t)game->offset << 16;
+  int ply;
+
+  if (!buffer) {
+    if (!(buffer = calloc(1, sizeof(buffer_t))) ||
+        !(buffer->records = malloc(builder->capacity * sizeof(record_t)))) {
+      free(buffer);
+      atomic_store(&builder->failed, true);
+      return false;
+    }
+    pthread_setspecific(builder->key, buffer);
+    pthread_mutex_lock(&builder->lock);
+    buffer->next = builder->buffers;
+    builder->buffers = buffer;
+    pthread_mutex_unlock(&builder->lock);
+  }
+  if (buffer->count + game->num_moves + 1 > builder->capacity &&
+      !spill(builder, buffer)) {
+    atomic_store(&builder->failed, true);
+    return false;
+  }
+
+  for (ply = 0; ; ply++) {
+    buffer->records[buffer->count].hash = board->hash;
+    buffer->records[buffer->count++].game_ply = offset | ply;
+    if (ply == game->num_moves) break;
+    board_make_move(board, &moves[ply], &undo[ply]);
+  }
+  while (ply--) board_unmake_move(board, &moves[ply], &undo[ply]);
+
+  atomic_fetch_add_explicit(&builder->games, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&builder->postings, game->num_moves + 1,
+                            memory_order_relaxed);
+  return true;
+}
+
+/*
+ *   spill
+ * Sort a buffer and write it out as the next run file
+ *   @param builder the builder
+ *   @param buffer the full buffer, emptied on success
+ *   @return true on success
+ */
+static bool spill(builder_t *builder, buffer_t *buffer)
+{
+  char path[1024];
+  FILE *handle;
+  bool ok;
+  int run;
+
+  qsort(buffer->records, buffer->count, sizeof(record_t), compare_records);
+
+  pthread_mutex_lock(&builder->lock);
+  run = builder->num_runs++;
+  pthread_mutex_unlock(&builder->lock);
+
+  run_path(builder, run, path, sizeof(path));
+  if (!(handle = fopen(path, "wb"))) return false;
+  ok = fwrite(buffer->records, sizeof(record_t), buffer->count, handle) ==
+       buffer->count;
+  ok = !fclose(handle) && ok;
+  buffer->count = 0;
+  return ok;
+}
+
+/*
+ *   compare_records
+ * qsort order: by hash, then game and ply
+ */
+static int compare_records(const void *a, const void *b)
+{
+  const record_t *x = a, *y = b;
+
+  if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+  if (x->game_ply != y->game_ply) return x->game_ply < y->game_ply ? -1 : 1;
+  return 0;
+}
+
+/*
+ *   run_path
+ * The file name of a run
+ */
+static void run_path(builder_t *builder, int run, char *path, size_t size)
+{
+  snprintf(path, size, "%s/position-index-%d-%d.run", builder->temp_dir,
+           (int)getpid(), run);
+}
+
+/*
+ *   merge_passes
+ * Merge the oldest runs, POSITION_INDEX_MERGE_WAYS at a time, into a
+ * new run at the end, until the final merge can take the rest at once.
+ * Merged runs are removed as soon as they are done with.
+ *   @param builder the builder, with its runs written
+ *   @return true on success
+ */
+static bool merge_passes(builder_t *builder)
+{
+  run_t runs[POSITION_INDEX_MERGE_WAYS], *heap[POSITION_INDEX_MERGE_WAYS];
+  char path[1024];
+  FILE *out;
+  int count, i;
+  bool ok = true;
+
+  while (ok &&
+         builder->num_runs - builder->first_run > POSITION_INDEX_MERGE_WAYS) {
+    if ((count = open_runs(builder, POSITION_INDEX_MERGE_WAYS, runs,
+                           heap)) < 0)
+      return false;
+    run_path(builder, builder->num_runs, path, sizeof(path));
+    if (!(out = fopen(path, "wb"))) {
+      close_runs(runs, POSITION_INDEX_MERGE_WAYS);
+      return false;
+    }
+    builder->num_runs++;
+    setvbuf(out, NULL, _IOFBF, RUN_IO_BUFFER);
+
+    while (count && ok) {
+      ok = fwrite(&heap[0]->head, sizeof(record_t), 1, out) == 1;
+      if (!run_next(heap[0])) heap[0] = heap[--count];
+      sift_down(heap, count, 0);
+    }
+    ok = !fclose(out) && ok;
+    close_runs(runs, POSITION_INDEX_MERGE_WAYS);
+    for (i = 0; i < POSITION_INDEX_MERGE_WAYS; i++) {
+      run_path(builder, builder->first_run++, path, sizeof(path));
+      remove(path);
+    }
+  }
+  return ok;
+}
+
+/*
+ *   merge
+ * Merge the sorted runs through a heap into the blocks of the index,
+ * then write the block table and, last, the header
+ *   @param builder the builder, with at most POSITION_INDEX_MERGE_WAYS
+ *                  runs left
+ *   @param path the file to write
+ *   @param num_games the number of games indexed
+ *   @param start_hash the start position's hash, for the header
+ *   @return 0 on success, -1 on failure
+ */
+static int merge(builder_t *builder, const char *path, uint64_t num_games,
+                 uint64_t start_hash)
+{
+  position_index_header_t header;
+  run_t runs[POSITION_INDEX_MERGE_WAYS], *heap[POSITION_INDEX_MERGE_WAYS];
+  int opened = builder->num_runs - builder->first_run, count;
+  block_writer_t writer;
+  bool ok = true;
+
+  memset(&header, 0, sizeof(header));
+  memset(&writer, 0, sizeof(writer));
+  if ((count = open_runs(builder, opened, runs, heap)) < 0) return -1;
+  if (!(writer.handle = fopen(path, "wb"))) {
+    close_runs(runs, opened);
+    return -1;
+  }
+  writer.offset = sizeof(header);
+  ok = fwrite(&header, sizeof(header), 1, writer.handle) == 1;
+
+  /* Pop the smallest head, then refill or drop its run */
+  while (count && ok) {
+    block_add(&writer, &heap[0]->head);
+    if (!run_next(heap[0])) heap[0] = heap[--count];
+    sift_down(heap, count, 0);
+  }
+  block_finish(&writer);
+  close_runs(runs, opened);
+
+  header.magic = POSITION_INDEX_MAGIC;
+  header.version = POSITION_INDEX_VERSION;
+  header.start_hash = start_hash;
+  header.num_postings = atomic_load(&builder->postings);
+  header.num_games = num_games;
+  header.num_blocks = writer.num_blocks;
+  header.blocks_offset = writer.offset;
+  ok = ok && !writer.failed &&
+       fwrite(writer.blocks, sizeof(position_index_block_t),
+              writer.num_blocks, writer.handle) == writer.num_blocks &&
+       !fseek(writer.handle, 0, SEEK_SET) &&
+       fwrite(&header, sizeof(header), 1, writer.handle) == 1;
+  ok = !fclose(writer.handle) && ok;
+  free(writer.blocks);
+  return ok ? 0 : -1;
+}
+
+/*
+ *   open_runs
+ * Open the oldest runs still unmerged and heap them by their first
+ * records
+ *   @param builder the builder
+ *   @param count how many runs, at most POSITION_INDEX_MERGE_WAYS
+ *   @param runs receives the open runs
+ *   @param heap receives the runs that aren't empty, in heap order
+ *   @return the number of runs in the heap, or -1 if one couldn't be
+ *           opened (none are left open then)
+ */
+static int open_runs(builder_t *builder, int count, run_t *runs,
+                     run_t **heap)
+{
+  char path[1024];
+  int live = 0, i;
+
+  for (i = 0; i < count; i++) {
+    run_path(builder, builder->first_run + i, path, sizeof(path));
+    if (!(runs[i].handle = fopen(path, "rb"))) {
+      close_runs(runs, i);
+      return -1;
+    }
+    setvbuf(runs[i].handle, NULL, _IOFBF, RUN_IO_BUFFER);
+    if (run_next(&runs[i])) heap[live++] = &runs[i];
+  }
+  for (i = live / 2 - 1; i >= 0; i--) sift_down(heap, live, i);
+  return live;
+}
+
+/*
+ *   close_runs
+ * Close the first 'count' runs
+ */
+static void close_runs(run_t *runs, int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++) fclose(runs[i].handle);
+}
+
+/*
+ *   run_next
+ * Read a run's next record into its head
+ *   @return false at the end of the run
+ */
+static bool run_next(run_t *run)
+{
+  return fread(&run->head, sizeof(record_t), 1, run->handle) == 1;
+}
+
+/*
+ *   sift_down
+ * Restore the heap order below 'i'
+ */
+static void sift_down(run_t **heap, int count, int i)
+{
+  int child;
+  run_t *moved = heap[i];
+
+  while ((child = 2 * i + 1) < count) {
+    if (child + 1 < count && run_less(heap[child + 1], heap[child])) child++;
+    if (!run_less(heap[child], moved)) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (count) heap[i] = moved;
+}
+
+/*
+ *   run_less
+ * Whether one run's head sorts before another's
+ */
+static bool run_less(const run_t *a, const run_t *b)
+{
+  return compare_records(&a->head, &b->head) < 0;
+}
+
+/*
+ *   block_add
+ * Append a record to the current block, starting a new block first if
+ * the current one is full.  A record is three varints: the hash minus
+ * the one before, the game offset (minus the one before when the hash
+ * is the same), and the ply.  The first record of a block is coded as
+ * if nothing came before it, so every block decodes on its own.
+ *   @param writer the block writer
+ *   @param record the next record, in sorted order
+ */
+static void block_add(block_writer_t *writer, const record_t *record)
+{
+  position_index_block_t *block;
+  uint64_t delta;
+
+  if (writer->open && writer->length >= POSITION_INDEX_BLOCK_SIZE)
+    block_finish(writer);
+
+  if (!writer->open) {
+    if (writer->num_blocks == writer->capacity) {
+      writer->capacity = writer->capacity ? 2 * writer->capacity : 1024;
+      block = realloc(writer->blocks,
+                      writer->capacity * sizeof(position_index_block_t));
+      if (!block) {
+        writer->failed = true;
+        return;
+      }
+      writer->blocks = block;
+    }
+    block = &writer->blocks[writer->num_blocks++];
+    block->first_hash = record->hash;
+    block->offset = writer->offset;
+    block->length = 0;
+    block->count = 0;
+    writer->open = true;
+    writer->length = put_varint(writer->data, 0);
+    writer->length += put_varint(writer->data + writer->length,
+                                 record->game_ply >> 16);
+  }
+  else {
+    block = &writer->blocks[writer->num_blocks - 1];
+    delta = record->hash - writer->last.hash;
+    writer->length += put_varint(writer->data + writer->length, delta);
+    writer->length += put_varint(writer->data + writer->length,
+                                 (record->game_ply >> 16) -
+                                 (delta ? 0 : writer->last.game_ply >> 16));
+  }
+  writer->length += put_varint(writer->data + writer->length,
+                               record->game_ply & 0xFFFF);
+  block->count++;
+  writer->last = *record;
+}
+
+/*
+ *   block_finish
+ * Write out the current block, if it has anything in it
+ *   @param writer the block writer
+ */
+static void block_finish(block_writer_t *writer)
+{
+  position_index_block_t *block;
+
+  if (!writer->open) return;
+  block = &writer->blocks[writer->num_blocks - 1];
+  writer->open = false;
+  block->length = writer->length;
+  if (fwrite(writer->data, 1, writer->length, writer->handle) !=
+      writer->length)
+    writer->failed = true;
+  writer->offset += writer->length;
+}
+
+/*
+ *   put_varint
+ * Write a value seven bits per byte, low bits first, with the top bit
+ * of each byte set when another follows
+ *   @return the number of bytes written
+ */
+static size_t put_varint(unsigned char *out, uint64_t value)
+{
+  size_t length = 0;
+
+  while (value >= 0x80) {
+    out[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+/*
+ *   get_varint
+ * Read a value written by put_varint
+ *   @return the byte after it
+ */
+static const unsigned char* get_varint(const unsigned char *in,
+                                       uint64_t *value)
+{
+  int shift = 0;
+
+  *value = 0;
+  do {
+    *value |= (uint64_t)(*in & 0x7F) << shift;
+    shift += 7;
+  } while (*in++ & 0x80);
+  return in;
+}
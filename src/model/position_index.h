@@ -0,0 +1,98 @@
+#ifndef _POSITION_INDEX_H
+#define _POSITION_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Position index: for every position reached in a PGN database, the
+ * games that reached it.  Postings are (game, ply) pairs, where a game
+ * is named by its byte offset in the PGN file so a hit leads straight
+ * back to the game text.
+ *
+ * Building streams the games through the parallel PGN reader.  Each
+ * thread fills its own buffer of (hash, game, ply) records and, when the
+ * memory budget is used up, sorts it and spills it to a run file; the
+ * runs are then merged into the index.  Nothing but the buffers has to
+ * fit in memory.  No more than POSITION_INDEX_MERGE_WAYS runs are open at
+ * once: while there are more, the oldest are merged into a new run.
+ *
+ * The index file is the sorted postings cut into blocks of about
+ * POSITION_INDEX_BLOCK_SIZE bytes, each record delta coded against the
+ * one before as variable-length integers, followed by a table of every
+ * block's first hash.  A query maps the file, binary searches the block
+ * table and decodes only the block(s) holding the hash.
+ *
+ * Hashes are board_t.hash, which only this program's Zobrist tables
+ * reproduce; the start position's hash is stored to catch a mismatch.
+ */
+
+#define POSITION_INDEX_BLOCK_SIZE  4096
+#define POSITION_INDEX_MERGE_WAYS  64
+#define POSITION_INDEX_MAX_PLY     0xFFFF
+
+/* One game that reached a position */
+struct position_hit {
+  uint64_t game;          /* Byte offset of the game in the PGN file */
+  uint16_t ply;           /* Half-moves played to first reach it */
+};
+typedef struct position_hit position_hit_t;
+
+#define POSITION_INDEX_MAGIC   0x58504A47u /* "GJPX" */
+#define POSITION_INDEX_VERSION 1
+struct position_index_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t start_hash;    /* board_init_start()->hash when built */
+  uint64_t num_postings;
+  uint64_t num_games;
+  uint64_t num_blocks;
+  uint64_t blocks_offset; /* The block table */
+};
+typedef struct position_index_header position_index_header_t;
+
+/* Where a block is and the first hash in it */
+struct position_index_block {
+  uint64_t first_hash;
+  uint64_t offset;
+  uint32_t length;        /* Bytes */
+  uint32_t count;         /* Postings */
+};
+typedef struct position_index_block position_index_block_t;
+
+struct position_index {
+  const unsigned char *mapping;         /* (strong) The whole file */
+  size_t size;
+  const position_index_header_t *header;/* Into the mapping */
+  const position_index_block_t *blocks; /* Into the mapping */
+};
+typedef struct position_index position_index_t;
+
+/* Index every position of every game in 'pgn_path' into 'index_path'.
+ * Run files go in 'temp_dir' and are removed afterwards.  'memory' is the
+ * budget in bytes for all threads' buffers together.  Progress goes to
+ * 'log' if non-NULL.  Returns 0, or -1 on failure (no index is left).
+ */
+int position_index_build(const char *pgn_path, const char *index_path,
+                         const char *temp_dir, int threads, size_t memory,
+                         FILE *log);
+
+/* Map an index.  Returns NULL if it is missing, damaged, or was built
+ * with different Zobrist keys.
+ */
+position_index_t* position_index_open(const char *path);
+
+/* Unmap the index and cleanup its resources */
+void position_index_close(position_index_t *index);
+
+/* Find the games that reached the position with 'hash', in file order,
+ * storing up to 'max' of them in 'hits'.  A game that reached it more
+ * than once (a repetition) is one hit, at the first ply it got there.
+ * Returns the number of games found, which may be more than 'max'.
+ */
+long position_index_query(position_index_t *index, uint64_t hash,
+                          position_hit_t *hits, long max);
+
+#endif
@@ -0,0 +1,380 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "san.h"
+#include "board.h"
+#include "move.h"
+#include "move_gen.h"
+#include "piece.h"
+#include "chess.h"
+
+#define SAN_MAX_CANDIDATES 10   /* Nine queens and one more never fit */
+
+static const int knight_steps[8][2] = {
+  {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}
+};
+static const int king_steps[8][2] = {
+  {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+};
+static const int slider_dirs[8][2] = {
+  {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
+};
+
+static int piece_type_of(char letter);
+static int parse_castle(board_t *board, const char *text, size_t length,
+                        move_t *out);
+static int find_pieces(board_t *board, piece_type_t type, int to_rank,
+                       int to_file, int *squares);
+static int find_pawns(board_t *board, int from_file, bool capture,
+                      int to_rank, int to_file, int *squares);
+static bool legal_move(board_t *board, move_t *move);
+static char check_suffix(board_t *board, move_t *move);
+
+static const char piece_letters[] = "RNBKQP";
+
+/*
+ *   san_parse
+ * Read a SAN move.  The text is parsed from the back: promotion,
+ * destination square, capture mark, then whatever disambiguation is
+ * left in front.
+ *   @param board the position the move is played in
+ *   @param text the move (need not be NUL-terminated)
+ *   @param length the number of bytes of the move
+ *   @param out receives the move, ready for board_make_move
+ *   @return 0 on success, -1 if no legal move fits, -2 if several do
+ */
+int san_parse(board_t *board, const char *text, size_t length, move_t *out)
+{
+  int type = PAWN, promotion = -1, from_file = -1, from_rank = -1;
+  int to_rank, to_file, squares[SAN_MAX_CANDIDATES], count, i, found = 0;
+  int last_rank = board->moves_next == WHITE ? 7 : 0;
+  bool capture = false;
+  piece_t *target;
+  move_t move;
+
+  /* Drop check, mate and annotation marks */
+  while (length && strchr("+#!?", text[length - 1]) ) length--;
+  if (length >= 3 && (text[0] == 'O' || text[0] == '0'))
+    return parse_castle(board, text, length, out);
+
+  if (length && piece_type_of(text[0]) >= 0 && text[0] != 'P') {
+    type = piece_type_of(text[0]);
+    text++;
+    length--;
+  }
+  else if (length && text[0] == 'P') {
+    text++;
+    length--;
+  }
+
+  /* Promotion: "e8=Q" or "e8Q" */
+  if (type == PAWN && length >= 3 && piece_type_of(text[length - 1]) >= 0) {
+    promotion = piece_type_of(text[length - 1]);
+    length -= text[length - 2] == '=' ? 2 : 1;
+    if (promotion == KING || promotion == PAWN) return -1;
+  }
+
+  if (length < 2 || text[length - 2] < 'a' || text[length - 2] > 'h' ||
+      text[length - 1] < '1' || text[length - 1] > '8')
+    return -1;
+  to_file = text[length - 2] - 'a';
+  to_rank = text[length - 1] - '1';
+  length -= 2;
+
+  if (length && (text[length - 1] == 'x' || text[length - 1] == ':')) {
+    capture = true;
+    length--;
+  }
+  for (i = 0; i < (int)length; i++) {
+    if (text[i] >= 'a' && text[i] <= 'h' && from_file < 0)
+      from_file = text[i] - 'a';
+    else if (text[i] >= '1' && text[i] <= '8' && from_rank < 0)
+      from_rank = text[i] - '1';
+    else
+      return -1;
+  }
+  if (type == PAWN && ((to_rank == last_rank) != (promotion >= 0)))
+    return -1;
+
+  /* Own pieces can't be captured */
+  target = board->spaces[to_rank][to_file]->piece;
+  if (target && target->color == board->moves_next) return -1;
+
+  count = type == PAWN
+        ? find_pawns(board, from_file, capture || from_file >= 0, to_rank,
+                     to_file, squares)
+        : find_pieces(board, type, to_rank, to_file, squares);
+
+  for (i = 0; i < count; i++) {
+    if ((from_file >= 0 && SQUARE_FILE(squares[i]) != from_file) ||
+        (from_rank >= 0 && SQUARE_RANK(squares[i]) != from_rank))
+      continue;
+
+    move.from_square = board->spaces[SQUARE_RANK(squares[i])]
+                                    [SQUARE_FILE(squares[i])];
+    move.to_square = board->spaces[to_rank][to_file];
+    move.score = 0;
+    move.promotion = promotion >= 0 ? promotion : QUEEN;
+    move.flags = target ? MOVE_CAPTURE : MOVE_QUIET;
+    if (promotion >= 0) move.flags |= MOVE_PROMOTION;
+    if (type == PAWN && !target && SQUARE_FILE(squares[i]) != to_file)
+      move.flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+    if (type == PAWN && abs(SQUARE_RANK(squares[i]) - to_rank) == 2)
+      move.flags |= MOVE_DOUBLE_PUSH;
+
+    if (!legal_move(board, &move)) continue;
+    if (found++) return -2;
+    *out = move;
+  }
+  return found ? 0 : -1;
+}
+
+/*
+ *   san_write
+ * Write a move as SAN.  A piece move is disambiguated when another legal
+ * move takes a piece of the same type to the same square: by file if
+ * that tells them apart, else by rank, else by both.  The other moves
+ * come from the legal move list if given, else from the same search
+ * san_parse uses, which is far cheaper than generating the list.
+ *   @param board the position before the move
+ *   @param move the move to write
+ *   @param legal the legal moves of the position, or NULL
+ *   @param buffer receives the move, at least SAN_MAX_LENGTH bytes
+ *   @return the length written
+ */
+int san_write(board_t *board, move_t *move, move_list_t *legal,
+              char *buffer)
+{
+  piece_t *piece = move->from_square->piece;
+  bool ambiguous = false, same_file = false, same_rank = false;
+  int length = 0, count, i, squares[SAN_MAX_CANDIDATES];
+  square_t *from;
+  move_t other;
+
+  if (move->flags & MOVE_CASTLE) {
+    strcpy(buffer, move->to_square->file == 6 ? "O-O" : "O-O-O");
+    length = strlen(buffer);
+  }
+  else if (piece->type == PAWN) {
+    if (move->flags & MOVE_CAPTURE) {
+      buffer[length++] = 'a' + move->from_square->file;
+      buffer[length++] = 'x';
+    }
+    buffer[length++] = 'a' + move->to_square->file;
+    buffer[length++] = '1' + move->to_square->rank;
+    if (move->flags & MOVE_PROMOTION) {
+      buffer[length++] = '=';
+      buffer[length++] = piece_letters[move->promotion];
+    }
+  }
+  else {
+    for (i = 0; legal && i < legal->num_moves; i++) {
+      from = legal->moves[i].from_square;
+      if (legal->moves[i].to_square != move->to_square ||
+          from == move->from_square || from->piece->type != piece->type)
+        continue;
+      ambiguous = true;
+      same_file |= from->file == move->from_square->file;
+      same_rank |= from->rank == move->from_square->rank;
+    }
+
+    /* Without the list, try the other pieces that reach the square */
+    count = legal ? 0 : find_pieces(board, piece->type, move->to_square->rank,
+                                    move->to_square->file, squares);
+    for (i = 0; i < count; i++) {
+      other = *move;
+      other.from_square = board->spaces[SQUARE_RANK(squares[i])]
+                                       [SQUARE_FILE(squares[i])];
+      if (other.from_square == move->from_square || !legal_move(board, &other))
+        continue;
+      ambiguous = true;
+      same_file |= other.from_square->file == move->from_square->file;
+      same_rank |= other.from_square->rank == move->from_square->rank;
+    }
+
+    buffer[length++] = piece_letters[piece->type];
+    if (ambiguous && (!same_file || same_rank))
+      buffer[length++] = 'a' + move->from_square->file;
+    if (ambiguous && same_file)
+      buffer[length++] = '1' + move->from_square->rank;
+    if (move->flags & MOVE_CAPTURE) buffer[length++] = 'x';
+    buffer[length++] = 'a' + move->to_square->file;
+    buffer[length++] = '1' + move->to_square->rank;
+  }
+
+  if ((buffer[length] = check_suffix(board, move)) ) length++;
+  buffer[length] = '\0';
+  return length;
+}
+
+/*
+ *   piece_type_of
+ * The piece type of an upper case SAN letter, or -1
+ */
+static int piece_type_of(char letter)
+{
+  switch (letter) {
+    case 'K': return KING;
+    case 'Q': return QUEEN;
+    case 'R': return ROOK;
+    case 'B': return BISHOP;
+    case 'N': return KNIGHT;
+    case 'P': return PAWN;
+    default: return -1;
+  }
+}
+
+/*
+ *   parse_castle
+ * "O-O" or "O-O-O" (or with zeros); castling is rare enough to look up
+ * through the legal move generator
+ *   @return 0 on success, -1 if not castling or not legal
+ */
+static int parse_castle(board_t *board, const char *text, size_t length,
+                        move_t *out)
+{
+  int rank = board->moves_next == WHITE ? 0 : 7;
+  char zero = text[0];
+  uint16_t packed;
+
+  if (length == 3 && text[1] == '-' && text[2] == zero)
+    packed = SQUARE_INDEX(rank, 4) | SQUARE_INDEX(rank, 6) << 6;
+  else if (length == 5 && text[1] == '-' && text[2] == zero &&
+           text[3] == '-' && text[4] == zero)
+    packed = SQUARE_INDEX(rank, 4) | SQUARE_INDEX(rank, 2) << 6;
+  else
+    return -1;
+
+  if (!move_gen_find_packed(board, packed, out) ||
+      !(out->flags & MOVE_CASTLE))
+    return -1;
+  return 0;
+}
+
+/*
+ *   find_pieces
+ * The squares of the mover's pieces of a type that reach a square,
+ * found by looking outward from that square
+ *   @return the number of squares found
+ */
+static int find_pieces(board_t *board, piece_type_t type, int to_rank,
+                       int to_file, int *squares)
+{
+  color_t us = board->moves_next;
+  int count = 0, i, r, f, first, last;
+  const int (*steps)[2] = type == KNIGHT ? knight_steps : king_steps;
+  piece_t *piece;
+
+  if (type == KNIGHT || type == KING) {
+    for (i = 0; i < 8; i++) {
+      r = to_rank + steps[i][0];
+      f = to_file + steps[i][1];
+      if (r < 0 || r >= BOARD_SIZE || f < 0 || f >= BOARD_SIZE) continue;
+      piece = board->spaces[r][f]->piece;
+      if (piece && piece->color == us && piece->type == type &&
+          count < SAN_MAX_CANDIDATES)
+        squares[count++] = SQUARE_INDEX(r, f);
+    }
+    return count;
+  }
+
+  /* Rooks use the straight directions, bishops the diagonals */
+  first = type == BISHOP ? 4 : 0;
+  last = type == ROOK ? 4 : 8;
+  for (i = first; i < last; i++) {
+    for (r = to_rank + slider_dirs[i][0], f = to_file + slider_dirs[i][1];
+         r >= 0 && r < BOARD_SIZE && f >= 0 && f < BOARD_SIZE;
+         r += slider_dirs[i][0], f += slider_dirs[i][1]) {
+      piece = board->spaces[r][f]->piece;
+      if (!piece) continue;
+      if (piece->color == us && piece->type == type &&
+          count < SAN_MAX_CANDIDATES)
+        squares[count++] = SQUARE_INDEX(r, f);
+      break;
+    }
+  }
+  return count;
+}
+
+/*
+ *   find_pawns
+ * The squares of the mover's pawns that could move to a square: one
+ * behind it (or two, from the starting rank), or diagonally behind it
+ * on 'from_file' for a capture
+ *   @return the number of squares found
+ */
+static int find_pawns(board_t *board, int from_file, bool capture,
+                      int to_rank, int to_file, int *squares)
+{
+  color_t us = board->moves_next;
+  int dir = us == WHITE ? 1 : -1, from_rank = to_rank - dir;
+  piece_t *piece;
+
+  if (from_rank < 0 || from_rank >= BOARD_SIZE) return 0;
+
+  if (capture) {
+    if (from_file < 0 || abs(from_file - to_file) != 1) return 0;
+    piece = board->spaces[from_rank][from_file]->piece;
+    if (!piece || piece->color != us || piece->type != PAWN) return 0;
+    if (!board->spaces[to_rank][to_file]->piece &&
+        board->en_passant != SQUARE_INDEX(to_rank, to_file))
+      return 0;
+    squares[0] = SQUARE_INDEX(from_rank, from_file);
+    return 1;
+  }
+
+  if (board->spaces[to_rank][to_file]->piece) return 0;
+  piece = board->spaces[from_rank][to_file]->piece;
+  if (piece && piece->color == us && piece->type == PAWN) {
+    squares[0] = SQUARE_INDEX(from_rank, to_file);
+    return 1;
+  }
+
+  /* Double push from the starting rank over an empty square */
+  if (piece || to_rank != (us == WHITE ? 3 : 4)) return 0;
+  piece = board->spaces[from_rank - dir][to_file]->piece;
+  if (!piece || piece->color != us || piece->type != PAWN) return 0;
+  squares[0] = SQUARE_INDEX(from_rank - dir, to_file);
+  return 1;
+}
+
+/*
+ *   legal_move
+ * Whether a move leaves the mover's king safe
+ */
+static bool legal_move(board_t *board, move_t *move)
+{
+  board_undo_t undo;
+  bool safe;
+
+  board_make_move(board, move, &undo);
+  safe = !move_gen_left_in_check(board);
+  board_unmake_move(board, move, &undo);
+  return safe;
+}
+
+/*
+ *   check_suffix
+ * Play a move to see whether it checks or mates.  Replies are only
+ * generated for the few moves that give check.
+ *   @return '+', '#' or '\0'
+ */
+static char check_suffix(board_t *board, move_t *move)
+{
+  move_list_t *replies;
+  board_undo_t undo;
+  char suffix = '\0';
+
+  board_make_move(board, move, &undo);
+  if (move_gen_in_check(board, board->moves_next)) {
+    suffix = '+';
+    if ((replies = move_list_new()) ) {
+      if (!move_gen_legal(board, replies)) suffix = '#';
+      move_list_destroy(replies);
+    }
+  }
+  board_unmake_move(board, move, &undo);
+  return suffix;
+}
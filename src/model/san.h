@@ -0,0 +1,39 @@
+#ifndef _SAN_H
+#define _SAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "move.h"
+#include "move_list.h"
+
+/*
+ * Standard Algebraic Notation ("Nbd7", "exd6", "e8=Q+", "O-O"), the move
+ * format of PGN.  Reading a SAN move doesn't generate every legal move:
+ * only the pieces of the named type that reach the destination are
+ * looked at, and only those are tried for legality.  Writing one looks
+ * the same way for other pieces that need telling apart, or through
+ * the position's legal move list when the caller already has it.
+ */
+
+#define SAN_MAX_LENGTH 8    /* Longest SAN move ("Qh4xe1+"), NUL included */
+
+/* Find the legal move that 'length' bytes of SAN at 'text' describe.
+ * Check, mate and annotation suffixes (+ # ! ?) are accepted and ignored,
+ * as are castles written with zeros.  Returns 0 and fills 'out' on
+ * success, -1 if the text is not SAN or names no legal move, -2 if it
+ * fits more than one legal move.
+ */
+int san_parse(board_t *board, const char *text, size_t length, move_t *out);
+
+/* Write a legal move of the board as SAN, with '+' or '#' if it gives
+ * check or mate, into 'buffer' (SAN_MAX_LENGTH bytes, NUL-terminated).
+ * 'legal' holds the position's legal moves, or is NULL to look only at
+ * the pieces that could also reach the square.  Returns the length
+ * written.
+ */
+int san_write(board_t *board, move_t *move, move_list_t *legal,
+              char *buffer);
+
+#endif
@@ -0,0 +1,399 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "timer.h"
+#include "chess.h"
+
+/* Every thread's profiling counters.  Each registers its own on its
+ * first measurement; a thread's counts move to 'exited' when it ends.
+ * Totals are kept relative to 'base', the totals at the last reset, so
+ * resetting never writes to another thread's counters.  The lock is only
+ * taken to register, retire and read.
+ */
+_Thread_local profile_counters_t timer_profile_local;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t profile_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profile_key;
+static profile_counters_t *profile_threads = NULL;
+static uint64_t profile_exited[2][PROFILE_NUM_REGIONS];
+static uint64_t profile_base[2][PROFILE_NUM_REGIONS];
+static const char *profile_names[PROFILE_NUM_REGIONS] = {
+  "move_gen",
+  "eval",
+  "search",
+  "render"
+};
+
+static int64_t turn_used_ms(game_clock_t *clock);
+static void profile_create_key(void);
+static void profile_retire(void *counters_as_void);
+static uint64_t profile_total(int counter, profile_region_t region);
+
+/*
+ *   timer_now_ns
+ * Read the monotonic clock.  Unlike wall-clock time it never jumps when
+ * the system time is adjusted, which matters for game clocks.
+ *   @return the current monotonic time in nanoseconds
+ */
+uint64_t timer_now_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/*
+ *   timer_reset
+ * Zero out a timer and leave it stopped
+ *   @param timer the chess_timer_t to reset
+ */
+void timer_reset(chess_timer_t *timer)
+{
+  timer->started_ns = 0;
+  timer->elapsed_ns = 0;
+  timer->running = false;
+}
+
+/*
+ *   timer_start
+ * Start a stopped timer.  Time keeps accumulating on top of whatever the
+ * timer recorded before it was last stopped.
+ *   @param timer the chess_timer_t to start
+ */
+void timer_start(chess_timer_t *timer)
+{
+  if (timer->running) return;
+  timer->started_ns = timer_now_ns();
+  timer->running = true;
+}
+
+/*
+ *   timer_stop
+ * Stop a running timer, banking the time since it was started
+ *   @param timer the chess_timer_t to stop
+ */
+void timer_stop(chess_timer_t *timer)
+{
+  if (!timer->running) return;
+  timer->elapsed_ns += timer_now_ns() - timer->started_ns;
+  timer->running = false;
+}
+
+/*
+ *   timer_elapsed_ms
+ * Report how long a timer has been running in total
+ *   @param timer the chess_timer_t to read
+ *   @return the elapsed time in milliseconds
+ */
+int64_t timer_elapsed_ms(chess_timer_t *timer)
+{
+  uint64_t elapsed = timer->elapsed_ns;
+  if (timer->running)
+    elapsed += timer_now_ns() - timer->started_ns;
+  return (int64_t)(elapsed / 1000000ULL);
+}
+
+/*
+ *   game_clock_init
+ * Create a stopped two-player clock.  WHITE is on move by default.
+ *   @param mode how time is credited after each move
+ *   @param base_ms the starting time for each side
+ *   @param bonus_ms the increment (FISCHER, BRONSTEIN) or delay (DELAY)
+ *   @return a * to the new game_clock_t, or NULL on failure
+ */
+game_clock_t*
+game_clock_init(game_clock_mode_t mode, int64_t base_ms, int64_t bonus_ms)
+{
+  game_clock_t *clock = malloc(sizeof(game_clock_t) );
+  if (!clock) return NULL;
+
+  clock->mode = mode;
+  clock->remaining_ms[WHITE] = base_ms;
+  clock->remaining_ms[BLACK] = base_ms;
+  clock->bonus_ms = bonus_ms;
+  clock->on_move = WHITE;
+  clock->moves[WHITE] = 0;
+  clock->moves[BLACK] = 0;
+  timer_reset(&clock->turn);
+  return clock;
+}
+
+/*
+ *   game_clock_destroy
+ * Cleanup the resources associated with a game clock
+ *   @param clock the game_clock_t to destroy
+ */
+void game_clock_destroy(game_clock_t *clock)
+{
+  free(clock);
+}
+
+/*
+ *   game_clock_start
+ * Start the clock of the given side.  If that side's turn was paused it
+ * resumes where it left off; otherwise a fresh turn begins.
+ *   @param clock the game clock to start
+ *   @param side the side whose time should start running
+ */
+void game_clock_start(game_clock_t *clock, color_t side)
+{
+  if (side != clock->on_move) {
+    game_clock_pause(clock);
+    timer_reset(&clock->turn);
+    clock->on_move = side;
+  }
+  timer_start(&clock->turn);
+}
+
+/*
+ *   game_clock_press
+ * End the turn of the side on move: charge it the time it used, credit
+ * its bonus according to the clock mode, and start the opponent's turn.
+ *   @param clock the game clock to press
+ */
+void game_clock_press(game_clock_t *clock)
+{
+  color_t mover = clock->on_move;
+  int64_t used;
+
+  timer_stop(&clock->turn);
+  used = timer_elapsed_ms(&clock->turn);
+
+  switch (clock->mode) {
+    case GAME_CLOCK_FISCHER:
+      clock->remaining_ms[mover] += clock->bonus_ms - used;
+      break;
+    case GAME_CLOCK_DELAY:
+      if (used > clock->bonus_ms)
+        clock->remaining_ms[mover] -= used - clock->bonus_ms;
+      break;
+    case GAME_CLOCK_BRONSTEIN:
+      clock->remaining_ms[mover] -= used;
+      clock->remaining_ms[mover] += used < clock->bonus_ms ? used : clock->bonus_ms;
+      break;
+    case GAME_CLOCK_UNTIMED:
+    default:
+      break;
+  }
+
+  clock->moves[mover]++;
+  clock->on_move = mover == WHITE ? BLACK : WHITE;
+  timer_reset(&clock->turn);
+  timer_start(&clock->turn);
+}
+
+/*
+ *   game_clock_pause
+ * Stop the running clock without ending the turn
+ *   @param clock the game clock to pause
+ */
+void game_clock_pause(game_clock_t *clock)
+{
+  timer_stop(&clock->turn);
+}
+
+/*
+ *   game_clock_reset
+ * Set a clock back to the start of a game: stopped, both sides on
+ * base_ms, WHITE on move, no moves made.  The mode and bonus are kept.
+ *   @param clock the game clock to reset
+ *   @param base_ms the starting time for each side
+ */
+void game_clock_reset(game_clock_t *clock, int64_t base_ms)
+{
+  clock->remaining_ms[WHITE] = base_ms;
+  clock->remaining_ms[BLACK] = base_ms;
+  clock->on_move = WHITE;
+  clock->moves[WHITE] = 0;
+  clock->moves[BLACK] = 0;
+  timer_reset(&clock->turn);
+}
+
+/*
+ *   game_clock_remaining_ms
+ * The time a side has left at this instant.  For the side on move this
+ * includes the time used so far in the current turn.
+ *   @param clock the game clock to read
+ *   @param side the side to report on
+ *   @return the remaining time in milliseconds (may be negative)
+ */
+int64_t game_clock_remaining_ms(game_clock_t *clock, color_t side)
+{
+  if (side != clock->on_move) return clock->remaining_ms[side];
+  return clock->remaining_ms[side] - turn_used_ms(clock);
+}
+
+/*
+ *   game_clock_flagged
+ * Check whether a side's flag has fallen
+ *   @param clock the game clock to read
+ *   @param side the side to check
+ *   @return true if the side has run out of time in a timed game
+ */
+bool game_clock_flagged(game_clock_t *clock, color_t side)
+{
+  if (clock->mode == GAME_CLOCK_UNTIMED) return false;
+  return game_clock_remaining_ms(clock, side) <= 0;
+}
+
+/*
+ *   turn_used_ms
+ * The time charged so far against the side on move.  In DELAY mode the
+ * first bonus_ms of every turn are free.
+ */
+static int64_t turn_used_ms(game_clock_t *clock)
+{
+  int64_t used = timer_elapsed_ms(&clock->turn);
+
+  switch (clock->mode) {
+    case GAME_CLOCK_UNTIMED:
+      return 0;
+    case GAME_CLOCK_DELAY:
+      return used > clock->bonus_ms ? used - clock->bonus_ms : 0;
+    default:
+      return used;
+  }
+}
+
+/*
+ *   timer_profile_register
+ * Add the calling thread's counters to the totals, and arrange for its
+ * counts to be kept when it exits
+ */
+void timer_profile_register(void)
+{
+  profile_counters_t *counters = &timer_profile_local;
+
+  pthread_once(&profile_once, profile_create_key);
+  pthread_mutex_lock(&profile_lock);
+  counters->next = profile_threads;
+  profile_threads = counters;
+  counters->registered = true;
+  pthread_mutex_unlock(&profile_lock);
+  pthread_setspecific(profile_key, counters);
+}
+
+/*
+ *   timer_profile_cycles
+ * Total cycles spent in a region since the last reset
+ */
+uint64_t timer_profile_cycles(profile_region_t region)
+{
+  return profile_total(0, region);
+}
+
+/*
+ *   timer_profile_calls
+ * Number of completed measurements of a region since the last reset
+ */
+uint64_t timer_profile_calls(profile_region_t region)
+{
+  return profile_total(1, region);
+}
+
+/*
+ *   timer_profile_reset
+ * Zero the counters of every region, by making the current totals the
+ * base the next ones are counted from
+ */
+void timer_profile_reset(void)
+{
+  profile_counters_t *counters;
+  int region;
+
+  pthread_mutex_lock(&profile_lock);
+  for (region = 0; region < PROFILE_NUM_REGIONS; region++) {
+    profile_base[0][region] = profile_exited[0][region];
+    profile_base[1][region] = profile_exited[1][region];
+    for (counters = profile_threads; counters; counters = counters->next) {
+      profile_base[0][region] += atomic_load_explicit(
+        &counters->cycles[region], memory_order_relaxed);
+      profile_base[1][region] += atomic_load_explicit(
+        &counters->calls[region], memory_order_relaxed);
+    }
+  }
+  pthread_mutex_unlock(&profile_lock);
+}
+
+/*
+ *   timer_profile_report
+ * Print the calls, total cycles and cycles per call of every region
+ *   @param out the stream to print to
+ */
+void timer_profile_report(FILE *out)
+{
+  int region;
+  uint64_t calls, cycles;
+
+  fprintf(out, "%-10s %14s %18s %12s\n", "region", "calls", "cycles", "cyc/call");
+  for (region = 0; region < PROFILE_NUM_REGIONS; region++) {
+    calls = timer_profile_calls(region);
+    cycles = timer_profile_cycles(region);
+    fprintf(out, "%-10s %14llu %18llu %12llu\n", profile_names[region],
+            (unsigned long long)calls, (unsigned long long)cycles,
+            (unsigned long long)(calls ? cycles / calls : 0));
+  }
+}
+
+/*
+ *   profile_create_key
+ * Create the key whose destructor retires an exiting thread's counters
+ */
+static void profile_create_key(void)
+{
+  pthread_key_create(&profile_key, profile_retire);
+}
+
+/*
+ *   profile_retire
+ * Thread-exit destructor: fold a thread's counts into 'exited' and drop
+ * its counters from the list before they go away
+ */
+static void profile_retire(void *counters_as_void)
+{
+  profile_counters_t *counters = counters_as_void, **link;
+  int region;
+
+  pthread_mutex_lock(&profile_lock);
+  for (region = 0; region < PROFILE_NUM_REGIONS; region++) {
+    profile_exited[0][region] += atomic_load_explicit(
+      &counters->cycles[region], memory_order_relaxed);
+    profile_exited[1][region] += atomic_load_explicit(
+      &counters->calls[region], memory_order_relaxed);
+  }
+  for (link = &profile_threads; *link; link = &(*link)->next) {
+    if (*link == counters) {
+      *link = counters->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&profile_lock);
+}
+
+/*
+ *   profile_total
+ * Sum one counter of a region over all threads, less the base
+ *   @param counter 0 for cycles, 1 for calls
+ *   @param region the region to sum
+ *   @return the total since the last reset
+ */
+static uint64_t profile_total(int counter, profile_region_t region)
+{
+  profile_counters_t *counters;
+  uint64_t total;
+
+  pthread_mutex_lock(&profile_lock);
+  total = profile_exited[counter][region];
+  for (counters = profile_threads; counters; counters = counters->next)
+    total += atomic_load_explicit(counter ? &counters->calls[region] :
+                                            &counters->cycles[region],
+                                  memory_order_relaxed);
+  total -= profile_base[counter][region];
+  pthread_mutex_unlock(&profile_lock);
+  return total;
+}
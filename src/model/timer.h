@@ -1,17 +1,224 @@
 #ifndef _TIMER_H
 #define _TIMER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "chess.h"
 /*
  * The timer struct is responsible for recording a party's in-game 'play-time'.
  * It is useful as a tool to implement timed chess matches, as well as for
  * aiding performance debugging in resource intensive areas such as computer
  * move searching and ranking.
+ *
+ * The struct is typedef'd as chess_timer_t because timer_t is already taken
+ * by POSIX (<sys/types.h>), which most of the tree includes via <stdlib.h>.
+ *
+ * Three layers are built on the same monotonic clock:
+ *   - chess_timer_t: a start/stop stopwatch measured in nanoseconds
+ *   - game_clock_t: a two-player chess clock with increment/delay modes
+ *   - profile regions: cycle counters accumulated per named code region,
+ *     cheap enough to stay enabled in release builds
+ *
+ * Profiling is inlined into the measured code, and each thread counts
+ * into its own counters, so a measurement costs two counter reads and
+ * two uncontended stores, however many threads are measuring.  Reading
+ * the totals sums every thread's counters (and those of threads that
+ * have exited).
  */
 
-/* Declare piece struct */
+/* Declare timer struct */
 
 struct timer {
+  uint64_t started_ns;  /* Monotonic timestamp of the last timer_start */
+  uint64_t elapsed_ns;  /* Time banked by earlier start/stop runs */
+  bool running;
+};
+typedef struct timer chess_timer_t;
+
+/* How a game clock credits time after each move */
+enum game_clock_mode {
+  GAME_CLOCK_UNTIMED,   /* Clocks count nothing; no side can flag */
+  GAME_CLOCK_FISCHER,   /* Bonus is added after every move */
+  GAME_CLOCK_DELAY,     /* Bonus passes before the clock starts running */
+  GAME_CLOCK_BRONSTEIN  /* Time used is refunded up to the bonus */
+};
+typedef enum game_clock_mode game_clock_mode_t;
+
+/* A chess clock: index per-player arrays with enum color {WHITE, BLACK} */
+struct game_clock {
+  game_clock_mode_t mode;
+  int64_t remaining_ms[2];  /* Time left, not counting the running turn */
+  int64_t bonus_ms;         /* Increment or delay, depending on mode */
+  chess_timer_t turn;       /* Measures the turn of the side on move */
+  color_t on_move;          /* Whose clock is (or was last) running */
+  int moves[2];             /* Completed moves per side */
+};
+typedef struct game_clock game_clock_t;
 
+/* Code regions with their own profiling counters */
+enum profile_region {
+  PROFILE_MOVE_GEN,
+  PROFILE_EVAL,
+  PROFILE_SEARCH,
+  PROFILE_RENDER,
+  PROFILE_NUM_REGIONS
 };
-typedef struct timer timer_t;
+typedef enum profile_region profile_region_t;
+
+/* An in-flight measurement, closed by timer_profile_end */
+struct profile_scope {
+  profile_region_t region;
+  uint64_t start_cycles;
+};
+typedef struct profile_scope profile_scope_t;
+
+/* One thread's profiling counters.  Only the owning thread writes them;
+ * the atomics let the totals be read from any thread meanwhile.
+ */
+struct profile_counters {
+  _Atomic uint64_t cycles[PROFILE_NUM_REGIONS];
+  _Atomic uint64_t calls[PROFILE_NUM_REGIONS];
+  bool registered;                /* Counted in the totals yet */
+  struct profile_counters *next;  /* (weak) Next thread's counters */
+};
+typedef struct profile_counters profile_counters_t;
+
+/* The calling thread's counters (see timer_profile_end) */
+extern _Thread_local profile_counters_t timer_profile_local;
+
+/* Read the monotonic clock in nanoseconds */
+uint64_t timer_now_ns(void);
+
+/* Zero a timer and leave it stopped */
+void timer_reset(chess_timer_t *timer);
+
+/* Start (or resume) a timer */
+void timer_start(chess_timer_t *timer);
+
+/* Stop a timer, banking the time since it was started */
+void timer_stop(chess_timer_t *timer);
+
+/* Total time the timer has been running, in milliseconds */
+int64_t timer_elapsed_ms(chess_timer_t *timer);
+
+/* Create a stopped clock giving both sides base_ms plus bonus_ms/move */
+game_clock_t*
+game_clock_init(game_clock_mode_t mode, int64_t base_ms, int64_t bonus_ms);
+
+/* Cleanup game clock resources */
+void game_clock_destroy(game_clock_t *clock);
+
+/* Start the given side's clock (or resume after a pause) */
+void game_clock_start(game_clock_t *clock, color_t side);
+
+/* The side on move completes its move: credit its bonus and start
+ * the opponent's clock.
+ */
+void game_clock_press(game_clock_t *clock);
+
+/* Stop the running clock without completing a move */
+void game_clock_pause(game_clock_t *clock);
+
+/* Stop the clock and give both sides base_ms again, WHITE on move, as
+ * for a new game
+ */
+void game_clock_reset(game_clock_t *clock, int64_t base_ms);
+
+/* Time a side has left right now, including the running turn */
+int64_t game_clock_remaining_ms(game_clock_t *clock, color_t side);
+
+/* True once a side has run out of time */
+bool game_clock_flagged(game_clock_t *clock, color_t side);
+
+/* Add the calling thread's counters to the totals; done by its first
+ * measurement
+ */
+void timer_profile_register(void);
+
+/*
+ *   timer_cycles
+ * Read the CPU's time-stamp counter where there is one, falling back to
+ * the monotonic clock.  Only differences between readings are meaningful.
+ *   @return the current cycle count
+ */
+static inline uint64_t timer_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return timer_now_ns();
+#endif
+}
+
+/*
+ *   timer_profile_begin
+ * Start measuring a code region.  Prefer TIMER_PROFILE_SCOPE, which ends
+ * the measurement automatically when the scope is left.
+ *   @param region the region being entered
+ *   @return a scope to hand to timer_profile_end
+ */
+static inline profile_scope_t timer_profile_begin(profile_region_t region)
+{
+  profile_scope_t scope;
+  scope.region = region;
+  scope.start_cycles = timer_cycles();
+  return scope;
+}
+
+/*
+ *   timer_profile_end
+ * Finish a measurement and add it to the calling thread's counters.  No
+ * other thread writes them, so a relaxed load and store (no locked
+ * instruction) do.  Takes a pointer so it can serve as a GCC cleanup
+ * handler.
+ *   @param scope the scope returned by timer_profile_begin
+ */
+static inline void timer_profile_end(profile_scope_t *scope)
+{
+  profile_counters_t *counters = &timer_profile_local;
+  uint64_t cycles = timer_cycles() - scope->start_cycles;
+
+  if (!counters->registered) timer_profile_register();
+  atomic_store_explicit(&counters->cycles[scope->region],
+    atomic_load_explicit(&counters->cycles[scope->region],
+                         memory_order_relaxed) + cycles,
+    memory_order_relaxed);
+  atomic_store_explicit(&counters->calls[scope->region],
+    atomic_load_explicit(&counters->calls[scope->region],
+                         memory_order_relaxed) + 1,
+    memory_order_relaxed);
+}
+
+/* Accumulated cycles and calls for a region, over all threads */
+uint64_t timer_profile_cycles(profile_region_t region);
+uint64_t timer_profile_calls(profile_region_t region);
+
+/* Zero all profiling counters */
+void timer_profile_reset(void);
+
+/* Print a table of all regions to the given stream */
+void timer_profile_report(FILE *out);
+
+/* Environment variable: if set, front ends print the profile to stderr
+ * when they exit
+ */
+#define TIMER_PROFILE_ENV "JEGCHESS_PROFILE"
+
+/* Measure the rest of the enclosing scope as 'region'.  Compiles to
+ * nothing when JEGCHESS_NO_PROFILE is defined.
+ */
+#ifdef JEGCHESS_NO_PROFILE
+#define TIMER_PROFILE_SCOPE(region) do {} while (0)
+#else
+#define TIMER_PROFILE_SCOPE(region) \
+  profile_scope_t __attribute__((cleanup(timer_profile_end))) \
+    profile_scope_##region = timer_profile_begin(region)
+#endif
 
 #endif
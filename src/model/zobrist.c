@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "zobrist.h"
+#include "chess.h"
+
+uint64_t zobrist_piece[2][6][NUM_SQUARES];
+uint64_t zobrist_castle[16];
+uint64_t zobrist_en_passant[BOARD_SIZE];
+uint64_t zobrist_side;
+
+static pthread_once_t zobrist_once = PTHREAD_ONCE_INIT;
+
+static void fill_tables(void);
+static uint64_t next_random(uint64_t *state);
+
+/*
+ *   zobrist_init
+ * Generate the key tables exactly once per process
+ */
+void zobrist_init(void)
+{
+  pthread_once(&zobrist_once, fill_tables);
+}
+
+/*
+ *   fill_tables
+ * Generate every key from a fixed seed.  Castling keys are built per
+ * right and combined, so castle[0] is 0 and removing one right changes
+ * the hash by exactly that right's key.
+ */
+static void fill_tables(void)
+{
+  uint64_t state = 0x6A09E667F3BCC908ULL;
+  uint64_t rights[4];
+  int color, type, square, i, mask;
+
+  for (color = 0; color < 2; color++)
+    for (type = 0; type < 6; type++)
+      for (square = 0; square < NUM_SQUARES; square++)
+        zobrist_piece[color][type][square] = next_random(&state);
+
+  for (i = 0; i < 4; i++)
+    rights[i] = next_random(&state);
+  for (mask = 0; mask < 16; mask++) {
+    zobrist_castle[mask] = 0;
+    for (i = 0; i < 4; i++)
+      if (mask & (1 << i)) zobrist_castle[mask] ^= rights[i];
+  }
+
+  for (i = 0; i < BOARD_SIZE; i++)
+    zobrist_en_passant[i] = next_random(&state);
+  zobrist_side = next_random(&state);
+}
+
+/*
+ *   next_random
+ * xorshift64* step: fast, and plenty random for hashing
+ */
+static uint64_t next_random(uint64_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
@@ -0,0 +1,28 @@
+#ifndef _ZOBRIST_H
+#define _ZOBRIST_H
+
+#include <stdint.h>
+#include "chess.h"
+
+/*
+ * Zobrist keys for hashing positions.  A board's hash is the XOR of one
+ * key per (color, piece type, square), the key for its castling rights,
+ * the en passant file key when a capture is possible, and the side key
+ * when BLACK is to move.  Boards keep their hash up to date as pieces
+ * are added, removed and moved.
+ *
+ * The keys come from a fixed-seed generator, so a position hashes to the
+ * same value in every process and build; on-disk tables can store them.
+ */
+
+extern uint64_t zobrist_piece[2][6][NUM_SQUARES];
+extern uint64_t zobrist_castle[16];
+extern uint64_t zobrist_en_passant[BOARD_SIZE];
+extern uint64_t zobrist_side;
+
+/* Fill in the key tables.  Safe to call any number of times, from any
+ * thread; board_init calls it.
+ */
+void zobrist_init(void);
+
+#endif
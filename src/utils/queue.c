@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "queue.h"
+
+/*
+ *   queue_init
+ * Create a queue.  Cell i starts with sequence i, meaning "free for the
+ * push at position i".
+ *   @param capacity the least number of pointers the queue must hold
+ *   @return a * to the queue, or NULL on failure
+ */
+queue_t* queue_init(size_t capacity)
+{
+  size_t size = 2, i;
+  queue_t *queue;
+
+  while (size < capacity) size <<= 1;
+  if (!(queue = malloc(sizeof(queue_t) ))) return NULL;
+  if (!(queue->cells = malloc(size * sizeof(queue_cell_t) ))) {
+    free(queue);
+    return NULL;
+  }
+  for (i = 0; i < size; i++) {
+    atomic_init(&queue->cells[i].sequence, i);
+    queue->cells[i].data = NULL;
+  }
+  queue->mask = size - 1;
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->head, 0);
+  return queue;
+}
+
+/*
+ *   queue_destroy
+ * Cleanup a queue
+ *   @param queue the queue to destroy
+ */
+void queue_destroy(queue_t *queue)
+{
+  if (!queue) return;
+  free(queue->cells);
+  free(queue);
+}
+
+/*
+ *   queue_push
+ * Claim the cell at the tail, if its sequence says it has been emptied
+ * on the previous lap, then publish the pointer by advancing the
+ * sequence past the claimed position.
+ *   @param queue the queue
+ *   @param data the pointer to add
+ *   @return true if added, false if the queue is full
+ */
+bool queue_push(queue_t *queue, void *data)
+{
+  size_t position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  queue_cell_t *cell;
+  long diff;
+
+  for (;;) {
+    cell = &queue->cells[position & queue->mask];
+    diff = (long)(atomic_load_explicit(&cell->sequence, memory_order_acquire)
+                  - position);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->tail, &position,
+                                                position + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+      return false;
+    else
+      position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  }
+
+  cell->data = data;
+  atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+  return true;
+}
+
+/*
+ *   queue_pop
+ * Claim the cell at the head, if its sequence says it has been filled
+ * on this lap, then free it for the push one lap ahead
+ *   @param queue the queue
+ *   @return the oldest pointer, or NULL if the queue is empty
+ */
+void* queue_pop(queue_t *queue)
+{
+  size_t position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  queue_cell_t *cell;
+  void *data;
+  long diff;
+
+  for (;;) {
+    cell = &queue->cells[position & queue->mask];
+    diff = (long)(atomic_load_explicit(&cell->sequence, memory_order_acquire)
+                  - (position + 1));
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->head, &position,
+                                                position + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+      return NULL;
+    else
+      position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  }
+
+  data = cell->data;
+  atomic_store_explicit(&cell->sequence, position + queue->mask + 1,
+                        memory_order_release);
+  return data;
+}
+
+/*
+ *   queue_empty
+ * Whether nothing was waiting to be popped
+ *   @param queue the queue
+ *   @return true if empty
+ */
+bool queue_empty(queue_t *queue)
+{
+  return atomic_load_explicit(&queue->head, memory_order_acquire) ==
+         atomic_load_explicit(&queue->tail, memory_order_acquire);
+}
@@ -0,0 +1,52 @@
+#ifndef _QUEUE_H_
+#define _QUEUE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/*
+ * A bounded lock-free queue of pointers, safe for any number of threads
+ * pushing and popping at once.  Each cell carries a sequence number that
+ * says whether it is ready to be written or read for the current lap
+ * around the ring, so a push or pop costs one compare-and-swap on the
+ * shared position and never blocks on another thread.
+ */
+
+#define QUEUE_CACHE_LINE 64
+
+struct queue_cell {
+  atomic_size_t sequence;
+  void *data;                 /* (weak) */
+};
+typedef struct queue_cell queue_cell_t;
+
+struct queue {
+  queue_cell_t *cells;        /* (strong) */
+  size_t mask;                /* Capacity - 1 */
+  char pad0[QUEUE_CACHE_LINE];
+  atomic_size_t tail;         /* Next cell to push into */
+  char pad1[QUEUE_CACHE_LINE];
+  atomic_size_t head;         /* Next cell to pop from */
+  char pad2[QUEUE_CACHE_LINE];
+};
+typedef struct queue queue_t;
+
+/* Create a queue holding at least 'capacity' pointers (rounded up to a
+ * power of two).  Returns NULL on failure.
+ */
+queue_t* queue_init(size_t capacity);
+
+/* Cleanup a queue.  Pointers still in it are not freed. */
+void queue_destroy(queue_t *queue);
+
+/* Add a pointer.  Returns false, without waiting, if the queue is full. */
+bool queue_push(queue_t *queue, void *data);
+
+/* Take the oldest pointer, or NULL if the queue is empty */
+void* queue_pop(queue_t *queue);
+
+/* Whether the queue looked empty at the time of the call */
+bool queue_empty(queue_t *queue);
+
+#endif
@@ -0,0 +1,253 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "timer.h"
+#include "file-utils.h"
+#include "book.h"
+
+#define KEYS_FILE "test_book_keys.bin"
+#define BOOK_FILE "test_book.bin"
+
+/* A made-up Random64 table, for the file override: the mechanics only
+ * need distinct random-looking words
+ */
+static void utility_write_keys(void)
+{
+  FILE *handle = fopen(KEYS_FILE, "wb");
+  uint64_t state = 0x0123456789ABCDEFULL;
+  int i, byte;
+
+  for (i = 0; i < BOOK_NUM_RANDOM; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    for (byte = 7; byte >= 0; byte--) fputc((state >> (8 * byte)) & 0xFF, handle);
+  }
+  fclose(handle);
+}
+
+static void utility_write_entry(FILE *handle, uint64_t key, int from, int to,
+                                int weight)
+{
+  uint16_t move = to | from << 6;
+  int byte;
+
+  for (byte = 7; byte >= 0; byte--) fputc((key >> (8 * byte)) & 0xFF, handle);
+  fputc(move >> 8, handle);
+  fputc(move & 0xFF, handle);
+  fputc(weight >> 8, handle);
+  fputc(weight & 0xFF, handle);
+  for (byte = 0; byte < 4; byte++) fputc(0, handle);
+}
+
+static uint16_t utility_pack(int from, int to)
+{
+  return from | to << 6;
+}
+
+void setUp(void)
+{
+  utility_write_keys();
+}
+
+void tearDown(void)
+{
+  remove(KEYS_FILE);
+  remove(BOOK_FILE);
+}
+
+void test_book_keys_load_rejects_missing_or_short_files()
+{
+  FILE *handle = fopen(BOOK_FILE, "wb");
+  fputs("too short", handle);
+  fclose(handle);
+
+  TEST_ASSERT_MESSAGE(
+    book_keys_load("no_such_keys.bin") == NULL &&
+    book_keys_load(BOOK_FILE) == NULL,
+    "Expected only a complete Random64 table to load"
+  );
+}
+
+void test_book_key_matches_the_polyglot_reference_keys()
+{
+  /* The worked examples of the Polyglot book format */
+  static const struct {
+    const char *moves;
+    uint64_t key;
+  } references[] = {
+    { "", 0x463B96181691FC9CULL },
+    { "e2e4", 0x823C9B50FD114196ULL },
+    { "e2e4 d7d5", 0x0756B94461C50FB0ULL },
+    { "e2e4 d7d5 e4e5", 0x662FAFB965DB29D4ULL },
+    { "e2e4 d7d5 e4e5 f7f5", 0x22A48B5A8E47FF78ULL },
+    { "e2e4 d7d5 e4e5 f7f5 e1e2", 0x652A607CA3F242C1ULL },
+    { "e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00FDD303C946BDD9ULL },
+    { "a2a4 b7b5 h2h4 b5b4 c2c4", 0x3C8123EA7B067637ULL },
+    { "a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5C3F9B829B279560ULL }
+  };
+  book_keys_t *keys = book_keys_load(NULL);
+  char buffer[64], *save, *token;
+  board_undo_t undo;
+  board_t *board;
+  move_t move;
+  int i;
+
+  TEST_ASSERT_MESSAGE(keys, "Expected the standard table to be built in");
+  for (i = 0; i < (int)(sizeof(references) / sizeof(references[0])); i++) {
+    board = board_init_start();
+    snprintf(buffer, sizeof(buffer), "%s", references[i].moves);
+    for (token = strtok_r(buffer, " ", &save); token;
+         token = strtok_r(NULL, " ", &save)) {
+      TEST_ASSERT_MESSAGE(move_gen_find_string(board, token, &move),
+                          "Expected the reference moves to be legal");
+      board_make_move(board, &move, &undo);
+    }
+    TEST_ASSERT_MESSAGE(book_key(keys, board) == references[i].key,
+                        "Expected the published key of each position");
+    board_destroy(board);
+  }
+  book_keys_destroy(keys);
+}
+
+void test_book_key_depends_on_side_castling_and_en_passant()
+{
+  book_keys_t *keys = book_keys_load(KEYS_FILE);
+  board_t *board = board_init_start();
+  uint64_t start = book_key(keys, board);
+  move_t move;
+  board_undo_t undo;
+
+  board->castle_rights = CASTLE_ALL & ~CASTLE_WHITE_KING;
+  TEST_ASSERT_MESSAGE(
+    book_key(keys, board) == (start ^ keys->random[BOOK_RANDOM_CASTLE]),
+    "Expected each castling right to toggle its own word"
+  );
+  board->castle_rights = CASTLE_ALL;
+
+  /* e2e4: no black pawn can take en passant, so no en passant word */
+  move_gen_find_string(board, "e2e4", &move);
+  board_make_move(board, &move, &undo);
+  TEST_ASSERT_MESSAGE(
+    board->en_passant == NO_SQUARE && book_key(keys, board) != start &&
+    !(book_key(keys, board) == (start ^ keys->random[BOOK_RANDOM_TURN])),
+    "Expected the move and side to move to change the key"
+  );
+
+  book_keys_destroy(keys);
+  board_destroy(board);
+}
+
+void test_book_probe_finds_moves_by_binary_search()
+{
+  book_keys_t *keys = book_keys_load(KEYS_FILE);
+  board_t *board = board_init_start();
+  uint64_t key = book_key(keys, board);
+  book_move_t moves[4];
+  book_t *book;
+  move_t move;
+  FILE *handle = fopen(BOOK_FILE, "wb");
+
+  /* Sorted by key, with the start position in the middle */
+  utility_write_entry(handle, key - 1, 1, 2, 5);
+  utility_write_entry(handle, key, SQUARE_INDEX(1, 4), SQUARE_INDEX(3, 4), 10);
+  utility_write_entry(handle, key, SQUARE_INDEX(1, 3), SQUARE_INDEX(3, 3), 30);
+  utility_write_entry(handle, key + 1, 3, 4, 5);
+  fclose(handle);
+
+  book = book_open(BOOK_FILE, keys);
+  TEST_ASSERT_MESSAGE(book && book->num_entries == 4, "Expected the book to map");
+
+  TEST_ASSERT_MESSAGE(
+    book_moves(book, board, moves, 4) == 2 &&
+    moves[0].move == utility_pack(SQUARE_INDEX(1, 4), SQUARE_INDEX(3, 4)) &&
+    moves[1].weight == 30,
+    "Expected both start position moves with their weights"
+  );
+  TEST_ASSERT_MESSAGE(
+    book_probe(book, board, BOOK_SELECT_BEST, &move) &&
+    move_pack(&move) == utility_pack(SQUARE_INDEX(1, 3), SQUARE_INDEX(3, 3)),
+    "Expected the best-weight selection to pick d2d4"
+  );
+
+  board->moves_next = BLACK;
+  board_refresh(board);
+  TEST_ASSERT_MESSAGE(
+    !book_probe(book, board, BOOK_SELECT_BEST, &move),
+    "Expected no book move for a position not in the book"
+  );
+
+  book_close(book);
+  board_destroy(board);
+}
+
+void test_book_weighted_selection_uses_every_move()
+{
+  book_keys_t *keys = book_keys_load(KEYS_FILE);
+  board_t *board = board_init_start();
+  uint64_t key = book_key(keys, board);
+  uint16_t e4 = utility_pack(SQUARE_INDEX(1, 4), SQUARE_INDEX(3, 4));
+  int i, picked_e4 = 0;
+  book_t *book;
+  move_t move;
+  FILE *handle = fopen(BOOK_FILE, "wb");
+
+  utility_write_entry(handle, key, SQUARE_INDEX(1, 4), SQUARE_INDEX(3, 4), 1);
+  utility_write_entry(handle, key, SQUARE_INDEX(1, 3), SQUARE_INDEX(3, 3), 3);
+  fclose(handle);
+
+  book = book_open(BOOK_FILE, keys);
+  book_seed(book, 42);
+  for (i = 0; i < 400; i++) {
+    book_probe(book, board, BOOK_SELECT_WEIGHTED, &move);
+    if (move_pack(&move) == e4) picked_e4++;
+  }
+  TEST_ASSERT_MESSAGE(
+    picked_e4 > 50 && picked_e4 < 150,
+    "Expected e2e4 about a quarter of the time with weights 1:3"
+  );
+
+  book_close(book);
+  board_destroy(board);
+}
+
+void test_book_converts_polyglot_castling()
+{
+  book_keys_t *keys = book_keys_load(KEYS_FILE);
+  board_t *board = board_init();
+  book_t *book;
+  move_t move;
+  FILE *handle;
+
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 0, 4);
+  board_add_piece(board, piece_init_alive(WHITE, ROOK, 0, 0), 0, 7);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 4);
+  board->castle_rights = CASTLE_WHITE_KING;
+  board_refresh(board);
+
+  /* Polyglot writes O-O as e1h1 */
+  handle = fopen(BOOK_FILE, "wb");
+  utility_write_entry(handle, book_key(keys, board), SQUARE_INDEX(0, 4),
+                      SQUARE_INDEX(0, 7), 1);
+  fclose(handle);
+
+  book = book_open(BOOK_FILE, keys);
+  TEST_ASSERT_MESSAGE(
+    book_probe(book, board, BOOK_SELECT_BEST, &move) &&
+    (move.flags & MOVE_CASTLE) && move.to_square->file == 6,
+    "Expected e1h1 in the book to mean castling to g1"
+  );
+  book_close(book);
+  board_destroy(board);
+}
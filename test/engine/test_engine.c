@@ -0,0 +1,164 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "timer.h"
+#include "history_stack.h"
+#include "file-utils.h"
+#include "material.h"
+#include "endgame.h"
+#include "eval.h"
+#include "trans_table.h"
+#include "time_manager.h"
+#include "search.h"
+#include "engine.h"
+
+static engine_t *engine;
+static uint16_t reported_best;
+static int reports;
+
+static void utility_on_bestmove(uint16_t best, uint16_t ponder, void *user)
+{
+  reported_best = best;
+  reports++;
+}
+
+void setUp(void)
+{
+  engine = engine_init(1);
+  engine_set_callbacks(engine, NULL, utility_on_bestmove, NULL);
+  reported_best = MOVE_NONE;
+  reports = 0;
+}
+
+void tearDown(void)
+{
+  engine_destroy(engine);
+}
+
+void test_engine_plays_legal_moves_only()
+{
+  TEST_ASSERT_MESSAGE(
+    engine_play_move(engine, "e2e4") == 0 &&
+    engine_play_move(engine, "e7e5") == 0 &&
+    engine->board->moves_next == WHITE,
+    "Expected legal moves to be played on the game board"
+  );
+  TEST_ASSERT_MESSAGE(
+    engine_play_move(engine, "e4e5") == -1 &&
+    engine_play_move(engine, "junk") == -1,
+    "Expected illegal or malformed moves to be rejected"
+  );
+}
+
+void test_engine_go_reports_one_legal_move()
+{
+  search_limits_t limits = {0};
+  move_t move;
+
+  limits.depth = 3;
+  TEST_ASSERT_MESSAGE(engine_go(engine, &limits) == 0, "Expected go to start");
+  engine_wait(engine);
+
+  TEST_ASSERT_MESSAGE(
+    reports == 1 && move_gen_find_packed(engine->board, reported_best, &move),
+    "Expected exactly one legal best move report"
+  );
+}
+
+void test_engine_infinite_search_waits_for_stop()
+{
+  search_limits_t limits = {0};
+
+  limits.infinite = true;
+  limits.depth = 1;
+  engine_go(engine, &limits);
+  TEST_ASSERT_MESSAGE(
+    engine_is_thinking(engine) && engine_play_move(engine, "e2e4") == -1,
+    "Expected an infinite search to hold the engine until stopped"
+  );
+
+  engine_stop(engine);
+  engine_wait(engine);
+  TEST_ASSERT_MESSAGE(
+    reports == 1 && !engine_is_thinking(engine) &&
+    engine_play_move(engine, "e2e4") == 0,
+    "Expected stop to release the best move and the engine"
+  );
+}
+
+void test_engine_new_game_resets_the_board()
+{
+  board_t *start = board_init_start();
+
+  engine_play_move(engine, "g1f3");
+  TEST_ASSERT_MESSAGE(
+    engine_new_game(engine) == 0 && board_equal(engine->board, start) &&
+    engine->num_game_hashes == 0,
+    "Expected a new game to return to the starting position"
+  );
+  board_destroy(start);
+}
+
+void test_engine_game_history_can_be_replaced()
+{
+  history_stack_t *history = history_stack_init(16);
+  const char *line[] = { "g1f3", "g8f6", "f3g1", "f6g8" };
+  move_t move;
+  int i;
+
+  /* A front end playing on the engine's board keeps its own history */
+  for (i = 0; i < 4; i++) {
+    move_gen_find_string(engine->board, line[i], &move);
+    history_stack_push(history, engine->board, &move);
+  }
+  TEST_ASSERT_MESSAGE(
+    engine_set_game_history(engine, history->hashes, history->count) == 0 &&
+    engine->num_game_hashes == 4 &&
+    engine->game_hashes[0] == history->hashes[0],
+    "Expected the history to be copied"
+  );
+  TEST_ASSERT_MESSAGE(engine_set_game_history(engine, NULL, 0) == 0 &&
+                      engine->num_game_hashes == 0,
+                      "Expected an empty history to clear it");
+  history_stack_destroy(history);
+}
+
+void test_engine_ponder_search_ignores_clock_until_ponderhit()
+{
+  search_limits_t limits = {0};
+
+  TEST_ASSERT_MESSAGE(
+    engine_ponderhit(engine) == -1,
+    "Expected ponderhit to be refused while idle"
+  );
+
+  limits.ponder = true;
+  limits.use_time = true;
+  limits.time.move_time_ms = 10;
+  engine_go(engine, &limits);
+  usleep(100 * 1000);
+  TEST_ASSERT_MESSAGE(
+    engine_is_thinking(engine) && reports == 0,
+    "Expected pondering to run past the move time"
+  );
+
+  TEST_ASSERT_MESSAGE(
+    engine_ponderhit(engine) == 0,
+    "Expected ponderhit to be accepted while pondering"
+  );
+  engine_wait(engine);
+  TEST_ASSERT_MESSAGE(
+    reports == 1 && reported_best != MOVE_NONE,
+    "Expected the search to report once the clock ran out"
+  );
+}
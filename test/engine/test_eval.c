@@ -0,0 +1,108 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "file-utils.h"
+#include "material.h"
+#include "endgame.h"
+#include "eval.h"
+
+static material_table_t *table;
+
+void setUp(void)
+{
+  table = material_table_init(256);
+}
+
+void tearDown(void)
+{
+  material_table_destroy(table);
+}
+
+void test_eval_start_position_is_balanced()
+{
+  board_t *board = board_init_start();
+  TEST_ASSERT_MESSAGE(
+    eval_evaluate(board, table) == 0,
+    "Expected the symmetric start position to evaluate to 0"
+  );
+  board_destroy(board);
+}
+
+void test_eval_is_from_side_to_move_view()
+{
+  board_t *board = board_init_start();
+  piece_destroy(board_remove_piece(board, 7, 3));
+
+  int white_view = eval_evaluate(board, table);
+  board->moves_next = BLACK;
+  int black_view = eval_evaluate(board, table);
+
+  TEST_ASSERT_MESSAGE(
+    white_view > 800 && black_view == -white_view,
+    "Expected a missing black queen to favor WHITE by the same amount both ways"
+  );
+  board_destroy(board);
+}
+
+void test_eval_knnk_is_a_draw()
+{
+  board_t *board = board_init();
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 0, 4);
+  board_add_piece(board, piece_init_alive(WHITE, KNIGHT, 0, 0), 0, 1);
+  board_add_piece(board, piece_init_alive(WHITE, KNIGHT, 0, 0), 0, 6);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 4);
+
+  TEST_ASSERT_MESSAGE(
+    eval_evaluate(board, table) == EVAL_DRAW,
+    "Expected two knights against a bare king to be a draw"
+  );
+  board_destroy(board);
+}
+
+void test_eval_kbnk_prefers_bishop_colored_corner()
+{
+  /* Dark-squared bishop: the defender belongs in a1 or h8 */
+  board_t *right_corner = board_init();
+  board_add_piece(right_corner, piece_init_alive(WHITE, KING, 0, 0), 2, 2);
+  board_add_piece(right_corner, piece_init_alive(WHITE, BISHOP, 0, 0), 0, 2);
+  board_add_piece(right_corner, piece_init_alive(WHITE, KNIGHT, 0, 0), 3, 3);
+  board_add_piece(right_corner, piece_init_alive(BLACK, KING, 0, 0), 0, 0);
+
+  board_t *wrong_corner = board_init();
+  board_add_piece(wrong_corner, piece_init_alive(WHITE, KING, 0, 0), 5, 2);
+  board_add_piece(wrong_corner, piece_init_alive(WHITE, BISHOP, 0, 0), 0, 2);
+  board_add_piece(wrong_corner, piece_init_alive(WHITE, KNIGHT, 0, 0), 3, 3);
+  board_add_piece(wrong_corner, piece_init_alive(BLACK, KING, 0, 0), 7, 0);
+
+  int right_score = eval_evaluate(right_corner, table);
+  int wrong_score = eval_evaluate(wrong_corner, table);
+  TEST_ASSERT_MESSAGE(
+    right_score > wrong_score && wrong_score > EVAL_KNOWN_WIN,
+    "Expected KBNK to be a known win that favors the bishop's corner"
+  );
+
+  board_destroy(right_corner);
+  board_destroy(wrong_corner);
+}
+
+void test_eval_wrong_rook_pawn_is_a_draw()
+{
+  /* Light bishop, h-pawn: h8 is dark so the defender holds in the corner */
+  board_t *board = board_init();
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 4, 4);
+  board_add_piece(board, piece_init_alive(WHITE, BISHOP, 0, 0), 0, 5);
+  board_add_piece(board, piece_init_alive(WHITE, PAWN, 0, 0), 4, 7);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 7);
+
+  /* Only the small middlegame share of the score survives scaling */
+  TEST_ASSERT_MESSAGE(
+    eval_evaluate(board, table) < eval_piece_value[PAWN],
+    "Expected bishop and wrong rook pawn to be scaled towards a draw"
+  );
+  board_destroy(board);
+}
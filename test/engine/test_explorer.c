@@ -0,0 +1,265 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "file-utils.h"
+#include "fen.h"
+#include "san.h"
+#include "pgn.h"
+#include "book.h"
+#include "explorer.h"
+
+#define KEYS_FILE     "test_explorer_keys.bin"
+#define PGN_FILE      "test_explorer.pgn"
+#define EXPLORER_FILE "test_explorer.jex"
+#define BOOK_FILE     "test_explorer.bin"
+
+#define SPANISH  "1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7"
+#define SICILIAN "1. e4 c5 2. Nf3 d6"
+#define GAMBIT   "1. d4 d5 2. c4"
+
+static book_keys_t *keys;
+static explorer_options_t options;
+
+static void utility_write_keys(void)
+{
+  FILE *handle = fopen(KEYS_FILE, "wb");
+  uint64_t state = 0x0123456789ABCDEFULL;
+  int i, byte;
+
+  for (i = 0; i < BOOK_NUM_RANDOM; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    for (byte = 7; byte >= 0; byte--) fputc((state >> (8 * byte)) & 0xFF, handle);
+  }
+  fclose(handle);
+}
+
+static void utility_game(FILE *handle, const char *moves, const char *result,
+                         bool rated)
+{
+  fprintf(handle, "[Event \"Test\"]\n");
+  if (rated) fprintf(handle, "[WhiteElo \"2400\"]\n[BlackElo \"2200\"]\n");
+  fprintf(handle, "[Result \"%s\"]\n\n%s %s\n\n", result, moves, result);
+}
+
+static void utility_setup(board_t *board, const char *fen)
+{
+  fen_parse(board, fen, strlen(fen), NULL);
+}
+
+/* Find a move's entry among a position's explorer moves */
+static explorer_entry_t* utility_find(explorer_entry_t *entries, int count,
+                                      board_t *board, const char *san)
+{
+  move_t move;
+  int i;
+
+  san_parse(board, san, strlen(san), &move);
+  for (i = 0; i < count; i++)
+    if (entries[i].move == book_polyglot_move(&move)) return &entries[i];
+  return NULL;
+}
+
+void setUp(void)
+{
+  FILE *handle = fopen(PGN_FILE, "w");
+  int i;
+
+  for (i = 0; i < 6; i++)
+    utility_game(handle, SPANISH, i < 4 ? "1-0" : "1/2-1/2", true);
+  for (i = 0; i < 3; i++) utility_game(handle, SICILIAN, "0-1", true);
+  for (i = 0; i < 2; i++) utility_game(handle, GAMBIT, "1/2-1/2", false);
+  fclose(handle);
+
+  utility_write_keys();
+  keys = book_keys_load(KEYS_FILE);
+  explorer_default_options(&options);
+  options.threads = 2;
+  options.max_ply = 9;
+  options.book_min_games = 3;
+}
+
+void tearDown(void)
+{
+  book_keys_destroy(keys);
+  remove(KEYS_FILE);
+  remove(PGN_FILE);
+  remove(EXPLORER_FILE);
+  remove(BOOK_FILE);
+}
+
+void test_explorer_counts_moves_results_and_ratings()
+{
+  explorer_entry_t entries[EXPLORER_MAX_MOVES], *e4, *d4;
+  board_t *board = board_init_start();
+  explorer_t *explorer;
+  int count;
+
+  TEST_ASSERT_MESSAGE(
+    explorer_build(PGN_FILE, EXPLORER_FILE, NULL, keys, &options, NULL) == 0,
+    "Expected the explorer to build"
+  );
+  explorer = explorer_open(EXPLORER_FILE);
+  TEST_ASSERT_MESSAGE(explorer && explorer->header->num_games == 11,
+                      "Expected the table to open with all 11 games");
+
+  count = explorer_moves(explorer, book_key(keys, board), entries,
+                         EXPLORER_MAX_MOVES);
+  e4 = utility_find(entries, count, board, "e4");
+  d4 = utility_find(entries, count, board, "d4");
+  TEST_ASSERT_MESSAGE(
+    count == 2 && e4 && d4 && e4->games == 9 && e4->white_wins == 4 &&
+    e4->draws == 2 && e4->black_wins == 3 && d4->games == 2 &&
+    d4->draws == 2,
+    "Expected 1. e4 in 9 games and 1. d4 in 2, with their results"
+  );
+  TEST_ASSERT_MESSAGE(
+    e4->rated_games == 9 && e4->rating_sum / e4->rated_games == 2300 &&
+    d4->rated_games == 0,
+    "Expected the average rating of the rated games only"
+  );
+
+  /* 5... Be7 is the 10th ply, past max_ply */
+  utility_setup(board, "r1bqkb1r/1ppp1ppp/p1n2n2/4p3/B3P3/5N2/PPPP1PPP/"
+                       "RNBQ1RK1 b kq - 5 5");
+  TEST_ASSERT_MESSAGE(
+    explorer_moves(explorer, book_key(keys, board), entries, 4) == 0,
+    "Expected nothing past the ply limit"
+  );
+
+  explorer_close(explorer);
+  board_destroy(board);
+}
+
+void test_explorer_writes_a_polyglot_book()
+{
+  book_move_t moves[4];
+  board_t *board = board_init_start();
+  book_keys_t *book_keys = book_keys_load(KEYS_FILE);
+  board_undo_t undo;
+  move_t move;
+  book_t *book;
+
+  TEST_ASSERT_MESSAGE(
+    explorer_build(PGN_FILE, EXPLORER_FILE, BOOK_FILE, keys, &options,
+                   NULL) == 0,
+    "Expected the explorer and book to build"
+  );
+  book = book_open(BOOK_FILE, book_keys);
+
+  /* 1. d4 was played twice, under the 3-game minimum */
+  TEST_ASSERT_MESSAGE(
+    book && book_moves(book, board, moves, 4) == 1 &&
+    moves[0].move == (SQUARE_INDEX(1, 4) | SQUARE_INDEX(3, 4) << 6) &&
+    moves[0].weight == 10,
+    "Expected only 1. e4, weighted 2 per win and 1 per draw"
+  );
+
+  /* Black scored better with 1... c5, so it comes first */
+  san_parse(board, "e4", 2, &move);
+  board_make_move(board, &move, &undo);
+  TEST_ASSERT_MESSAGE(
+    book_moves(book, board, moves, 4) == 2 && moves[0].weight == 6 &&
+    moves[1].weight == 2,
+    "Expected black's replies ordered by weight"
+  );
+
+  utility_setup(board, "r1bqkb1r/1ppp1ppp/p1n2n2/4p3/B3P3/5N2/PPPP1PPP/"
+                       "RNBQK2R w KQkq - 4 5");
+  TEST_ASSERT_MESSAGE(
+    book_probe(book, board, BOOK_SELECT_BEST, &move) &&
+    (move.flags & MOVE_CASTLE) && move.to_square->file == 6,
+    "Expected castling written the Polyglot way and read back"
+  );
+
+  book_close(book);
+  board_destroy(board);
+}
+
+/* Write 'count' games of random legal moves over PGN_FILE */
+static void utility_random_games(int count, int plies)
+{
+  FILE *handle = fopen(PGN_FILE, "w");
+  board_t *board = board_init_start();
+  board_undo_t undo[64];
+  move_list_t *legal = move_list_new();
+  move_t played[64];
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  char san[SAN_MAX_LENGTH];
+  int game, ply;
+
+  for (game = 0; game < count; game++) {
+    fprintf(handle, "[Event \"Random %d\"]\n\n", game);
+    for (ply = 0; ply < plies; ply++) {
+      move_list_clear(legal);
+      if (move_gen_legal(board, legal) <= 0) break;
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      played[ply] = legal->moves[state % legal->num_moves];
+      san_write(board, &played[ply], legal, san);
+      if (ply % 2 == 0) fprintf(handle, "%d. ", ply / 2 + 1);
+      fprintf(handle, "%s ", san);
+      board_make_move(board, &played[ply], &undo[ply]);
+    }
+    fprintf(handle, "1/2-1/2\n\n");
+    while (ply--) board_unmake_move(board, &played[ply], &undo[ply]);
+  }
+  move_list_destroy(legal);
+  board_destroy(board);
+  fclose(handle);
+}
+
+void test_explorer_merges_more_runs_than_it_opens_at_once()
+{
+  explorer_entry_t entries[EXPLORER_MAX_MOVES];
+  board_t *board = board_init_start();
+  explorer_t *explorer;
+  uint32_t games = 0;
+  int count, i;
+
+  /* Random games rarely share a position past the first few moves, so
+   * one thread's smallest map spills every hundred games or so */
+  utility_random_games(EXPLORER_MERGE_WAYS * 120, 40);
+  options.threads = 1;
+  options.memory = 1;
+  options.max_ply = 40;
+  TEST_ASSERT_MESSAGE(
+    explorer_build(PGN_FILE, EXPLORER_FILE, NULL, keys, &options, NULL) == 0,
+    "Expected the explorer to build from many runs"
+  );
+  explorer = explorer_open(EXPLORER_FILE);
+  count = explorer_moves(explorer, book_key(keys, board), entries,
+                         EXPLORER_MAX_MOVES);
+  for (i = 0; i < count; i++) games += entries[i].games;
+  TEST_ASSERT_MESSAGE(
+    explorer && count <= 20 && games == EXPLORER_MERGE_WAYS * 120,
+    "Expected each first move once, counting every game"
+  );
+
+  explorer_close(explorer);
+  board_destroy(board);
+}
+
+void test_explorer_rejects_bad_input()
+{
+  TEST_ASSERT_MESSAGE(
+    explorer_build("no_such_games.pgn", EXPLORER_FILE, NULL, keys, &options,
+                   NULL) == -1 &&
+    !file_utils_exists(EXPLORER_FILE) &&
+    explorer_open(PGN_FILE) == NULL,
+    "Expected missing games and non-explorer files to fail"
+  );
+}
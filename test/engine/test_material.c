@@ -0,0 +1,154 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "file-utils.h"
+#include "material.h"
+#include "endgame.h"
+#include "eval.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* Build a board holding only the two kings */
+static board_t* utility_create_kings_only(int wk_rank, int wk_file,
+                                          int bk_rank, int bk_file)
+{
+  board_t *board = board_init();
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), wk_rank, wk_file);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), bk_rank, bk_file);
+  return board;
+}
+
+void test_material_table_init_rounds_to_power_of_two()
+{
+  material_table_t *table = material_table_init(1000);
+  TEST_ASSERT_MESSAGE(
+    table != NULL && table->num_entries == 1024,
+    "Expected material table size to round up to 1024"
+  );
+  material_table_destroy(table);
+}
+
+void test_material_probe_start_position_is_full_phase()
+{
+  material_table_t *table = material_table_init(64);
+  board_t *board = board_init_start();
+  material_entry_t *entry = material_table_probe(table, board);
+
+  TEST_ASSERT_MESSAGE(
+    entry->phase == PHASE_MAX,
+    "Expected the starting position to be at full middlegame phase"
+  );
+  TEST_ASSERT_MESSAGE(
+    entry->eval_fn == NULL && entry->imbalance == 0,
+    "Expected no endgame function and a balanced start position"
+  );
+
+  board_destroy(board);
+  material_table_destroy(table);
+}
+
+void test_material_probe_returns_cached_entry()
+{
+  material_table_t *table = material_table_init(64);
+  board_t *board = board_init_start();
+  material_entry_t *first = material_table_probe(table, board);
+  material_entry_t *second = material_table_probe(table, board);
+
+  TEST_ASSERT_MESSAGE(
+    first == second && first->key == board->material_key,
+    "Expected a second probe to hit the cached entry"
+  );
+
+  board_destroy(board);
+  material_table_destroy(table);
+}
+
+void test_endgame_material_key_matches_board()
+{
+  board_t *board = utility_create_kings_only(0, 4, 7, 4);
+  board_add_piece(board, piece_init_alive(BLACK, BISHOP, 0, 0), 5, 5);
+  board_add_piece(board, piece_init_alive(BLACK, KNIGHT, 0, 0), 5, 6);
+
+  TEST_ASSERT_MESSAGE(
+    endgame_material_key("KBNvK", BLACK) == board->material_key,
+    "Expected 'KBNvK' for BLACK to match the board's material key"
+  );
+  board_destroy(board);
+}
+
+void test_material_probe_recognizes_kbnk_for_either_color()
+{
+  material_table_t *table = material_table_init(64);
+  board_t *board = utility_create_kings_only(0, 4, 7, 4);
+  board_add_piece(board, piece_init_alive(BLACK, BISHOP, 0, 0), 5, 5);
+  board_add_piece(board, piece_init_alive(BLACK, KNIGHT, 0, 0), 5, 6);
+
+  material_entry_t *entry = material_table_probe(table, board);
+  TEST_ASSERT_MESSAGE(
+    entry->eval_fn == endgame_eval_kbnk && entry->eval_strong_side == BLACK,
+    "Expected KBNK to be dispatched to its evaluator with BLACK as strong side"
+  );
+
+  board_destroy(board);
+  material_table_destroy(table);
+}
+
+void test_material_probe_uses_kxk_for_lone_king()
+{
+  material_table_t *table = material_table_init(64);
+  board_t *board = utility_create_kings_only(0, 4, 7, 4);
+  board_add_piece(board, piece_init_alive(WHITE, ROOK, 0, 0), 0, 0);
+
+  material_entry_t *entry = material_table_probe(table, board);
+  TEST_ASSERT_MESSAGE(
+    entry->eval_fn == endgame_eval_kxk && entry->eval_strong_side == WHITE,
+    "Expected KRK to be handled by the lone-king evaluator"
+  );
+
+  board_destroy(board);
+  material_table_destroy(table);
+}
+
+void test_material_probe_scales_minor_without_pawns_to_draw()
+{
+  material_table_t *table = material_table_init(64);
+  board_t *board = utility_create_kings_only(0, 4, 7, 4);
+  board_add_piece(board, piece_init_alive(WHITE, BISHOP, 0, 0), 0, 2);
+
+  material_entry_t *entry = material_table_probe(table, board);
+  TEST_ASSERT_MESSAGE(
+    entry->default_scale[WHITE] == SCALE_DRAW,
+    "Expected a lone bishop to have no winning chances"
+  );
+
+  board_destroy(board);
+  material_table_destroy(table);
+}
+
+void test_material_probe_flags_opposite_bishops()
+{
+  material_table_t *table = material_table_init(64);
+  board_t *board = utility_create_kings_only(0, 4, 7, 4);
+  board_add_piece(board, piece_init_alive(WHITE, BISHOP, 0, 0), 0, 2);
+  board_add_piece(board, piece_init_alive(BLACK, BISHOP, 0, 0), 7, 2);
+  board_add_piece(board, piece_init_alive(WHITE, PAWN, 0, 0), 1, 0);
+
+  material_entry_t *entry = material_table_probe(table, board);
+  TEST_ASSERT_MESSAGE(
+    entry->scale_fn[WHITE] == endgame_scale_opposite_bishops,
+    "Expected bishops-and-pawns material to get the opposite-bishop scaler"
+  );
+  TEST_ASSERT_MESSAGE(
+    endgame_scale_opposite_bishops(board, WHITE) != SCALE_NONE,
+    "Expected c1 and c8 bishops to be recognized as opposite colored"
+  );
+
+  board_destroy(board);
+  material_table_destroy(table);
+}
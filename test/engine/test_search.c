@@ -0,0 +1,219 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "timer.h"
+#include "history_stack.h"
+#include "file-utils.h"
+#include "material.h"
+#include "endgame.h"
+#include "eval.h"
+#include "trans_table.h"
+#include "time_manager.h"
+#include "search.h"
+
+static material_table_t *material;
+static trans_table_t *table;
+static search_t *search;
+
+void setUp(void)
+{
+  material = material_table_init(256);
+  table = trans_table_init(1);
+  search = search_init(material, table);
+}
+
+void tearDown(void)
+{
+  search_destroy(search);
+  trans_table_destroy(table);
+  material_table_destroy(material);
+}
+
+static uint16_t utility_pack(int from_rank, int from_file, int to_rank,
+                             int to_file)
+{
+  return SQUARE_INDEX(from_rank, from_file)
+       | SQUARE_INDEX(to_rank, to_file) << 6;
+}
+
+static void utility_on_info(const search_info_t *info, void *user)
+{
+  *(search_info_t *)user = *info;
+}
+
+void test_search_finds_back_rank_mate()
+{
+  /* White: Kg1, Ra1; Black: Kg8, pawns f7 g7 h7.  Ra8 mates. */
+  board_t *board = board_init();
+  search_limits_t limits = {0};
+  search_info_t info = {0};
+  uint16_t best;
+
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 0, 6);
+  board_add_piece(board, piece_init_alive(WHITE, ROOK, 0, 0), 0, 0);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 6);
+  board_add_piece(board, piece_init_alive(BLACK, PAWN, 0, 0), 6, 5);
+  board_add_piece(board, piece_init_alive(BLACK, PAWN, 0, 0), 6, 6);
+  board_add_piece(board, piece_init_alive(BLACK, PAWN, 0, 0), 6, 7);
+
+  limits.depth = 4;
+  search_set_info_callback(search, utility_on_info, &info);
+  best = search_run(search, board, &limits, NULL);
+
+  TEST_ASSERT_MESSAGE(
+    best == utility_pack(0, 0, 7, 0),
+    "Expected Ra8 to be found as the mating move"
+  );
+  TEST_ASSERT_MESSAGE(
+    info.score == EVAL_MATE - 1 && info.pv_length >= 1,
+    "Expected a mate-in-one score in the last report"
+  );
+  TEST_ASSERT_MESSAGE(
+    board->hash == board_compute_hash(board),
+    "Expected the search to leave the board as it found it"
+  );
+  board_destroy(board);
+}
+
+void test_search_wins_hanging_queen()
+{
+  /* White to move: Rd1 can take the undefended black queen on d5 */
+  board_t *board = board_init();
+  search_limits_t limits = {0};
+
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 0, 6);
+  board_add_piece(board, piece_init_alive(WHITE, ROOK, 0, 0), 0, 3);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 6);
+  board_add_piece(board, piece_init_alive(BLACK, QUEEN, 0, 0), 4, 3);
+
+  limits.depth = 3;
+  TEST_ASSERT_MESSAGE(
+    search_run(search, board, &limits, NULL) == utility_pack(0, 3, 4, 3),
+    "Expected Rxd5 winning the queen"
+  );
+  board_destroy(board);
+}
+
+void test_search_returns_none_without_legal_moves()
+{
+  /* Black to move, stalemated: Kh8 vs White Kf7, Qg6 */
+  board_t *board = board_init();
+  search_limits_t limits = {0};
+  uint16_t ponder = 1;
+
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 7);
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 6, 5);
+  board_add_piece(board, piece_init_alive(WHITE, QUEEN, 0, 0), 5, 6);
+  board->moves_next = BLACK;
+  board_refresh(board);
+
+  limits.depth = 2;
+  TEST_ASSERT_MESSAGE(
+    search_run(search, board, &limits, &ponder) == MOVE_NONE &&
+    ponder == MOVE_NONE,
+    "Expected no move in a stalemate"
+  );
+  board_destroy(board);
+}
+
+void test_search_respects_node_limit()
+{
+  board_t *board = board_init_start();
+  search_limits_t limits = {0};
+  uint16_t best;
+  move_t move;
+
+  limits.nodes = 1000;
+  best = search_run(search, board, &limits, NULL);
+  TEST_ASSERT_MESSAGE(
+    search->nodes <= 1000 + 1 &&
+    move_gen_find_packed(board, best, &move),
+    "Expected a legal move within the node budget"
+  );
+  board_destroy(board);
+}
+
+void test_search_stop_request_persists_until_reset()
+{
+  board_t *board = board_init_start();
+  search_limits_t limits = {0};
+  move_t move;
+
+  search_stop(search);
+  TEST_ASSERT_MESSAGE(
+    move_gen_find_packed(board, search_run(search, board, &limits, NULL),
+                         &move) && search->nodes <= 1,
+    "Expected a stopped search to return a legal move at once"
+  );
+
+  search_reset_stop(search);
+  limits.depth = 2;
+  search_run(search, board, &limits, NULL);
+  TEST_ASSERT_MESSAGE(
+    search->nodes > 20,
+    "Expected a reset search to run normally"
+  );
+  board_destroy(board);
+}
+
+static void utility_collect_lines(const search_info_t *info, void *user)
+{
+  search_info_t *lines = user;
+  lines[info->multipv - 1] = *info;
+}
+
+void test_search_multipv_reports_distinct_lines()
+{
+  board_t *board = board_init_start();
+  search_limits_t limits = {0};
+  search_info_t lines[3] = {{0}};
+  uint16_t best;
+
+  limits.depth = 3;
+  limits.multipv = 3;
+  search_set_info_callback(search, utility_collect_lines, lines);
+  best = search_run(search, board, &limits, NULL);
+
+  TEST_ASSERT_MESSAGE(
+    lines[0].depth == 3 && lines[1].depth == 3 && lines[2].depth == 3,
+    "Expected every line to be reported at the final depth"
+  );
+  TEST_ASSERT_MESSAGE(
+    lines[0].pv[0] == best && lines[0].pv[0] != lines[1].pv[0] &&
+    lines[0].pv[0] != lines[2].pv[0] && lines[1].pv[0] != lines[2].pv[0],
+    "Expected each line to start with a different move, best first"
+  );
+  TEST_ASSERT_MESSAGE(
+    lines[0].score >= lines[1].score && lines[0].score >= lines[2].score,
+    "Expected no later line to beat the first"
+  );
+  board_destroy(board);
+}
+
+void test_search_multipv_is_capped_by_legal_moves()
+{
+  /* WHITE's king in the corner has three moves */
+  board_t *board = board_init();
+  search_limits_t limits = {0};
+
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0), 0, 0);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0), 7, 7);
+  limits.depth = 2;
+  limits.multipv = 10;
+  search_run(search, board, &limits, NULL);
+
+  TEST_ASSERT_MESSAGE(
+    search->num_lines == 3,
+    "Expected no more lines than legal moves"
+  );
+  board_destroy(board);
+}
@@ -0,0 +1,259 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "timer.h"
+#include "history_stack.h"
+#include "file-utils.h"
+#include "material.h"
+#include "endgame.h"
+#include "eval.h"
+#include "trans_table.h"
+#include "time_manager.h"
+#include "search.h"
+#include "tablebase.h"
+#include "tablebase_gen.h"
+
+#define TB_DIR "test_tablebase_dir"
+
+static tablebase_t *tablebase;
+
+void setUp(void)
+{
+  mkdir(TB_DIR, 0755);
+  tablebase_generate("KQvK", TB_DIR, 2, NULL);
+  tablebase_generate("KRvK", TB_DIR, 1, NULL);
+  tablebase = tablebase_open(TB_DIR);
+}
+
+void tearDown(void)
+{
+  tablebase_close(tablebase);
+  remove(TB_DIR "/KQvK.jtb");
+  remove(TB_DIR "/KRvK.jtb");
+  rmdir(TB_DIR);
+}
+
+/* Three pieces: two kings and one more, squares as rank * 8 + file */
+static board_t* utility_board(color_t strong, piece_type_t type,
+                              int strong_king, int piece, int weak_king,
+                              color_t to_move)
+{
+  board_t *board = board_init();
+  color_t weak = OTHER_COLOR(strong);
+
+  board_add_piece(board, piece_init_alive(strong, KING, 0, 0),
+                  SQUARE_RANK(strong_king), SQUARE_FILE(strong_king) );
+  board_add_piece(board, piece_init_alive(strong, type, 0, 0),
+                  SQUARE_RANK(piece), SQUARE_FILE(piece) );
+  board_add_piece(board, piece_init_alive(weak, KING, 0, 0),
+                  SQUARE_RANK(weak_king), SQUARE_FILE(weak_king) );
+  board->moves_next = to_move;
+  board_refresh(board);
+  return board;
+}
+
+static int utility_longest_win(const char *name)
+{
+  tb_layout_t layout;
+  tb_table_t *table = NULL;
+  uint64_t index;
+  int i, wdl, longest = -1;
+
+  tb_layout_parse(name, &layout);
+  for (i = 0; i < TB_HASH_SLOTS; i++) {
+    if (tablebase->slots[i] &&
+        tablebase->slots[i]->layout.material_key == layout.material_key)
+      table = tablebase->slots[i];
+  }
+  if (!table) return -1;
+
+  for (index = 0; index < table->layout.num_positions; index++) {
+    wdl = (table->wdl[index >> 2] >> ((index & 3) * 2)) & 3;
+    if (wdl == TB_WIN && table->dtm[index] > longest)
+      longest = table->dtm[index];
+  }
+  return longest;
+}
+
+void test_tablebase_layout_parse()
+{
+  tb_layout_t layout, other;
+
+  TEST_ASSERT_MESSAGE(
+    tb_layout_parse("KvKQ", &layout) == 0 &&
+    !strcmp(layout.name, "KQvK") && layout.num_pieces == 3 &&
+    layout.colors[2] == WHITE && layout.types[2] == QUEEN &&
+    layout.num_positions == 2 * 10 * 64 * 64,
+    "Expected the stronger side to become WHITE in a pawnless layout"
+  );
+  TEST_ASSERT_MESSAGE(
+    tb_layout_parse("KRvKP", &layout) == 0 && layout.has_pawns &&
+    layout.num_positions == 2ULL * 32 * 64 * 64 * 64,
+    "Expected pawns to confine the first king to four files only"
+  );
+  TEST_ASSERT_MESSAGE(
+    tb_layout_parse("KNvKB", &layout) == 0 &&
+    tb_layout_parse("KBvKN", &other) == 0 &&
+    !strcmp(layout.name, other.name) &&
+    layout.material_key == other.material_key,
+    "Expected both spellings of a signature to give the same table"
+  );
+  TEST_ASSERT_MESSAGE(
+    tb_layout_parse("KQ", &layout) == -1 &&
+    tb_layout_parse("KKvK", &layout) == -1 &&
+    tb_layout_parse("QvK", &layout) == -1 &&
+    tb_layout_parse("KQRBvKN", &layout) == -1,
+    "Expected malformed and oversized signatures to be rejected"
+  );
+}
+
+void test_tablebase_index_symmetry()
+{
+  tb_layout_t layout;
+  board_t *board, *mirrored;
+
+  tb_layout_parse("KRvK", &layout);
+  /* Kc3 Rb7 vs Ke5, and the same mirrored through the long diagonal */
+  board = utility_board(WHITE, ROOK, 18, 49, 36, WHITE);
+  mirrored = utility_board(WHITE, ROOK, 18, 14, 36, WHITE);
+
+  TEST_ASSERT_MESSAGE(
+    tb_layout_index(&layout, board, false) >= 0 &&
+    tb_layout_index(&layout, board, false) ==
+    tb_layout_index(&layout, mirrored, false),
+    "Expected symmetric positions to share an index"
+  );
+  TEST_ASSERT_MESSAGE(
+    tb_layout_index(&layout, board, true) == -1,
+    "Expected a color-flipped lookup to miss when the colors don't match"
+  );
+
+  board_destroy(board);
+  board_destroy(mirrored);
+}
+
+void test_tablebase_probe_results()
+{
+  tb_result_t result;
+  board_t *board;
+
+  TEST_ASSERT_MESSAGE(
+    tablebase && tablebase->num_tables == 2 && tablebase->max_pieces == 3,
+    "Expected the generated tables to be mapped"
+  );
+
+  /* Kg6 Qa7 vs Kh8: Qg7 or Qa8 mates */
+  board = utility_board(WHITE, QUEEN, 46, 48, 63, WHITE);
+  TEST_ASSERT_MESSAGE(
+    tablebase_probe(tablebase, board, &result) &&
+    result.wdl == TB_WIN && result.dtm == 1,
+    "Expected a mate in one ply"
+  );
+  board_destroy(board);
+
+  /* Kg6 Qg7 vs Kh8, black to move: checkmated */
+  board = utility_board(WHITE, QUEEN, 46, 54, 63, BLACK);
+  TEST_ASSERT_MESSAGE(
+    tablebase_probe(tablebase, board, &result) &&
+    result.wdl == TB_LOSS && result.dtm == 0,
+    "Expected a checkmate to be a loss at distance 0"
+  );
+  board_destroy(board);
+
+  /* Kc7 Qb6 vs Ka8, black to move: stalemate */
+  board = utility_board(WHITE, QUEEN, 50, 41, 56, BLACK);
+  TEST_ASSERT_MESSAGE(
+    tablebase_probe(tablebase, board, &result) && result.wdl == TB_DRAW,
+    "Expected a stalemate to be a draw"
+  );
+  board_destroy(board);
+
+  /* Ka1 Qg7 vs Kh8, black to move: the queen is lost */
+  board = utility_board(WHITE, QUEEN, 0, 54, 63, BLACK);
+  TEST_ASSERT_MESSAGE(
+    tablebase_probe(tablebase, board, &result) && result.wdl == TB_DRAW,
+    "Expected capturing the unprotected queen to draw"
+  );
+  board_destroy(board);
+
+  /* The first position with colors swapped and ranks mirrored */
+  board = utility_board(BLACK, QUEEN, 22, 8, 7, BLACK);
+  TEST_ASSERT_MESSAGE(
+    tablebase_probe(tablebase, board, &result) &&
+    result.wdl == TB_WIN && result.dtm == 1,
+    "Expected a color-flipped probe to find the same mate"
+  );
+  board_destroy(board);
+
+  /* Kg6 Bg7 vs Kh8: no KBvK table was generated */
+  board = utility_board(WHITE, BISHOP, 46, 54, 63, BLACK);
+  TEST_ASSERT_MESSAGE(
+    !tablebase_probe(tablebase, board, &result),
+    "Expected no result for material without a table"
+  );
+  board_destroy(board);
+}
+
+void test_tablebase_longest_mates()
+{
+  /* Known maxima: KQvK mates in 10 moves, KRvK in 16 */
+  TEST_ASSERT_MESSAGE(
+    utility_longest_win("KQvK") == 19,
+    "Expected the longest KQvK win to take 19 plies"
+  );
+  TEST_ASSERT_MESSAGE(
+    utility_longest_win("KRvK") == 31,
+    "Expected the longest KRvK win to take 31 plies"
+  );
+}
+
+void test_tablebase_search_plays_shortest_mate()
+{
+  material_table_t *material = material_table_init(256);
+  trans_table_t *table = trans_table_init(1);
+  search_t *search = search_init(material, table);
+  search_limits_t limits = {0};
+  tb_result_t before, after;
+  board_undo_t undo;
+  move_t move;
+  uint16_t best;
+
+  /* Kd3 Rh1 vs Ke5 */
+  board_t *board = utility_board(WHITE, ROOK, 19, 7, 36, WHITE);
+  tablebase_probe(tablebase, board, &before);
+
+  limits.depth = 2;
+  search_set_tablebase(search, tablebase);
+  best = search_run(search, board, &limits, NULL);
+
+  TEST_ASSERT_MESSAGE(
+    move_gen_find_packed(board, best, &move),
+    "Expected a legal move"
+  );
+  board_make_move(board, &move, &undo);
+  TEST_ASSERT_MESSAGE(
+    before.wdl == TB_WIN && search->tb_hits > 0 &&
+    tablebase_probe(tablebase, board, &after) &&
+    after.wdl == TB_LOSS && after.dtm == before.dtm - 1,
+    "Expected the search to keep to the shortest mate"
+  );
+  board_unmake_move(board, &move, &undo);
+
+  board_destroy(board);
+  search_destroy(search);
+  trans_table_destroy(table);
+  material_table_destroy(material);
+}
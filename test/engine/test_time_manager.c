@@ -0,0 +1,110 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "timer.h"
+#include "time_manager.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_time_manager_null_control_is_unlimited()
+{
+  time_manager_t tm;
+  time_manager_init(&tm, NULL);
+  TEST_ASSERT_MESSAGE(
+    !tm.limited && !time_manager_should_stop(&tm, 1000000),
+    "Expected a search without a time control never to be stopped"
+  );
+}
+
+void test_time_manager_move_time_sets_both_deadlines()
+{
+  time_manager_t tm;
+  time_control_t control = {0, 0, 0, 500, 20};
+  time_manager_init(&tm, &control);
+  TEST_ASSERT_MESSAGE(
+    tm.optimum_ms == 480 && tm.maximum_ms == 480,
+    "Expected movetime minus overhead for both deadlines"
+  );
+}
+
+void test_time_manager_sudden_death_spreads_the_clock()
+{
+  time_manager_t tm;
+  time_control_t control = {60000, 0, 0, 0, 0};
+  time_manager_init(&tm, &control);
+  TEST_ASSERT_MESSAGE(
+    tm.optimum_ms == 60000 / 40,
+    "Expected a sudden-death clock to be spread over 40 moves"
+  );
+  TEST_ASSERT_MESSAGE(
+    tm.maximum_ms > tm.optimum_ms && tm.maximum_ms <= 60000 * 80 / 100,
+    "Expected the hard deadline to exceed the optimum but keep a reserve"
+  );
+}
+
+void test_time_manager_last_move_before_control_keeps_reserve()
+{
+  time_manager_t tm;
+  time_control_t control = {1000, 0, 1, 0, 50};
+  time_manager_init(&tm, &control);
+  TEST_ASSERT_MESSAGE(
+    tm.maximum_ms < 1000,
+    "Expected the hard deadline to stay below the remaining clock"
+  );
+}
+
+void test_time_manager_unstable_best_move_extends_target()
+{
+  time_manager_t stable, unstable;
+  time_control_t control = {60000, 1000, 0, 0, 0};
+  int i;
+
+  time_manager_init(&stable, &control);
+  time_manager_init(&unstable, &control);
+  for (i = 0; i < 6; i++) {
+    time_manager_iteration_done(&stable, false, 10);
+    time_manager_iteration_done(&unstable, true, 10);
+  }
+
+  TEST_ASSERT_MESSAGE(
+    stable.target_ms < stable.optimum_ms &&
+    unstable.target_ms > unstable.optimum_ms,
+    "Expected stability to cut and instability to extend the target"
+  );
+}
+
+void test_time_manager_score_drop_extends_target()
+{
+  time_manager_t tm;
+  time_control_t control = {60000, 0, 0, 0, 0};
+  time_manager_init(&tm, &control);
+
+  time_manager_iteration_done(&tm, true, 50);
+  int64_t before = tm.target_ms;
+  time_manager_iteration_done(&tm, true, -100);
+
+  TEST_ASSERT_MESSAGE(
+    tm.target_ms > before,
+    "Expected a falling score to extend the soft deadline"
+  );
+}
+
+void test_time_manager_only_reads_clock_every_interval()
+{
+  time_manager_t tm;
+  time_control_t control = {0, 0, 0, 1, 0};
+  time_manager_init(&tm, &control);
+  tm.maximum_ms = 0;
+
+  TEST_ASSERT_MESSAGE(
+    !time_manager_should_stop(&tm, tm.check_interval - 1),
+    "Expected no clock read before the check interval"
+  );
+  TEST_ASSERT_MESSAGE(
+    time_manager_should_stop(&tm, tm.check_interval),
+    "Expected the expired deadline to be noticed at the check interval"
+  );
+}
@@ -0,0 +1,82 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "trans_table.h"
+
+static trans_table_t *table;
+
+void setUp(void)
+{
+  table = trans_table_init(1);
+}
+
+void tearDown(void)
+{
+  trans_table_destroy(table);
+}
+
+void test_trans_table_size_is_a_power_of_two_within_budget()
+{
+  TEST_ASSERT_MESSAGE(
+    (table->num_buckets & (table->num_buckets - 1)) == 0 &&
+    table->num_buckets * TRANS_TABLE_BUCKET_SIZE * sizeof(trans_entry_t)
+      <= 1024 * 1024,
+    "Expected a power-of-two bucket count that fits in 1MB"
+  );
+}
+
+void test_trans_table_stores_and_probes()
+{
+  trans_entry_t *entry;
+
+  TEST_ASSERT_MESSAGE(
+    trans_table_probe(table, 0x1234) == NULL,
+    "Expected an empty table to miss"
+  );
+
+  trans_table_store(table, 0x1234, 77, -150, 6, TT_BOUND_LOWER);
+  entry = trans_table_probe(table, 0x1234);
+  TEST_ASSERT_MESSAGE(
+    entry && entry->move == 77 && entry->score == -150 &&
+    entry->depth == 6 && entry->bound == TT_BOUND_LOWER,
+    "Expected the stored entry to come back unchanged"
+  );
+
+  trans_table_clear(table);
+  TEST_ASSERT_MESSAGE(
+    trans_table_probe(table, 0x1234) == NULL,
+    "Expected a cleared table to miss"
+  );
+}
+
+void test_trans_table_keeps_move_when_overwritten_without_one()
+{
+  trans_table_store(table, 0x42, 99, 10, 4, TT_BOUND_EXACT);
+  trans_table_store(table, 0x42, 0, 20, 5, TT_BOUND_UPPER);
+
+  TEST_ASSERT_MESSAGE(
+    trans_table_probe(table, 0x42)->move == 99,
+    "Expected a move-less store to keep the known move"
+  );
+}
+
+void test_trans_table_replaces_oldest_shallowest_entry()
+{
+  uint64_t stride = table->num_buckets;
+  int i;
+
+  /* Fill one bucket, then age the table and store one more position */
+  for (i = 0; i < TRANS_TABLE_BUCKET_SIZE; i++)
+    trans_table_store(table, 1 + i * stride, 0, 0, 10 + i, TT_BOUND_EXACT);
+  trans_table_new_search(table);
+  trans_table_store(table, 1 + i * stride, 0, 0, 1, TT_BOUND_EXACT);
+
+  TEST_ASSERT_MESSAGE(
+    trans_table_probe(table, 1) == NULL &&
+    trans_table_probe(table, 1 + stride) != NULL &&
+    trans_table_probe(table, 1 + i * stride) != NULL,
+    "Expected the shallowest entry of the full bucket to be replaced"
+  );
+}
@@ -2,10 +2,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "board.h"
 #include "square.h"
 #include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
 #include "file-utils.h"
 
 void setUp(void) {}
@@ -347,3 +352,177 @@ void test_board_load_from_file_returns_null_if_filename_doesnt_exist()
     "Expected board_load_from_file to return NULL when given non-existent file"
   );
 }
+
+void test_board_init_start_material_key_counts_pieces()
+{
+  board_t *board = board_init_start();
+  TEST_ASSERT_MESSAGE(
+    board_material_count(board, WHITE, PAWN) == 8 &&
+    board_material_count(board, BLACK, KNIGHT) == 2 &&
+    board_material_count(board, WHITE, QUEEN) == 1,
+    "Expected material key to count the starting pieces"
+  );
+  board_destroy(board);
+}
+
+void test_board_add_and_remove_piece_update_material_key()
+{
+  board_t *board = board_init();
+  board_add_piece(board, piece_init_alive(BLACK, ROOK, 0, 0), 3, 3);
+  TEST_ASSERT_MESSAGE(
+    board_material_count(board, BLACK, ROOK) == 1,
+    "Expected board_add_piece to add the rook to the material key"
+  );
+
+  piece_t *removed = board_remove_piece(board, 3, 3);
+  TEST_ASSERT_MESSAGE(
+    removed != NULL && board->spaces[3][3]->piece == NULL,
+    "Expected board_remove_piece to lift the rook off its square"
+  );
+  TEST_ASSERT_MESSAGE(
+    board->material_key == 0,
+    "Expected the material key to be empty after removing the only piece"
+  );
+
+  piece_destroy(removed);
+  board_destroy(board);
+}
+
+void test_board_pack_start_position_layout()
+{
+  board_t *board = board_init_start();
+  board_packed_t packed;
+
+  TEST_ASSERT_MESSAGE(
+    sizeof(board_packed_t) == BOARD_PACKED_SIZE &&
+    board_pack(board, &packed) == 0,
+    "Expected the starting position to pack into 32 bytes"
+  );
+  /* Ranks 1, 2, 7 and 8 occupied; a1 holds a WHITE ROOK (code 0) and
+   * a knight (code 1) follows; a8 holds a BLACK ROOK (code 8)
+   */
+  TEST_ASSERT_MESSAGE(
+    packed.bytes[0] == 0xFF && packed.bytes[1] == 0xFF &&
+    packed.bytes[2] == 0x00 && packed.bytes[5] == 0x00 &&
+    packed.bytes[6] == 0xFF && packed.bytes[7] == 0xFF &&
+    packed.bytes[8] == 0x01 && packed.bytes[20] == 0x89,
+    "Expected a big-endian occupancy bitboard followed by piece codes"
+  );
+  TEST_ASSERT_MESSAGE(
+    packed.bytes[24] == (CASTLE_ALL << 1) && packed.bytes[25] == 0xFF &&
+    packed.bytes[26] == 0 && packed.bytes[27] == 0 &&
+    packed.bytes[28] == 0 && packed.bytes[29] == 1,
+    "Expected WHITE to move with all castling rights at move 1"
+  );
+
+  board_destroy(board);
+}
+
+void test_board_unpack_restores_game_state()
+{
+  board_t *board = board_init_start(), *copy = board_init();
+  board_packed_t packed;
+  board_undo_t undo;
+  move_t move;
+
+  /* 1. e4 Nf6 2. e5 d5: en passant on d6, BLACK's king side rook moved */
+  move_gen_find_string(board, "e2e4", &move);
+  board_make_move(board, &move, &undo);
+  move_gen_find_string(board, "g8f6", &move);
+  board_make_move(board, &move, &undo);
+  move_gen_find_string(board, "e4e5", &move);
+  board_make_move(board, &move, &undo);
+  move_gen_find_string(board, "d7d5", &move);
+  board_make_move(board, &move, &undo);
+  board->castle_rights &= ~CASTLE_BLACK_KING;
+  board->hash = board_compute_hash(board);
+
+  TEST_ASSERT_MESSAGE(
+    board_pack(board, &packed) == 0 && board_unpack(copy, &packed) == 0,
+    "Expected a game position to pack and unpack"
+  );
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, copy) && copy->hash == board->hash &&
+    copy->material_key == board->material_key &&
+    copy->en_passant == SQUARE_INDEX(5, 3) &&
+    copy->castle_rights == (CASTLE_ALL & ~CASTLE_BLACK_KING) &&
+    copy->fullmove_number == 3 && copy->kings[BLACK] != NULL,
+    "Expected the unpacked board to match, game state included"
+  );
+
+  board_destroy(board);
+  board_destroy(copy);
+}
+
+void test_board_unpack_rejects_malformed_records()
+{
+  board_t *board = board_init_start(), *target = board_init_start();
+  board_packed_t packed, bad;
+
+  board_pack(board, &packed);
+
+  bad = packed;
+  bad.bytes[8] = 0x07;  /* Piece type 7 doesn't exist */
+  TEST_ASSERT_MESSAGE(
+    board_unpack(target, &bad) == -1,
+    "Expected an invalid piece code to be rejected"
+  );
+  bad = packed;
+  bad.bytes[25] = 64;
+  TEST_ASSERT_MESSAGE(
+    board_unpack(target, &bad) == -1,
+    "Expected an invalid en passant square to be rejected"
+  );
+  bad = packed;
+  bad.bytes[3] = 0xFF;  /* 40 pieces */
+  TEST_ASSERT_MESSAGE(
+    board_unpack(target, &bad) == -1,
+    "Expected more than 32 pieces to be rejected"
+  );
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, target),
+    "Expected a rejected record to leave the board untouched"
+  );
+
+  board_destroy(board);
+  board_destroy(target);
+}
+
+void test_board_packed_batch_round_trip()
+{
+  const char *filename = "test_board_batch.bin";
+  board_packed_t *out = malloc(1000 * sizeof(board_packed_t) );
+  board_packed_t *in = malloc(1000 * sizeof(board_packed_t) );
+  board_t *board = board_init_start();
+  FILE *handle;
+  int i;
+
+  /* Vary the side to move and clocks so every record differs */
+  for (i = 0; i < 1000; i++) {
+    board->halfmove_clock = i % 100;
+    board->fullmove_number = i + 1;
+    board->moves_next = i % 2 ? BLACK : WHITE;
+    board_pack(board, &out[i]);
+  }
+
+  handle = fopen(filename, "wb");
+  TEST_ASSERT_MESSAGE(
+    board_write_packed(handle, out, 1000) == 1000,
+    "Expected 1000 records to be written in one call"
+  );
+  fclose(handle);
+
+  handle = fopen(filename, "rb");
+  TEST_ASSERT_MESSAGE(
+    board_read_packed(handle, in, 1000) == 1000 &&
+    !memcmp(in, out, 1000 * sizeof(board_packed_t) ) &&
+    board_read_packed(handle, in, 1) == 0,
+    "Expected the same 1000 records back and then end of file"
+  );
+  fclose(handle);
+
+  remove(filename);
+  free(out);
+  free(in);
+  board_destroy(board);
+}
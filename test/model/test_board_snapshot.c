@@ -0,0 +1,151 @@
+#include "unity.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "fen.h"
+#include "board_snapshot.h"
+
+#define STRESS_PUBLICATIONS 200000
+
+static board_t *board;
+static board_snapshot_t *snapshot;
+
+/* Shared with the reader thread of the stress test */
+static board_packed_t positions[2];
+static atomic_bool publishing;
+
+void setUp(void)
+{
+  board = board_init_start();
+  snapshot = board_snapshot_init(board);
+}
+
+void tearDown(void)
+{
+  board_snapshot_destroy(snapshot);
+  board_destroy(board);
+}
+
+void test_board_snapshot_publishes_new_positions()
+{
+  board_packed_t expected, read;
+  board_undo_t undo;
+  move_t move;
+
+  board_pack(board, &expected);
+  TEST_ASSERT_MESSAGE(
+    board_snapshot_read(snapshot, &read) == 0 &&
+    !memcmp(&read, &expected, sizeof(read)),
+    "Expected the initial position as version 0"
+  );
+
+  move_gen_find_string(board, "e2e4", &move);
+  board_make_move(board, &move, &undo);
+  TEST_ASSERT_MESSAGE(board_snapshot_version(snapshot) == 0 &&
+                      board_snapshot_read(snapshot, &read) == 0 &&
+                      !memcmp(&read, &expected, sizeof(read)),
+                      "Expected nothing new before publishing");
+
+  board_snapshot_publish(snapshot, board);
+  board_pack(board, &expected);
+  TEST_ASSERT_MESSAGE(
+    board_snapshot_version(snapshot) == 1 &&
+    board_snapshot_read(snapshot, &read) == 1 &&
+    !memcmp(&read, &expected, sizeof(read)),
+    "Expected the published position as version 1"
+  );
+
+  board_unmake_move(board, &move, &undo);
+  board_snapshot_publish(snapshot, board);
+  board_snapshot_publish(snapshot, board);
+  board_pack(board, &expected);
+  TEST_ASSERT_MESSAGE(board_snapshot_read(snapshot, &read) == 3 &&
+                      !memcmp(&read, &expected, sizeof(read)),
+                      "Expected each publication to count");
+}
+
+void test_board_snapshot_decodes_the_squares()
+{
+  const char *fen = "4k3/8/8/8/8/8/4P3/R3K3 w Q - 0 1";
+  uint8_t squares[NUM_SQUARES];
+  board_packed_t read;
+  int square, pieces = 0;
+
+  fen_parse(board, fen, strlen(fen), NULL);
+  board_snapshot_publish(snapshot, board);
+  board_snapshot_read(snapshot, &read);
+  board_snapshot_squares(&read, squares);
+
+  for (square = 0; square < NUM_SQUARES; square++) {
+    piece_t *piece =
+      board->spaces[SQUARE_RANK(square)][SQUARE_FILE(square)]->piece;
+    pieces += squares[square] != BOARD_SNAPSHOT_EMPTY;
+    TEST_ASSERT_MESSAGE(
+      piece ? squares[square] == (piece->color << 3 | piece->type) :
+              squares[square] == BOARD_SNAPSHOT_EMPTY,
+      "Expected every square to match the board"
+    );
+  }
+  TEST_ASSERT_MESSAGE(pieces == 4, "Expected four pieces");
+}
+
+static void* utility_publish(void *unused)
+{
+  board_t *boards[2];
+  int i;
+
+  boards[0] = board_init_start();
+  boards[1] = board_init();
+  board_unpack(boards[1], &positions[1]);
+  for (i = 0; i < STRESS_PUBLICATIONS; i++)
+    board_snapshot_publish(snapshot, boards[i & 1]);
+  atomic_store(&publishing, false);
+
+  board_destroy(boards[0]);
+  board_destroy(boards[1]);
+  return NULL;
+}
+
+void test_board_snapshot_reads_are_never_torn()
+{
+  const char *fen = "r3k2r/8/8/3pP3/8/8/8/R3K2R w KQkq d6 7 42";
+  board_t *other = board_init();
+  board_packed_t read;
+  pthread_t writer;
+  uint64_t version, last = 0;
+  long reads = 0, torn = 0, backwards = 0;
+
+  board_pack(board, &positions[0]);
+  fen_parse(other, fen, strlen(fen), NULL);
+  board_pack(other, &positions[1]);
+  atomic_store(&publishing, true);
+  pthread_create(&writer, NULL, utility_publish, NULL);
+
+  while (atomic_load(&publishing) ) {
+    version = board_snapshot_read(snapshot, &read);
+    torn += memcmp(&read, &positions[0], sizeof(read)) &&
+            memcmp(&read, &positions[1], sizeof(read));
+    backwards += version < last;
+    last = version;
+    reads++;
+  }
+  pthread_join(writer, NULL);
+
+  TEST_ASSERT_MESSAGE(reads > 0 && torn == 0,
+                      "Expected every read to be a published position");
+  TEST_ASSERT_MESSAGE(backwards == 0, "Expected versions never to go back");
+  TEST_ASSERT_MESSAGE(board_snapshot_version(snapshot) ==
+                      STRESS_PUBLICATIONS,
+                      "Expected every publication counted");
+  board_destroy(other);
+}
@@ -0,0 +1,196 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "file-utils.h"
+#include "fen.h"
+
+#define KIWIPETE \
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"
+
+static board_t *board;
+
+void setUp(void)
+{
+  board = board_init();
+}
+
+void tearDown(void)
+{
+  board_destroy(board);
+}
+
+static int utility_parse(const char *text)
+{
+  return fen_parse(board, text, strlen(text), NULL);
+}
+
+void test_fen_parse_start_position_matches_board_init_start()
+{
+  board_t *start = board_init_start();
+
+  TEST_ASSERT_MESSAGE(
+    utility_parse(FEN_START_POSITION) == 0,
+    "Expected the starting FEN to parse"
+  );
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, start) && board->hash == start->hash &&
+    board->castle_rights == CASTLE_ALL && board->en_passant == NO_SQUARE &&
+    board->material_key == start->material_key &&
+    board->kings[WHITE] && board->kings[BLACK],
+    "Expected the same board as board_init_start"
+  );
+  board_destroy(start);
+}
+
+void test_fen_write_round_trips()
+{
+  const char *fens[] = {
+    FEN_START_POSITION,
+    KIWIPETE,
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 12 40",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "4k3/8/8/8/8/8/8/4K2R b K - 99 120",
+  };
+  char text[FEN_MAX_LENGTH];
+  int i;
+
+  for (i = 0; i < 5; i++) {
+    TEST_ASSERT_MESSAGE(
+      utility_parse(fens[i]) == 0 &&
+      fen_write(board, text, sizeof(text)) == (int)strlen(fens[i]) &&
+      !strcmp(text, fens[i]),
+      "Expected a parsed FEN to be written back unchanged"
+    );
+  }
+  TEST_ASSERT_MESSAGE(
+    fen_write(board, text, 10) == -1,
+    "Expected a too-small buffer to be refused"
+  );
+}
+
+void test_fen_parse_normalizes_rights()
+{
+  char text[FEN_MAX_LENGTH];
+
+  /* No black pawn can take on e3; the h1 rook is missing */
+  utility_parse("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBN1 b KQkq e3 0 1");
+  fen_write(board, text, sizeof(text));
+  TEST_ASSERT_MESSAGE(
+    !strcmp(text, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBN1 b Qkq - 0 1"),
+    "Expected unusable castling and en passant rights to be dropped"
+  );
+  TEST_ASSERT_MESSAGE(
+    board->hash == board_compute_hash(board),
+    "Expected the hash to match the normalized rights"
+  );
+}
+
+void test_fen_parse_epd_operations()
+{
+  const char *epd = "1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - - "
+                    "bm Qd1+; id \"BK.01\";\n";
+  size_t consumed;
+  char value[32];
+
+  TEST_ASSERT_MESSAGE(
+    fen_parse(board, epd, strlen(epd), &consumed) == 0 &&
+    board->halfmove_clock == 0 && board->fullmove_number == 1 &&
+    board->moves_next == BLACK,
+    "Expected an EPD record without move counters to parse"
+  );
+  TEST_ASSERT_MESSAGE(
+    fen_epd_operation(epd + consumed, strlen(epd) - consumed, "bm", value,
+                      sizeof(value)) && !strcmp(value, "Qd1+"),
+    "Expected the best move operation"
+  );
+  TEST_ASSERT_MESSAGE(
+    fen_epd_operation(epd + consumed, strlen(epd) - consumed, "id", value,
+                      sizeof(value)) && !strcmp(value, "BK.01") &&
+    !fen_epd_operation(epd + consumed, strlen(epd) - consumed, "am", value,
+                       sizeof(value)),
+    "Expected the quoted id and no avoid-move operation"
+  );
+  fen_write_epd(board, value, sizeof(value));
+  TEST_ASSERT_MESSAGE(
+    fen_write_epd(board, value, 8) == -1,
+    "Expected EPD output to respect the buffer size"
+  );
+}
+
+void test_fen_parse_rejects_bad_syntax_without_touching_board()
+{
+  board_t *start = board_init_start();
+
+  utility_parse(FEN_START_POSITION);
+  TEST_ASSERT_MESSAGE(
+    utility_parse("rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") == -1 &&
+    utility_parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1") == -1 &&
+    utility_parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNX w KQkq - 0 1") == -1 &&
+    utility_parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1") == -1 &&
+    utility_parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KZkq - 0 1") == -1 &&
+    utility_parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e4 0 1") == -1 &&
+    utility_parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0") == -1,
+    "Expected malformed FENs to be rejected as syntax errors"
+  );
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, start),
+    "Expected a syntax error to leave the board alone"
+  );
+  board_destroy(start);
+}
+
+void test_fen_parse_rejects_illegal_positions()
+{
+  TEST_ASSERT_MESSAGE(
+    utility_parse("4k3/8/8/8/8/8/8/3KK3 w - - 0 1") == -2,
+    "Expected two white kings to be illegal"
+  );
+  TEST_ASSERT_MESSAGE(
+    utility_parse("4k2P/8/8/8/8/8/8/4K3 w - - 0 1") == -2,
+    "Expected a pawn on the last rank to be illegal"
+  );
+  TEST_ASSERT_MESSAGE(
+    utility_parse("4k3/8/8/8/8/8/8/4K2r b - - 0 1") == -2,
+    "Expected the side that just moved being in check to be illegal"
+  );
+  TEST_ASSERT_MESSAGE(
+    fen_board("4k3/8/8/8/8/8/8/4K2r b - - 0 1") == NULL &&
+    fen_board(NULL) == NULL,
+    "Expected fen_board to refuse illegal positions"
+  );
+}
+
+void test_fen_parsed_board_generates_correct_moves()
+{
+  /* Known perft counts of the "Kiwipete" position */
+  TEST_ASSERT_MESSAGE(
+    utility_parse(KIWIPETE) == 0 &&
+    move_gen_perft(board, 1) == 48 && move_gen_perft(board, 2) == 2039 &&
+    move_gen_perft(board, 3) == 97862,
+    "Expected perft 48/2039/97862 from Kiwipete"
+  );
+}
+
+void test_fen_parse_reuses_board_pieces()
+{
+  utility_parse(FEN_START_POSITION);
+  utility_parse(KIWIPETE);
+  utility_parse("8/8/8/4k3/8/3K4/8/7R w - - 0 1");
+  TEST_ASSERT_MESSAGE(
+    board->kings[WHITE] && board->kings[WHITE]->rank == 2 &&
+    board->kings[WHITE]->file == 3 &&
+    board_material_count(board, WHITE, ROOK) == 1 &&
+    board_material_count(board, BLACK, PAWN) == 0,
+    "Expected the new position after reparsing a board"
+  );
+}
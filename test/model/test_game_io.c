@@ -0,0 +1,267 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "fen.h"
+#include "san.h"
+#include "pgn.h"
+#include "queue.h"
+#include "history_stack.h"
+#include "journal.h"
+#include "game_io.h"
+
+#define SAVE_FILE "test_game_io.pgn"
+#define JOURNAL_FILE "test_game_io.journal"
+
+static board_t *board;
+static history_stack_t *stack;
+static game_io_t *io;
+
+void setUp(void)
+{
+  remove(SAVE_FILE);
+  board = board_init_start();
+  stack = history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+  io = game_io_init();
+}
+
+void tearDown(void)
+{
+  game_io_destroy(io);
+  history_stack_destroy(stack);
+  board_destroy(board);
+  remove(SAVE_FILE);
+  remove(JOURNAL_FILE);
+  remove(JOURNAL_FILE JOURNAL_TEMP_SUFFIX);
+}
+
+static void utility_play(const char **text, int count)
+{
+  move_t move;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    move_gen_find_string(board, text[i], &move);
+    history_stack_push(stack, board, &move);
+  }
+}
+
+/* Poll the way the display does, until the next request comes back */
+static game_io_request_t* utility_wait(void)
+{
+  game_io_request_t *request;
+
+  while (!(request = game_io_poll(io)) ) usleep(1000);
+  return request;
+}
+
+static long utility_file_size(const char *path)
+{
+  struct stat info;
+  return stat(path, &info) == 0 ? (long)info.st_size : -1;
+}
+
+/* Undo and redo until the journal is due a compaction */
+static void utility_churn(journal_t *journal)
+{
+  while (journal_due(journal) != JOURNAL_DUE_COMPACT) {
+    journal_undo(journal);
+    journal_redo(journal);
+  }
+}
+
+void test_game_io_saves_and_loads_a_game()
+{
+  const char *line[] = { "e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6" };
+  board_t *fresh = board_init_start();
+  history_stack_t *history = history_stack_init(16);
+  game_io_request_t *request;
+
+  utility_play(line, 6);
+  TEST_ASSERT_MESSAGE(game_io_save(io, SAVE_FILE, board, stack) == 0,
+                      "Expected the save to be queued");
+  TEST_ASSERT_MESSAGE(stack->count == 6,
+                      "Expected the snapshot to leave the game alone");
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(request->type == GAME_IO_SAVE && request->status == 0,
+                      "Expected the save to succeed");
+  game_io_release(request);
+  TEST_ASSERT_MESSAGE(access(SAVE_FILE, F_OK) == 0 &&
+                      access(SAVE_FILE ".tmp", F_OK) != 0,
+                      "Expected the file renamed into place");
+
+  TEST_ASSERT_MESSAGE(game_io_load(io, SAVE_FILE) == 0,
+                      "Expected the load to be queued");
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(
+    request->type == GAME_IO_LOAD && request->status == 0 &&
+    request->snapshot.num_moves == 6,
+    "Expected every move loaded"
+  );
+  TEST_ASSERT_MESSAGE(
+    game_io_apply(request, fresh, history) == 0 && history->count == 6 &&
+    board_equal(fresh, board) && fresh->hash == board->hash,
+    "Expected the loaded game to match the saved one"
+  );
+  TEST_ASSERT_MESSAGE(!game_io_busy(io), "Expected nothing left in flight");
+
+  game_io_release(request);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_game_io_keeps_a_set_up_start_position()
+{
+  const char *fen = "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1";
+  const char *line[] = { "e2e4", "e8d7", "e1d2" };
+  board_t *fresh = board_init_start();
+  game_io_request_t *request;
+
+  fen_parse(board, fen, strlen(fen), NULL);
+  utility_play(line, 3);
+  history_stack_undo(stack, board);
+  game_io_save(io, SAVE_FILE, board, stack);
+  game_io_release(utility_wait() );
+
+  game_io_load(io, SAVE_FILE);
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(
+    game_io_apply(request, fresh, stack) == 0 && stack->count == 2 &&
+    stack->redo_count == 0 && fresh->hash == board->hash,
+    "Expected the set-up position and the moves not taken back"
+  );
+  game_io_release(request);
+  board_destroy(fresh);
+}
+
+void test_game_io_reports_a_missing_file()
+{
+  game_io_request_t *request;
+
+  game_io_load(io, "no/such/file.pgn");
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(request->status == -1 &&
+                      game_io_apply(request, board, stack) == -1,
+                      "Expected the load to fail");
+  game_io_release(request);
+}
+
+void test_game_io_limits_the_requests_in_flight()
+{
+  int i, queued = 0;
+
+  for (i = 0; i < GAME_IO_QUEUE_SIZE + 4; i++)
+    queued += game_io_load(io, "no/such/file.pgn") == 0;
+  TEST_ASSERT_MESSAGE(queued == GAME_IO_QUEUE_SIZE,
+                      "Expected requests past the limit to be refused");
+
+  for (i = 0; i < queued; i++) game_io_release(utility_wait() );
+  TEST_ASSERT_MESSAGE(!game_io_busy(io) && game_io_poll(io) == NULL,
+                      "Expected every request back exactly once");
+}
+
+void test_game_io_compacts_a_background_journal()
+{
+  const char *line[] = { "d2d4", "d7d5" };
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  game_io_request_t *request;
+  history_stack_t *history;
+  board_t *fresh;
+  long size;
+  move_t move;
+  int i;
+
+  journal->background = true;
+  for (i = 0; i < 2; i++) {
+    move_gen_find_string(board, line[i], &move);
+    journal_push(journal, &move);
+  }
+  utility_churn(journal);
+  size = utility_file_size(JOURNAL_FILE);
+  TEST_ASSERT_MESSAGE(size == JOURNAL_HEADER_SIZE +
+                              (long)journal->records * JOURNAL_RECORD_SIZE,
+                      "Expected the journal to leave compacting to game_io");
+
+  TEST_ASSERT_MESSAGE(game_io_journal(io, journal) == 0 &&
+                      journal->compacting &&
+                      journal_due(journal) != JOURNAL_DUE_COMPACT,
+                      "Expected one compaction to be posted");
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(
+    request->type == GAME_IO_JOURNAL_COMPACT && request->status == 0 &&
+    utility_file_size(JOURNAL_FILE) == size,
+    "Expected the worker to write the new file but not put it in place"
+  );
+  TEST_ASSERT_MESSAGE(
+    game_io_journal_done(io, request, journal) == 0 &&
+    utility_file_size(JOURNAL_FILE) ==
+      JOURNAL_HEADER_SIZE + 2 * JOURNAL_RECORD_SIZE,
+    "Expected the compacted journal in place"
+  );
+  game_io_release(request);
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(request->type == GAME_IO_JOURNAL_SYNC &&
+                      request->status == 0,
+                      "Expected its directory to be synced");
+  game_io_release(request);
+  journal_close(journal);
+
+  fresh = board_init_start();
+  history = history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+  journal = journal_open(JOURNAL_FILE, fresh, history);
+  TEST_ASSERT_MESSAGE(journal && history->count == 2 &&
+                      fresh->hash == board->hash,
+                      "Expected the compacted journal to replay");
+  journal_close(journal);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_game_io_drops_a_compaction_the_game_has_moved_past()
+{
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  game_io_request_t *request;
+  move_t move;
+  long size;
+
+  journal->background = true;
+  move_gen_find_string(board, "e2e4", &move);
+  journal_push(journal, &move);
+  utility_churn(journal);
+  game_io_journal(io, journal);
+
+  /* A move is taken back while the worker writes */
+  journal_undo(journal);
+  size = utility_file_size(JOURNAL_FILE);
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(
+    game_io_journal_done(io, request, journal) == -1 &&
+    utility_file_size(JOURNAL_FILE) == size &&
+    access(JOURNAL_FILE JOURNAL_TEMP_SUFFIX, F_OK) != 0,
+    "Expected the out of date file thrown away"
+  );
+  game_io_release(request);
+
+  TEST_ASSERT_MESSAGE(journal_due(journal) == JOURNAL_DUE_COMPACT &&
+                      game_io_journal(io, journal) == 0,
+                      "Expected the compaction to be due again");
+  request = utility_wait();
+  TEST_ASSERT_MESSAGE(game_io_journal_done(io, request, journal) == 0 &&
+                      utility_file_size(JOURNAL_FILE) == JOURNAL_HEADER_SIZE,
+                      "Expected the second compaction in place");
+  game_io_release(request);
+  game_io_release(utility_wait() );
+  journal_close(journal);
+}
@@ -0,0 +1,278 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "fen.h"
+#include "san.h"
+#include "pgn.h"
+#include "game_record.h"
+#include "timer.h"
+
+#define RECORD_SIZE 4096
+
+static board_t *board;
+static move_t moves[GAME_RECORD_MAX_PLIES];
+static move_t decoded[GAME_RECORD_MAX_PLIES];
+static uint8_t record[RECORD_SIZE];
+
+void setUp(void)
+{
+  board = board_init_start();
+}
+
+void tearDown(void)
+{
+  board_destroy(board);
+}
+
+/* Fill 'moves' from coordinate notation, leaving the board where it was */
+static int utility_moves(const char **text, int count)
+{
+  board_undo_t undo[GAME_RECORD_MAX_PLIES];
+  int i;
+
+  for (i = 0; i < count; i++) {
+    TEST_ASSERT_MESSAGE(move_gen_find_string(board, text[i], &moves[i]),
+                        "Expected a legal move in the fixture");
+    board_make_move(board, &moves[i], &undo[i]);
+  }
+  while (i-- > 0) board_unmake_move(board, &moves[i], &undo[i]);
+  return count;
+}
+
+/* Play random legal moves until the game ends or 'count' plies */
+static int utility_random_game(int count, unsigned int seed)
+{
+  board_undo_t undo[GAME_RECORD_MAX_PLIES];
+  move_list_t *list = move_list_new();
+  int i;
+
+  srand(seed);
+  for (i = 0; i < count; i++) {
+    move_list_clear(list);
+    if (move_gen_legal(board, list) == 0) break;
+    moves[i] = list->moves[rand() % list->num_moves];
+    board_make_move(board, &moves[i], &undo[i]);
+  }
+  count = i;
+  while (i-- > 0) board_unmake_move(board, &moves[i], &undo[i]);
+  move_list_destroy(list);
+  return count;
+}
+
+static bool utility_same_moves(int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    if (move_pack(&moves[i]) != move_pack(&decoded[i])) return false;
+  return true;
+}
+
+void test_game_record_round_trips_an_opening_in_under_a_byte_per_move()
+{
+  const char *opening[] = {
+    "e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6", "b5a4", "g8f6",
+    "e1g1", "f8e7", "f1e1", "b7b5", "a4b3", "d7d6", "c2c3", "e8g8"
+  };
+  uint64_t hash = board->hash;
+  pgn_result_t result;
+  size_t consumed;
+  int length, count = utility_moves(opening, 16);
+
+  length = game_record_encode(board, moves, count, PGN_RESULT_DRAW, record,
+                              RECORD_SIZE);
+  TEST_ASSERT_MESSAGE(
+    length > 0 && length < count && board->hash == hash,
+    "Expected a short record and the board back at the start"
+  );
+  TEST_ASSERT_MESSAGE(
+    game_record_decode(board, record, length, decoded, GAME_RECORD_MAX_PLIES,
+                       &result, &consumed) == count &&
+    utility_same_moves(count) && result == PGN_RESULT_DRAW &&
+    consumed == (size_t)length && board->hash == hash,
+    "Expected the same moves and result back"
+  );
+}
+
+void test_game_record_round_trips_long_random_games()
+{
+  board_undo_t undo;
+  int seed, count, length;
+
+  for (seed = 1; seed <= 20; seed++) {
+    count = utility_random_game(400, seed);
+    length = game_record_encode(board, moves, count, PGN_RESULT_UNKNOWN,
+                                record, RECORD_SIZE);
+    TEST_ASSERT_MESSAGE(length > 0, "Expected every random game to encode");
+    TEST_ASSERT_MESSAGE(
+      game_record_decode(board, record, length, decoded,
+                         GAME_RECORD_MAX_PLIES, NULL, NULL) == count &&
+      utility_same_moves(count),
+      "Expected every random game to decode to the same moves"
+    );
+  }
+
+  /* The decoded moves point into the board and replay the game */
+  board_make_move(board, &decoded[0], &undo);
+  TEST_ASSERT_MESSAGE(board->moves_next == BLACK,
+                      "Expected decoded moves to be playable");
+  board_unmake_move(board, &decoded[0], &undo);
+}
+
+void test_game_record_stores_a_custom_start_position()
+{
+  const char *fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R"
+    " w KQkq - 0 1";
+  const char *line[] = { "e1c1", "b4c3", "d2c3", "e8g8" };
+  board_t *start = board_init_start();
+  int count, length;
+
+  TEST_ASSERT_MESSAGE(fen_parse(board, fen, strlen(fen), NULL) == 0,
+                      "Expected the fixture FEN to parse");
+  count = utility_moves(line, 4);
+  length = game_record_encode(board, moves, count, PGN_RESULT_WHITE, record,
+                              RECORD_SIZE);
+  TEST_ASSERT_MESSAGE(
+    length > BOARD_PACKED_SIZE && (record[1] & GAME_RECORD_CUSTOM_START),
+    "Expected the start position in the record"
+  );
+
+  /* Decoding onto a board at the standard start sets the position up */
+  TEST_ASSERT_MESSAGE(
+    game_record_decode(start, record, length, decoded, GAME_RECORD_MAX_PLIES,
+                       NULL, NULL) == count &&
+    start->hash == board->hash && utility_same_moves(count),
+    "Expected the custom start and moves back"
+  );
+  board_destroy(start);
+}
+
+void test_game_record_resets_the_board_for_a_standard_start()
+{
+  const char *line[] = { "d2d4", "d7d5" };
+  const char *fen = "8/8/4k3/8/8/4K3/8/8 b - - 3 40";
+  uint64_t hash = board->hash;
+  int count = utility_moves(line, 2), length;
+
+  length = game_record_encode(board, moves, count, PGN_RESULT_UNKNOWN, record,
+                              RECORD_SIZE);
+  fen_parse(board, fen, strlen(fen), NULL);
+  TEST_ASSERT_MESSAGE(
+    game_record_decode(board, record, length, decoded, GAME_RECORD_MAX_PLIES,
+                       NULL, NULL) == count &&
+    board->hash == hash && utility_same_moves(count),
+    "Expected the board put back at the standard start"
+  );
+}
+
+void test_game_record_reads_concatenated_records()
+{
+  const char *first[] = { "e2e4", "c7c5" };
+  const char *second[] = { "c2c4" };
+  size_t consumed, offset;
+  int length;
+
+  utility_moves(first, 2);
+  offset = game_record_encode(board, moves, 2, PGN_RESULT_WHITE, record,
+                              RECORD_SIZE);
+  utility_moves(second, 1);
+  length = game_record_encode(board, moves, 1, PGN_RESULT_BLACK,
+                              record + offset, RECORD_SIZE - offset);
+
+  TEST_ASSERT_MESSAGE(
+    game_record_decode(board, record, offset + length, decoded,
+                       GAME_RECORD_MAX_PLIES, NULL, &consumed) == 2 &&
+    consumed == offset &&
+    game_record_decode(board, record + consumed, length, decoded,
+                       GAME_RECORD_MAX_PLIES, NULL, NULL) == 1 &&
+    move_pack(&decoded[0]) == move_pack(&moves[0]),
+    "Expected each record's length to lead to the next"
+  );
+}
+
+void test_game_record_rejects_bad_games_and_records()
+{
+  const char *line[] = { "e2e4", "e7e5", "g1f3" };
+  move_t illegal[2];
+  int count = utility_moves(line, 3), length;
+
+  /* e2e4 twice: the second is no move at all */
+  illegal[0] = moves[0];
+  illegal[1] = moves[0];
+  TEST_ASSERT_MESSAGE(
+    game_record_encode(board, illegal, 2, PGN_RESULT_UNKNOWN, record,
+                       RECORD_SIZE) == -1 &&
+    game_record_encode(board, moves, count, PGN_RESULT_UNKNOWN, record,
+                       2) == -1,
+    "Expected an illegal move or a short buffer to fail"
+  );
+
+  length = game_record_encode(board, moves, count, PGN_RESULT_UNKNOWN, record,
+                              RECORD_SIZE);
+  TEST_ASSERT_MESSAGE(
+    game_record_decode(board, record, length - 1, decoded,
+                       GAME_RECORD_MAX_PLIES, NULL, NULL) == -1 &&
+    game_record_decode(board, record, length, decoded, 2, NULL, NULL) == -1,
+    "Expected a truncated record or too little room to fail"
+  );
+}
+
+/* Decode benchmark: a record is decoded by generating each position's
+ * moves, so decoding is timed against generating and playing the same
+ * moves.  The ordering and legality tests on top must stay well under
+ * the generator's own cost.
+ */
+void test_game_record_decodes_within_a_small_factor_of_move_generation()
+{
+  static uint8_t records[64 * RECORD_SIZE];
+  board_undo_t undo[GAME_RECORD_MAX_PLIES];
+  move_list_t *list = move_list_new();
+  uint64_t start, decode_ns = 0, replay_ns = 0;
+  size_t used = 0, consumed, offset;
+  long plies = 0;
+  int game, round, count, ply;
+
+  for (game = 0; game < 64; game++) {
+    count = utility_random_game(120, 100 + game);
+    used += game_record_encode(board, moves, count, PGN_RESULT_UNKNOWN,
+                               records + used, sizeof(records) - used);
+  }
+
+  for (round = 0; round < 20; round++) {
+    for (offset = 0; offset < used; offset += consumed) {
+      start = timer_now_ns();
+      count = game_record_decode(board, records + offset, used - offset,
+                                 decoded, GAME_RECORD_MAX_PLIES, NULL,
+                                 &consumed);
+      decode_ns += timer_now_ns() - start;
+      TEST_ASSERT_MESSAGE(count > 0, "Expected every record to decode");
+
+      start = timer_now_ns();
+      for (ply = 0; ply < count; ply++) {
+        move_list_clear(list);
+        move_gen_pseudo_legal(board, list);
+        board_make_move(board, &decoded[ply], &undo[ply]);
+      }
+      while (ply-- > 0) board_unmake_move(board, &decoded[ply], &undo[ply]);
+      replay_ns += timer_now_ns() - start;
+      plies += count;
+    }
+  }
+  move_list_destroy(list);
+
+  printf("game_record_decode: %.0f plies/s, generate and play: %.0f "
+         "plies/s\n", plies * 1e9 / decode_ns, plies * 1e9 / replay_ns);
+  TEST_ASSERT_MESSAGE(decode_ns < 4 * replay_ns,
+                      "Expected decoding to cost under 4x move generation");
+}
@@ -0,0 +1,182 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "fen.h"
+#include "history_stack.h"
+
+static board_t *board;
+static history_stack_t *stack;
+
+void setUp(void)
+{
+  board = board_init_start();
+  stack = history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+}
+
+void tearDown(void)
+{
+  history_stack_destroy(stack);
+  board_destroy(board);
+}
+
+/* Push moves given in coordinate notation */
+static bool utility_play(const char **text, int count)
+{
+  move_t move;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (!move_gen_find_string(board, text[i], &move) ||
+        history_stack_push(stack, board, &move) != 0)
+      return false;
+  }
+  return true;
+}
+
+void test_history_stack_undoes_and_redoes_moves()
+{
+  const char *line[] = { "e2e4", "d7d5", "e4d5", "d8d5" };
+  board_t *start = board_copy_deep(board), *end;
+  int i;
+
+  TEST_ASSERT_MESSAGE(utility_play(line, 4), "Expected the line to play");
+  end = board_copy_deep(board);
+
+  for (i = 0; i < 4; i++) history_stack_undo(stack, board);
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, start) && stack->count == 0 &&
+    stack->redo_count == 4 && !history_stack_undo(stack, board),
+    "Expected every move, capture included, taken back"
+  );
+
+  for (i = 0; i < 4; i++) history_stack_redo(stack, board);
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, end) && board->hash == end->hash &&
+    !history_stack_redo(stack, board),
+    "Expected redo to replay the same moves"
+  );
+
+  board_destroy(start);
+  board_destroy(end);
+}
+
+void test_history_stack_push_drops_undone_moves()
+{
+  const char *line[] = { "e2e4", "e7e5" };
+  const char *other[] = { "c7c5" };
+  move_t last;
+
+  utility_play(line, 2);
+  history_stack_undo(stack, board);
+  TEST_ASSERT_MESSAGE(utility_play(other, 1), "Expected c7c5 to play");
+  TEST_ASSERT_MESSAGE(
+    !history_stack_redo(stack, board) && stack->count == 2 &&
+    history_stack_last(stack, board, &last) &&
+    last.to_square == board->spaces[4][2],
+    "Expected the new move on top and nothing left to redo"
+  );
+}
+
+void test_history_stack_restores_promotions_and_castling()
+{
+  const char *fen = "r3k3/1P6/8/8/8/8/8/R3K2R w KQq - 0 1";
+  const char *line[] = { "b7a8n", "e8e7", "e1g1" };
+  board_t *start;
+  move_t last;
+
+  fen_parse(board, fen, strlen(fen), NULL);
+  start = board_copy_deep(board);
+  TEST_ASSERT_MESSAGE(utility_play(line, 3), "Expected the line to play");
+  history_stack_undo(stack, board);
+  history_stack_undo(stack, board);
+  history_stack_redo(stack, board);
+  history_stack_redo(stack, board);
+  TEST_ASSERT_MESSAGE(
+    board->spaces[7][0]->piece->type == KNIGHT &&
+    board->spaces[0][6]->piece->type == KING &&
+    board->spaces[0][5]->piece->type == ROOK &&
+    history_stack_last(stack, board, &last) && (last.flags & MOVE_CASTLE),
+    "Expected the under-promotion and castling replayed"
+  );
+
+  while (history_stack_undo(stack, board));
+  TEST_ASSERT_MESSAGE(board_equal(board, start) && board->hash == start->hash,
+                      "Expected the start position back");
+  board_destroy(start);
+}
+
+void test_history_stack_detects_threefold_repetition()
+{
+  const char *shuffle[] = { "g1f3", "g8f6", "f3g1", "f6g8" };
+
+  utility_play(shuffle, 4);
+  TEST_ASSERT_MESSAGE(history_stack_draw(stack, board) == HISTORY_NO_DRAW,
+                      "Expected a second occurrence not to be a draw");
+  utility_play(shuffle, 4);
+  TEST_ASSERT_MESSAGE(
+    history_stack_draw(stack, board) == HISTORY_DRAW_REPETITION,
+    "Expected the third occurrence to be a draw"
+  );
+
+  history_stack_undo(stack, board);
+  TEST_ASSERT_MESSAGE(history_stack_draw(stack, board) == HISTORY_NO_DRAW,
+                      "Expected undo to take the repetition back");
+}
+
+void test_history_stack_repetitions_stop_at_irreversible_moves()
+{
+  uint64_t hashes[6] = { 7, 1, 7, 2, 5, 3 };
+
+  TEST_ASSERT_MESSAGE(
+    history_stack_repeated(hashes, 6, 0, 7, 2) &&
+    !history_stack_repeated(hashes, 6, 1, 7, 2) &&
+    history_stack_repeated(hashes, 6, 1, 7, 1) &&
+    !history_stack_repeated(hashes, 6, 3, 7, 1) &&
+    !history_stack_repeated(hashes, 6, 0, 1, 1),
+    "Expected only same-side positions after 'oldest' to count"
+  );
+}
+
+void test_history_stack_detects_the_fifty_move_rule()
+{
+  const char *fen = "8/8/4k3/8/8/4K3/8/7R w - - 99 80";
+  const char *line[] = { "h1h2" };
+
+  fen_parse(board, fen, strlen(fen), NULL);
+  TEST_ASSERT_MESSAGE(history_stack_draw(stack, board) == HISTORY_NO_DRAW,
+                      "Expected 99 plies not to be enough");
+  utility_play(line, 1);
+  TEST_ASSERT_MESSAGE(
+    history_stack_draw(stack, board) == HISTORY_DRAW_FIFTY_MOVES,
+    "Expected the hundredth ply to draw"
+  );
+}
+
+void test_history_stack_refuses_moves_when_full()
+{
+  const char *line[] = { "e2e4", "e7e5" };
+  history_stack_t *small = history_stack_init(1);
+  move_t move;
+
+  move_gen_find_string(board, line[0], &move);
+  TEST_ASSERT_MESSAGE(history_stack_push(small, board, &move) == 0,
+                      "Expected room for one move");
+  move_gen_find_string(board, line[1], &move);
+  TEST_ASSERT_MESSAGE(
+    history_stack_push(small, board, &move) == -1 &&
+    board->moves_next == BLACK,
+    "Expected a full stack to leave the board alone"
+  );
+  history_stack_destroy(small);
+}
@@ -0,0 +1,238 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "fen.h"
+#include "history_stack.h"
+#include "journal.h"
+
+#define JOURNAL_FILE "test_journal.bin"
+
+static board_t *board;
+static history_stack_t *stack;
+
+void setUp(void)
+{
+  remove(JOURNAL_FILE);
+  board = board_init_start();
+  stack = history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+}
+
+void tearDown(void)
+{
+  history_stack_destroy(stack);
+  board_destroy(board);
+  remove(JOURNAL_FILE);
+  remove(JOURNAL_FILE ".tmp");
+}
+
+static bool utility_play(journal_t *journal, const char **text, int count)
+{
+  move_t move;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (!move_gen_find_string(board, text[i], &move) ||
+        journal_push(journal, &move) != 0)
+      return false;
+  }
+  return true;
+}
+
+/* Open the journal again on a fresh board and stack, as after a restart */
+static journal_t* utility_reopen(board_t **fresh, history_stack_t **history)
+{
+  *fresh = board_init_start();
+  *history = history_stack_init(HISTORY_STACK_DEFAULT_CAPACITY);
+  return journal_open(JOURNAL_FILE, *fresh, *history);
+}
+
+static long utility_file_size(void)
+{
+  struct stat info;
+  return stat(JOURNAL_FILE, &info) == 0 ? (long)info.st_size : -1;
+}
+
+void test_journal_replays_moves_and_undos_after_a_restart()
+{
+  const char *line[] = { "e2e4", "c7c5", "g1f3", "d7d6" };
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  history_stack_t *history;
+  board_t *fresh;
+
+  TEST_ASSERT_MESSAGE(journal && journal->recovered == 0,
+                      "Expected a new journal");
+  utility_play(journal, line, 4);
+  journal_undo(journal);
+  journal_undo(journal);
+  journal_redo(journal);
+  TEST_ASSERT_MESSAGE(
+    journal_close(journal) == 0 &&
+    utility_file_size() == JOURNAL_HEADER_SIZE + 7 * JOURNAL_RECORD_SIZE,
+    "Expected one record per move, undo and redo"
+  );
+
+  journal = utility_reopen(&fresh, &history);
+  TEST_ASSERT_MESSAGE(
+    journal && journal->recovered == 7 && history->count == 3 &&
+    board_equal(fresh, board) && fresh->hash == board->hash,
+    "Expected the game back as it was left"
+  );
+  TEST_ASSERT_MESSAGE(journal_undo(journal) && history->count == 2,
+                      "Expected the recovered moves to be undoable");
+
+  journal_close(journal);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_journal_cuts_off_a_torn_tail()
+{
+  const char *line[] = { "d2d4", "g8f6", "c2c4" };
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  history_stack_t *history;
+  board_t *fresh;
+  FILE *handle;
+
+  utility_play(journal, line, 3);
+  journal_close(journal);
+
+  /* A bad record, then half of one */
+  handle = fopen(JOURNAL_FILE, "ab");
+  fwrite("M\0\0\0\0\0\0\0M\0\x0c", 1, 11, handle);
+  fclose(handle);
+
+  journal = utility_reopen(&fresh, &history);
+  TEST_ASSERT_MESSAGE(
+    journal && journal->recovered == 3 && history->count == 3 &&
+    fresh->hash == board->hash &&
+    utility_file_size() == JOURNAL_HEADER_SIZE + 3 * JOURNAL_RECORD_SIZE,
+    "Expected the good records replayed and the rest cut off"
+  );
+
+  journal_close(journal);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_journal_compacts_after_many_undos()
+{
+  const char *line[] = { "e2e4", "e7e5" };
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  history_stack_t *history;
+  board_t *fresh;
+  int i;
+
+  utility_play(journal, line, 2);
+  for (i = 0; i < 200; i++) {
+    journal_undo(journal);
+    journal_redo(journal);
+  }
+  TEST_ASSERT_MESSAGE(
+    utility_file_size() < JOURNAL_HEADER_SIZE +
+                          (2 + JOURNAL_COMPACT_SLACK) * JOURNAL_RECORD_SIZE,
+    "Expected snapshots to keep the journal short"
+  );
+  journal_close(journal);
+
+  journal = utility_reopen(&fresh, &history);
+  TEST_ASSERT_MESSAGE(journal && history->count == 2 &&
+                      fresh->hash == board->hash,
+                      "Expected the compacted journal to replay");
+  journal_close(journal);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_journal_keeps_the_game_going_when_a_write_fails()
+{
+  const char *line[] = { "e2e4", "e7e5", "g1f3" };
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  history_stack_t *history;
+  board_t *fresh;
+  int fd;
+
+  utility_play(journal, line, 1);
+
+  /* Writes fail from here on, as on a full disk */
+  fd = journal->fd;
+  journal->fd = open("/dev/null", O_RDONLY);
+  TEST_ASSERT_MESSAGE(utility_play(journal, line + 1, 1) &&
+                      stack->count == 2 && journal->stale,
+                      "Expected the move played and the journal stale");
+  TEST_ASSERT_MESSAGE(journal_undo(journal) && stack->count == 1,
+                      "Expected the undo to happen all the same");
+
+  /* The disk recovers: the next record rewrites the journal */
+  close(fd);
+  TEST_ASSERT_MESSAGE(journal_redo(journal) && !journal->stale,
+                      "Expected a snapshot to bring the journal up to date");
+  utility_play(journal, line + 2, 1);
+  journal_close(journal);
+
+  journal = utility_reopen(&fresh, &history);
+  TEST_ASSERT_MESSAGE(
+    journal && history->count == 3 && fresh->hash == board->hash,
+    "Expected every move back, the ones that failed to write too"
+  );
+  journal_close(journal);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_journal_snapshots_the_game_it_is_started_on()
+{
+  const char *fen = "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1";
+  const char *line[] = { "e2e4", "e8d7" };
+  journal_t *journal = journal_open(JOURNAL_FILE, board, stack);
+  history_stack_t *history;
+  board_t *fresh;
+  move_t move;
+
+  /* A new game from a set-up position */
+  fen_parse(board, fen, strlen(fen), NULL);
+  TEST_ASSERT_MESSAGE(journal_reset(journal) == 0 && stack->count == 0,
+                      "Expected the reset to forget the moves");
+  move_gen_find_string(board, line[0], &move);
+  history_stack_push(stack, board, &move);
+  journal_close(journal);
+
+  /* Opening a missing journal snapshots the moves already played */
+  remove(JOURNAL_FILE);
+  journal = journal_open(JOURNAL_FILE, board, stack);
+  utility_play(journal, line + 1, 1);
+  journal_close(journal);
+
+  journal = utility_reopen(&fresh, &history);
+  TEST_ASSERT_MESSAGE(
+    journal && history->count == 2 && fresh->hash == board->hash,
+    "Expected the set-up position and both moves back"
+  );
+  journal_close(journal);
+  history_stack_destroy(history);
+  board_destroy(fresh);
+}
+
+void test_journal_rejects_a_file_that_is_not_a_journal()
+{
+  FILE *handle = fopen(JOURNAL_FILE, "wb");
+
+  fputs("not a journal, but long enough to hold a journal header ....",
+        handle);
+  fclose(handle);
+  TEST_ASSERT_MESSAGE(journal_open(JOURNAL_FILE, board, stack) == NULL,
+                      "Expected a foreign file to be refused");
+}
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "move.h"
 #include "square.h"
@@ -48,3 +49,25 @@ void test_score_can_be_changed()
     "Calling move_set_score didn't update the score"
   );
 }
+
+void test_move_pack_round_trips_through_packed_string()
+{
+  move_t *move = utility_create_simple_move();
+  char text[6];
+
+  move_packed_to_string(move_pack(move), text);
+  TEST_ASSERT_MESSAGE(
+    strcmp(text, "a1b1") == 0,
+    "Expected a packed a1-b1 move to print as a1b1"
+  )
+
+  move_packed_to_string(MOVE_NONE, text);
+  TEST_ASSERT_MESSAGE(
+    strcmp(text, "0000") == 0,
+    "Expected MOVE_NONE to print as the UCI null move"
+  )
+
+  square_destroy(move->from_square);
+  square_destroy(move->to_square);
+  move_destroy(move);
+}
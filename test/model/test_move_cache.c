@@ -0,0 +1,125 @@
+#include "unity.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "fen.h"
+#include "move_cache.h"
+
+static board_t *board;
+static move_cache_t *cache;
+
+void setUp(void)
+{
+  board = board_init_start();
+  cache = move_cache_init();
+}
+
+void tearDown(void)
+{
+  move_cache_destroy(cache);
+  board_destroy(board);
+}
+
+static int utility_count_bits(uint64_t bits)
+{
+  int count = 0;
+  for (; bits; bits &= bits - 1) count++;
+  return count;
+}
+
+void test_move_cache_indexes_moves_by_origin()
+{
+  uint64_t knight = move_cache_targets(cache, SQUARE_INDEX(0, 6) );
+  int square, total = 0;
+
+  TEST_ASSERT_MESSAGE(knight == 0,
+                      "Expected no targets before the first update");
+  TEST_ASSERT_MESSAGE(move_cache_update(cache, board) == 0,
+                      "Expected the update to succeed");
+
+  knight = move_cache_targets(cache, SQUARE_INDEX(0, 6) );
+  TEST_ASSERT_MESSAGE(
+    knight == (1ULL << SQUARE_INDEX(2, 5) | 1ULL << SQUARE_INDEX(2, 7) ),
+    "Expected the g1 knight to reach f3 and h3"
+  );
+  TEST_ASSERT_MESSAGE(move_cache_targets(cache, SQUARE_INDEX(0, 4) ) == 0,
+                      "Expected the king to have no moves");
+
+  for (square = 0; square < NUM_SQUARES; square++) {
+    TEST_ASSERT_MESSAGE(
+      cache->first[square + 1] - cache->first[square] ==
+      utility_count_bits(move_cache_targets(cache, square) ),
+      "Expected each origin's run to hold one move per target"
+    );
+    total += cache->first[square + 1] - cache->first[square];
+  }
+  TEST_ASSERT_MESSAGE(total == 20, "Expected the 20 opening moves");
+}
+
+void test_move_cache_finds_only_legal_moves()
+{
+  move_t *move;
+
+  move_cache_update(cache, board);
+  move = move_cache_find(cache, SQUARE_INDEX(1, 4), SQUARE_INDEX(3, 4) );
+  TEST_ASSERT_MESSAGE(move && move->from_square->rank == 1 &&
+                      move->to_square->rank == 3 &&
+                      (move->flags & MOVE_DOUBLE_PUSH),
+                      "Expected e2e4 to be found");
+  TEST_ASSERT_MESSAGE(
+    !move_cache_find(cache, SQUARE_INDEX(1, 4), SQUARE_INDEX(4, 4) ),
+    "Expected e2e5 to be rejected"
+  );
+  TEST_ASSERT_MESSAGE(
+    !move_cache_find(cache, SQUARE_INDEX(6, 4), SQUARE_INDEX(4, 4) ),
+    "Expected the side not to move to have no moves"
+  );
+}
+
+void test_move_cache_prefers_queen_promotions()
+{
+  board_t *promoting = fen_board("4k3/1P6/8/8/8/8/8/4K3 w - - 0 1");
+  move_t *move;
+
+  TEST_ASSERT_MESSAGE(promoting, "Expected the FEN to parse");
+  move_cache_update(cache, promoting);
+  move = move_cache_find(cache, SQUARE_INDEX(6, 1), SQUARE_INDEX(7, 1) );
+  TEST_ASSERT_MESSAGE(move && (move->flags & MOVE_PROMOTION) &&
+                      move->promotion == QUEEN,
+                      "Expected b7b8 to promote to a queen");
+  board_destroy(promoting);
+}
+
+void test_move_cache_regenerates_only_when_invalidated()
+{
+  board_undo_t undo;
+  move_t *move;
+
+  move_cache_update(cache, board);
+  move = move_cache_find(cache, SQUARE_INDEX(1, 4), SQUARE_INDEX(3, 4) );
+  board_make_move(board, move, &undo);
+
+  move_cache_update(cache, board);
+  TEST_ASSERT_MESSAGE(
+    move_cache_targets(cache, SQUARE_INDEX(1, 3) ) != 0,
+    "Expected the cached (stale) moves until invalidated"
+  );
+
+  move_cache_invalidate(cache);
+  TEST_ASSERT_MESSAGE(move_cache_targets(cache, SQUARE_INDEX(1, 3) ) == 0,
+                      "Expected no targets once invalidated");
+  move_cache_update(cache, board);
+  TEST_ASSERT_MESSAGE(
+    move_cache_targets(cache, SQUARE_INDEX(1, 3) ) == 0 &&
+    move_cache_targets(cache, SQUARE_INDEX(6, 3) ) != 0,
+    "Expected BLACK's moves after the update"
+  );
+}
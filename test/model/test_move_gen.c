@@ -0,0 +1,170 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "timer.h"
+#include "file-utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* Play a move given in coordinate notation, failing the test if the
+ * move isn't legal
+ */
+static void utility_play(board_t *board, const char *text)
+{
+  move_t move;
+  board_undo_t undo;
+
+  TEST_ASSERT_MESSAGE(
+    move_gen_find_string(board, text, &move),
+    "Expected the scripted move to be legal"
+  );
+  board_make_move(board, &move, &undo);
+}
+
+static bool utility_is_legal(board_t *board, const char *text)
+{
+  move_t move;
+  return move_gen_find_string(board, text, &move);
+}
+
+static board_t* utility_kings_only(int white_rank, int white_file,
+                                   int black_rank, int black_file)
+{
+  board_t *board = board_init();
+  board_add_piece(board, piece_init_alive(WHITE, KING, 0, 0),
+                  white_rank, white_file);
+  board_add_piece(board, piece_init_alive(BLACK, KING, 0, 0),
+                  black_rank, black_file);
+  return board;
+}
+
+void test_move_gen_perft_from_start_position()
+{
+  board_t *board = board_init_start();
+
+  TEST_ASSERT_MESSAGE(
+    move_gen_perft(board, 1) == 20 && move_gen_perft(board, 2) == 400 &&
+    move_gen_perft(board, 3) == 8902 && move_gen_perft(board, 4) == 197281,
+    "Expected the standard perft counts from the start position"
+  );
+  board_destroy(board);
+}
+
+void test_move_gen_make_unmake_restores_the_board()
+{
+  board_t *board = board_init_start();
+  board_t *copy = board_copy_deep(board);
+
+  move_gen_perft(board, 3);
+  TEST_ASSERT_MESSAGE(
+    board_equal(board, copy) && board->hash == copy->hash &&
+    board->hash == board_compute_hash(board),
+    "Expected walking the move tree to leave the board untouched"
+  );
+  board_destroy(board);
+  board_destroy(copy);
+}
+
+void test_move_gen_castling_needs_safe_squares()
+{
+  board_t *board = utility_kings_only(0, 4, 7, 4);
+  board_add_piece(board, piece_init_alive(WHITE, ROOK, 0, 0), 0, 0);
+  board_add_piece(board, piece_init_alive(WHITE, ROOK, 0, 0), 0, 7);
+  board->castle_rights = CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN;
+  board_refresh(board);
+
+  TEST_ASSERT_MESSAGE(
+    utility_is_legal(board, "e1g1") && utility_is_legal(board, "e1c1"),
+    "Expected both castling moves with empty, unattacked squares"
+  );
+
+  /* A black rook on f8 covers f1, which the king must cross */
+  board_add_piece(board, piece_init_alive(BLACK, ROOK, 0, 0), 7, 5);
+  TEST_ASSERT_MESSAGE(
+    !utility_is_legal(board, "e1g1") && utility_is_legal(board, "e1c1"),
+    "Expected no king-side castling through an attacked square"
+  );
+
+  utility_play(board, "e1c1");
+  TEST_ASSERT_MESSAGE(
+    board->spaces[0][3]->piece && board->spaces[0][3]->piece->type == ROOK &&
+    board->castle_rights == 0,
+    "Expected castling to move the rook and spend the rights"
+  );
+  board_destroy(board);
+}
+
+void test_move_gen_en_passant_capture()
+{
+  board_t *board = board_init_start();
+  utility_play(board, "e2e4");
+  utility_play(board, "a7a6");
+  utility_play(board, "e4e5");
+  utility_play(board, "d7d5");
+
+  TEST_ASSERT_MESSAGE(
+    utility_is_legal(board, "e5d6"),
+    "Expected e5xd6 en passant right after d7-d5"
+  );
+  utility_play(board, "e5d6");
+  TEST_ASSERT_MESSAGE(
+    !board->spaces[4][3]->piece && board->num_dead == 1 &&
+    board->hash == board_compute_hash(board),
+    "Expected en passant to remove the pawn on d5"
+  );
+  board_destroy(board);
+}
+
+void test_move_gen_promotions()
+{
+  board_t *board = utility_kings_only(0, 4, 7, 7);
+  move_list_t *moves = move_list_new();
+  int i, promotions = 0;
+
+  board_add_piece(board, piece_init_alive(WHITE, PAWN, 0, 0), 6, 0);
+  move_gen_legal(board, moves);
+  for (i = 0; i < move_list_length(moves); i++) {
+    if (move_list_get_move(moves, i)->flags & MOVE_PROMOTION) promotions++;
+  }
+  TEST_ASSERT_MESSAGE(
+    promotions == 4,
+    "Expected a pawn on the seventh rank to promote four ways"
+  );
+
+  utility_play(board, "a7a8n");
+  TEST_ASSERT_MESSAGE(
+    board->spaces[7][0]->piece->type == KNIGHT &&
+    board_material_count(board, WHITE, PAWN) == 0,
+    "Expected the pawn to become a knight"
+  );
+  move_list_destroy(moves);
+  board_destroy(board);
+}
+
+void test_move_gen_detects_checkmate()
+{
+  board_t *board = board_init_start();
+  move_list_t *moves = move_list_new();
+
+  utility_play(board, "f2f3");
+  utility_play(board, "e7e5");
+  utility_play(board, "g2g4");
+  utility_play(board, "d8h4");
+
+  TEST_ASSERT_MESSAGE(
+    move_gen_in_check(board, WHITE) && move_gen_legal(board, moves) == 0,
+    "Expected fool's mate to leave WHITE in check without moves"
+  );
+  move_list_destroy(moves);
+  board_destroy(board);
+}
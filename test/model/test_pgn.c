@@ -0,0 +1,276 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "file-utils.h"
+#include "fen.h"
+#include "san.h"
+#include "pgn.h"
+
+#define PGN_FILE "test_pgn.pgn"
+
+static const char *games =
+  "% exported by a test\n"
+  "[Event \"Casual \\\"blitz\\\"\"]\n"
+  "[White \"Anderssen\"]\n"
+  "[Black \"Kieseritzky\"]\n"
+  "[Result \"1-0\"]\n"
+  "\n"
+  "1. e4 e5 2. f4 {King's Gambit} exf4 3. Bc4 Qh4+ (3... d5 4. Bxd5 (4. exd5)\n"
+  "Nf6) 4. Kf1 $1 b5 5.Bxb5 Nf6 6. Nf3 Qh6 ; a comment to the end of line\n"
+  "7. d3 1-0\n"
+  "\n"
+  "[Event \"Endgame\"]\n"
+  "[FEN \"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\"]\n"
+  "\n"
+  "1. e4 Kd7 2. e5 Ke6 1/2-1/2\n"
+  "[Event \"Missing result\"]\n"
+  "1. d4 d5 2. Nf3\n"
+  "[Event \"Illegal\"]\n"
+  "1. e4 e5 2. Ke3 Nc6 0-1\n";
+
+/* What the callback saw */
+struct seen {
+  int games;
+  int moves[8];
+  bool error[8];
+  pgn_result_t result[8];
+  char event[8][64];
+  bool start_position[8];
+  int stop_after;
+};
+
+static bool utility_collect(const pgn_game_t *game, void *user)
+{
+  struct seen *seen = user;
+  int n = seen->games++;
+  board_t *start = board_init_start();
+
+  if (n < 8) {
+    seen->moves[n] = game->num_moves;
+    seen->error[n] = game->error;
+    seen->result[n] = game->result;
+    pgn_tag_value(game, "Event", seen->event[n], sizeof(seen->event[n]));
+    seen->start_position[n] = game->board &&
+                              game->board->hash == start->hash;
+  }
+  board_destroy(start);
+  return seen->games != seen->stop_after;
+}
+
+static long utility_read(const char *text, bool decode, struct seen *seen)
+{
+  memset(seen, 0, sizeof(*seen));
+  return pgn_read_buffer(text, strlen(text), decode, utility_collect, seen);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+  remove(PGN_FILE);
+}
+
+void test_pgn_reads_tags_in_place()
+{
+  struct seen seen;
+
+  TEST_ASSERT_MESSAGE(utility_read(games, false, &seen) == 4,
+                      "Expected four games");
+  TEST_ASSERT_MESSAGE(
+    !strcmp(seen.event[0], "Casual \"blitz\"") &&
+    !strcmp(seen.event[1], "Endgame") &&
+    !strcmp(seen.event[3], "Illegal"),
+    "Expected tag values with their escapes removed"
+  );
+  TEST_ASSERT_MESSAGE(
+    seen.result[0] == PGN_RESULT_WHITE && seen.result[1] == PGN_RESULT_DRAW &&
+    seen.result[2] == PGN_RESULT_UNKNOWN && seen.result[3] == PGN_RESULT_BLACK,
+    "Expected each game's result"
+  );
+  TEST_ASSERT_MESSAGE(
+    seen.moves[0] == 0 && !seen.error[3],
+    "Expected no moves decoded when not asked to"
+  );
+}
+
+void test_pgn_decodes_moves_skipping_comments_and_variations()
+{
+  struct seen seen;
+
+  utility_read(games, true, &seen);
+  TEST_ASSERT_MESSAGE(
+    seen.moves[0] == 13 && !seen.error[0],
+    "Expected the 13 moves of the main line"
+  );
+  TEST_ASSERT_MESSAGE(
+    seen.moves[1] == 4 && !seen.error[1] && !seen.start_position[1],
+    "Expected the FEN game decoded from its own position"
+  );
+  TEST_ASSERT_MESSAGE(
+    seen.moves[2] == 3 && !seen.error[2] && seen.start_position[2],
+    "Expected the game after a FEN game back at the start position"
+  );
+  TEST_ASSERT_MESSAGE(
+    seen.moves[3] == 2 && seen.error[3] && seen.start_position[3],
+    "Expected decoding to stop at the illegal Ke3"
+  );
+}
+
+void test_pgn_game_moves_replay_on_the_board()
+{
+  const char *text = "[Event \"x\"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 *\n";
+  pgn_file_t *file;
+  FILE *handle = fopen(PGN_FILE, "w");
+  struct seen seen;
+
+  fputs(text, handle);
+  fclose(handle);
+  file = pgn_open(PGN_FILE);
+  TEST_ASSERT_MESSAGE(file && file->size == strlen(text),
+                      "Expected the file to map");
+
+  memset(&seen, 0, sizeof(seen));
+  TEST_ASSERT_MESSAGE(
+    pgn_read(file, true, utility_collect, &seen) == 1 && seen.moves[0] == 6,
+    "Expected the one game read from the file"
+  );
+  pgn_close(file);
+  TEST_ASSERT_MESSAGE(pgn_open("no_such_file.pgn") == NULL,
+                      "Expected a missing file not to open");
+}
+
+void test_pgn_callback_stops_reading()
+{
+  struct seen seen;
+
+  memset(&seen, 0, sizeof(seen));
+  seen.stop_after = 2;
+  TEST_ASSERT_MESSAGE(
+    pgn_read_buffer(games, strlen(games), true, utility_collect, &seen) == 2,
+    "Expected reading to stop when the callback says so"
+  );
+}
+
+static bool utility_count(const pgn_game_t *game, void *user)
+{
+  long *totals = user;
+
+  __atomic_add_fetch(&totals[0], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&totals[1], game->num_moves, __ATOMIC_RELAXED);
+  return true;
+}
+
+void test_pgn_parallel_reads_every_game_once()
+{
+  FILE *handle = fopen(PGN_FILE, "w");
+  long totals[2] = {0, 0};
+  pgn_file_t *file;
+  int i;
+
+  for (i = 0; i < 500; i++) fputs(games, handle);
+  fclose(handle);
+  file = pgn_open(PGN_FILE);
+
+  TEST_ASSERT_MESSAGE(
+    pgn_read_parallel(file, 7, true, utility_count, totals) == 2000 &&
+    totals[0] == 2000 && totals[1] == 500 * (13 + 4 + 3 + 2),
+    "Expected every game and move read across the threads"
+  );
+  pgn_close(file);
+}
+
+void test_pgn_write_game_reads_back()
+{
+  pgn_tag_t tags[2] = {
+    { "Event", "Say \"hi\"", 5, 8 },
+    { "Result", "0-1", 6, 3 }
+  };
+  const char *moves[] = { "f3", "e5", "g4", "Qh4#" };
+  board_t *board = board_init_start();
+  move_t played[4];
+  board_undo_t undo[4];
+  char text[512];
+  struct seen seen;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    san_parse(board, moves[i], strlen(moves[i]), &played[i]);
+    board_make_move(board, &played[i], &undo[i]);
+  }
+  for (i = 3; i >= 0; i--) board_unmake_move(board, &played[i], &undo[i]);
+
+  TEST_ASSERT_MESSAGE(
+    pgn_write_game(board, tags, 2, played, 4, PGN_RESULT_BLACK, text,
+                   sizeof(text)) > 0 &&
+    !strcmp(text, "[Event \"Say \\\"hi\\\"\"]\n[Result \"0-1\"]\n\n"
+                  "1. f3 e5 2. g4 Qh4# 0-1\n\n"),
+    "Expected the tags escaped and the moves numbered in SAN"
+  );
+
+  utility_read(text, true, &seen);
+  TEST_ASSERT_MESSAGE(
+    seen.games == 1 && seen.moves[0] == 4 && !seen.error[0] &&
+    !strcmp(seen.event[0], "Say \"hi\"") && seen.result[0] == PGN_RESULT_BLACK,
+    "Expected the written game to read back the same"
+  );
+  TEST_ASSERT_MESSAGE(
+    pgn_write_game(board, tags, 2, played, 4, PGN_RESULT_BLACK, text, 40) == -1,
+    "Expected a game that doesn't fit to fail"
+  );
+  board_destroy(board);
+}
+
+void test_pgn_write_game_adds_fen_and_wraps_lines()
+{
+  board_t *board = board_init();
+  move_t moves[PGN_MAX_PLIES];
+  board_undo_t undo[PGN_MAX_PLIES];
+  move_list_t *legal = move_list_new();
+  char text[8192], *line;
+  int i, longest = 0;
+  struct seen seen;
+
+  /* Kings and rooks shuffling from a custom position, black to move */
+  fen_parse(board, "4k3/r7/8/8/8/8/R7/4K3 b - - 0 30", 33, NULL);
+  for (i = 0; i < 120; i++) {
+    move_list_clear(legal);
+    move_gen_legal(board, legal);
+    moves[i] = legal->moves[i % legal->num_moves];
+    board_make_move(board, &moves[i], &undo[i]);
+  }
+  while (i--) board_unmake_move(board, &moves[i], &undo[i]);
+  move_list_destroy(legal);
+
+  TEST_ASSERT_MESSAGE(
+    pgn_write_game(board, NULL, 0, moves, 120, PGN_RESULT_UNKNOWN, text,
+                   sizeof(text)) > 0 &&
+    strstr(text, "[FEN \"4k3/r7/8/8/8/8/R7/4K3 b - - 0 30\"]") &&
+    strstr(text, "\n\n30... "),
+    "Expected a FEN tag and black's first move numbered 30..."
+  );
+  for (line = text; line; line = strchr(line, '\n'))
+    if (*line == '\n') line++;
+    else {
+      longest = strcspn(line, "\n") > longest ? strcspn(line, "\n") : longest;
+      line = strchr(line, '\n');
+    }
+  TEST_ASSERT_MESSAGE(longest <= PGN_LINE_LENGTH,
+                      "Expected the movetext wrapped");
+
+  utility_read(text, true, &seen);
+  TEST_ASSERT_MESSAGE(seen.moves[0] == 120 && !seen.error[0],
+                      "Expected the custom-start game to read back");
+  board_destroy(board);
+}
@@ -0,0 +1,114 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "file-utils.h"
+#include "fen.h"
+#include "san.h"
+#include "pgn.h"
+#include "queue.h"
+#include "pgn_export.h"
+
+#define EXPORT_FILE "test_pgn_export.pgn"
+#define THREADS 4
+#define GAMES_PER_THREAD 250
+
+static pgn_export_t *export;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+  remove(EXPORT_FILE);
+}
+
+static bool utility_check(const pgn_game_t *game, void *user)
+{
+  long *counts = user;
+
+  counts[0]++;
+  counts[1] += game->num_moves == 4 && !game->error;
+  return true;
+}
+
+/* Each thread plays its own fool's mate and exports it */
+static void* utility_export(void *arg)
+{
+  const char *sans[] = { "f3", "e5", "g4", "Qh4#" };
+  pgn_tag_t tags[1] = { { "Event", "Export", 5, 6 } };
+  board_t *board = board_init_start();
+  board_undo_t undo[4];
+  move_t moves[4];
+  int i, game;
+
+  (void)arg;
+  for (i = 0; i < 4; i++) {
+    san_parse(board, sans[i], strlen(sans[i]), &moves[i]);
+    board_make_move(board, &moves[i], &undo[i]);
+  }
+  for (i = 3; i >= 0; i--) board_unmake_move(board, &moves[i], &undo[i]);
+
+  for (game = 0; game < GAMES_PER_THREAD; game++)
+    pgn_export_game(export, board, tags, 1, moves, 4, PGN_RESULT_BLACK);
+  board_destroy(board);
+  return NULL;
+}
+
+void test_pgn_export_writes_every_game_from_every_thread()
+{
+  pthread_t threads[THREADS];
+  long counts[2] = {0, 0};
+  pgn_file_t *file;
+  int i;
+
+  export = pgn_export_open(EXPORT_FILE, false);
+  TEST_ASSERT_MESSAGE(export != NULL, "Expected the export file to open");
+
+  for (i = 0; i < THREADS; i++)
+    pthread_create(&threads[i], NULL, utility_export, NULL);
+  for (i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+  TEST_ASSERT_MESSAGE(pgn_export_close(export) == 0,
+                      "Expected the export to close cleanly");
+
+  file = pgn_open(EXPORT_FILE);
+  pgn_read(file, true, utility_check, counts);
+  pgn_close(file);
+  TEST_ASSERT_MESSAGE(
+    counts[0] == THREADS * GAMES_PER_THREAD && counts[1] == counts[0],
+    "Expected every exported game whole in the file"
+  );
+}
+
+void test_pgn_export_appends()
+{
+  board_t *board = board_init_start();
+  long counts[2] = {0, 0};
+  pgn_file_t *file;
+  int round;
+
+  for (round = 0; round < 2; round++) {
+    export = pgn_export_open(EXPORT_FILE, true);
+    pgn_export_game(export, board, NULL, 0, NULL, 0, PGN_RESULT_DRAW);
+    pgn_export_close(export);
+  }
+  file = pgn_open(EXPORT_FILE);
+  pgn_read(file, false, utility_check, counts);
+  pgn_close(file);
+  board_destroy(board);
+
+  TEST_ASSERT_MESSAGE(counts[0] == 2, "Expected the second game appended");
+  TEST_ASSERT_MESSAGE(pgn_export_open("no_such_dir/x.pgn", false) == NULL,
+                      "Expected an unwritable path to fail");
+}
@@ -0,0 +1,186 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "file-utils.h"
+#include "fen.h"
+#include "san.h"
+#include "pgn.h"
+#include "position_index.h"
+
+#define PGN_FILE   "test_position_index.pgn"
+#define INDEX_FILE "test_position_index.pix"
+#define NUM_GAMES  150
+
+static const char *openings[3] = {
+  "1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 d6",
+  "1. d4 Nf6 2. c4 e6 3. Nc3 Bb4 4. e3 O-O 5. Bd3 d5 6. Nf3 c5 7. O-O Nc6",
+  "1. e4 c5 2. Nf3 d6 3. d4 cxd4 4. Nxd4 Nf6 5. Nc3 a6 6. Be3 e5 7. Nb3 Be6"
+};
+
+static long offsets[NUM_GAMES];
+
+static uint64_t utility_hash(const char *fen)
+{
+  board_t *board = fen_board(fen);
+  uint64_t hash = board->hash;
+
+  board_destroy(board);
+  return hash;
+}
+
+void setUp(void)
+{
+  FILE *handle = fopen(PGN_FILE, "w");
+  int i;
+
+  /* Game i plays opening i % 3; every game also ends in the same way */
+  for (i = 0; i < NUM_GAMES; i++) {
+    offsets[i] = ftell(handle);
+    fprintf(handle, "[Event \"Game %d\"]\n\n%s 1/2-1/2\n\n", i,
+            openings[i % 3]);
+  }
+  fclose(handle);
+}
+
+void tearDown(void)
+{
+  remove(PGN_FILE);
+  remove(INDEX_FILE);
+}
+
+void test_position_index_finds_every_game_through_several_runs()
+{
+  position_hit_t hits[NUM_GAMES];
+  position_index_t *index;
+  long found, i;
+  bool right = true;
+
+  /* A budget too small for the postings forces spilled runs */
+  TEST_ASSERT_MESSAGE(
+    position_index_build(PGN_FILE, INDEX_FILE, ".", 2, 1024, NULL) == 0,
+    "Expected the index to build"
+  );
+  index = position_index_open(INDEX_FILE);
+  TEST_ASSERT_MESSAGE(
+    index && index->header->num_games == NUM_GAMES &&
+    index->header->num_postings == NUM_GAMES * 15,
+    "Expected every position of every game indexed"
+  );
+
+  found = position_index_query(index, utility_hash(FEN_START_POSITION),
+                               hits, NUM_GAMES);
+  for (i = 0; i < found; i++)
+    right &= hits[i].game == (uint64_t)offsets[i] && hits[i].ply == 0;
+  TEST_ASSERT_MESSAGE(found == NUM_GAMES && right,
+                      "Expected every game at ply 0, in file order");
+
+  /* After 1. e4, only the Spanish and the Sicilian games */
+  found = position_index_query(index, utility_hash(
+    "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1"),
+    hits, 10);
+  TEST_ASSERT_MESSAGE(
+    found == 100 && hits[0].game == (uint64_t)offsets[0] &&
+    hits[1].game == (uint64_t)offsets[2] && hits[1].ply == 1,
+    "Expected the e4 games, with only 'max' of them stored"
+  );
+
+  TEST_ASSERT_MESSAGE(
+    position_index_query(index, utility_hash("4k3/8/8/8/8/8/8/4K3 w - - 0 1"),
+                         hits, 10) == 0,
+    "Expected no games for a position never reached"
+  );
+  position_index_close(index);
+}
+
+void test_position_index_merges_more_runs_than_it_opens_at_once()
+{
+  /* About 136 games fill a thread's smallest buffer: enough games for
+   * two merge passes before the final merge */
+  long games = (2 * POSITION_INDEX_MERGE_WAYS + 8) * 140L, found, i;
+  position_hit_t *hits = malloc(games * sizeof(position_hit_t) );
+  long *offset = malloc(games * sizeof(long) );
+  FILE *handle = fopen(PGN_FILE, "w");
+  position_index_t *index;
+  bool right = true;
+
+  for (i = 0; i < games; i++) {
+    offset[i] = ftell(handle);
+    fprintf(handle, "[Event \"Game %ld\"]\n\n%s 1/2-1/2\n\n", i,
+            openings[i % 3]);
+  }
+  fclose(handle);
+
+  TEST_ASSERT_MESSAGE(
+    position_index_build(PGN_FILE, INDEX_FILE, ".", 1, 1024, NULL) == 0,
+    "Expected the index to build from many runs"
+  );
+  index = position_index_open(INDEX_FILE);
+  found = position_index_query(index, utility_hash(FEN_START_POSITION),
+                               hits, games);
+  for (i = 0; i < found; i++)
+    right &= hits[i].game == (uint64_t)offset[i] && hits[i].ply == 0;
+  TEST_ASSERT_MESSAGE(
+    index && index->header->num_postings == (uint64_t)games * 15 &&
+    found == games && right,
+    "Expected every game at ply 0, in file order, after merge passes"
+  );
+
+  position_index_close(index);
+  free(hits);
+  free(offset);
+}
+
+void test_position_index_counts_a_repeated_position_once_per_game()
+{
+  position_hit_t hits[4];
+  position_index_t *index;
+  FILE *handle = fopen(PGN_FILE, "w");
+  long second, found;
+
+  /* The knights go out and back: the start position again at ply 4 */
+  fprintf(handle, "[Event \"Shuffle\"]\n\n"
+          "1. Nf3 Nf6 2. Ng1 Ng8 3. e4 1/2-1/2\n\n");
+  second = ftell(handle);
+  fprintf(handle, "[Event \"Plain\"]\n\n1. d4 d5 1/2-1/2\n\n");
+  fclose(handle);
+
+  TEST_ASSERT_MESSAGE(
+    position_index_build(PGN_FILE, INDEX_FILE, ".", 1, 1 << 20, NULL) == 0,
+    "Expected the index to build"
+  );
+  index = position_index_open(INDEX_FILE);
+  found = position_index_query(index, utility_hash(FEN_START_POSITION),
+                               hits, 4);
+  TEST_ASSERT_MESSAGE(
+    index && index->header->num_postings == 6 + 3 && found == 2 &&
+    hits[0].game == 0 && hits[0].ply == 0 &&
+    hits[1].game == (uint64_t)second && hits[1].ply == 0,
+    "Expected each game once, at the first ply it reached the position"
+  );
+  position_index_close(index);
+}
+
+void test_position_index_rejects_other_files()
+{
+  TEST_ASSERT_MESSAGE(
+    position_index_open(PGN_FILE) == NULL &&
+    position_index_open("no_such_index.pix") == NULL,
+    "Expected only index files to open"
+  );
+  TEST_ASSERT_MESSAGE(
+    position_index_build("no_such_games.pgn", INDEX_FILE, ".", 1, 1 << 20,
+                         NULL) == -1 &&
+    !file_utils_exists(INDEX_FILE),
+    "Expected a failed build to leave no index behind"
+  );
+}
@@ -0,0 +1,215 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "board.h"
+#include "square.h"
+#include "piece.h"
+#include "move.h"
+#include "move_list.h"
+#include "move_gen.h"
+#include "zobrist.h"
+#include "file-utils.h"
+#include "fen.h"
+#include "san.h"
+
+static board_t *board;
+
+void setUp(void)
+{
+  board = board_init();
+}
+
+void tearDown(void)
+{
+  board_destroy(board);
+}
+
+static void utility_setup(const char *fen)
+{
+  fen_parse(board, fen, strlen(fen), NULL);
+}
+
+/* Parse a move and compare it with the coordinate form */
+static bool utility_parses_to(const char *san, const char *coordinates)
+{
+  move_t move, expected;
+
+  if (san_parse(board, san, strlen(san), &move)) return false;
+  if (!move_gen_find_string(board, coordinates, &expected)) return false;
+  return move_pack(&move) == move_pack(&expected) &&
+         move.flags == expected.flags;
+}
+
+void test_san_parses_pawn_and_piece_moves()
+{
+  utility_setup(FEN_START_POSITION);
+  TEST_ASSERT_MESSAGE(
+    utility_parses_to("e4", "e2e4") && utility_parses_to("e3", "e2e3") &&
+    utility_parses_to("Nf3", "g1f3") && utility_parses_to("Nc3+", "b1c3") &&
+    utility_parses_to("Pd4", "d2d4") && utility_parses_to("Na3!?", "b1a3"),
+    "Expected pushes and knight moves from the start position"
+  );
+
+  move_t move;
+  TEST_ASSERT_MESSAGE(
+    san_parse(board, "e5", 2, &move) == -1 &&
+    san_parse(board, "Bc4", 3, &move) == -1 &&
+    san_parse(board, "Ke2", 3, &move) == -1 &&
+    san_parse(board, "Nf3x", 4, &move) == -1 &&
+    san_parse(board, "", 0, &move) == -1,
+    "Expected unreachable squares and garbage to be rejected"
+  );
+}
+
+void test_san_disambiguates_by_file_rank_and_legality()
+{
+  move_t move;
+
+  /* Knights on b1 and f1 both reach d2; rooks on a1 and a5 both reach a3 */
+  utility_setup("4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1");
+  TEST_ASSERT_MESSAGE(
+    san_parse(board, "Nd2", 3, &move) == -2 &&
+    san_parse(board, "Ra3", 3, &move) == -2,
+    "Expected an ambiguous move to be reported as such"
+  );
+  TEST_ASSERT_MESSAGE(
+    utility_parses_to("Nbd2", "b1d2") && utility_parses_to("Nfd2", "f1d2") &&
+    utility_parses_to("R1a3", "a1a3") && utility_parses_to("R5a3", "a5a3") &&
+    utility_parses_to("Ra1a3", "a1a3"),
+    "Expected file and rank disambiguation to pick the piece"
+  );
+
+  /* The knight on d2 is pinned, so Nf3 can only be the other knight */
+  utility_setup("3qk3/8/8/8/8/8/3N4/3K2N1 w - - 0 1");
+  TEST_ASSERT_MESSAGE(
+    utility_parses_to("Nf3", "g1f3"),
+    "Expected a pinned piece not to make the move ambiguous"
+  );
+}
+
+void test_san_parses_captures_en_passant_and_promotion()
+{
+  utility_setup("r3k3/1P6/8/3pP3/8/8/8/4K3 w - d6 0 1");
+  TEST_ASSERT_MESSAGE(
+    utility_parses_to("exd6", "e5d6") && utility_parses_to("ed6", "e5d6"),
+    "Expected the en passant capture"
+  );
+  TEST_ASSERT_MESSAGE(
+    utility_parses_to("bxa8=Q+", "b7a8q") &&
+    utility_parses_to("bxa8N", "b7a8n") &&
+    utility_parses_to("b8=R", "b7b8r"),
+    "Expected capturing and quiet promotions"
+  );
+
+  move_t move;
+  TEST_ASSERT_MESSAGE(
+    san_parse(board, "b8", 2, &move) == -1 &&
+    san_parse(board, "e6=Q", 4, &move) == -1 &&
+    san_parse(board, "b8=K", 4, &move) == -1,
+    "Expected a missing or misplaced promotion piece to be rejected"
+  );
+}
+
+void test_san_parses_castling_with_letters_or_zeros()
+{
+  utility_setup("r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1");
+  TEST_ASSERT_MESSAGE(
+    utility_parses_to("O-O", "e8g8") && utility_parses_to("0-0-0", "e8c8") &&
+    utility_parses_to("O-O-O+", "e8c8"),
+    "Expected both castles for black"
+  );
+
+  move_t move;
+  board->castle_rights = CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN;
+  board_refresh(board);
+  TEST_ASSERT_MESSAGE(
+    san_parse(board, "O-O", 3, &move) == -1 &&
+    san_parse(board, "O-O-O-O", 7, &move) == -1,
+    "Expected no castling without the right"
+  );
+}
+
+static bool utility_writes(const char *coordinates, const char *san)
+{
+  char buffer[SAN_MAX_LENGTH];
+  move_t move;
+
+  move_gen_find_string(board, coordinates, &move);
+  san_write(board, &move, NULL, buffer);
+  return !strcmp(buffer, san);
+}
+
+void test_san_write_disambiguates_only_when_needed()
+{
+  utility_setup("4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1");
+  TEST_ASSERT_MESSAGE(
+    utility_writes("b1d2", "Nbd2") && utility_writes("a1a3", "R1a3") &&
+    utility_writes("b1c3", "Nc3") && utility_writes("e1e2", "Ke2"),
+    "Expected file or rank only where another piece reaches the square"
+  );
+
+  /* Three queens reaching d4: neither file nor rank alone is enough */
+  utility_setup("8/7k/8/8/Q7/8/8/Q2Q2K1 w - - 0 1");
+  TEST_ASSERT_MESSAGE(
+    utility_writes("a1d4", "Qa1d4") && utility_writes("a4a2", "Q4a2") &&
+    utility_writes("d1d3", "Qd3+"),
+    "Expected both, rank, or nothing as the other queens require"
+  );
+
+  /* A pinned twin doesn't count */
+  utility_setup("3qk3/8/8/8/8/8/3N4/3K2N1 w - - 0 1");
+  TEST_ASSERT_MESSAGE(utility_writes("g1f3", "Nf3"),
+                      "Expected no disambiguation against a pinned piece");
+}
+
+void test_san_write_pawns_castles_checks_and_mates()
+{
+  utility_setup("r3k2r/1P6/8/3pP3/8/8/8/R3K2R w KQkq d6 0 1");
+  TEST_ASSERT_MESSAGE(
+    utility_writes("e5d6", "exd6") && utility_writes("b7a8q", "bxa8=Q+") &&
+    utility_writes("b7b8n", "b8=N") && utility_writes("e1c1", "O-O-O") &&
+    utility_writes("e1g1", "O-O"),
+    "Expected pawn, castling and checking moves"
+  );
+
+  utility_setup("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+  TEST_ASSERT_MESSAGE(utility_writes("a1a8", "Ra8#"),
+                      "Expected the back rank mate marked as mate");
+}
+
+/* Every legal move, written and read back, is the same move */
+static long utility_round_trip(int depth)
+{
+  char buffer[SAN_MAX_LENGTH];
+  move_list_t *moves = move_list_new();
+  board_undo_t undo;
+  long failures = 0;
+  move_t parsed;
+  int i;
+
+  move_gen_legal(board, moves);
+  for (i = 0; i < moves->num_moves; i++) {
+    san_write(board, &moves->moves[i], moves, buffer);
+    if (san_parse(board, buffer, strlen(buffer), &parsed) ||
+        move_pack(&parsed) != move_pack(&moves->moves[i]))
+      failures++;
+    if (depth > 1) {
+      board_make_move(board, &moves->moves[i], &undo);
+      failures += utility_round_trip(depth - 1);
+      board_unmake_move(board, &moves->moves[i], &undo);
+    }
+  }
+  move_list_destroy(moves);
+  return failures;
+}
+
+void test_san_write_and_parse_round_trip()
+{
+  utility_setup(
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+  TEST_ASSERT_MESSAGE(utility_round_trip(3) == 0,
+                      "Expected every Kiwipete move to survive SAN");
+}
@@ -0,0 +1,160 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "timer.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_timer_accumulates_across_runs()
+{
+  chess_timer_t timer;
+  timer_reset(&timer);
+
+  timer_start(&timer);
+  usleep(20000);
+  timer_stop(&timer);
+  usleep(20000);
+  timer_start(&timer);
+  usleep(20000);
+  timer_stop(&timer);
+
+  int64_t elapsed = timer_elapsed_ms(&timer);
+  TEST_ASSERT_MESSAGE(
+    elapsed >= 40 && elapsed < 60 + 200,
+    "Expected the timer to count only the two running periods"
+  );
+}
+
+void test_game_clock_starts_stopped_with_base_time()
+{
+  game_clock_t *clock = game_clock_init(GAME_CLOCK_FISCHER, 60000, 1000);
+  TEST_ASSERT_MESSAGE(
+    game_clock_remaining_ms(clock, WHITE) == 60000 &&
+    game_clock_remaining_ms(clock, BLACK) == 60000,
+    "Expected both sides to start with the base time"
+  );
+  game_clock_destroy(clock);
+}
+
+void test_game_clock_fischer_adds_increment_on_press()
+{
+  game_clock_t *clock = game_clock_init(GAME_CLOCK_FISCHER, 60000, 1000);
+  game_clock_start(clock, WHITE);
+  game_clock_press(clock);
+
+  TEST_ASSERT_MESSAGE(
+    game_clock_remaining_ms(clock, WHITE) > 60000,
+    "Expected an instant move to gain the increment"
+  );
+  TEST_ASSERT_MESSAGE(
+    clock->on_move == BLACK && clock->moves[WHITE] == 1,
+    "Expected pressing the clock to hand the move to BLACK"
+  );
+  game_clock_destroy(clock);
+}
+
+void test_game_clock_delay_is_free_time()
+{
+  game_clock_t *clock = game_clock_init(GAME_CLOCK_DELAY, 60000, 5000);
+  game_clock_start(clock, WHITE);
+  usleep(20000);
+
+  TEST_ASSERT_MESSAGE(
+    game_clock_remaining_ms(clock, WHITE) == 60000,
+    "Expected time inside the delay not to be charged"
+  );
+  game_clock_press(clock);
+  TEST_ASSERT_MESSAGE(
+    game_clock_remaining_ms(clock, WHITE) == 60000,
+    "Expected a move inside the delay to cost nothing and gain nothing"
+  );
+  game_clock_destroy(clock);
+}
+
+void test_game_clock_flags_when_time_runs_out()
+{
+  game_clock_t *clock = game_clock_init(GAME_CLOCK_FISCHER, 10, 0);
+  game_clock_start(clock, BLACK);
+  usleep(30000);
+
+  TEST_ASSERT_MESSAGE(
+    game_clock_flagged(clock, BLACK) && !game_clock_flagged(clock, WHITE),
+    "Expected only BLACK, whose clock ran, to flag"
+  );
+  game_clock_destroy(clock);
+}
+
+void test_game_clock_reset_starts_a_new_game()
+{
+  game_clock_t *clock = game_clock_init(GAME_CLOCK_FISCHER, 60000, 2000);
+
+  game_clock_start(clock, WHITE);
+  game_clock_press(clock);
+  game_clock_press(clock);
+  game_clock_reset(clock, 30000);
+  TEST_ASSERT_MESSAGE(
+    !clock->turn.running && clock->on_move == WHITE &&
+    clock->moves[WHITE] == 0 && clock->moves[BLACK] == 0 &&
+    game_clock_remaining_ms(clock, WHITE) == 30000 &&
+    game_clock_remaining_ms(clock, BLACK) == 30000 &&
+    clock->mode == GAME_CLOCK_FISCHER && clock->bonus_ms == 2000,
+    "Expected a stopped clock with the new base time and the same mode"
+  );
+  game_clock_destroy(clock);
+}
+
+#define PROFILE_THREADS       4
+#define PROFILE_THREAD_CALLS  1000
+
+/* Measure PROFILE_THREAD_CALLS empty move_gen regions, then exit */
+static void* utility_profile_worker(void *unused)
+{
+  int i;
+  for (i = 0; i < PROFILE_THREAD_CALLS; i++) {
+    TIMER_PROFILE_SCOPE(PROFILE_MOVE_GEN);
+  }
+  return NULL;
+}
+
+void test_timer_profile_counts_scoped_regions()
+{
+  timer_profile_reset();
+  {
+    TIMER_PROFILE_SCOPE(PROFILE_EVAL);
+    usleep(1000);
+  }
+  TEST_ASSERT_MESSAGE(
+    timer_profile_calls(PROFILE_EVAL) == 1 &&
+    timer_profile_cycles(PROFILE_EVAL) > 0,
+    "Expected leaving the scope to record one measurement"
+  );
+}
+
+void test_timer_profile_sums_every_thread()
+{
+  pthread_t threads[PROFILE_THREADS];
+  int i;
+
+  timer_profile_reset();
+  for (i = 0; i < PROFILE_THREADS; i++)
+    pthread_create(&threads[i], NULL, utility_profile_worker, NULL);
+  for (i = 0; i < PROFILE_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  {
+    TIMER_PROFILE_SCOPE(PROFILE_MOVE_GEN);
+  }
+  TEST_ASSERT_MESSAGE(
+    timer_profile_calls(PROFILE_MOVE_GEN) ==
+    PROFILE_THREADS * PROFILE_THREAD_CALLS + 1,
+    "Expected the exited threads' measurements to be kept"
+  );
+
+  timer_profile_reset();
+  TEST_ASSERT_MESSAGE(timer_profile_calls(PROFILE_MOVE_GEN) == 0,
+                      "Expected a reset to zero every thread's counts");
+}
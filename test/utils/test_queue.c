@@ -0,0 +1,76 @@
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "queue.h"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 100000
+
+static queue_t *queue;
+
+void setUp(void)
+{
+  queue = queue_init(100);
+}
+
+void tearDown(void)
+{
+  queue_destroy(queue);
+}
+
+void test_queue_is_first_in_first_out_and_bounded()
+{
+  intptr_t i;
+
+  TEST_ASSERT_MESSAGE(queue && queue->mask == 127,
+                      "Expected the capacity rounded up to 128");
+  TEST_ASSERT_MESSAGE(queue_empty(queue) && queue_pop(queue) == NULL,
+                      "Expected a new queue to be empty");
+
+  for (i = 1; i <= 128; i++) queue_push(queue, (void *)i);
+  TEST_ASSERT_MESSAGE(!queue_push(queue, (void *)i),
+                      "Expected a push to a full queue to fail");
+
+  for (i = 1; i <= 128; i++)
+    if (queue_pop(queue) != (void *)i) break;
+  TEST_ASSERT_MESSAGE(i == 129 && queue_empty(queue),
+                      "Expected pointers back in the order pushed");
+}
+
+static void* utility_produce(void *arg)
+{
+  intptr_t base = (intptr_t)arg, i;
+
+  for (i = 0; i < PER_PRODUCER; i++)
+    while (!queue_push(queue, (void *)(base + i + 1))) ;
+  return NULL;
+}
+
+void test_queue_loses_nothing_between_threads()
+{
+  pthread_t threads[PRODUCERS];
+  intptr_t next[PRODUCERS] = {0}, value;
+  long popped = 0;
+  bool ordered = true;
+  int i, producer;
+
+  for (i = 0; i < PRODUCERS; i++)
+    pthread_create(&threads[i], NULL, utility_produce,
+                   (void *)(intptr_t)(i * PER_PRODUCER * 2));
+
+  while (popped < PRODUCERS * PER_PRODUCER) {
+    if (!(value = (intptr_t)queue_pop(queue))) continue;
+    producer = (value - 1) / (PER_PRODUCER * 2);
+    ordered &= value - 1 - producer * PER_PRODUCER * 2 == next[producer];
+    next[producer]++;
+    popped++;
+  }
+  for (i = 0; i < PRODUCERS; i++) pthread_join(threads[i], NULL);
+
+  TEST_ASSERT_MESSAGE(ordered && queue_empty(queue),
+                      "Expected each producer's pointers once, in order");
+}